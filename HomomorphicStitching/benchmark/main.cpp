@@ -0,0 +1,166 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "Emulation.h"
+#include "Golombs.h"
+#include "Headers.h"
+#include "SliceSegmentLayer.h"
+#include "StitchContext.h"
+#include "Stitcher.h"
+
+using stitching::bytestring;
+using stitching::Headers;
+using stitching::StitchContext;
+
+/* Usage */
+// ./header_benchmark
+// <path to an annex-b HEVC tile without tiles enabled, e.g. one GOP written by TASM> - 1
+// <number of iterations> - 2 (optional, default 1000)
+//
+// Reports how many parameter set groups (VPS/SPS/PPS) and slice segment headers are parsed per second, how many
+// slice headers are rewritten per second by SetAddressAndPPSId, and how many exp-Golomb codes are encoded per second.
+// Also reports the throughput of emulation prevention over whole nals and of stitching the file as a 2x2 tiling: into
+// a single buffer, reusing a cached stitch plan, and as a list of ranges that refer to the tiles.
+
+static std::list<bytestring> SplitNals(const bytestring &stream) {
+    std::list<bytestring> nals;
+    auto zero_count = 0u;
+    auto start = stream.end();
+    for (auto it = stream.begin(); it != stream.end(); it++) {
+        auto c = static_cast<unsigned char>(*it);
+        if (c == 1 && zero_count >= 2) {
+            if (start != stream.end())
+                nals.emplace_back(start, it - std::min(zero_count, 3u));
+            start = it + 1;
+            zero_count = 0;
+        } else if (c == 0) {
+            zero_count++;
+        } else {
+            zero_count = 0;
+        }
+    }
+    if (start != stream.end())
+        nals.emplace_back(start, stream.end());
+    return nals;
+}
+
+template<typename Function>
+static void Measure(const std::string &name, unsigned long count, Function function) {
+    auto start = std::chrono::high_resolution_clock::now();
+    function();
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    std::cout << name << ": " << static_cast<unsigned long>(count / elapsed.count()) << " per second ("
+              << count << " in " << elapsed.count() << " s)" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <annex-b HEVC file> [iterations]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream istrm(argv[1], std::ios::binary);
+    std::stringstream buffer;
+    buffer << istrm.rdbuf();
+    auto contents = buffer.str();
+    auto nals = SplitNals(bytestring(contents.begin(), contents.end()));
+    auto iterations = argc > 2 ? std::stoul(argv[2]) : 1000ul;
+
+    std::list<bytestring> segments;
+    for (const auto &nal : nals) {
+        if (stitching::IsSegment(nal))
+            segments.push_back(nal);
+    }
+
+    StitchContext context({1, 1}, {0, 0});
+    Headers headers(context, nals);
+
+    // Defeats dead-code elimination.
+    unsigned long checksum = 0;
+
+    Measure("parameter sets parsed", iterations, [&] {
+        for (auto i = 0u; i < iterations; i++)
+            checksum += Headers(context, nals).GetSequence()->GetAddressLength();
+    });
+
+    Measure("slice headers parsed", iterations * segments.size(), [&] {
+        for (auto i = 0u; i < iterations; i++) {
+            for (const auto &segment : segments)
+                checksum += stitching::Load(context, segment, headers).getEnd();
+        }
+    });
+
+    Measure("slice headers rewritten", iterations * segments.size(), [&] {
+        for (auto i = 0u; i < iterations; i++) {
+            for (const auto &segment : segments) {
+                auto layer = stitching::Load(context, segment, headers);
+                checksum += layer.SetAddressAndPPSId(0, 1);
+                checksum += layer.GetHeaderBytes().size();
+            }
+        }
+    });
+
+    std::vector<unsigned long> values(1024);
+    for (auto i = 0u; i < values.size(); i++)
+        values[i] = (i * 2654435761u) % (1u << (i % 20));
+    Measure("exp-Golomb codes encoded", iterations * values.size(), [&] {
+        for (auto i = 0u; i < iterations; i++)
+            checksum += stitching::EncodeGolombs(values).size();
+    });
+
+    unsigned long nal_bytes = 0;
+    for (const auto &nal : nals)
+        nal_bytes += nal.size();
+
+    Measure("emulation prevention removed (bytes)", iterations * nal_bytes, [&] {
+        for (auto i = 0u; i < iterations; i++) {
+            for (const auto &nal : nals)
+                checksum += stitching::RemoveEmulationPreventionBytes(nal, stitching::GetHeaderSize(), nal.size()).size();
+        }
+    });
+
+    std::vector<stitching::BitArray> rbsps;
+    for (const auto &nal : nals)
+        rbsps.push_back(stitching::RemoveEmulationPrevention(nal, stitching::GetHeaderSize(), nal.size()));
+    Measure("emulation prevention added (bytes)", iterations * nal_bytes, [&] {
+        for (auto i = 0u; i < iterations; i++) {
+            for (const auto &rbsp : rbsps)
+                checksum += stitching::AddEmulationPreventionAndMarker(rbsp, stitching::GetHeaderSize(), rbsp.size() / 8).size();
+        }
+    });
+
+    auto stitch_iterations = std::max(1ul, iterations / 100);
+    // Share the tiles across iterations so that copying them into place is not measured.
+    std::vector<std::shared_ptr<const bytestring>> tiles;
+    for (auto i = 0u; i < 4; i++)
+        tiles.push_back(std::make_shared<bytestring>(contents.begin(), contents.end()));
+    auto sequence = headers.GetSequence()->GetTileDimensions();
+    StitchContext stitch_context({2, 2}, {2 * sequence.first, 2 * sequence.second});
+    Measure("stitched 2x2 (tile bytes)", stitch_iterations * 4 * contents.size(), [&] {
+        for (auto i = 0u; i < stitch_iterations; i++) {
+            stitching::Stitcher stitcher(stitch_context, tiles);
+            checksum += stitcher.GetStitchedSegments()->size();
+        }
+    });
+
+    stitching::StitchPlanCache cache;
+    Measure("stitched 2x2 with a cached plan (tile bytes)", stitch_iterations * 4 * contents.size(), [&] {
+        for (auto i = 0u; i < stitch_iterations; i++) {
+            stitching::Stitcher stitcher(stitch_context, tiles, cache);
+            checksum += stitcher.GetStitchedSegments()->size();
+        }
+    });
+
+    Measure("stitched 2x2 as ranges (tile bytes)", stitch_iterations * 4 * contents.size(), [&] {
+        for (auto i = 0u; i < stitch_iterations; i++) {
+            stitching::Stitcher stitcher(stitch_context, tiles);
+            checksum += stitcher.StitchSegments().size();
+        }
+    });
+
+    std::cout << "checksum: " << checksum << std::endl;
+    return 0;
+}
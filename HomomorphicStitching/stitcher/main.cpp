@@ -1,17 +1,30 @@
 #include <iostream>
 #include <string>
 #include <fstream>
-#include <streambuf>
 #include <sstream>
 #include <cstring>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "StitchContext.h"
 #include "Stitcher.h"
 
 using std::string;
 using std::vector;
+using stitching::bytestring_view;
 using stitching::StitchContext;
+using stitching::StitchedSegments;
 using stitching::Stitcher;
+using stitching::StitchPlanCache;
 
 /* Usage */
 // ./stitcher
@@ -25,84 +38,351 @@ using stitching::Stitcher;
 // If not uniform: PPS_id - + 10
 // If not uniform: <heights of first n-1 rows, in CTBs> - + 11
 // If not uniform: <widths of first n-1 columns, in CTBs> - + 11 + num_rows - 1
+//
+// ./stitcher batch <path to manifest> [<number of threads>]
+// Each line of the manifest holds the arguments above for one GOP, separated by whitespace. Blank lines and lines starting
+// with '#' are ignored. GOPs are stitched in parallel, and GOPs with the same output path are appended to it in manifest
+// order, so a whole video can be restitched by listing its GOPs in order.
 
-int main(int argc, char *argv[]) {
-    if (!strcmp(argv[1], "save_active_parameter_sets_sei")) {
-        auto sei = Stitcher::GetActiveParameterSetsSEI();
+struct StitchJob {
+    vector<string> tile_paths;
+    StitchContext context;
+    string output_path;
+};
 
-        std::ofstream ostrm(argv[2]);
-        for (auto c : *sei) {
-            ostrm << c;
-        }
-        ostrm.close();
-        return 0;
-    }
+static StitchJob ParseJob(const vector<string> &args) {
+    auto arg = [&](size_t index) -> const string& {
+        if (index >= args.size())
+            throw std::invalid_argument("Expected at least " + std::to_string(index + 1) + " arguments");
+        return args[index];
+    };
 
-    int num_tiles = std::stoi(argv[1]);
-    vector<vector<char>> tiles(num_tiles);
-    for (int i = 0; i < num_tiles; i++) {
-        std::ifstream istrm;
-        istrm.open(argv[i + 2]);
-        std::stringstream buffer;
-        buffer << istrm.rdbuf();
-        string tile = buffer.str();
-        tiles[i] = vector<char>(tile.begin(), tile.end());
-    }
+    int num_tiles = std::stoi(arg(0));
+    vector<string> tile_paths(num_tiles);
+    for (int i = 0; i < num_tiles; i++)
+        tile_paths[i] = arg(i + 1);
 
     std::pair<unsigned int, unsigned int> tile_dimensions;
     std::pair<unsigned int, unsigned int> video_dimensions;
     std::pair<unsigned int, unsigned int> video_display_dimensions;
-    int number_of_rows = std::stoi(argv[num_tiles + 2]);
-    int number_of_columns = std::stoi(argv[num_tiles + 3]);
+    int number_of_rows = std::stoi(arg(num_tiles + 1));
+    int number_of_columns = std::stoi(arg(num_tiles + 2));
     tile_dimensions.first = number_of_rows;
     tile_dimensions.second = number_of_columns;
-    video_dimensions.first = std::stoi(argv[num_tiles + 4]);
-    video_dimensions.second = std::stoi(argv[num_tiles + 5]);
-    video_display_dimensions.first = std::stoi(argv[num_tiles + 6]);
-    video_display_dimensions.second = std::stoi(argv[num_tiles + 7]);
+    video_dimensions.first = std::stoi(arg(num_tiles + 3));
+    video_dimensions.second = std::stoi(arg(num_tiles + 4));
+    video_display_dimensions.first = std::stoi(arg(num_tiles + 5));
+    video_display_dimensions.second = std::stoi(arg(num_tiles + 6));
 
     // See if uniform tiles should be used.
-    bool should_use_uniform_tiles = std::stoi(argv[num_tiles + 9]);
+    bool should_use_uniform_tiles = std::stoi(arg(num_tiles + 8));
     unsigned int pps_id = 0;
 
     std::vector<unsigned int> tile_heights;
     std::vector<unsigned int> tile_widths;
     if (!should_use_uniform_tiles) {
-        pps_id = std::stoi(argv[num_tiles + 10]);
+        pps_id = std::stoi(arg(num_tiles + 9));
 
         // Read in tile heights and tile widths.
         tile_heights.resize(number_of_rows - 1);
         for (int i = 0; i < number_of_rows - 1; ++i)
-            tile_heights[i] = std::stoi(argv[num_tiles + 11 + i]);
+            tile_heights[i] = std::stoi(arg(num_tiles + 10 + i));
 
         tile_widths.resize(number_of_columns - 1);
         for (int i = 0; i < number_of_columns - 1; ++i)
-            tile_widths[i] = std::stoi(argv[num_tiles + 10 + number_of_rows - 1 + 1 + i]);
+            tile_widths[i] = std::stoi(arg(num_tiles + 9 + number_of_rows - 1 + 1 + i));
+    }
+
+    return {std::move(tile_paths),
+            StitchContext(tile_dimensions, video_dimensions, video_display_dimensions, should_use_uniform_tiles, tile_heights, tile_widths, pps_id),
+            arg(num_tiles + 7)};
+}
+
+static vector<StitchJob> ParseManifest(const string &path) {
+    std::ifstream istrm(path);
+    if (!istrm)
+        throw std::runtime_error("Failed to open manifest " + path);
+
+    vector<StitchJob> jobs;
+    string line;
+    for (unsigned int line_number = 1; std::getline(istrm, line); ++line_number) {
+        std::istringstream words(line);
+        vector<string> args;
+        for (string word; words >> word; )
+            args.push_back(word);
+        if (args.empty() || args.front()[0] == '#')
+            continue;
+
+        try {
+            jobs.push_back(ParseJob(args));
+        } catch (const std::exception &e) {
+            throw std::runtime_error(path + ":" + std::to_string(line_number) + ": " + e.what());
+        }
+    }
+    return jobs;
+}
+
+// A tile mapped read-only into memory, so that it is stitched without being copied.
+class MappedFile {
+public:
+    explicit MappedFile(const string &path)
+            : data_(nullptr), size_(0) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Failed to open " + path + ": " + strerror(errno));
+
+        struct stat status;
+        if (fstat(fd, &status)) {
+            close(fd);
+            throw std::runtime_error("Failed to stat " + path + ": " + strerror(errno));
+        }
+        size_ = status.st_size;
+        if (size_) {
+            data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data_ == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Failed to map " + path + ": " + strerror(errno));
+            }
+            // The whole tile is about to be read.
+            madvise(data_, size_, MADV_WILLNEED);
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (size_)
+            munmap(data_, size_);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bytestring_view view() const { return bytestring_view(static_cast<const char*>(data_), size_); }
+
+private:
+    void *data_;
+    size_t size_;
+};
+
+// Gathers small ranges, such as rewritten headers, into large writes. Ranges at least as large as the buffer are written directly.
+class BufferedOutputFile {
+public:
+    static const size_t kBufferSize = 8 << 20;
+
+    explicit BufferedOutputFile(const string &path)
+            : path_(path), fd_(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)) {
+        if (fd_ < 0)
+            throw std::runtime_error("Failed to open " + path + ": " + strerror(errno));
+        buffer_.reserve(kBufferSize);
+    }
+
+    ~BufferedOutputFile() {
+        if (fd_ >= 0)
+            ::close(fd_);
+    }
+
+    BufferedOutputFile(const BufferedOutputFile&) = delete;
+    BufferedOutputFile& operator=(const BufferedOutputFile&) = delete;
+
+    void Write(const vector<struct iovec> &ranges) {
+        for (const auto &range : ranges) {
+            auto start = static_cast<const char*>(range.iov_base);
+            if (buffer_.size() + range.iov_len > kBufferSize)
+                Flush();
+            if (range.iov_len >= kBufferSize)
+                WriteAll(start, range.iov_len);
+            else
+                buffer_.insert(buffer_.end(), start, start + range.iov_len);
+        }
+    }
+
+    // Flushes the buffer and closes the file, reporting any error that the destructor would hide.
+    void Close() {
+        Flush();
+        auto fd = fd_;
+        fd_ = -1;
+        if (::close(fd))
+            throw std::runtime_error("Failed to close " + path_ + ": " + strerror(errno));
     }
 
-    StitchContext context(tile_dimensions, video_dimensions, video_display_dimensions, should_use_uniform_tiles, tile_heights, tile_widths, pps_id);
-    Stitcher stitcher(context, tiles);
-    auto stitched = stitcher.GetStitchedSegments();
+private:
+    void Flush() {
+        WriteAll(buffer_.data(), buffer_.size());
+        buffer_.clear();
+    }
+
+    void WriteAll(const char *data, size_t size) {
+        while (size) {
+            auto written = write(fd_, data, size);
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error("Failed to write " + path_ + ": " + strerror(errno));
+            }
+            data += written;
+            size -= written;
+        }
+    }
+
+    const string path_;
+    int fd_;
+    vector<char> buffer_;
+};
+
+// A stitched GOP that is waiting to be written. The segments refer to the mapped tiles and to the stitcher.
+struct StitchedJob {
+    vector<std::unique_ptr<MappedFile>> tiles;
+    std::unique_ptr<Stitcher> stitcher;
+    StitchedSegments segments;
+};
+
+static std::unique_ptr<StitchedJob> Stitch(const StitchJob &job, StitchPlanCache &plans) {
+    auto stitched = std::make_unique<StitchedJob>();
+    vector<bytestring_view> tiles;
+    for (const auto &path : job.tile_paths) {
+        stitched->tiles.push_back(std::make_unique<MappedFile>(path));
+        tiles.push_back(stitched->tiles.back()->view());
+    }
+    stitched->stitcher = std::make_unique<Stitcher>(job.context, tiles, plans);
+    stitched->segments = stitched->stitcher->StitchSegments();
+    return stitched;
+}
+
+// Stitches the jobs on number_of_threads threads and writes them in order from this one. At most two GOPs per thread are
+// held between being stitched and being written. Returns the number of bytes written.
+static size_t StitchJobs(const vector<StitchJob> &jobs, unsigned int number_of_threads) {
+    StitchPlanCache plans;
+    const size_t window = 2 * number_of_threads;
+
+    // Each output is closed once the last GOP written to it is.
+    std::unordered_map<string, size_t> last_job_for_output;
+    for (size_t i = 0; i < jobs.size(); ++i)
+        last_job_for_output[jobs[i].output_path] = i;
+
+    std::mutex mutex;
+    std::condition_variable job_stitched;
+    std::condition_variable job_written;
+    std::map<size_t, std::unique_ptr<StitchedJob>> stitched_jobs;
+    size_t next_job_to_stitch = 0;
+    size_t next_job_to_write = 0;
+    bool should_stop = false;
+    std::exception_ptr error;
+
+    auto stitch_jobs = [&] {
+        while (true) {
+            size_t index;
+            {
+                std::unique_lock lock(mutex);
+                job_written.wait(lock, [&] { return should_stop || next_job_to_stitch < std::min(jobs.size(), next_job_to_write + window); });
+                if (should_stop)
+                    return;
+                index = next_job_to_stitch++;
+            }
+
+            std::unique_ptr<StitchedJob> stitched;
+            try {
+                stitched = Stitch(jobs[index], plans);
+            } catch (...) {
+                std::scoped_lock lock(mutex);
+                if (!error)
+                    error = std::current_exception();
+                should_stop = true;
+                job_stitched.notify_all();
+                job_written.notify_all();
+                return;
+            }
+
+            std::scoped_lock lock(mutex);
+            stitched_jobs.emplace(index, std::move(stitched));
+            job_stitched.notify_all();
+        }
+    };
+
+    vector<std::thread> threads;
+    for (auto i = 0u; i < number_of_threads; ++i)
+        threads.emplace_back(stitch_jobs);
+
+    std::unordered_map<string, std::unique_ptr<BufferedOutputFile>> outputs;
+    size_t number_of_bytes = 0;
+    try {
+        for (size_t index = 0; index < jobs.size(); ++index) {
+            std::unique_ptr<StitchedJob> stitched;
+            {
+                std::unique_lock lock(mutex);
+                job_stitched.wait(lock, [&] { return should_stop || stitched_jobs.count(index); });
+                if (error)
+                    std::rethrow_exception(error);
+                stitched = std::move(stitched_jobs.at(index));
+                stitched_jobs.erase(index);
+            }
+
+            auto &output_path = jobs[index].output_path;
+            auto &output = outputs[output_path];
+            if (!output)
+                output = std::make_unique<BufferedOutputFile>(output_path);
+            output->Write(stitched->segments.GetIovecs());
+            number_of_bytes += stitched->segments.size();
+            if (last_job_for_output.at(output_path) == index) {
+                output->Close();
+                outputs.erase(output_path);
+            }
+
+            // Unmap the tiles before letting another GOP be stitched.
+            stitched.reset();
+            std::scoped_lock lock(mutex);
+            next_job_to_write = index + 1;
+            job_written.notify_all();
+        }
+    } catch (...) {
+        {
+            std::scoped_lock lock(mutex);
+            should_stop = true;
+        }
+        job_written.notify_all();
+        for (auto &thread : threads)
+            thread.join();
+        throw;
+    }
+
+    {
+        std::scoped_lock lock(mutex);
+        should_stop = true;
+    }
+    job_written.notify_all();
+    for (auto &thread : threads)
+        thread.join();
+
+    return number_of_bytes;
+}
+
+int main(int argc, char *argv[]) {
+    if (!strcmp(argv[1], "save_active_parameter_sets_sei")) {
+        auto sei = Stitcher::GetActiveParameterSetsSEI();
+
+        std::ofstream ostrm(argv[2], std::ios::binary);
+        ostrm.write(sei->data(), sei->size());
+        ostrm.close();
+        return 0;
+    }
+
+    try {
+        if (!strcmp(argv[1], "batch")) {
+            int number_of_threads = argc > 3 ? std::stoi(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+            if (number_of_threads < 1)
+                throw std::invalid_argument("The number of threads must be positive");
+            auto jobs = ParseManifest(argv[2]);
+            auto number_of_bytes = StitchJobs(jobs, number_of_threads);
+            std::cout << "Stitched " << jobs.size() << " GOPs (" << number_of_bytes << " bytes) on " << number_of_threads << " threads" << std::endl;
+            return 0;
+        }
 
-    std::ofstream ostrm;
-    ostrm.open(argv[num_tiles + 8]);
-    for (auto c : *stitched) {
-        ostrm << c;
+        // A single GOP is stitched the same way as a batch of one.
+        vector<StitchJob> jobs;
+        jobs.push_back(ParseJob(vector<string>(argv + 1, argv + argc)));
+        StitchJobs(jobs, 1);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
     }
-    ostrm.close();
-
-    /**
-    std::cout << "correct" << std::endl;
-    std::ifstream istrm;
-    istrm.open(argv[num_tiles + 7]);
-    std::stringstream buffer;
-    buffer << istrm.rdbuf();
-    string correct = buffer.str();
-    for (auto c : correct) {
-        std::cout << static_cast<int>(static_cast<unsigned char>(c)) << std::endl;
-    } **/
     return 0;
-     /**
-    testing::InitGoogleTest(&argc, argv);
-    RUN_ALL_TESTS(); **/
-}
\ No newline at end of file
+}
@@ -0,0 +1,136 @@
+#ifndef HOMOMORPHIC_STITCHING_BITREADER_H
+#define HOMOMORPHIC_STITCHING_BITREADER_H
+
+#include <cassert>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace stitching {
+
+    /**
+     * Returns floor(log2(value)) using count-leading-zeros
+     * @param value Must be greater than zero
+     */
+    inline unsigned int FloorLog2(const uint64_t value) {
+        assert(value);
+        return 63u - static_cast<unsigned int>(__builtin_clzll(value));
+    }
+
+    /**
+     * Reads bits from a byte buffer, most significant bit first. Bits are fetched a 64-bit word at a time rather
+     * than one at a time. Reads past the end of the buffer return zero bits
+     */
+    class BitReader {
+    public:
+        /**
+         * @param data The bytes to read. Must outlive the reader
+         * @param size_in_bytes The number of bytes in data
+         * @param bit_offset The offset of the first bit to read
+         */
+        BitReader(const unsigned char *data, const size_t size_in_bytes, const size_t bit_offset = 0)
+                : data_(data), size_in_bytes_(size_in_bytes), position_(bit_offset) {}
+
+        /**
+         *
+         * @return The offset of the next unread bit from the start of the buffer
+         */
+        inline size_t Position() const {
+            return position_;
+        }
+
+        inline void SkipBits(const size_t num) {
+            position_ += num;
+        }
+
+        /**
+         * Returns the next num bits without advancing the reader
+         * @param num The number of bits, at most 57
+         */
+        inline uint64_t PeekBits(const size_t num) const {
+            assert(num <= kMaxBitsPerWord);
+            return num ? PeekWord() >> (64 - num) : 0;
+        }
+
+        /**
+         * Returns the next num bits, leaving the reader at the next unread bit
+         * @param num The number of bits, at most 64
+         */
+        inline uint64_t ReadBits(const size_t num) {
+            if (num > kMaxBitsPerWord) {
+                auto high = ReadBits(num - 32);
+                return (high << 32) | ReadBits(32);
+            }
+
+            auto bits = PeekBits(num);
+            position_ += num;
+            return bits;
+        }
+
+        inline bool ReadBit() {
+            return ReadBits(1);
+        }
+
+        /**
+         * Reads an unsigned exponential golomb (ue(v)). The number of leading zeroes is found with a single
+         * count-leading-zeros on the next word instead of testing one bit at a time
+         */
+        inline uint64_t ReadExponentialGolomb() {
+            auto word = PeekWord();
+            if (word) {
+                auto leading_zeros = static_cast<unsigned int>(__builtin_clzll(word));
+                auto size = 2 * leading_zeros + 1;
+                if (size <= kMaxBitsPerWord) {
+                    position_ += size;
+                    return (word >> (64 - size)) - 1;
+                }
+            }
+
+            // The prefix does not fit in the bits that were fetched, so fall back to counting it in pieces.
+            auto leading_zeros = 0u;
+            while (!(word = PeekWord())) {
+                if (position_ >= size_in_bytes_ * CHAR_BIT)
+                    throw std::out_of_range("Exponential golomb extends past the end of the data");
+                leading_zeros += kMaxBitsPerWord;
+                position_ += kMaxBitsPerWord;
+            }
+            auto remaining_zeros = static_cast<unsigned int>(__builtin_clzll(word));
+            leading_zeros += remaining_zeros;
+            position_ += remaining_zeros + 1;
+            assert(leading_zeros < 64);
+            return ((uint64_t{1} << leading_zeros) | ReadBits(leading_zeros)) - 1;
+        }
+
+        // Any read of up to this many bits is satisfied by a single 64-bit load, whatever the bit alignment.
+        static constexpr size_t kMaxBitsPerWord = 64 - (CHAR_BIT - 1);
+
+    private:
+        /**
+         * @return The 64 bits following the current position, left aligned. Bits past the end of the buffer are 0
+         */
+        inline uint64_t PeekWord() const {
+            auto byte_offset = position_ / CHAR_BIT;
+            uint64_t word = 0;
+            if (byte_offset + sizeof(word) <= size_in_bytes_) {
+                std::memcpy(&word, data_ + byte_offset, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+                word = __builtin_bswap64(word);
+#endif
+            } else {
+                for (auto i = 0u; i < sizeof(word); i++) {
+                    word <<= CHAR_BIT;
+                    if (byte_offset + i < size_in_bytes_)
+                        word |= data_[byte_offset + i];
+                }
+            }
+            return word << (position_ % CHAR_BIT);
+        }
+
+        const unsigned char *data_;
+        size_t size_in_bytes_;
+        size_t position_;
+    };
+}; //namespace stitching
+
+#endif //HOMOMORPHIC_STITCHING_BITREADER_H
@@ -0,0 +1,112 @@
+#ifndef HOMOMORPHIC_STITCHING_BITWRITER_H
+#define HOMOMORPHIC_STITCHING_BITWRITER_H
+
+#include "BitArray.h"
+#include "BitReader.h"
+#include "bytestring.h"
+
+namespace stitching {
+
+    /**
+     * Appends bits to a byte buffer, most significant bit first. Bits are collected in a 64-bit word that is
+     * flushed to the buffer when it fills up, rather than being stored one at a time
+     */
+    class BitWriter {
+    public:
+        BitWriter() : word_(0), bits_in_word_(0) {}
+
+        /**
+         *
+         * @return The number of bits that have been written
+         */
+        inline size_t SizeInBits() const {
+            return bytes_.size() * CHAR_BIT + bits_in_word_;
+        }
+
+        /**
+         * Appends the low num bits of value
+         * @param value The value to write. Bits above num must be zero
+         * @param num The number of bits, at most 64
+         */
+        inline void WriteBits(const uint64_t value, const size_t num) {
+            assert(num <= 64);
+            assert(num == 64 || !(value >> num));
+            if (!num)
+                return;
+
+            auto free_bits = 64 - bits_in_word_;
+            if (num < free_bits) {
+                word_ |= value << (free_bits - num);
+                bits_in_word_ += num;
+                return;
+            }
+
+            // Fill the current word with the high bits of value, then start a new word with the rest.
+            auto remaining = num - free_bits;
+            word_ |= value >> remaining;
+            FlushWord();
+            if (remaining) {
+                word_ = value << (64 - remaining);
+                bits_in_word_ = remaining;
+            }
+        }
+
+        inline void WriteBit(const bool value) {
+            WriteBits(value, 1);
+        }
+
+        /**
+         * Appends value as an unsigned exponential golomb (ue(v))
+         */
+        inline void WriteExponentialGolomb(const uint64_t value) {
+            assert(value < UINT64_MAX);
+            auto value_size = FloorLog2(value + 1) + 1;
+            if (value_size < 32) {
+                // The leading zeroes are just the high bits of a single write.
+                WriteBits(value + 1, 2 * value_size - 1);
+            } else {
+                WriteBits(0, value_size - 1);
+                WriteBits(value + 1, value_size);
+            }
+        }
+
+        /**
+         * Pads with zero bits until the size is a multiple of 8
+         */
+        inline void ByteAlign() {
+            WriteBits(0, (CHAR_BIT - bits_in_word_ % CHAR_BIT) % CHAR_BIT);
+        }
+
+        /**
+         * Returns the bytes that have been written. The writer must be byte aligned
+         */
+        bytestring GetBytes() const;
+
+        /**
+         * Returns the bits that have been written as a BitArray. The writer does not have to be byte aligned
+         */
+        BitArray GetBitArray() const;
+
+    private:
+        inline void FlushWord() {
+            for (auto shift = 56; shift >= 0; shift -= CHAR_BIT)
+                bytes_.push_back(static_cast<char>(word_ >> shift));
+            word_ = 0;
+            bits_in_word_ = 0;
+        }
+
+        bytestring bytes_;
+        uint64_t word_;
+        size_t bits_in_word_;
+    };
+
+    /**
+     *
+     * @return The number of bits in the exponential golomb encoding of value
+     */
+    inline size_t GetExponentialGolombSize(const uint64_t value) {
+        return 2 * FloorLog2(value + 1) + 1;
+    }
+}; //namespace stitching
+
+#endif //HOMOMORPHIC_STITCHING_BITWRITER_H
@@ -0,0 +1,61 @@
+#ifndef HOMOMORPHIC_STITCHING_BYTESCAN_H
+#define HOMOMORPHIC_STITCHING_BYTESCAN_H
+
+#include <cstddef>
+
+namespace stitching {
+
+    /**
+     * The instruction sets that the scans can use. Each gives the same results; the default picks the fastest one
+     * that the CPU supports
+     */
+    enum class ByteScanPath {
+        Scalar,
+        SSE2,
+        AVX2,
+    };
+
+    /**
+     * Returns whether this build and CPU can run the scans with path
+     */
+    bool IsByteScanPathSupported(ByteScanPath path);
+
+    /**
+     * Returns the first position p in [begin, end) such that p and p + 1 are both zero bytes, or end if there is
+     * none. Start codes and emulation prevention sequences both begin with two zero bytes, so the byte-at-a-time
+     * parsers use this to skip over the payload between them. Uses AVX2 or SSE2 when the CPU supports it
+     * @param begin The first byte to search
+     * @param end One past the last byte to search. The second byte of a pair must also be before end
+     * @return The position of the first zero pair
+     */
+    const char *FindZeroPair(const char *begin, const char *end);
+
+    /**
+     * Same as FindZeroPair, but scans with path, which must be supported
+     */
+    const char *FindZeroPair(const char *begin, const char *end, ByteScanPath path);
+
+    /**
+     * Returns the position of the first four byte start code (0x00000001) in [begin, end), or end if there is none
+     * @param begin The first byte to search
+     * @param end One past the last byte to search
+     * @return The position of the first byte of the start code
+     */
+    const char *FindStartCode(const char *begin, const char *end);
+
+    /**
+     * Same as FindStartCode, but scans with path, which must be supported
+     */
+    const char *FindStartCode(const char *begin, const char *end, ByteScanPath path);
+
+    template<typename Iterator>
+    inline Iterator FindStartCode(Iterator begin, Iterator end) {
+        if (begin == end)
+            return end;
+
+        const char *first = &*begin;
+        return begin + (FindStartCode(first, first + (end - begin)) - first);
+    }
+}; //namespace stitching
+
+#endif //HOMOMORPHIC_STITCHING_BYTESCAN_H
@@ -19,6 +19,22 @@ namespace stitching {
          */
         BitArray RemoveEmulationPrevention(const bytestring &data, unsigned long start, unsigned long end);
 
+        /**
+         * Same as RemoveEmulationPrevention, but returns the result as bytes rather than as a BitArray
+         */
+        bytestring RemoveEmulationPreventionBytes(const bytestring &data, unsigned long start, unsigned long end);
+
+        /**
+         * Maps an offset into the result of RemoveEmulationPreventionBytes(data, start, ...) back to the
+         * corresponding offset into data
+         * @param data The byte stream, including any emulation_prevention_three bytes
+         * @param start The start of the emulation prevention removal, in bytes
+         * @param offset The offset into the bytes with the emulation_prevention_three bytes removed
+         * @return The offset into data at which the same number of bytes have been kept. An
+         * emulation_prevention_three_byte at that offset is not skipped, so data up to it removes to offset bytes
+         */
+        unsigned long OffsetBeforeEmulationPreventionRemoval(bytestring_view data, unsigned long start, unsigned long offset);
+
         /**
          * Adds the emulation_prevention_three byte to "data" starting at the byte at
          * "start" and ending at "end". Then converts data to a string of bytes and returns it, adding the
@@ -32,5 +48,11 @@ namespace stitching {
          */
         bytestring AddEmulationPreventionAndMarker(const BitArray &data, unsigned long start, unsigned long end, bool stopAfterEnd = false, unsigned int *outNumberOfEmulationBytesAdded = nullptr);
 
+        /**
+         * Same as the BitArray version, but operates on bytes. All of data is copied to the result, and
+         * emulation_prevention_three bytes are added to the bytes in [start, end)
+         */
+        bytestring AddEmulationPreventionAndMarker(const bytestring &data, unsigned long start, unsigned long end, unsigned int *outNumberOfEmulationBytesAdded = nullptr);
+
 }; //namespace stitching
 #endif //HOMOMORPHIC_STITCHING_EMULATION_H
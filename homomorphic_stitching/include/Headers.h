@@ -18,8 +18,8 @@ namespace stitching {
             spsMetadata_(spsMetadata)
         {}
 
-        const PictureParameterSetMetadata &GetPicture() { return ppsMetadata_; }
-        const SequenceParameterSetMetadata &GetSequence() { return spsMetadata_; }
+        const PictureParameterSetMetadata &GetPicture() const { return ppsMetadata_; }
+        const SequenceParameterSetMetadata &GetSequence() const { return spsMetadata_; }
 
     private:
         PictureParameterSetMetadata ppsMetadata_;
@@ -39,6 +39,8 @@ namespace stitching {
          * @param context The context of the nals
          * @param nals The byte streams of the nals
          */
+        Headers(const StitchContext &context, const std::vector<bytestring_view> &nals);
+
         Headers(const StitchContext &context, const std::list<bytestring> &nals);
 
         /**
@@ -31,6 +31,11 @@ namespace stitching {
         return (static_cast<unsigned char>(data[0]) & 0x7Fu) >> 1;
     }
 
+    inline unsigned int PeekType(bytestring_view data) {
+        assert(!data.empty());
+        return (static_cast<unsigned char>(data[0]) & 0x7Fu) >> 1;
+    }
+
     inline unsigned int PeekType(std::vector<bool>::iterator startOfNalUnitType) {
         unsigned char value = 0;
         for (auto i = 0u; i < 6; i++) {
@@ -167,6 +172,12 @@ inline bool IsSegment(const bytestring &data) {
            type == NalUnitCodedSliceTrailR;
 }
 
+inline bool IsSegment(bytestring_view data) {
+    auto type = PeekType(data);
+    return type == NalUnitCodedSliceIDRWRADL ||
+           type == NalUnitCodedSliceTrailR;
+}
+
 /**
  *
  * @param data The byte stream
@@ -176,6 +187,10 @@ inline bool IsKeyframe(const bytestring &data) {
     return PeekType(data) == NalUnitCodedSliceIDRWRADL;
 }
 
+inline bool IsKeyframe(bytestring_view data) {
+    return PeekType(data) == NalUnitCodedSliceIDRWRADL;
+}
+
 
 /**
  * Returns a Nal with type based on the value returned by PeekType on data. Since this takes no
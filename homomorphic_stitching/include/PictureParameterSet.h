@@ -74,10 +74,7 @@ namespace stitching {
          * @param data The byte stream
          */
         PictureParameterSet(const StitchContext &context, const bytestring &data)
-                : Nal(context, data),
-                  data_(RemoveEmulationPrevention(data, GetHeaderSize(), data.size())),
-                  ppsMetadata_({data_.begin(), data_.begin() + GetHeaderSizeInBits()}),
-                  tile_dimensions_{0, 0} {
+                : PictureParameterSet(context, data, std::make_shared<const bytestring>(RemoveEmulationPreventionBytes(data, GetHeaderSize(), data.size()))) {
 
         }
 
@@ -140,6 +137,17 @@ namespace stitching {
         void SetPPSId(unsigned int pps_id);
 
     private:
+        /**
+         * @param rbsp The bytes of data with the emulation prevention bytes removed
+         */
+        PictureParameterSet(const StitchContext &context, const bytestring &data, std::shared_ptr<const bytestring> rbsp)
+                : Nal(context, data),
+                  data_(*rbsp),
+                  ppsMetadata_({rbsp, GetHeaderSizeInBits()}),
+                  tile_dimensions_{0, 0} {
+
+        }
+
         unsigned long getMetadataValue(const std::string &key) const {
             return ppsMetadata_.metadata().GetValue(key);
         }
@@ -109,6 +109,10 @@ namespace stitching {
         inline SequenceParameterSetMetadata sequenceParameterSetMetadata() const { return spsMetadata_; }
 
     private:
+        /**
+         * @param rbsp The bytes of data with the emulation prevention bytes removed
+         */
+        SequenceParameterSet(const StitchContext &context, const bytestring &data, std::shared_ptr<const bytestring> rbsp);
 
         void CalculateSizes();
 
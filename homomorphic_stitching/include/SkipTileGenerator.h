@@ -0,0 +1,80 @@
+#ifndef HOMOMORPHIC_STITCHING_SKIPTILEGENERATOR_H
+#define HOMOMORPHIC_STITCHING_SKIPTILEGENERATOR_H
+
+#include "StitchContext.h"
+#include "TileExtractor.h"
+#include "bytestring.h"
+#include <memory>
+#include <vector>
+
+namespace stitching {
+
+    /**
+     * Generates tiles that cost almost nothing to decode, to stand in for the tiles of a picture that are not needed.
+     * Intra pictures are coded as flat grey blocks without residuals, and every other picture as skipped blocks that
+     * copy the picture before it. The parameter sets and slice segment headers are copied from a template tile, so a
+     * generated tile has the same pictures as the template and can be stitched with the tiles of the same GOP
+     */
+    class SkipTileGenerator {
+    public:
+        /**
+         * @param templateTile One GOP of a tile with one slice segment per picture, starting with its parameter sets.
+         * It must not be stitched from tiles itself, so tiles coarsened in the compressed domain have to be expanded
+         * first. The data must outlive the generator
+         */
+        explicit SkipTileGenerator(bytestring_view templateTile);
+
+        /**
+         *
+         * @return The CTB size of the template tile, in luma samples
+         */
+        unsigned int CtbSize() const { return ctbSize_; }
+
+        /**
+         *
+         * @return The coded width and height of the template tile, in luma samples
+         */
+        std::pair<unsigned int, unsigned int> CodedDimensions() const { return codedDimensions_; }
+
+        /**
+         * @param width The coded width of the generated tile in luma samples, which must be a multiple of the minimum coding
+         * block size. This is the width the tile covers in the stitched picture, so it is only a multiple of the CTB size if
+         * the tile is not in the last column or the stitched picture's width is
+         * @param height The coded height of the generated tile in luma samples, with the same restrictions
+         * @param displayWidth The width that is left after the conformance window crops the tile, which must differ from
+         * width by a multiple of the chroma subsampling. Defaults to width
+         * @param displayHeight The same for the height
+         * @return The generated tile, with the template's parameter sets rewritten for its dimensions
+         */
+        bytestring Generate(unsigned int width, unsigned int height, unsigned int displayWidth = 0, unsigned int displayHeight = 0) const;
+
+    private:
+        /**
+         * Writes slice_segment_data() (7.3.8.1) and rbsp_slice_segment_trailing_bits() for a slice segment that covers a
+         * whole picture of width x height luma samples
+         */
+        static bytestring SliceData(const TileExtractor::SliceSegmentHeader &header,
+                                    const TileExtractor::SequenceParameters &sps,
+                                    const TileExtractor::PictureParameters &pps,
+                                    unsigned int width, unsigned int height);
+
+        bytestring_view templateTile_;
+        unsigned int ctbSize_;
+        std::pair<unsigned int, unsigned int> codedDimensions_;
+    };
+
+    /**
+     * Replaces the tiles that were not read with skip tiles generated from the first tile that was, so that the tiles
+     * can be stitched into a picture where only the tiles that were read have content
+     * @param context The context for stitching the tiles. Tiles that were coarsened in the compressed domain must
+     * already be expanded with ExpandStitchedTiles(). The tile that the skip tiles are generated from must be coded at
+     * the size it covers in the stitched picture, since every tile has to be
+     * @param tiles The data for one GOP of each tile, in raster order, with null for the tiles that were not read. At
+     * least one tile must have been read. Skip tiles of the same size share their data
+     * @return The number of tiles that were replaced
+     */
+    unsigned int FillSkipTiles(const StitchContext &context, std::vector<std::shared_ptr<const bytestring>> &tiles);
+
+}; //namespace stitching
+
+#endif //HOMOMORPHIC_STITCHING_SKIPTILEGENERATOR_H
@@ -6,7 +6,10 @@
 #include "BitStream.h"
 #include "BitArray.h"
 #include "Emulation.h"
+#include "BitReader.h"
+#include <algorithm>
 #include <bitset>
+#include <mutex>
 
 
 namespace stitching {
@@ -14,7 +17,7 @@ namespace stitching {
 
     class SliceSegmentLayerMetadata {
     public:
-        SliceSegmentLayerMetadata(BitStream &metadata, HeadersMetadata headersMetadata)
+        SliceSegmentLayerMetadata(BitStream &metadata, const HeadersMetadata &headersMetadata)
             : metadata_(metadata),
             headersMetadata_(headersMetadata)
         {}
@@ -52,13 +55,8 @@ namespace stitching {
         * @param headers The headers associated with this segment
         */
         SliceSegmentLayer(const StitchContext &context, const bytestring &data, Headers headers)
-                : Nal(context, data),
-                  headersMetadata_(headers.GetPicture()->pictureParameterSetMetadata(), headers.GetSequence()->sequenceParameterSetMetadata()),
-                  numberOfTranslatedBytes_(std::min((unsigned long)kMaxHeaderLength, data.size())),
-                  data_(RemoveEmulationPrevention(data, GetHeaderSize(), numberOfTranslatedBytes_)),
-                  headers_(std::move(headers)),
-                  metadata_(data_.begin(), data_.begin() + GetHeaderSizeInBits()),
-                  address_(0)
+                : SliceSegmentLayer(context, data, std::move(headers), std::make_shared<const bytestring>(
+                        RemoveEmulationPreventionBytes(data, GetHeaderSize(), std::min((unsigned long)kMaxHeaderLength, data.size()))))
         { }
 
         /**
@@ -98,6 +96,18 @@ namespace stitching {
             return AddEmulationPreventionAndMarker(data_, GetHeaderSize(), end, true);
         }
 
+        /**
+         *
+         * @return The bytes of the header, like GetHeaderBytes(), but without emulation prevention or a start code
+         */
+        inline bytestring GetHeaderRbsp() {
+            auto end = metadata_.GetValue("end");
+            if (metadata_.ValueExists("updated-end-bits"))
+                end = metadata_.GetValue("updated-end-bits");
+
+            return data_.GetBytes(end / 8);
+        }
+
         unsigned long numberOfBytesInHeaderWithUpdatedAddress() const {
             return metadata_.GetValue("updated-end-bits") / 8;
         }
@@ -108,6 +118,9 @@ namespace stitching {
 
         void InsertPicOutputFlag(bool value);
 
+        // Headers are parsed from at most this many bytes at the start of a segment
+        static constexpr unsigned int kMaxHeaderLength = 24;
+
         SliceSegmentLayer(const SliceSegmentLayer& other) = default;
         SliceSegmentLayer(SliceSegmentLayer&& other) = default;
         ~SliceSegmentLayer() = default;
@@ -142,6 +155,20 @@ namespace stitching {
         unsigned long numberOfAddedBits_;
 
     private:
+        /**
+        * @param rbsp The first bytes of data, up to kMaxHeaderLength, with the emulation prevention bytes removed
+        */
+        SliceSegmentLayer(const StitchContext &context, const bytestring &data, Headers headers, std::shared_ptr<const bytestring> rbsp)
+                : Nal(context, data),
+                  headersMetadata_(headers.GetPicture()->pictureParameterSetMetadata(), headers.GetSequence()->sequenceParameterSetMetadata()),
+                  numberOfAddedBits_(0),
+                  numberOfTranslatedBytes_(std::min((unsigned long)kMaxHeaderLength, data.size())),
+                  data_(*rbsp),
+                  headers_(std::move(headers)),
+                  metadata_(rbsp, GetHeaderSizeInBits()),
+                  address_(0)
+        { }
+
         // For the original data as bytes.
         unsigned long numberOfTranslatedBytes_;
 
@@ -151,12 +178,11 @@ namespace stitching {
         size_t address_;
 
         static constexpr unsigned int kFirstSliceFlagOffset = 0;
-        static constexpr unsigned int kMaxHeaderLength = 24;
     };
 
     class IDRSliceSegmentLayerMetadata : public SliceSegmentLayerMetadata {
     public:
-        IDRSliceSegmentLayerMetadata(BitStream &metadata, HeadersMetadata headersMetadata);
+        IDRSliceSegmentLayerMetadata(BitStream &metadata, const HeadersMetadata &headersMetadata);
     };
 
     class IDRSliceSegmentLayer : public SliceSegmentLayer {
@@ -176,7 +202,7 @@ namespace stitching {
 
     class TrailRSliceSegmentLayerMetadata : public SliceSegmentLayerMetadata {
     public:
-        TrailRSliceSegmentLayerMetadata(BitStream &metadata, HeadersMetadata headersMetadata);
+        TrailRSliceSegmentLayerMetadata(BitStream &metadata, const HeadersMetadata &headersMetadata);
     };
 
     class TrailRSliceSegmentLayer : public SliceSegmentLayer {
@@ -195,75 +221,181 @@ namespace stitching {
 
     };
 
+    /**
+     * A rewritten slice segment header, which can be reused for any segment that starts with the same original header
+     */
+    struct SegmentHeaderTemplate {
+        // The header bytes of the segment this was built from, up to the end of its byte alignment bits
+        bytestring originalHeader;
+        // The rewritten header, including a start code
+        bytestring updatedHeader;
+        // The rewritten header without emulation prevention or a start code. Only set for P-frames
+        bytestring updatedRbsp;
+        // The offsets of slice_pic_order_cnt_lsb in originalHeader and in updatedRbsp, in bits. Only set for P-frames
+        unsigned int originalOffsetOfPicOrder;
+        unsigned int offsetOfPicOrder;
+        // Whether originalHeader has no emulation prevention bytes, so that the bits of a segment's header are at the same
+        // offsets as in originalHeader when the segment only differs in slice_pic_order_cnt_lsb
+        bool canUpdatePicOrder;
+
+        /**
+         * @param segment A segment that matches this template everywhere but slice_pic_order_cnt_lsb
+         * @param numberOfPicOrderBits The size of slice_pic_order_cnt_lsb
+         * @return Whether segment's header can be rewritten by setting slice_pic_order_cnt_lsb in updatedRbsp
+         */
+        bool MatchesExceptForPicOrder(bytestring_view segment, unsigned int numberOfPicOrderBits) const {
+            if (!canUpdatePicOrder || segment.size() < originalHeader.size())
+                return false;
+
+            auto firstPicOrderBit = originalOffsetOfPicOrder;
+            auto lastPicOrderBit = originalOffsetOfPicOrder + numberOfPicOrderBits;
+            auto zeros = 0u;
+            for (auto i = 0u; i < originalHeader.size(); i++) {
+                auto byte = static_cast<unsigned char>(segment[i]);
+                // An emulation prevention byte would shift the bits that follow it.
+                if (zeros >= 2 && byte == 3)
+                    return false;
+                zeros = byte ? 0 : zeros + 1;
+
+                unsigned int mask = 0xff;
+                for (auto bit = std::max(firstPicOrderBit, i * CHAR_BIT); bit < std::min(lastPicOrderBit, (i + 1) * CHAR_BIT); bit++)
+                    mask &= ~(0x80u >> (bit % CHAR_BIT));
+                if ((byte ^ static_cast<unsigned char>(originalHeader[i])) & mask)
+                    return false;
+            }
+            return true;
+        }
+    };
+
+    /**
+     * The most recently built keyframe and P-frame header templates for one tile position. Safe to share between threads
+     */
+    class SegmentHeaderTemplates {
+    public:
+        /**
+         * @param numberOfPicOrderBits The size of slice_pic_order_cnt_lsb
+         * @return The template whose original header segment starts with, or nullptr if there is none. A P-frame template
+         * is also returned when the headers only differ in slice_pic_order_cnt_lsb
+         */
+        std::shared_ptr<const SegmentHeaderTemplate> Find(bytestring_view segment, bool isKeyframe, unsigned int numberOfPicOrderBits) const {
+            std::scoped_lock lock(mutex_);
+            auto &headerTemplate = isKeyframe ? keyframe_ : pFrame_;
+            if (!headerTemplate)
+                return nullptr;
+            if (segment.size() >= headerTemplate->originalHeader.size() &&
+                    std::equal(headerTemplate->originalHeader.begin(), headerTemplate->originalHeader.end(), segment.begin()))
+                return headerTemplate;
+            if (!isKeyframe && headerTemplate->MatchesExceptForPicOrder(segment, numberOfPicOrderBits))
+                return headerTemplate;
+            return nullptr;
+        }
+
+        void Set(std::shared_ptr<const SegmentHeaderTemplate> headerTemplate, bool isKeyframe) {
+            std::scoped_lock lock(mutex_);
+            (isKeyframe ? keyframe_ : pFrame_) = std::move(headerTemplate);
+        }
+
+    private:
+        mutable std::mutex mutex_;
+        std::shared_ptr<const SegmentHeaderTemplate> keyframe_;
+        std::shared_ptr<const SegmentHeaderTemplate> pFrame_;
+    };
+
     class SegmentAddressUpdater {
     public:
+        /**
+         * @param templates If set, headers are only parsed and rewritten when they do not match a template, and new templates are stored here
+         */
         SegmentAddressUpdater(unsigned int address,
-                const StitchContext &context, const Headers &headers)
+                const StitchContext &context, const Headers &headers, SegmentHeaderTemplates *templates = nullptr)
             : address_(address),
                 context_(context),
                 headers_(headers),
-              sizeOfPicOrderGolomb_(headers_.GetSequence()->GetMaxPicOrder()),
-              sizeOfAddress_(headers_.GetSequence()->GetAddressLength()),
-              offsetOfPicOrder_(0),
-            numberOfBytesInPFrameHeader_(0),
-            pFrameNumber_(0)
+                templates_(templates),
+              sizeOfPicOrderGolomb_(headers_.GetSequence()->GetMaxPicOrder())
         { }
 
-        const bytestring &updatedSegmentHeader(const bytestring &segment, bool &isKeyframe) {
-            isKeyframe = false;
-            if (IsKeyframe(segment)) {
+        /**
+         * Rewrites the header of segment for this updater's address. Only the first kMaxHeaderLength bytes of segment are read.
+         * P-frame headers are only parsed when they differ from the last one in more than slice_pic_order_cnt_lsb, since the
+         * other syntax elements, such as slice_qp_delta, determine how the slice data is decoded
+         * @param segment The bytes of a slice segment nal, without a start code
+         * @param isKeyframe Set to whether segment is an IDR slice
+         * @return The rewritten header, including a start code. The rest of the nal is segment's bytes starting at
+         * offsetIntoOriginalSegment(). The returned bytes are overwritten by the next call
+         */
+        const bytestring &updatedSegmentHeader(bytestring_view segment, bool &isKeyframe) {
+            isKeyframe = IsKeyframe(segment);
+            if (isKeyframe) {
                 // Do it normal because header is different.
-                // Also reset the pFrameHeaderBytes for the new GOP.
-                pFrameHeaderBytes_.clear();
-
-                auto current = Load(context_, segment, headers_);
-                current.SetAddressAndPPSId(address_, context_.GetPPSId());
-                iFrameBytes_ = std::move(current.GetBytes());
-
-                isKeyframe = true;
-                return iFrameBytes_;
-            } else if (!pFrameHeaderBytes_.size()) {
-                // Load the next segment and extract its header bytes.
-                auto pFrame = Load(context_, segment, headers_);
-                auto numberOfAddedBitsBeforePicOrder = pFrame.SetAddressAndPPSId(address_, context_.GetPPSId());
-
-                offsetOfPicOrder_ = pFrame.originalOffsetOfPicOrderCnt() + numberOfAddedBitsBeforePicOrder;
-
-                // TODO: This doesn't account for whether GetHeaderBytes() adds emulation prevention bytes.
-                pFrameHeaderBytes_ = std::move(pFrame.GetHeaderBytes());
-                assert(!(pFrame.getEnd() % 8));
-                numberOfBytesInPFrameHeader_ = pFrame.getEnd() / 8;
-                pFrameNumber_ = 1;
-
-                return pFrameHeaderBytes_;
-            } else {
-                // Update pic_order_lsb.
-                ++pFrameNumber_;
-                updatePicOrderInPFrameBytes();
-                return pFrameHeaderBytes_;
+                // Also reset the P-frame header for the new GOP.
+                pFrameTemplate_ = nullptr;
+                keyframeTemplate_ = templateForSegment(segment, true);
+                currentTemplate_ = keyframeTemplate_.get();
+                return keyframeTemplate_->updatedHeader;
             }
+
+            if (!pFrameTemplate_ || !pFrameTemplate_->MatchesExceptForPicOrder(segment, sizeOfPicOrderGolomb_))
+                pFrameTemplate_ = templateForSegment(segment, false);
+            currentTemplate_ = pFrameTemplate_.get();
+
+            // Copy slice_pic_order_cnt_lsb from the segment into the template's header.
+            if (!pFrameTemplate_->canUpdatePicOrder)
+                return pFrameTemplate_->updatedHeader;
+            pFrameRbsp_ = pFrameTemplate_->updatedRbsp;
+            BitReader reader(reinterpret_cast<const unsigned char*>(segment.data()), segment.size(), pFrameTemplate_->originalOffsetOfPicOrder);
+            UpdatePicOrderCntLsb(pFrameRbsp_, pFrameTemplate_->offsetOfPicOrder, reader.ReadBits(sizeOfPicOrderGolomb_), sizeOfPicOrderGolomb_, false);
+            pFrameHeaderBytes_ = AddEmulationPreventionAndMarker(pFrameRbsp_, GetHeaderSize(), pFrameRbsp_.size());
+            return pFrameHeaderBytes_;
         }
 
-        unsigned int offsetIntoOriginalPFrameData() const {
-            return numberOfBytesInPFrameHeader_;
+        /**
+         * @return The offset into the segment last passed to updatedSegmentHeader() of the bytes that follow the rewritten header
+         */
+        unsigned int offsetIntoOriginalSegment() const {
+            return currentTemplate_->originalHeader.size();
         }
 
     private:
-        void updatePicOrderInPFrameBytes() {
-            UpdatePicOrderCntLsb(pFrameHeaderBytes_, offsetOfPicOrder_, pFrameNumber_, sizeOfPicOrderGolomb_, true);
+        std::shared_ptr<const SegmentHeaderTemplate> templateForSegment(bytestring_view segment, bool isKeyframe) {
+            if (templates_) {
+                auto existing = templates_->Find(segment, isKeyframe, sizeOfPicOrderGolomb_);
+                if (existing)
+                    return existing;
+            }
+
+            // Parsing never looks past kMaxHeaderLength bytes, so leave the rest of the segment where it is.
+            auto length = std::min(segment.size(), static_cast<size_t>(SliceSegmentLayer::kMaxHeaderLength));
+            auto header = Load(context_, bytestring(segment.begin(), segment.begin() + length), headers_);
+            auto numberOfAddedBitsBeforePicOrder = header.SetAddressAndPPSId(address_, context_.GetPPSId());
+            assert(!(header.getEnd() % 8));
+
+            auto headerTemplate = std::make_shared<SegmentHeaderTemplate>();
+            auto endOfHeader = OffsetBeforeEmulationPreventionRemoval(segment, GetHeaderSize(), header.getEnd() / 8);
+            headerTemplate->originalHeader.assign(segment.begin(), segment.begin() + endOfHeader);
+            headerTemplate->updatedHeader = header.GetHeaderBytes();
+            headerTemplate->originalOffsetOfPicOrder = isKeyframe ? 0 : header.originalOffsetOfPicOrderCnt();
+            headerTemplate->offsetOfPicOrder = isKeyframe ? 0 : header.originalOffsetOfPicOrderCnt() + numberOfAddedBitsBeforePicOrder;
+            headerTemplate->canUpdatePicOrder = !isKeyframe && endOfHeader == header.getEnd() / 8;
+            if (headerTemplate->canUpdatePicOrder)
+                headerTemplate->updatedRbsp = header.GetHeaderRbsp();
+
+            if (templates_)
+                templates_->Set(headerTemplate, isKeyframe);
+            return headerTemplate;
         }
 
         const unsigned int address_;
         const StitchContext &context_;
         const Headers &headers_;
+        SegmentHeaderTemplates *templates_;
         const unsigned int sizeOfPicOrderGolomb_;
-        unsigned int sizeOfAddress_;
 
-        unsigned int offsetOfPicOrder_;
-        unsigned int numberOfBytesInPFrameHeader_;
-        unsigned int pFrameNumber_;
+        std::shared_ptr<const SegmentHeaderTemplate> keyframeTemplate_;
+        std::shared_ptr<const SegmentHeaderTemplate> pFrameTemplate_;
+        const SegmentHeaderTemplate *currentTemplate_ = nullptr;
+        bytestring pFrameRbsp_;
         bytestring pFrameHeaderBytes_;
-        bytestring iFrameBytes_;
     };
 }; //namespace stitching
 
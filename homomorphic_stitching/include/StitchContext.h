@@ -74,6 +74,20 @@ namespace stitching {
         const unsigned int pps_id_;
     };
 
+    /**
+     * Converts the sizes of a layout's rows or columns to the sizes that a StitchContext takes
+     * @param sizes The size of every row or column, in luma samples
+     * @param ctb_size The CTB size of the tiles' SPS, which is read with TileExtractor::CtbSize
+     * @return The size of every row or column but the last, in CTBs. A size that is not a multiple of the CTB size is
+     * rounded up, since the tile's last CTB is only partly inside the picture
+     */
+    inline std::vector<unsigned int> TileSizesInCtbs(const std::vector<unsigned int> &sizes, unsigned int ctb_size) {
+        std::vector<unsigned int> ctbs;
+        for (auto i = 0u; i + 1 < sizes.size(); ++i)
+            ctbs.push_back((sizes[i] + ctb_size - 1) / ctb_size);
+        return ctbs;
+    }
+
 }; //namespace stitching
 
 #endif //HOMOMORPHIC_STITCHING_STITCHCONTEXT_H
@@ -0,0 +1,99 @@
+#ifndef HOMOMORPHIC_STITCHING_STITCHPLAN_H
+#define HOMOMORPHIC_STITCHING_STITCHPLAN_H
+
+#include "Headers.h"
+#include "SliceSegmentLayer.h"
+#include "StitchContext.h"
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace stitching {
+
+    /**
+     * The parts of stitching that only depend on the tile layout and the tiles' parameter sets: the rewritten VPS/SPS/PPS,
+     * the address of each tile, and templates for each tile's rewritten slice segment headers. Stitchers that share a plan
+     * only parse a slice segment header when it differs from the last one seen at the same tile position
+     */
+    class StitchPlan {
+    public:
+        /**
+         * Rewrites headers for the layout described by context
+         * @param context The context of the stitched video
+         * @param headers The headers parsed from the first tile. These are modified, so they must not be shared
+         */
+        StitchPlan(StitchContext context, std::shared_ptr<const Headers> headers);
+
+        const StitchContext &GetContext() const { return context_; }
+
+        /**
+         *
+         * @return The headers, already rewritten for the stitched video
+         */
+        const std::shared_ptr<const Headers> &GetHeaders() const { return headers_; }
+
+        /**
+         *
+         * @return The bytes of the rewritten VPS, SPS, and PPS, each with a start code
+         */
+        const bytestring &GetHeaderBytes() const { return headerBytes_; }
+
+        size_t GetAddress(unsigned int tile) const { return addresses_[tile]; }
+
+        SegmentHeaderTemplates &GetSegmentHeaderTemplates(unsigned int tile) { return templates_[tile]; }
+
+    private:
+        const StitchContext context_;
+        const std::shared_ptr<const Headers> headers_;
+        bytestring headerBytes_;
+        std::vector<size_t> addresses_;
+        // A deque because SegmentHeaderTemplates cannot be moved
+        std::deque<SegmentHeaderTemplates> templates_;
+    };
+
+    /**
+     * Reuses plans across GOPs. Plans are keyed by the stitch context, which includes the tile layout and PPS id, and by the
+     * parameter sets of the first tile, which capture the tiles' encode parameters. Once maximumNumberOfPlans plans are
+     * cached, the least recently used plan is evicted for each new one
+     */
+    class StitchPlanCache {
+    public:
+        static constexpr size_t DefaultMaximumNumberOfPlans = 64;
+
+        explicit StitchPlanCache(size_t maximumNumberOfPlans = DefaultMaximumNumberOfPlans)
+            : maximumNumberOfPlans_(maximumNumberOfPlans),
+            hits_(0),
+            misses_(0),
+            evictions_(0)
+        { }
+
+        /**
+         * Returns the plan for stitching tiles under context, building it if it is not cached
+         * @param context The context of the stitched video
+         * @param firstTileNals The nals of the first tile, which must start with its parameter sets
+         */
+        std::shared_ptr<StitchPlan> GetPlan(const StitchContext &context, const std::vector<bytestring_view> &firstTileNals);
+
+        unsigned long hits() const;
+        unsigned long misses() const;
+        unsigned long evictions() const;
+        size_t size() const;
+
+    private:
+        using Entry = std::pair<std::string, std::shared_ptr<StitchPlan>>;
+
+        const size_t maximumNumberOfPlans_;
+        mutable std::mutex mutex_;
+        // Ordered from most to least recently used
+        std::list<Entry> plans_;
+        std::unordered_map<std::string, std::list<Entry>::iterator> planForKey_;
+        unsigned long hits_;
+        unsigned long misses_;
+        unsigned long evictions_;
+    };
+
+}; //namespace stitching
+
+#endif //HOMOMORPHIC_STITCHING_STITCHPLAN_H
@@ -3,6 +3,8 @@
 
 #include "Headers.h"
 #include "StitchContext.h"
+#include "StitchPlan.h"
+#include <sys/uio.h>
 #include <unordered_set>
 #include <vector>
 
@@ -17,6 +19,14 @@ namespace stitching {
         frameNumber_(0)
         {}
 
+        /**
+         * Marks the pictures of a GOP that are not in framesToKeep as not output, so that a decoder only outputs the
+         * ones that are needed. Pictures that are not output are still decoded, since later pictures may refer to them.
+         * Each PPS gets output_flag_present_flag, and each independent slice segment gets pic_output_flag
+         * @param gopData Annex B data holding whole pictures in decoding order, starting with their parameter sets.
+         * Replaced by the marked data
+         * @param firstFrameIndex The frame number of the first picture in gopData
+         */
         void addPicOutputFlagToGOP(bytestring &gopData, int firstFrameIndex, const std::unordered_set<int> &framesToKeep);
 
     private:
@@ -24,25 +34,107 @@ namespace stitching {
         unsigned int frameNumber_;
     };
 
+    /**
+     * A stitched bitstream as an ordered list of byte ranges. Rewritten headers are copied into a side buffer owned by this object,
+     * and every other range points into the tiles held by the Stitcher that produced it, so it must not outlive that Stitcher
+     */
+    class StitchedSegments {
+    public:
+        StitchedSegments()
+            : size_(0)
+        { }
+
+        /**
+         * Appends a range that is referenced rather than copied
+         */
+        void AppendView(bytestring_view bytes);
+
+        /**
+         * Appends a copy of bytes, which may be modified or freed once this returns
+         */
+        void AppendCopy(const bytestring &bytes);
+
+        /**
+         *
+         * @return The total number of bytes in the stitched bitstream
+         */
+        size_t size() const { return size_; }
+
+        /**
+         *
+         * @return The ranges in order, e.g. for writev
+         */
+        std::vector<struct iovec> GetIovecs() const;
+
+        /**
+         *
+         * @return The stitched bitstream in a single buffer that is allocated once
+         */
+        std::unique_ptr<bytestring> GetBytes() const;
+
+    private:
+        struct Range {
+            // Null when the range is in sideBuffer_, because sideBuffer_ may be reallocated as it grows
+            const char *view;
+            size_t offset;
+            size_t size;
+        };
+
+        std::vector<Range> ranges_;
+        bytestring sideBuffer_;
+        size_t size_;
+    };
+
     class Stitcher {
         friend class IdenticalFrameRetriever;
      public:
 
         /**
          * Creates a Stitcher object, which involves splitting all of the tiles into their component nals. It also moves all of the data from
-         * the tiles passed in, rendering "data" useless after the constructor
+         * the tiles passed in, rendering "data" useless after the constructor. Nals are not copied; they refer to the moved tiles
          * @param context The context of the video data
          * @param data A vector with each element being the bytestring of a tile. All data is moved from this vector, rendering it useless post
          * processing
          */
         Stitcher(StitchContext context, std::vector<bytestring> &data)
-                : context_(std::move(context)), headers_(context_, GetNals(data).front())
+                : context_(std::move(context)), headers_(std::make_shared<const Headers>(context_, GetNals(data).front()))
         { }
 
-        Stitcher(StitchContext context, std::vector<std::shared_ptr<bytestring>> &data)
-                : context_(std::move(context)), headers_(context_, GetNals(data).front())
+        /**
+         * Same as above, but shares ownership of the tiles rather than moving them
+         */
+        Stitcher(StitchContext context, std::vector<std::shared_ptr<const bytestring>> &data)
+                : context_(std::move(context)), headers_(std::make_shared<const Headers>(context_, GetNals(data).front()))
+        { }
+
+        /**
+         * Same as above, but takes the parameter sets and slice header templates from a plan in cache rather than parsing them
+         * from the tiles. The plan's headers are already rewritten for stitching, so this should only be used to call StitchSegments()
+         * or GetStitchedSegments()
+         */
+        Stitcher(StitchContext context, std::vector<std::shared_ptr<const bytestring>> &data, StitchPlanCache &cache)
+                : context_(std::move(context)), plan_(cache.GetPlan(context_, GetNals(data).front())), headers_(plan_->GetHeaders())
         { }
 
+        /**
+         * Same as above, but refers to tiles that the caller owns, such as mapped files, rather than owning them. The tiles must
+         * outlive the Stitcher and the segments it stitches
+         */
+        Stitcher(StitchContext context, const std::vector<bytestring_view> &data, StitchPlanCache &cache)
+                : context_(std::move(context)), plan_(cache.GetPlan(context_, GetNals(data).front())), headers_(plan_->GetHeaders())
+        { }
+
+        // Nals refer to tiles_, so copies would refer to the original's data.
+        Stitcher(const Stitcher&) = delete;
+        Stitcher& operator=(const Stitcher&) = delete;
+
+        /**
+         *
+         * @return The ranges that make up all tiles passed into the constructor stitched together. Only rewritten slice headers
+         * and parameter sets are copied; everything else refers to the tiles owned by this Stitcher
+         */
+        StitchedSegments StitchSegments();
+
         /**
          *
          * @return A bytestring with all tiles passed into the constructor stitched together
@@ -52,24 +144,26 @@ namespace stitching {
         void addPicOutputFlagIfNecessaryKeepingFrames(const std::unordered_set<int> &framesToKeep);
         bytestring combinedNalsForTile(unsigned int tileNumber) const;
 
-        SliceSegmentLayer loadPFrameSegment(bytestring &data);
+        SliceSegmentLayer loadPFrameSegment(bytestring_view data);
 
         static std::shared_ptr<bytestring> GetActiveParameterSetsSEI();
 
      private:
+        static std::shared_ptr<bytestring> MakeActiveParameterSetsSEI();
 
         /**
          *
          * @return The tile_nals_ field populated with the nals of each tile. Each element of the outer vector is a tile, and each element of the inner
          * vector is a nal for tha tile
          */
-        const std::vector<std::list<bytestring>> &GetNals(std::vector<bytestring> &data);
+        const std::vector<std::vector<bytestring_view>> &GetNals(std::vector<bytestring> &data);
+
+        const std::vector<std::vector<bytestring_view>> &GetNals(std::vector<std::shared_ptr<const bytestring>> &data);
 
-        const std::vector<std::list<bytestring>> &GetNals(std::vector<std::shared_ptr<bytestring>> &data);
+        const std::vector<std::vector<bytestring_view>> &GetNals(const std::vector<bytestring_view> &data);
 
         /**
-         * Returns the nals that are segments for a given tile. Note that this moves the corresponding nal from the tile_nals_ field, rendering the
-         * index for each affected nal useless in the field
+         * Returns the nals that are segments for a given tile
          * @param tile_num The index of the tile in the tile_nals_ vector
          * @param num_bytes A running count of the number of bytes the segment nals of all the tiles occupy. This is incremented by the number of bytes
          * the segments of this tile_num occupy
@@ -78,12 +172,15 @@ namespace stitching {
          * @param first Whether or not this is the first tile being processed
          * @return The nals that are segments for this tile
          */
-        std::list<bytestring> GetSegmentNals(unsigned long tile_num, unsigned long *num_bytes, unsigned long *num_keyframes, bool first);
+        std::vector<bytestring_view> GetSegmentNals(unsigned long tile_num, unsigned long *num_bytes, unsigned long *num_keyframes, bool first);
 
-//        const std::vector<bytestring> tiles_;
-        std::vector<std::list<bytestring>> tile_nals_;
+        // The tile data that tile_nals_ refers to. At most one of these is populated, depending on the constructor
+        std::vector<bytestring> tiles_;
+        std::vector<std::shared_ptr<const bytestring>> sharedTiles_;
+        std::vector<std::vector<bytestring_view>> tile_nals_;
         const StitchContext context_;
-        const Headers headers_;
+        std::shared_ptr<StitchPlan> plan_;
+        std::shared_ptr<const Headers> headers_;
         std::vector<std::vector<std::unique_ptr<Nal>>> formattedNals_;
 //        static std::shared_ptr<bytestring> activeParameterSetsSEI_;
     };
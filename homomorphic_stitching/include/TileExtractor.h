@@ -0,0 +1,314 @@
+#ifndef HOMOMORPHIC_STITCHING_TILEEXTRACTOR_H
+#define HOMOMORPHIC_STITCHING_TILEEXTRACTOR_H
+
+#include "BitReader.h"
+#include "BitWriter.h"
+#include "StitchContext.h"
+#include "bytestring.h"
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace stitching {
+
+    /**
+     * The tile grid of a picture, in luma samples. The last column and row exclude the samples that are cropped by
+     * the conformance window, so the widths and heights add up to the displayed dimensions
+     */
+    struct TileGrid {
+        std::vector<unsigned int> widthsOfColumns;
+        std::vector<unsigned int> heightsOfRows;
+
+        bool operator==(const TileGrid &other) const {
+            return widthsOfColumns == other.widthsOfColumns && heightsOfRows == other.heightsOfRows;
+        }
+
+        bool operator!=(const TileGrid &other) const {
+            return !(*this == other);
+        }
+    };
+
+    /**
+     * Consecutive pictures that share a tile grid, split into one Annex B bitstream per tile in raster order
+     */
+    struct ExtractedTiles {
+        TileGrid grid;
+        unsigned int ctbSize;
+        unsigned int numberOfPictures;
+        /**
+         * Whether every picture is output in the order it is decoded, i.e. the SPS allows no reordering and there are
+         * no leading pictures. Otherwise each picture's output time differs from its decoding time
+         */
+        bool outputsInDecodingOrder;
+        std::vector<bytestring> tiles;
+    };
+
+    /**
+     * Splits an HEVC bitstream that was encoded with tiles into independent bitstreams, one per tile, without decoding
+     * it. This is the inverse of stitching: each tile's SPS and PPS are rewritten for the tile's dimensions with tiles
+     * disabled, and each slice segment header is rewritten with an address relative to its tile. The slice data is
+     * copied as is.
+     *
+     * The tiles can only be decoded on their own if the source was encoded with motion-constrained tiles and without
+     * loop filtering across tiles. The loop filter flag is checked, but motion vectors are not, since that would
+     * require decoding the slice data. Each slice segment must lie within a single tile, and wavefront parallel
+     * processing and range extensions are not supported
+     */
+    class TileExtractor {
+        friend class PicOutputFlagAdder;
+        friend class SkipTileGenerator;
+        friend unsigned int FillSkipTiles(const StitchContext &context, std::vector<std::shared_ptr<const bytestring>> &tiles);
+    public:
+        /**
+         * Splits the pictures in data. Parameter sets seen in earlier calls stay active, so data can be one GOP at a time
+         * @param data Annex B data holding whole pictures
+         * @return The tiles of the pictures in data, with a new element whenever the tile grid changes. The grid
+         * may only change at an IRAP picture. The tiles' parameter sets are repeated at each IRAP picture
+         */
+        std::vector<ExtractedTiles> Extract(bytestring_view data);
+
+        /**
+         * Checks the first PPS in data without parsing any slice segments
+         * @return Whether the pictures in data are split into more than one tile
+         */
+        static bool HasTiles(bytestring_view data);
+
+        /**
+         * @param nal An SPS, without its start code
+         * @return sps_max_num_reorder_pics of the SPS's highest sub-layer. Pictures are output in decoding order if it is 0
+         */
+        static unsigned int MaxNumReorderPics(bytestring_view nal);
+
+        /**
+         * @param data Annex B data that holds an SPS before its first slice segment
+         * @return The size of the CTBs that the first SPS in data codes pictures with, in luma samples
+         */
+        static unsigned int CtbSize(bytestring_view data);
+
+    private:
+        // The pictures each short_term_ref_pic_set() refers to, as derived in 7.4.8
+        struct ShortTermRefPicSet {
+            std::vector<int> deltaPocS0;
+            std::vector<bool> usedByCurrPicS0;
+            std::vector<int> deltaPocS1;
+            std::vector<bool> usedByCurrPicS1;
+
+            size_t NumDeltaPocs() const { return deltaPocS0.size() + deltaPocS1.size(); }
+        };
+
+        // The parts of 7.3.2.2 that are needed to rewrite the SPS and to parse slice segment headers
+        struct SequenceParameters {
+            bytestring rbsp;
+            unsigned int vpsId;
+            unsigned int chromaArrayType;
+            bool separateColourPlane;
+            unsigned int subWidthC;
+            unsigned int subHeightC;
+            unsigned int width;
+            unsigned int height;
+            unsigned int conformanceWindow[4];
+            unsigned int log2MaxPicOrderCntLsb;
+            // sps_max_num_reorder_pics of the highest sub-layer
+            unsigned int maxNumReorderPics;
+            unsigned int log2MinCbSize;
+            unsigned int log2CtbSize;
+            unsigned int log2MinTbSize;
+            unsigned int log2MaxTbSize;
+            unsigned int maxTransformHierarchyDepthIntra;
+            bool pcmEnabled;
+            unsigned int log2MinPcmCbSize;
+            unsigned int log2MaxPcmCbSize;
+            std::vector<ShortTermRefPicSet> shortTermRefPicSets;
+            bool longTermRefPicsPresent;
+            std::vector<bool> usedByCurrPicLongTermSps;
+            bool temporalMvpEnabled;
+            bool sampleAdaptiveOffsetEnabled;
+
+            // Bit offsets into rbsp of pic_width_in_luma_samples, of the first syntax element after the conformance
+            // window, and of rbsp_stop_one_bit
+            size_t dimensionsOffset;
+            size_t afterConformanceWindowOffset;
+            size_t stopBitOffset;
+
+            unsigned int CtbSize() const { return 1u << log2CtbSize; }
+            unsigned int WidthInCtbs() const { return (width + CtbSize() - 1) / CtbSize(); }
+            unsigned int HeightInCtbs() const { return (height + CtbSize() - 1) / CtbSize(); }
+        };
+
+        // The parts of 7.3.2.3 that are needed to rewrite the PPS and to parse slice segment headers
+        struct PictureParameters {
+            bytestring rbsp;
+            unsigned int spsId;
+            bool dependentSliceSegmentsEnabled;
+            bool outputFlagPresent;
+            unsigned int numExtraSliceHeaderBits;
+            bool cabacInitPresent;
+            unsigned int numRefIdxL0DefaultActive;
+            unsigned int numRefIdxL1DefaultActive;
+            int initQp;
+            bool sliceChromaQpOffsetsPresent;
+            bool weightedPred;
+            bool weightedBipred;
+            bool transquantBypassEnabled;
+            bool tilesEnabled;
+            bool entropyCodingSyncEnabled;
+            bool uniformSpacing;
+            unsigned int numberOfColumns;
+            unsigned int numberOfRows;
+            std::vector<unsigned int> columnWidthsInCtbs;
+            std::vector<unsigned int> rowHeightsInCtbs;
+            bool loopFilterAcrossTilesEnabled;
+            bool loopFilterAcrossSlicesEnabled;
+            bool deblockingFilterOverrideEnabled;
+            bool deblockingFilterDisabled;
+            bool listsModificationPresent;
+            bool sliceSegmentHeaderExtensionPresent;
+            bool hasUnsupportedExtension;
+
+            // Bit offsets into rbsp of output_flag_present_flag, of tiles_enabled_flag, of the first syntax element
+            // after the tile information, and of rbsp_stop_one_bit
+            size_t outputFlagPresentOffset;
+            size_t tilesEnabledOffset;
+            size_t afterTilesOffset;
+            size_t stopBitOffset;
+        };
+
+        // The CTB boundaries of the tile columns and rows of a picture, as derived in 6.5.1
+        struct ActiveParameters {
+            unsigned int spsId;
+            unsigned int ppsId;
+            std::vector<unsigned int> columnBoundaries;
+            std::vector<unsigned int> rowBoundaries;
+            TileGrid grid;
+            // The VPS, SPS, and PPS of each tile, with start codes
+            std::vector<bytestring> tileParameterSets;
+        };
+
+        // The parts of 7.3.6.1 that are needed to rewrite a slice segment header or to write slice data for it
+        struct SliceSegmentHeader {
+            // The start of the slice segment with its emulation prevention removed, which holds at least the header
+            bytestring rbsp;
+            bool isFirst;
+            bool isDependent;
+            unsigned int address;
+            unsigned int sliceType;
+            bool saoLuma;
+            bool saoChroma;
+            bool cabacInit;
+            unsigned int maxNumMergeCand;
+            int sliceQpDelta;
+            // Entry points of the tiles or CTB rows after the first one that the slice segment contains
+            unsigned int numberOfEntryPoints;
+
+            // Bit offsets into rbsp of slice_segment_address (or what follows first_slice_segment_in_pic_flag's
+            // pps id when there is none), of the syntax element after it, of pic_output_flag (or where it would be
+            // when the PPS has none), of num_entry_point_offsets, of the syntax element after the entry points, and
+            // of byte_alignment(). Dependent slice segments have no pic_output_flag, and its offset is the one after
+            // the address
+            size_t addressOffset;
+            size_t afterAddressOffset;
+            size_t picOutputFlagOffset;
+            size_t entryPointOffset;
+            size_t afterEntryPointOffset;
+            size_t endOfHeaderSyntax;
+        };
+
+        /**
+         * Splits Annex B data into its nals, without their start codes
+         */
+        static std::vector<bytestring_view> SplitAnnexB(bytestring_view data);
+
+        void ParseVideoParameterSet(bytestring_view nal);
+        void ParseSequenceParameterSet(bytestring_view nal);
+        /**
+         * @return pps_pic_parameter_set_id
+         */
+        unsigned int ParsePictureParameterSet(bytestring_view nal);
+        /**
+         * Parses st_ref_pic_set(index) (7.3.7)
+         * @param sets The sets already parsed from the SPS, which a predicted set may refer to
+         * @param numberOfSetsInSps num_short_term_ref_pic_sets. When index is equal to it, the set is in a slice header
+         */
+        static ShortTermRefPicSet ParseShortTermRefPicSet(BitReader &reader, unsigned int index, unsigned int numberOfSetsInSps,
+                                                          const std::vector<ShortTermRefPicSet> &sets);
+
+        /**
+         * Derives the CTB boundaries of the tile columns or rows of a picture as in 6.5.1
+         * @param explicitSizes The sizes of every tile but the last, which are only used if uniform is false
+         * @return The first CTB of each tile, followed by sizeInCtbs
+         */
+        static std::vector<unsigned int> TileBoundaries(unsigned int numberOfTiles, unsigned int sizeInCtbs, bool uniform,
+                                                        const std::vector<unsigned int> &explicitSizes);
+
+        /**
+         * @param nal A slice segment, without its start code
+         * @return slice_pic_parameter_set_id
+         */
+        static unsigned int PeekPictureParameterSetId(bytestring_view nal);
+
+        void Activate(unsigned int ppsId);
+        static bytestring TileSequenceParameterSet(const SequenceParameters &sps, unsigned int width, unsigned int height,
+                                                   unsigned int conformanceWindowRight, unsigned int conformanceWindowBottom);
+        static bytestring TilePictureParameterSet(const PictureParameters &pps);
+        /**
+         * @return The PPS with output_flag_present_flag set, with a start code
+         */
+        static bytestring OutputFlagPictureParameterSet(const PictureParameters &pps);
+
+        /**
+         * Parses the header of a slice segment of a picture that uses the active parameter sets
+         * @param nal The slice segment, without its start code
+         */
+        SliceSegmentHeader ParseSliceSegmentHeader(bytestring_view nal) const;
+
+        /**
+         * Replaces the header of a slice segment, keeping its slice data
+         * @param header The new header with its nal unit header and without emulation prevention, ending with byte_alignment()
+         * @param nal The slice segment, without its start code
+         * @param endOfHeader The size in bytes of the slice segment's header with its nal unit header and without emulation
+         * prevention, which is where its slice data starts
+         * @return The slice segment with the new header, with a start code
+         */
+        static bytestring ReplaceSliceSegmentHeader(bytestring header, bytestring_view nal, size_t endOfHeader);
+
+        /**
+         * Rewrites a slice segment for the tile that contains it
+         * @param nal The slice segment, without its start code
+         * @param tile Set to the index of the tile that contains the slice segment
+         * @return The rewritten slice segment, with a start code
+         */
+        bytestring RewriteSliceSegment(bytestring_view nal, unsigned int &tile) const;
+
+        /**
+         * Sets pic_output_flag in an independent slice segment, inserting it if the slice segment's PPS does not have
+         * output_flag_present_flag set
+         * @param nal The slice segment, without its start code
+         * @return The rewritten slice segment, with a start code
+         */
+        static bytestring OutputFlagSliceSegment(const SliceSegmentHeader &header, const PictureParameters &pps,
+                                                 bytestring_view nal, bool output);
+
+        std::unordered_map<unsigned int, bytestring> videoParameterSets_;
+        std::unordered_map<unsigned int, SequenceParameters> sequenceParameterSets_;
+        std::unordered_map<unsigned int, PictureParameters> pictureParameterSets_;
+        std::unique_ptr<ActiveParameters> active_;
+        // Set when a parameter set arrives, since the next picture may refer to a changed version of the active one
+        bool parameterSetsChanged_ = false;
+    };
+
+    /**
+     * Splits any of tiles that were themselves stitched from several tiles back into the tiles they contain, so that
+     * all of them can be stitched into one picture. The tiles inside the tiles of a column must have the same widths,
+     * and those inside the tiles of a row must have the same heights
+     * @param context The context for stitching tiles as they are
+     * @param tiles The data for one GOP of each tile, in raster order. Tiles that were not read may be null. Replaced by
+     * the data of the finer grid's tiles, which are null where the tile that covers them was
+     * @return The context for stitching the finer grid, or nothing if no tile has tiles of its own, in which case tiles
+     * is not modified
+     */
+    std::optional<StitchContext> ExpandStitchedTiles(const StitchContext &context, std::vector<std::shared_ptr<const bytestring>> &tiles);
+
+}; //namespace stitching
+
+#endif //HOMOMORPHIC_STITCHING_TILEEXTRACTOR_H
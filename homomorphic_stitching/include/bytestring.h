@@ -1,10 +1,14 @@
 #ifndef HOMOMORPHIC_STITCHING_BYTESTRING_H
 #define HOMOMORPHIC_STITCHING_BYTESTRING_H
 
+#include <string_view>
 #include <vector>
 
 namespace stitching {
     using bytestring = std::vector<char>;
+
+    // A non-owning range of bytes, e.g. a single nal within a tile's bytestring
+    using bytestring_view = std::string_view;
 }
 
 #endif //HOMOMORPHIC_STITCHING_BYTESTRING_H
@@ -0,0 +1,22 @@
+#include "BitWriter.h"
+
+namespace stitching {
+
+    bytestring BitWriter::GetBytes() const {
+        assert(!(bits_in_word_ % CHAR_BIT));
+        bytestring bytes(bytes_);
+        for (auto i = 0u; i < bits_in_word_ / CHAR_BIT; i++)
+            bytes.push_back(static_cast<char>(word_ >> (56 - i * CHAR_BIT)));
+        return bytes;
+    }
+
+    BitArray BitWriter::GetBitArray() const {
+        bytestring bytes(bytes_);
+        for (auto i = 0u; i < (bits_in_word_ + CHAR_BIT - 1) / CHAR_BIT; i++)
+            bytes.push_back(static_cast<char>(word_ >> (56 - i * CHAR_BIT)));
+
+        BitArray bits(bytes);
+        bits.resize(SizeInBits());
+        return bits;
+    }
+}; //namespace stitching
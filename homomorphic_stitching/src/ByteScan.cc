@@ -0,0 +1,113 @@
+#include "ByteScan.h"
+#include <cassert>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HOMOMORPHIC_STITCHING_X86
+#endif
+
+namespace stitching {
+
+    static const char *FindZeroPairScalar(const char *begin, const char *end) {
+        for (auto p = begin; p + 1 < end; p++) {
+            if (!p[0] && !p[1])
+                return p;
+        }
+        return end;
+    }
+
+#ifdef HOMOMORPHIC_STITCHING_X86
+#ifdef __SSE2__
+    static const char *FindZeroPairSSE2(const char *begin, const char *end) {
+        auto zero = _mm_setzero_si128();
+        auto p = begin;
+        // Compare each byte and its successor at once: (p[i] | p[i + 1]) is zero only when both are.
+        for (; end - p > static_cast<std::ptrdiff_t>(sizeof(__m128i)); p += sizeof(__m128i)) {
+            auto current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            auto next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+            auto mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(current, next), zero));
+            if (mask)
+                return p + __builtin_ctz(static_cast<unsigned int>(mask));
+        }
+        return FindZeroPairScalar(p, end);
+    }
+#endif
+
+    __attribute__((target("avx2")))
+    static const char *FindZeroPairAVX2(const char *begin, const char *end) {
+        auto zero = _mm256_setzero_si256();
+        auto p = begin;
+        for (; end - p > static_cast<std::ptrdiff_t>(sizeof(__m256i)); p += sizeof(__m256i)) {
+            auto current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            auto next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+            auto mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_or_si256(current, next), zero));
+            if (mask)
+                return p + __builtin_ctz(static_cast<unsigned int>(mask));
+        }
+        return FindZeroPairScalar(p, end);
+    }
+#endif
+
+    using FindZeroPairFunction = const char *(*)(const char*, const char*);
+
+    static FindZeroPairFunction FindZeroPairForPath(ByteScanPath path) {
+        switch (path) {
+#ifdef HOMOMORPHIC_STITCHING_X86
+            case ByteScanPath::AVX2:
+                return __builtin_cpu_supports("avx2") ? FindZeroPairAVX2 : nullptr;
+#ifdef __SSE2__
+            case ByteScanPath::SSE2:
+                return FindZeroPairSSE2;
+#endif
+#endif
+            case ByteScanPath::Scalar:
+                return FindZeroPairScalar;
+            default:
+                return nullptr;
+        }
+    }
+
+    static FindZeroPairFunction SelectFindZeroPair() {
+        if (auto find = FindZeroPairForPath(ByteScanPath::AVX2))
+            return find;
+        if (auto find = FindZeroPairForPath(ByteScanPath::SSE2))
+            return find;
+        return FindZeroPairScalar;
+    }
+
+    static const char *FindStartCode(const char *begin, const char *end, FindZeroPairFunction findZeroPair) {
+        for (auto p = findZeroPair(begin, end); p != end; p = findZeroPair(p + 1, end)) {
+            if (end - p < 4)
+                return end;
+            if (!p[2] && p[3] == 1)
+                return p;
+        }
+        return end;
+    }
+
+    bool IsByteScanPathSupported(ByteScanPath path) {
+        return FindZeroPairForPath(path) != nullptr;
+    }
+
+    const char *FindZeroPair(const char *begin, const char *end) {
+        static const FindZeroPairFunction find = SelectFindZeroPair();
+        return find(begin, end);
+    }
+
+    const char *FindZeroPair(const char *begin, const char *end, ByteScanPath path) {
+        auto find = FindZeroPairForPath(path);
+        assert(find);
+        return find(begin, end);
+    }
+
+    const char *FindStartCode(const char *begin, const char *end) {
+        static const FindZeroPairFunction find = SelectFindZeroPair();
+        return FindStartCode(begin, end, find);
+    }
+
+    const char *FindStartCode(const char *begin, const char *end, ByteScanPath path) {
+        auto find = FindZeroPairForPath(path);
+        assert(find);
+        return FindStartCode(begin, end, find);
+    }
+}; //namespace stitching
@@ -2,13 +2,21 @@
 
 namespace stitching {
 
-	Headers::Headers(const StitchContext &context, const std::list<bytestring> &nals)  {
+	static std::vector<bytestring_view> ViewsOf(const std::list<bytestring> &nals) {
+		std::vector<bytestring_view> views;
+		views.reserve(nals.size());
+		for (const auto &nal : nals)
+			views.emplace_back(nal.data(), nal.size());
+		return views;
+	}
+
+	Headers::Headers(const StitchContext &context, const std::vector<bytestring_view> &nals)  {
 	    auto i = 0u;
 
 	    // No need to check if it < nals.end() since any well formed stream
         // is guaranteed to have three headers
 		for (auto it = nals.begin(); i < kNumHeaders; it++) {
-	  		auto current_nal = Load(context, *it);
+	  		auto current_nal = Load(context, bytestring(it->begin(), it->end()));
 	  		if (current_nal->IsHeader()) {
                 headers_.push_back(current_nal);
                 if (current_nal->IsSequence()) {
@@ -23,6 +31,10 @@ namespace stitching {
 		assert(headers_.size() == kNumHeaders);
 	}
 
+	Headers::Headers(const StitchContext &context, const std::list<bytestring> &nals)
+		: Headers(context, ViewsOf(nals))
+	{ }
+
 	bytestring Headers::GetBytes() const {
 		bytestring bytes;
 
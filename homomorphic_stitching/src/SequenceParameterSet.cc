@@ -48,9 +48,13 @@ namespace stitching {
     }
 
     SequenceParameterSet::SequenceParameterSet(const StitchContext &context, const bytestring &data)
+            : SequenceParameterSet(context, data, std::make_shared<const bytestring>(RemoveEmulationPreventionBytes(data, GetHeaderSize(), data.size()))) {
+    }
+
+    SequenceParameterSet::SequenceParameterSet(const StitchContext &context, const bytestring &data, std::shared_ptr<const bytestring> rbsp)
             : Nal(context, data),
-              data_(RemoveEmulationPrevention(data, GetHeaderSize(), data.size())),
-              spsMetadata_({data_.begin(), data_.begin() + GetHeaderSizeInBits()}) {
+              data_(*rbsp),
+              spsMetadata_({rbsp, GetHeaderSizeInBits()}) {
 
         dimensions_ = spsMetadata_.GetTileDimensions();
         log2_max_pic_order_cnt_lsb_ = spsMetadata_.GetMaxPicOrder();
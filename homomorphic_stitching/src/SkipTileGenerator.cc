@@ -0,0 +1,444 @@
+#include "SkipTileGenerator.h"
+#include "BitWriter.h"
+#include "Emulation.h"
+#include "Nal.h"
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <map>
+#include <stdexcept>
+
+namespace stitching {
+
+    static constexpr unsigned int kSliceTypeB = 0;
+    static constexpr unsigned int kSliceTypeI = 2;
+
+    // rangeTabLps (Table 9-52), indexed by pStateIdx and qRangeIdx
+    static const unsigned char kRangeTableLps[64][4] = {
+            {128, 176, 208, 240}, {128, 167, 197, 227}, {128, 158, 187, 216}, {123, 150, 178, 205},
+            {116, 142, 169, 195}, {111, 135, 160, 185}, {105, 128, 152, 175}, {100, 122, 144, 166},
+            {95, 116, 137, 158}, {90, 110, 130, 150}, {85, 104, 123, 142}, {81, 99, 117, 135},
+            {77, 94, 111, 128}, {73, 89, 105, 122}, {69, 85, 100, 116}, {66, 80, 95, 110},
+            {62, 76, 90, 104}, {59, 72, 86, 99}, {56, 69, 81, 94}, {53, 65, 77, 89},
+            {51, 62, 73, 85}, {48, 59, 69, 80}, {46, 56, 66, 76}, {43, 53, 63, 72},
+            {41, 50, 59, 69}, {39, 48, 56, 65}, {37, 45, 54, 62}, {35, 43, 51, 59},
+            {33, 41, 48, 56}, {32, 39, 46, 53}, {30, 37, 43, 50}, {29, 35, 41, 48},
+            {27, 33, 39, 45}, {26, 31, 37, 43}, {24, 30, 35, 41}, {23, 28, 33, 39},
+            {22, 27, 32, 37}, {21, 26, 30, 35}, {20, 24, 29, 33}, {19, 23, 27, 31},
+            {18, 22, 26, 30}, {17, 21, 25, 28}, {16, 20, 23, 27}, {15, 19, 22, 25},
+            {14, 18, 21, 24}, {14, 17, 20, 23}, {13, 16, 19, 22}, {12, 15, 18, 21},
+            {12, 14, 17, 20}, {11, 14, 16, 19}, {11, 13, 15, 18}, {10, 12, 15, 17},
+            {10, 12, 14, 16}, {9, 11, 13, 15}, {9, 11, 12, 14}, {8, 10, 12, 14},
+            {8, 9, 11, 13}, {7, 9, 11, 12}, {7, 9, 10, 12}, {7, 8, 10, 11},
+            {6, 8, 9, 11}, {6, 7, 9, 10}, {6, 7, 8, 9}, {2, 2, 2, 2}};
+
+    // transIdxLps (Table 9-53). transIdxMps is pStateIdx + 1, up to 62
+    static const unsigned char kTransitionIndexLps[64] = {
+            0, 0, 1, 2, 2, 4, 4, 5, 6, 7, 8, 9, 9, 11, 11, 12,
+            13, 13, 15, 15, 16, 16, 18, 18, 19, 19, 21, 21, 22, 22, 23, 24,
+            24, 25, 26, 26, 27, 27, 28, 29, 29, 30, 30, 30, 31, 32, 32, 33,
+            33, 33, 34, 34, 35, 35, 35, 36, 36, 36, 37, 37, 37, 38, 38, 63};
+
+    /**
+     * The state of one context variable, initialized from its initValue as in 9.3.2.2
+     */
+    struct ContextModel {
+        ContextModel() = default;
+
+        ContextModel(unsigned int initValue, int sliceQp) {
+            auto slope = static_cast<int>(initValue >> 4) * 5 - 45;
+            auto offset = (static_cast<int>(initValue & 15) << 3) - 16;
+            auto state = std::clamp(((slope * std::clamp(sliceQp, 0, 51)) >> 4) + offset, 1, 126);
+            isMpsOne = state > 63;
+            stateIndex = isMpsOne ? state - 64 : 63 - state;
+        }
+
+        unsigned int stateIndex;
+        bool isMpsOne;
+    };
+
+    /**
+     * The arithmetic encoding engine of 9.3.4.3
+     */
+    class CabacWriter {
+    public:
+        explicit CabacWriter(BitWriter &writer)
+            : writer_(writer), low_(0), range_(510), isFirstBit_(true), bitsOutstanding_(0)
+        { }
+
+        void EncodeDecision(ContextModel &context, bool bin) {
+            auto lpsRange = kRangeTableLps[context.stateIndex][(range_ >> 6) & 3];
+            range_ -= lpsRange;
+            if (bin != context.isMpsOne) {
+                low_ += range_;
+                range_ = lpsRange;
+                if (!context.stateIndex)
+                    context.isMpsOne = !context.isMpsOne;
+                context.stateIndex = kTransitionIndexLps[context.stateIndex];
+            } else if (context.stateIndex < 62) {
+                ++context.stateIndex;
+            }
+            Renormalize();
+        }
+
+        void EncodeBypass(bool bin) {
+            low_ <<= 1;
+            if (bin)
+                low_ += range_;
+            if (low_ >= 1024) {
+                PutBit(true);
+                low_ -= 1024;
+            } else if (low_ < 512) {
+                PutBit(false);
+            } else {
+                low_ -= 512;
+                ++bitsOutstanding_;
+            }
+        }
+
+        /**
+         * Encodes a bin with the terminating engine. Encoding a 1 flushes the engine, and its last bit is the
+         * rbsp_stop_one_bit
+         */
+        void EncodeTerminate(bool bin) {
+            range_ -= 2;
+            if (!bin) {
+                Renormalize();
+                return;
+            }
+
+            low_ += range_;
+            range_ = 2;
+            Renormalize();
+            PutBit((low_ >> 9) & 1);
+            writer_.WriteBits(((low_ >> 7) & 3) | 1, 2);
+        }
+
+    private:
+        void Renormalize() {
+            while (range_ < 256) {
+                if (low_ < 256) {
+                    PutBit(false);
+                } else if (low_ >= 512) {
+                    low_ -= 512;
+                    PutBit(true);
+                } else {
+                    low_ -= 256;
+                    ++bitsOutstanding_;
+                }
+                range_ <<= 1;
+                low_ <<= 1;
+            }
+        }
+
+        void PutBit(bool bit) {
+            if (isFirstBit_)
+                isFirstBit_ = false;
+            else
+                writer_.WriteBit(bit);
+            for (; bitsOutstanding_; --bitsOutstanding_)
+                writer_.WriteBit(!bit);
+        }
+
+        BitWriter &writer_;
+        unsigned int low_;
+        unsigned int range_;
+        bool isFirstBit_;
+        unsigned int bitsOutstanding_;
+    };
+
+    /**
+     * The context variables of the syntax elements that skip tiles use, with the initValues of Tables 9-5 to 9-37
+     * for each initType. Elements that are not used for an initType are initialized to 154
+     */
+    struct SkipTileContexts {
+        SkipTileContexts(unsigned int initType, int sliceQp) {
+            auto initialize = [&](auto &contexts, std::initializer_list<std::initializer_list<unsigned int>> initValues) {
+                auto values = (initValues.begin() + initType)->begin();
+                for (auto &context : contexts)
+                    context = ContextModel(*values++, sliceQp);
+            };
+            initialize(saoMergeFlag, {{153}, {153}, {153}});
+            initialize(saoTypeIndex, {{200}, {185}, {160}});
+            initialize(splitCuFlag, {{139, 141, 157}, {107, 139, 126}, {107, 139, 126}});
+            initialize(cuTransquantBypassFlag, {{154}, {154}, {154}});
+            initialize(cuSkipFlag, {{154, 154, 154}, {197, 185, 201}, {197, 185, 201}});
+            initialize(mergeIndex, {{154}, {122}, {137}});
+            initialize(partMode, {{184}, {154}, {154}});
+            initialize(previousIntraLumaPredictionFlag, {{184}, {154}, {183}});
+            initialize(intraChromaPredictionMode, {{63}, {152}, {152}});
+            initialize(splitTransformFlag, {{153, 138, 138}, {124, 138, 94}, {224, 167, 122}});
+            initialize(cbfLuma, {{111, 141}, {153, 111}, {153, 111}});
+            initialize(cbfChroma, {{94, 138, 182, 154}, {149, 107, 167, 154}, {149, 92, 167, 154}});
+        }
+
+        ContextModel saoMergeFlag[1];
+        ContextModel saoTypeIndex[1];
+        ContextModel splitCuFlag[3];
+        ContextModel cuTransquantBypassFlag[1];
+        ContextModel cuSkipFlag[3];
+        ContextModel mergeIndex[1];
+        ContextModel partMode[1];
+        ContextModel previousIntraLumaPredictionFlag[1];
+        ContextModel intraChromaPredictionMode[1];
+        ContextModel splitTransformFlag[3];
+        ContextModel cbfLuma[2];
+        ContextModel cbfChroma[4];
+    };
+
+    SkipTileGenerator::SkipTileGenerator(bytestring_view templateTile)
+        : templateTile_(templateTile),
+          ctbSize_(0)
+    {
+        for (auto nal : TileExtractor::SplitAnnexB(templateTile)) {
+            if (nal.size() > GetHeaderSize() && PeekType(nal) == NalUnitSPS) {
+                TileExtractor parser;
+                parser.ParseSequenceParameterSet(nal);
+                auto &sps = parser.sequenceParameterSets_.begin()->second;
+                ctbSize_ = sps.CtbSize();
+                codedDimensions_ = {sps.width, sps.height};
+                return;
+            }
+        }
+        throw std::runtime_error("Skip tiles can only be generated from a tile that starts with its parameter sets");
+    }
+
+    bytestring SkipTileGenerator::Generate(const unsigned int width, const unsigned int height,
+                                           unsigned int displayWidth, unsigned int displayHeight) const {
+        displayWidth = displayWidth ? displayWidth : width;
+        displayHeight = displayHeight ? displayHeight : height;
+        if (displayWidth > width || displayHeight > height)
+            throw std::runtime_error("Skip tiles cannot display more than they code");
+
+        TileExtractor parser;
+        bytestring tile;
+        for (auto nal : TileExtractor::SplitAnnexB(templateTile_)) {
+            if (nal.size() <= GetHeaderSize())
+                continue;
+
+            auto type = PeekType(nal);
+            if (type == NalUnitVPS || type == NalUnitSPS || type == NalUnitPPS) {
+                if (type == NalUnitVPS)
+                    parser.ParseVideoParameterSet(nal);
+                else if (type == NalUnitSPS)
+                    parser.ParseSequenceParameterSet(nal);
+                else
+                    parser.ParsePictureParameterSet(nal);
+                parser.parameterSetsChanged_ = true;
+                continue;
+            } else if (type > NalUnitReservedIRAPVCL23) {
+                continue;
+            }
+
+            // Write the parameter sets ahead of the first slice segment that follows them, as the template does.
+            if (parser.parameterSetsChanged_) {
+                parser.Activate(TileExtractor::PeekPictureParameterSetId(nal));
+                parser.parameterSetsChanged_ = false;
+                if (parser.active_->tileParameterSets.size() != 1)
+                    throw std::runtime_error("Skip tiles cannot be generated from a tile that is stitched from tiles");
+
+                auto &sps = parser.sequenceParameterSets_.at(parser.active_->spsId);
+                auto &vps = parser.videoParameterSets_.at(sps.vpsId);
+                // The conformance window is in units of chroma samples (7-43 and 7-44).
+                if ((width - displayWidth) % sps.subWidthC || (height - displayHeight) % sps.subHeightC)
+                    throw std::runtime_error("Skip tiles can only be cropped by a multiple of the chroma subsampling");
+                auto tileSequenceParameterSet = TileExtractor::TileSequenceParameterSet(sps, width, height,
+                                                                                         (width - displayWidth) / sps.subWidthC,
+                                                                                         (height - displayHeight) / sps.subHeightC);
+                auto tilePictureParameterSet = TileExtractor::TilePictureParameterSet(parser.pictureParameterSets_.at(parser.active_->ppsId));
+                tile.insert(tile.end(), vps.begin(), vps.end());
+                tile.insert(tile.end(), tileSequenceParameterSet.begin(), tileSequenceParameterSet.end());
+                tile.insert(tile.end(), tilePictureParameterSet.begin(), tilePictureParameterSet.end());
+            } else if (!parser.active_) {
+                throw std::runtime_error("Skip tiles can only be generated from a tile that starts with its parameter sets");
+            }
+
+            auto header = parser.ParseSliceSegmentHeader(nal);
+            if (!header.isFirst)
+                throw std::runtime_error("Skip tiles can only be generated from tiles with one slice segment per picture");
+
+            // The header ends with byte_alignment(), so it is kept as is and followed by new slice data.
+            bytestring segment(header.rbsp.begin(), header.rbsp.begin() + (header.endOfHeaderSyntax + CHAR_BIT) / CHAR_BIT);
+            auto data = SliceData(header,
+                                  parser.sequenceParameterSets_.at(parser.active_->spsId),
+                                  parser.pictureParameterSets_.at(parser.active_->ppsId),
+                                  width, height);
+            segment.insert(segment.end(), data.begin(), data.end());
+            segment = AddEmulationPreventionAndMarker(segment, GetHeaderSize(), segment.size());
+            tile.insert(tile.end(), segment.begin(), segment.end());
+        }
+        return tile;
+    }
+
+    bytestring SkipTileGenerator::SliceData(const TileExtractor::SliceSegmentHeader &header,
+                                            const TileExtractor::SequenceParameters &sps,
+                                            const TileExtractor::PictureParameters &pps,
+                                            const unsigned int width, const unsigned int height) {
+        if (sps.chromaArrayType > 1)
+            throw std::runtime_error("Skip tiles can only be generated for 4:2:0 or monochrome video");
+        if (width % (1u << sps.log2MinCbSize) || height % (1u << sps.log2MinCbSize))
+            throw std::runtime_error("Skip tile dimensions must be a multiple of the minimum coding block size");
+
+        auto isIntra = header.sliceType == kSliceTypeI;
+        auto initType = isIntra ? 0 : ((header.sliceType == kSliceTypeB) == header.cabacInit ? 1 : 2);
+        SkipTileContexts contexts(initType, pps.initQp + header.sliceQpDelta);
+        BitWriter writer;
+        CabacWriter cabac(writer);
+
+        // The depth of the coding quadtree at each minimum coding block, which selects the context of split_cu_flag.
+        auto minCbSize = 1u << sps.log2MinCbSize;
+        auto widthInMinCbs = width / minCbSize;
+        std::vector<unsigned char> depths(widthInMinCbs * (height / minCbSize));
+        auto depthAt = [&](unsigned int x, unsigned int y) -> unsigned int {
+            return depths[(y / minCbSize) * widthInMinCbs + x / minCbSize];
+        };
+
+        // transform_tree() (7.3.8.8) with every coded block flag equal to 0, so no transform_unit() has any syntax.
+        std::function<void(unsigned int, unsigned int)> transformTree = [&](unsigned int log2TrafoSize, unsigned int trafoDepth) {
+            auto split = log2TrafoSize > sps.log2MaxTbSize;
+            if (log2TrafoSize <= sps.log2MaxTbSize && log2TrafoSize > sps.log2MinTbSize && trafoDepth < sps.maxTransformHierarchyDepthIntra)
+                cabac.EncodeDecision(contexts.splitTransformFlag[5 - log2TrafoSize], false);
+            if (log2TrafoSize > 2 && sps.chromaArrayType && !trafoDepth) {
+                cabac.EncodeDecision(contexts.cbfChroma[trafoDepth], false); // cbf_cb
+                cabac.EncodeDecision(contexts.cbfChroma[trafoDepth], false); // cbf_cr
+            }
+            if (split) {
+                for (auto i = 0; i < 4; i++)
+                    transformTree(log2TrafoSize - 1, trafoDepth + 1);
+            } else {
+                cabac.EncodeDecision(contexts.cbfLuma[trafoDepth ? 0 : 1], false);
+            }
+        };
+
+        // coding_unit() (7.3.8.5): intra 2Nx2N with the first most probable mode and no residual, or skipped with the
+        // first merge candidate.
+        auto codingUnit = [&](unsigned int x0, unsigned int y0, unsigned int log2CbSize) {
+            if (pps.transquantBypassEnabled)
+                cabac.EncodeDecision(contexts.cuTransquantBypassFlag[0], false);
+            if (!isIntra) {
+                cabac.EncodeDecision(contexts.cuSkipFlag[(x0 > 0) + (y0 > 0)], true);
+                if (header.maxNumMergeCand > 1)
+                    cabac.EncodeDecision(contexts.mergeIndex[0], false);
+                return;
+            }
+
+            if (log2CbSize == sps.log2MinCbSize)
+                cabac.EncodeDecision(contexts.partMode[0], true); // PART_2Nx2N
+            if (sps.pcmEnabled && log2CbSize >= sps.log2MinPcmCbSize && log2CbSize <= sps.log2MaxPcmCbSize)
+                cabac.EncodeTerminate(false); // pcm_flag
+            cabac.EncodeDecision(contexts.previousIntraLumaPredictionFlag[0], true);
+            cabac.EncodeBypass(false); // mpm_idx
+            if (sps.chromaArrayType)
+                cabac.EncodeDecision(contexts.intraChromaPredictionMode[0], false); // Same mode as luma.
+            transformTree(log2CbSize, 0);
+        };
+
+        // coding_quadtree() (7.3.8.4), which only splits blocks that cross the edge of the picture.
+        std::function<void(unsigned int, unsigned int, unsigned int, unsigned int)> codingQuadtree =
+                [&](unsigned int x0, unsigned int y0, unsigned int log2CbSize, unsigned int depth) {
+            auto size = 1u << log2CbSize;
+            auto split = log2CbSize > sps.log2MinCbSize;
+            if (x0 + size <= width && y0 + size <= height && log2CbSize > sps.log2MinCbSize) {
+                auto context = (x0 > 0 && depthAt(x0 - 1, y0) > depth) + (y0 > 0 && depthAt(x0, y0 - 1) > depth);
+                cabac.EncodeDecision(contexts.splitCuFlag[context], false);
+                split = false;
+            }
+
+            if (split) {
+                auto half = size / 2;
+                for (auto y = y0; y < y0 + size && y < height; y += half) {
+                    for (auto x = x0; x < x0 + size && x < width; x += half)
+                        codingQuadtree(x, y, log2CbSize - 1, depth + 1);
+                }
+                return;
+            }
+
+            for (auto y = y0; y < y0 + size; y += minCbSize) {
+                for (auto x = x0; x < x0 + size; x += minCbSize)
+                    depths[(y / minCbSize) * widthInMinCbs + x / minCbSize] = depth;
+            }
+            codingUnit(x0, y0, log2CbSize);
+        };
+
+        auto ctbSize = sps.CtbSize();
+        for (auto y = 0u; y < height; y += ctbSize) {
+            for (auto x = 0u; x < width; x += ctbSize) {
+                // sao() (7.3.8.3): the first CTB turns SAO off, and the rest merge with their left or upper neighbour.
+                if (header.saoLuma || header.saoChroma) {
+                    if (x || y) {
+                        cabac.EncodeDecision(contexts.saoMergeFlag[0], true);
+                    } else {
+                        if (header.saoLuma)
+                            cabac.EncodeDecision(contexts.saoTypeIndex[0], false);
+                        if (header.saoChroma)
+                            cabac.EncodeDecision(contexts.saoTypeIndex[0], false);
+                    }
+                }
+
+                codingQuadtree(x, y, sps.log2CtbSize, 0);
+                cabac.EncodeTerminate(x + ctbSize >= width && y + ctbSize >= height); // end_of_slice_segment_flag
+            }
+        }
+
+        writer.ByteAlign();
+        return writer.GetBytes();
+    }
+
+    unsigned int FillSkipTiles(const StitchContext &context, std::vector<std::shared_ptr<const bytestring>> &tiles) {
+        auto numberOfSkipTiles = static_cast<unsigned int>(std::count(tiles.begin(), tiles.end(), nullptr));
+        if (!numberOfSkipTiles)
+            return 0;
+
+        auto templateTile = std::find_if(tiles.begin(), tiles.end(), [](const auto &tile) { return tile != nullptr; });
+        if (templateTile == tiles.end())
+            throw std::runtime_error("Skip tiles need a tile that was read to copy their headers from");
+        SkipTileGenerator generator(bytestring_view((*templateTile)->data(), (*templateTile)->size()));
+
+        // Find the dimensions of each tile as the stitched picture will divide it. Each tile is coded up to the edge of
+        // the stitched picture, and the conformance window crops the last column and row to the displayed picture.
+        auto ctbSize = generator.CtbSize();
+        auto numberOfRows = context.GetTileDimensions().first;
+        auto numberOfColumns = context.GetTileDimensions().second;
+        assert(tiles.size() == numberOfRows * numberOfColumns);
+        auto codedWidth = context.GetVideoCodedWidth();
+        auto codedHeight = context.GetVideoCodedHeight();
+        auto displayWidth = context.GetVideoDisplayWidth() ? context.GetVideoDisplayWidth() : codedWidth;
+        auto displayHeight = context.GetVideoDisplayHeight() ? context.GetVideoDisplayHeight() : codedHeight;
+        auto columns = TileExtractor::TileBoundaries(numberOfColumns, (codedWidth + ctbSize - 1) / ctbSize,
+                                                     context.GetShouldUseUniformTiles(), context.GetWidthsOfTiles());
+        auto rows = TileExtractor::TileBoundaries(numberOfRows, (codedHeight + ctbSize - 1) / ctbSize,
+                                                  context.GetShouldUseUniformTiles(), context.GetHeightsOfTiles());
+        auto size = [&](const std::vector<unsigned int> &boundaries, unsigned int index, unsigned int pictureSize) {
+            return std::min(boundaries[index + 1] * ctbSize, pictureSize) - std::min(boundaries[index] * ctbSize, pictureSize);
+        };
+        auto dimensionsOfTile = [&](unsigned int tile, bool display) -> std::pair<unsigned int, unsigned int> {
+            return {size(columns, tile % numberOfColumns, display ? displayWidth : codedWidth),
+                    size(rows, tile / numberOfColumns, display ? displayHeight : codedHeight)};
+        };
+
+        // Slice data is only valid for the CTBs of the picture it was coded for, so a template that was coded at another size
+        // means the real tiles will not line up with the skip tiles either.
+        auto templateIndex = static_cast<unsigned int>(templateTile - tiles.begin());
+        if (generator.CodedDimensions() != dimensionsOfTile(templateIndex, false))
+            throw std::runtime_error("Tile " + std::to_string(templateIndex) + " is coded at "
+                                     + std::to_string(generator.CodedDimensions().first) + "x" + std::to_string(generator.CodedDimensions().second)
+                                     + ", which does not match the area it covers in the stitched picture");
+
+        std::map<std::pair<std::pair<unsigned int, unsigned int>, std::pair<unsigned int, unsigned int>>, std::shared_ptr<bytestring>> skipTiles;
+        for (auto i = 0u; i < tiles.size(); i++) {
+            if (tiles[i])
+                continue;
+
+            auto coded = dimensionsOfTile(i, false);
+            auto display = dimensionsOfTile(i, true);
+            if (!display.first || !display.second)
+                throw std::runtime_error("Skip tiles must display at least one sample");
+            auto &skipTile = skipTiles[{coded, display}];
+            if (!skipTile)
+                skipTile = std::make_shared<bytestring>(generator.Generate(coded.first, coded.second, display.first, display.second));
+            tiles[i] = skipTile;
+        }
+        return numberOfSkipTiles;
+    }
+
+}; //namespace stitching
@@ -107,7 +107,7 @@ namespace stitching {
             data.insert(data.begin() + indexFollowingTrailing1, 7, false);
     }
 
-    IDRSliceSegmentLayerMetadata::IDRSliceSegmentLayerMetadata(BitStream& metadata, HeadersMetadata headersMetadata)
+    IDRSliceSegmentLayerMetadata::IDRSliceSegmentLayerMetadata(BitStream& metadata, const HeadersMetadata &headersMetadata)
         : SliceSegmentLayerMetadata(metadata, headersMetadata) {
         GetBitStream().CollectValue("first_slice_segment_in_pic_flag", 1, true);
         GetBitStream().SkipBits(1); // no_output_of_prior_pics_flag
@@ -132,7 +132,7 @@ namespace stitching {
             idrSliceSegmentLayerMetadata_(GetBitStream(), headersMetadata_){
     }
 
-    TrailRSliceSegmentLayerMetadata::TrailRSliceSegmentLayerMetadata(BitStream &metadata, stitching::HeadersMetadata headersMetadata)
+    TrailRSliceSegmentLayerMetadata::TrailRSliceSegmentLayerMetadata(BitStream &metadata, const stitching::HeadersMetadata &headersMetadata)
         : SliceSegmentLayerMetadata(metadata, headersMetadata) {
         GetBitStream().CollectValue("first_slice_segment_in_pic_flag", 1, true);
         GetBitStream().MarkPosition("slice_pic_parameter_set_id_offset");
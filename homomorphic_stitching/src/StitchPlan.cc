@@ -0,0 +1,111 @@
+#include "StitchPlan.h"
+
+namespace stitching {
+
+    StitchPlan::StitchPlan(StitchContext context, std::shared_ptr<const Headers> headers)
+        : context_(std::move(context)),
+        headers_(std::move(headers)) {
+        headers_->GetSequence()->SetConformanceWindow(context_.GetVideoDisplayWidth(), context_.GetVideoCodedWidth(),
+                                                      context_.GetVideoDisplayHeight(), context_.GetVideoCodedHeight());
+        headers_->GetSequence()->SetDimensions(context_.GetVideoDimensions());
+        headers_->GetSequence()->SetGeneralLevelIDC(120);
+        headers_->GetVideo()->SetGeneralLevelIDC(120);
+        headers_->GetPicture()->SetTileDimensions(context_.GetTileDimensions());
+        // Set PPS_Id after setting tile dimensions to avoid issues with the offsets changing.
+        headers_->GetPicture()->SetPPSId(context_.GetPPSId());
+
+        addresses_ = headers_->GetSequence()->GetAddresses();
+        headerBytes_ = headers_->GetBytes();
+        for (auto i = 0u; i < addresses_.size(); i++)
+            templates_.emplace_back();
+    }
+
+    static void AppendToKey(std::string &key, unsigned int value) {
+        key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    static std::string KeyForPlan(const StitchContext &context, const std::vector<bytestring_view> &firstTileNals) {
+        std::string key;
+        AppendToKey(key, context.GetTileDimensions().first);
+        AppendToKey(key, context.GetTileDimensions().second);
+        AppendToKey(key, context.GetVideoCodedHeight());
+        AppendToKey(key, context.GetVideoCodedWidth());
+        AppendToKey(key, context.GetVideoDisplayHeight());
+        AppendToKey(key, context.GetVideoDisplayWidth());
+        AppendToKey(key, context.GetShouldUseUniformTiles());
+        AppendToKey(key, context.GetPPSId());
+        AppendToKey(key, context.GetHeightsOfTiles().size());
+        for (auto height : context.GetHeightsOfTiles())
+            AppendToKey(key, height);
+        AppendToKey(key, context.GetWidthsOfTiles().size());
+        for (auto width : context.GetWidthsOfTiles())
+            AppendToKey(key, width);
+
+        // The parameter sets determine how slice headers are parsed and rewritten.
+        auto numberOfHeaders = 0u;
+        for (auto it = firstTileNals.begin(); it != firstTileNals.end() && numberOfHeaders < Headers::kNumHeaders; it++) {
+            auto type = PeekType(*it);
+            if (type != NalUnitVPS && type != NalUnitSPS && type != NalUnitPPS)
+                continue;
+
+            AppendToKey(key, it->size());
+            key.append(it->data(), it->size());
+            ++numberOfHeaders;
+        }
+        return key;
+    }
+
+    std::shared_ptr<StitchPlan> StitchPlanCache::GetPlan(const StitchContext &context, const std::vector<bytestring_view> &firstTileNals) {
+        auto key = KeyForPlan(context, firstTileNals);
+        {
+            std::scoped_lock lock(mutex_);
+            auto plan = planForKey_.find(key);
+            if (plan != planForKey_.end()) {
+                ++hits_;
+                plans_.splice(plans_.begin(), plans_, plan->second);
+                return plan->second->second;
+            }
+            ++misses_;
+        }
+
+        // Build the plan without holding the lock. If another thread builds the same plan, the first one to finish is kept.
+        auto plan = std::make_shared<StitchPlan>(context, std::make_shared<const Headers>(context, firstTileNals));
+        std::scoped_lock lock(mutex_);
+        auto existing = planForKey_.find(key);
+        if (existing != planForKey_.end())
+            return existing->second->second;
+        if (!maximumNumberOfPlans_)
+            return plan;
+
+        // Stitchers that are still using an evicted plan keep it alive through their own reference
+        if (plans_.size() == maximumNumberOfPlans_) {
+            planForKey_.erase(plans_.back().first);
+            plans_.pop_back();
+            ++evictions_;
+        }
+        plans_.emplace_front(key, plan);
+        planForKey_[key] = plans_.begin();
+        return plan;
+    }
+
+    unsigned long StitchPlanCache::hits() const {
+        std::scoped_lock lock(mutex_);
+        return hits_;
+    }
+
+    unsigned long StitchPlanCache::misses() const {
+        std::scoped_lock lock(mutex_);
+        return misses_;
+    }
+
+    unsigned long StitchPlanCache::evictions() const {
+        std::scoped_lock lock(mutex_);
+        return evictions_;
+    }
+
+    size_t StitchPlanCache::size() const {
+        std::scoped_lock lock(mutex_);
+        return plans_.size();
+    }
+
+}; //namespace stitching
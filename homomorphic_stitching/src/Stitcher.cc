@@ -1,87 +1,102 @@
 #include "Stitcher.h"
 #include "SliceSegmentLayer.h"
+#include "BitWriter.h"
+#include "ByteScan.h"
+#include "TileExtractor.h"
 #include <algorithm>
 #include <list>
 
 namespace stitching {
 
-    //TODO typedef nested type
-    const std::vector<std::list<bytestring>> &Stitcher::GetNals(std::vector<bytestring> &data) {
-        tile_nals_.resize(data.size());
-        auto index = 0u;
-        for (auto &tile : data) {
-            auto zero_count = 0u;
-            auto first = true;
-            auto start = tile.begin();
-            for (auto it = tile.begin(); it != tile.end(); it++) {
-                auto c = static_cast<unsigned char>(*it);
-                // We found the nal marker "0001"
-                if (c == 1 && zero_count >= 3) {
-                    // Since each stream will start with 0001, the first segment will always be empty,
-                    // so we want to just discard it
-                    if (!first) {
-                        // -3, not -4, because the constructor is exclusive [first, last)
-                        tile_nals_[index].push_back(move(bytestring(make_move_iterator(start), make_move_iterator(it - 3))));
-                    } else {
-                        first = false;
-                    }
-                    zero_count = 0;
-                    start = it + 1;
-                } else if (c == 0) {
-                    zero_count++;
-                } else {
-                    zero_count = 0;
-                }
-            }
-            tile_nals_[index].push_back(move(bytestring(make_move_iterator(start), make_move_iterator(tile.end()))));
-            ++index;
+    /**
+     * Appends views of the nals in tile to nals, without their start codes
+     */
+    static void SplitNals(bytestring_view tile, std::vector<bytestring_view> &nals) {
+        auto first = tile.data();
+        auto last = first + tile.size();
+        auto start = first;
+        // Since each stream will start with 0001, the first segment will always be empty,
+        // so we want to just discard it
+        auto isFirst = true;
+        for (auto marker = FindStartCode(first, last); marker != last; marker = FindStartCode(start, last)) {
+            if (!isFirst)
+                nals.emplace_back(start, marker - start);
+            isFirst = false;
+            start = marker + Nal::kNalMarker4.size();
         }
-        return tile_nals_;
+        nals.emplace_back(start, last - start);
     }
 
-const std::vector<std::list<bytestring>> &Stitcher::GetNals(std::vector<std::shared_ptr<bytestring>> &data) {
-    tile_nals_.resize(data.size());
-    auto index = 0u;
-    for (auto &tile : data) {
-        auto zero_count = 0u;
-        auto first = true;
-        auto start = tile->begin();
-        for (auto it = tile->begin(); it != tile->end(); it++) {
-            auto c = static_cast<unsigned char>(*it);
-            // We found the nal marker "0001"
-            if (c == 1 && zero_count >= 3) {
-                // Since each stream will start with 0001, the first segment will always be empty,
-                // so we want to just discard it
-                if (!first) {
-                    // -3, not -4, because the constructor is exclusive [first, last)
-                    tile_nals_[index].push_back(move(bytestring(make_move_iterator(start), make_move_iterator(it - 3))));
-                } else {
-                    first = false;
-                }
-                zero_count = 0;
-                start = it + 1;
-            } else if (c == 0) {
-                zero_count++;
-            } else {
-                zero_count = 0;
-            }
+    void StitchedSegments::AppendView(bytestring_view bytes) {
+        ranges_.push_back({bytes.data(), 0, bytes.size()});
+        size_ += bytes.size();
+    }
+
+    void StitchedSegments::AppendCopy(const bytestring &bytes) {
+        // Consecutive copies are contiguous in the side buffer, so they can share a range.
+        if (!ranges_.empty() && !ranges_.back().view)
+            ranges_.back().size += bytes.size();
+        else
+            ranges_.push_back({nullptr, sideBuffer_.size(), bytes.size()});
+
+        sideBuffer_.insert(sideBuffer_.end(), bytes.begin(), bytes.end());
+        size_ += bytes.size();
+    }
+
+    std::vector<struct iovec> StitchedSegments::GetIovecs() const {
+        std::vector<struct iovec> iovecs;
+        iovecs.reserve(ranges_.size());
+        for (const auto &range : ranges_) {
+            auto start = range.view ? range.view : sideBuffer_.data() + range.offset;
+            iovecs.push_back({const_cast<char*>(start), range.size});
         }
-        tile_nals_[index].push_back(move(bytestring(make_move_iterator(start), make_move_iterator(tile->end()))));
-        ++index;
+        return iovecs;
     }
-    return tile_nals_;
-}
 
-    std::list<bytestring> Stitcher::GetSegmentNals(const unsigned long tile_num, unsigned long *num_bytes, unsigned long *num_keyframes, bool first) {
+    std::unique_ptr<bytestring> StitchedSegments::GetBytes() const {
+        std::unique_ptr<bytestring> bytes(new bytestring);
+        bytes->reserve(size_);
+        for (const auto &range : GetIovecs()) {
+            auto start = static_cast<const char*>(range.iov_base);
+            bytes->insert(bytes->end(), start, start + range.iov_len);
+        }
+        return bytes;
+    }
+
+    //TODO typedef nested type
+    const std::vector<std::vector<bytestring_view>> &Stitcher::GetNals(std::vector<bytestring> &data) {
+        tiles_ = std::move(data);
+        tile_nals_.resize(tiles_.size());
+        for (auto i = 0u; i < tiles_.size(); i++)
+            SplitNals(bytestring_view(tiles_[i].data(), tiles_[i].size()), tile_nals_[i]);
+        return tile_nals_;
+    }
+
+    const std::vector<std::vector<bytestring_view>> &Stitcher::GetNals(std::vector<std::shared_ptr<const bytestring>> &data) {
+        sharedTiles_ = data;
+        tile_nals_.resize(sharedTiles_.size());
+        for (auto i = 0u; i < sharedTiles_.size(); i++)
+            SplitNals(bytestring_view(sharedTiles_[i]->data(), sharedTiles_[i]->size()), tile_nals_[i]);
+        return tile_nals_;
+    }
+
+    const std::vector<std::vector<bytestring_view>> &Stitcher::GetNals(const std::vector<bytestring_view> &data) {
+        tile_nals_.resize(data.size());
+        for (auto i = 0u; i < data.size(); i++)
+            SplitNals(data[i], tile_nals_[i]);
+        return tile_nals_;
+    }
+
+    std::vector<bytestring_view> Stitcher::GetSegmentNals(const unsigned long tile_num, unsigned long *num_bytes, unsigned long *num_keyframes, bool first) {
         auto &nals = tile_nals_[tile_num];
-        std::list<bytestring> segments;
+        std::vector<bytestring_view> segments;
         for (auto &nal : nals) {
             if (IsSegment(nal)) {
                 if (IsKeyframe(nal) && first) {
                     (*num_keyframes)++;
                 }
                 *num_bytes += nal.size();
-                segments.push_back(move(nal));
+                segments.push_back(nal);
 
             }
         }
@@ -130,10 +145,12 @@ const std::vector<std::list<bytestring>> &Stitcher::GetNals(std::vector<std::sha
     }
 
     std::shared_ptr<bytestring> Stitcher::GetActiveParameterSetsSEI() {
-        static std::shared_ptr<bytestring> activeParameterSetsSEI_ = nullptr;
-        if (activeParameterSetsSEI_)
-            return activeParameterSetsSEI_;
+        // Stitchers may run on several threads, so build the SEI in a thread-safe static initializer.
+        static const std::shared_ptr<bytestring> activeParameterSetsSEI = MakeActiveParameterSetsSEI();
+        return activeParameterSetsSEI;
+    }
 
+    std::shared_ptr<bytestring> Stitcher::MakeActiveParameterSetsSEI() {
         unsigned int payloadType = 129;
         unsigned int payloadSize = 2;
 
@@ -144,231 +161,136 @@ const std::vector<std::list<bytestring>> &Stitcher::GetNals(std::vector<std::sha
         unsigned int active_seq_parameter_set_id = 0;
         unsigned int layer_sps_idx = 0;
 
-        BitArray payloadBits(8);
-        payloadBits.SetByte(0, payloadType);
-
-        payloadBits.Insert(payloadBits.size(), payloadSize, 8);
-        payloadBits.Insert(payloadBits.size(), active_video_parameter_set_id, 4);
-        payloadBits.Insert(payloadBits.size(), self_contained_cvs_flag, 1);
-        payloadBits.Insert(payloadBits.size(), no_parameter_set_update_flag, 1);
-
-        BitArray numSpsIdsMinus1Bits = EncodeGolombs({ num_sps_ids_minus1 });
-        payloadBits.insert(payloadBits.end(), numSpsIdsMinus1Bits.begin(), numSpsIdsMinus1Bits.end());
-
-        BitArray activeSeqParameterSetBits = EncodeGolombs({ active_seq_parameter_set_id });
-        payloadBits.insert(payloadBits.end(), activeSeqParameterSetBits.begin(), activeSeqParameterSetBits.end());
-
-        BitArray layerSpsIdxBits = EncodeGolombs({ layer_sps_idx });
-        payloadBits.insert(payloadBits.end(), layerSpsIdxBits.begin(), layerSpsIdxBits.end());
+        BitWriter payloadBits;
+        payloadBits.WriteBits(payloadType, 8);
+        payloadBits.WriteBits(payloadSize, 8);
+        payloadBits.WriteBits(active_video_parameter_set_id, 4);
+        payloadBits.WriteBits(self_contained_cvs_flag, 1);
+        payloadBits.WriteBits(no_parameter_set_update_flag, 1);
+        payloadBits.WriteExponentialGolomb(num_sps_ids_minus1);
+        payloadBits.WriteExponentialGolomb(active_seq_parameter_set_id);
+        payloadBits.WriteExponentialGolomb(layer_sps_idx);
 
-        payloadBits.Insert(payloadBits.size(), 1, 1); // Payload bits I guess?
-        payloadBits.ByteAlignWithoutRemoval();
+        payloadBits.WriteBit(true); // Payload bits I guess?
+        payloadBits.ByteAlign();
 
-        payloadBits.Insert(payloadBits.size(), 1, 1); // 1-bit of RBSP trailing bits.
-        payloadBits.ByteAlignWithoutRemoval();
+        payloadBits.WriteBit(true); // 1-bit of RBSP trailing bits.
+        payloadBits.ByteAlign();
 
-        // Convert to bytes.
-        auto numberOfBytes = payloadBits.size() / 8;
-        bytestring payloadBytes(numberOfBytes);
-        for (auto i = 0u; i < numberOfBytes; i++)
-            payloadBytes[i] = payloadBits.GetByte(i);
+        auto payloadBytes = payloadBits.GetBytes();
 
-        activeParameterSetsSEI_ = GetPrefixSEINut();
-        activeParameterSetsSEI_->insert(activeParameterSetsSEI_->end(), payloadBytes.begin(), payloadBytes.end());
+        auto activeParameterSetsSEI = GetPrefixSEINut();
+        activeParameterSetsSEI->insert(activeParameterSetsSEI->end(), payloadBytes.begin(), payloadBytes.end());
 
-        return activeParameterSetsSEI_;
+        return activeParameterSetsSEI;
     }
 
-    std::unique_ptr<bytestring> Stitcher::GetStitchedSegments() {
-        headers_.GetSequence()->SetConformanceWindow(context_.GetVideoDisplayWidth(), context_.GetVideoCodedWidth(),
-                                                     context_.GetVideoDisplayHeight(), context_.GetVideoCodedHeight());
-        headers_.GetSequence()->SetDimensions(context_.GetVideoDimensions());
-        headers_.GetSequence()->SetGeneralLevelIDC(120);
-        headers_.GetVideo()->SetGeneralLevelIDC(120);
-        headers_.GetPicture()->SetTileDimensions(context_.GetTileDimensions());
-        // Set PPS_Id after setting tile dimensions to avoid issues with the offsets changing.
-        headers_.GetPicture()->SetPPSId(context_.GetPPSId());
+    StitchedSegments Stitcher::StitchSegments() {
+        if (!plan_)
+            plan_ = std::make_shared<StitchPlan>(context_, headers_);
 
         auto numberOfTiles = tile_nals_.size();
-        std::list<std::list<bytestring>> segment_nals;
-        auto num_segments = 0u;
+        std::vector<std::vector<bytestring_view>> segment_nals;
         unsigned long num_bytes = 0u;
         unsigned long num_keyframes = 0u;
 
-        auto addresses = headers_.GetSequence()->GetAddresses();
-        auto header_bytes = headers_.GetBytes();
+        auto &header_bytes = plan_->GetHeaderBytes();
 
         // First, collect the segment nals from each tile
         // Create a SegmentAddressUpdater for each tile.
         std::vector<SegmentAddressUpdater> updaters;
-        std::vector<std::list<bytestring>::iterator> segmentDataIterators;
+        segment_nals.reserve(numberOfTiles);
         updaters.reserve(numberOfTiles);
-        segmentDataIterators.reserve(numberOfTiles);
         for (auto i = 0u; i < numberOfTiles; i++) {
             segment_nals.emplace_back(GetSegmentNals(i, &num_bytes, &num_keyframes, i == 0u));
-            num_segments += segment_nals.back().size();
-
-            updaters.emplace_back(addresses[i], context_, headers_);
-            segmentDataIterators.emplace_back(segment_nals.back().begin());
+            updaters.emplace_back(plan_->GetAddress(i), context_, *headers_, &plan_->GetSegmentHeaderTemplates(i));
         }
 
-        std::unique_ptr<bytestring> result(new bytestring);
-        auto seiSize = context_.GetPPSId() ? Stitcher::GetActiveParameterSetsSEI()->size() : 0;
-        result->reserve(header_bytes.size() * num_keyframes + num_bytes + seiSize);
-
-        auto it = segment_nals.front().begin();
+        StitchedSegments result;
         bool first = true;
-        while (it != segment_nals.front().end()) {
+        for (auto segment = 0u; segment < segment_nals.front().size(); segment++) {
           for (auto i = 0u; i < numberOfTiles; i++) {
             bool isKeyframe = false;
-            auto &headerData = updaters[i].updatedSegmentHeader(*segmentDataIterators[i], isKeyframe);
-            if (isKeyframe) {
-                if (!i) {
-                    result->insert(result->end(), header_bytes.begin(), header_bytes.end());
-
-                    if (first && context_.GetPPSId()) {
-                        first = false;
-                        auto activeParameterSEIBytes = Stitcher::GetActiveParameterSetsSEI();
-                        result->insert(result->end(), activeParameterSEIBytes->begin(), activeParameterSEIBytes->end());
-                    }
-                }
+            auto &segmentData = segment_nals[i][segment];
+            auto &headerData = updaters[i].updatedSegmentHeader(segmentData, isKeyframe);
+            if (isKeyframe && !i) {
+                result.AppendCopy(header_bytes);
 
-                // For keyframes, insert all of the data.
-                result->insert(result->end(), headerData.begin(), headerData.end());
-            } else {
-                result->insert(result->end(), headerData.begin(), headerData.end());
-                //  TODO: compensate for size containing header nals / emulation bytes.
-                result->insert(result->end(), segmentDataIterators[i]->begin() + updaters[i].offsetIntoOriginalPFrameData(), segmentDataIterators[i]->end());
+                if (first && context_.GetPPSId()) {
+                    first = false;
+                    result.AppendCopy(*Stitcher::GetActiveParameterSetsSEI());
+                }
             }
-            ++segmentDataIterators[i];
+
+            // Only the rewritten header is copied; the rest of the segment is referenced in place.
+            //  TODO: compensate for size containing header nals / emulation bytes.
+            result.AppendCopy(headerData);
+            result.AppendView(segmentData.substr(std::min<size_t>(updaters[i].offsetIntoOriginalSegment(), segmentData.size())));
           }
-          it++;
         }
         return result;
     }
 
-    static BitArray createBitArray(const bytestring &data, bytestring::iterator &currentByte, unsigned int numberOfBytesToTranslate) {
-        BitArray bits(0);
-        bits.reserve(numberOfBytesToTranslate * 8);
-        for (auto i = 0u; i < numberOfBytesToTranslate; i++) {
-            unsigned char c = *currentByte++;
-            if (c == 3)
-                continue;
-
-            for (auto j = 0; j < 8; j++)
-                bits.push_back((c << j) & 128);
-        }
-
-        return bits;
-    }
-
-    static void updateBytes(bytestring &data, unsigned int startingByteIndex, unsigned int numberOfBytesToUpdate, const BitArray &updatedBits) {
-        auto translatedByteIndex = 0u;
-        for (auto i = 0u; i < numberOfBytesToUpdate; ++i) {
-            if (data[startingByteIndex+ i] == 3)
-                continue;
-
-            data[startingByteIndex + i] = updatedBits.GetByte(translatedByteIndex++);
-        }
-        assert(translatedByteIndex == updatedBits.size() / 8);
-    }
-
-    static void insertPicOutputFlag(bytestring &data, bytestring::iterator startingByte, HeadersMetadata &headersMetadata, unsigned int nalType, bool value) {
-        auto numberOfBytesToTranslate = 4;
-
-        auto indexOfStartOfHeader = std::distance(data.begin(), startingByte);
-        BitArray sliceHeaderBits = createBitArray(data, startingByte, numberOfBytesToTranslate);
-        BitStream parser(sliceHeaderBits.begin(), sliceHeaderBits.begin());
-
-        SliceSegmentLayerMetadata *sliceMetadata = nullptr;
-        if (nalType == NalUnitCodedSliceIDRWRADL)
-            sliceMetadata = new IDRSliceSegmentLayerMetadata(parser, headersMetadata);
-        else
-            sliceMetadata = new TrailRSliceSegmentLayerMetadata(parser, headersMetadata);
-
-        sliceMetadata->InsertPicOutputFlag(sliceHeaderBits, value);
-        updateBytes(data, indexOfStartOfHeader, numberOfBytesToTranslate, sliceHeaderBits);
-
-        delete sliceMetadata;
+    std::unique_ptr<bytestring> Stitcher::GetStitchedSegments() {
+        return StitchSegments().GetBytes();
     }
 
     void PicOutputFlagAdder::addPicOutputFlagToGOP(bytestring &gopData, int firstFrameIndex, const std::unordered_set<int> &framesToKeep) {
-        bytestring nalPattern = { 0, 0, 0, 1 };
-
-        auto currentFrameIndex = firstFrameIndex;
-        auto currentStart = gopData.begin();
-
-        std::unique_ptr<PictureParameterSetMetadata> ppsMetadata;
-        std::unique_ptr<SequenceParameterSetMetadata> spsMetadata;
-        std::unique_ptr<HeadersMetadata> headersMetadata;
-
-        bool nalsAlreadyHaveOutputFlagPresentFlag = false;
-        while (currentStart != gopData.end()) {
-            // Move the iterator past the nal header.
-            currentStart += 4;
-            auto nalType = PeekType(*currentStart);
-
-            // Advance past the header.
-            currentStart += GetHeaderSize();
-            if (nalType == NalUnitPPS) {
-                // Flip bit if it's not already set.
-                // Need to find it first …
-
-                // Start of next nal = size of header.
-                auto startOfNextNal = std::search(currentStart, gopData.end(), nalPattern.begin(), nalPattern.end());
-                auto sizeOfPPS = std::distance(currentStart, startOfNextNal);
-                auto indexOfStartOfHeader = std::distance(gopData.begin(), currentStart);
-
-                BitArray headerBits = createBitArray(gopData, currentStart, sizeOfPPS);
-                BitStream parser(headerBits.begin(), headerBits.begin());
-                ppsMetadata = std::make_unique<PictureParameterSetMetadata>(parser);
-                if (spsMetadata.get()) {
-                    assert(!headersMetadata);
-                    headersMetadata = std::make_unique<HeadersMetadata>(*ppsMetadata, *spsMetadata);
+        TileExtractor parser;
+        bytestring marked;
+        marked.reserve(gopData.size() + gopData.size() / 256);
+
+        auto currentFrameIndex = firstFrameIndex - 1;
+        auto keep = true;
+        for (auto nal : TileExtractor::SplitAnnexB(bytestring_view(gopData.data(), gopData.size()))) {
+            auto type = nal.size() > GetHeaderSize() ? PeekType(nal) : NalUnitInvalid;
+            bytestring rewritten;
+            if (type == NalUnitVPS) {
+                parser.ParseVideoParameterSet(nal);
+            } else if (type == NalUnitSPS) {
+                parser.ParseSequenceParameterSet(nal);
+            } else if (type == NalUnitPPS) {
+                auto &pps = parser.pictureParameterSets_.at(parser.ParsePictureParameterSet(nal));
+                if (!pps.outputFlagPresent)
+                    rewritten = TileExtractor::OutputFlagPictureParameterSet(pps);
+            } else if (type <= NalUnitReservedIRAPVCL23) {
+                if (static_cast<unsigned char>(nal[GetHeaderSize()]) & 0x80u) {
+                    // Only the parameter set ids are needed to parse the headers, so the picture does not have to
+                    // meet the restrictions on extracting tiles.
+                    auto ppsId = TileExtractor::PeekPictureParameterSetId(nal);
+                    auto pps = parser.pictureParameterSets_.find(ppsId);
+                    if (pps == parser.pictureParameterSets_.end() || !parser.sequenceParameterSets_.count(pps->second.spsId))
+                        throw std::runtime_error("Slice segment refers to a parameter set that does not precede it");
+                    parser.active_ = std::make_unique<TileExtractor::ActiveParameters>();
+                    parser.active_->ppsId = ppsId;
+                    parser.active_->spsId = pps->second.spsId;
+                    keep = framesToKeep.count(++currentFrameIndex);
+                } else if (!parser.active_) {
+                    throw std::runtime_error("Data must start with the first slice segment of a picture");
                 }
 
-                if (ppsMetadata->OutputFlagPresentFlag())
-                    nalsAlreadyHaveOutputFlagPresentFlag = true;
-                else {
-                    headerBits[ppsMetadata->GetOutputFlagPresentFlagOffset()] = true;
-
-                    // Convert back into bytes and replace in gopData.
-                    updateBytes(gopData, indexOfStartOfHeader, sizeOfPPS, headerBits);
-                }
-            } else if (nalType == NalUnitSPS) {
-                // Get metadata for SPS.
-                auto startOfNextNal = std::search(currentStart, gopData.end(), nalPattern.begin(), nalPattern.end());
-                auto sizeOfSPS = std::distance(currentStart, startOfNextNal);
-                BitArray headerBits = createBitArray(gopData, currentStart, sizeOfSPS);
-                BitStream parser(headerBits.begin(), headerBits.begin());
-                spsMetadata = std::make_unique<SequenceParameterSetMetadata>(parser);
-                if (ppsMetadata.get()) {
-                    assert(!headersMetadata.get());
-                    headersMetadata = std::make_unique<HeadersMetadata>(*ppsMetadata, *spsMetadata);
-                }
-
-            } else if (nalType == NalUnitCodedSliceIDRWRADL || nalType == NalUnitCodedSliceTrailR) {
-                // Insert bit and re-byte-align.
-                assert(headersMetadata.get());
-
-                if (nalsAlreadyHaveOutputFlagPresentFlag)
-                    continue;
-
-                insertPicOutputFlag(gopData, currentStart, *headersMetadata, nalType, framesToKeep.count(currentFrameIndex++));
+                auto header = parser.ParseSliceSegmentHeader(nal);
+                if (!header.isDependent)
+                    rewritten = TileExtractor::OutputFlagSliceSegment(header, parser.pictureParameterSets_.at(parser.active_->ppsId), nal, keep);
             }
 
-            currentStart = std::search(currentStart, gopData.end(), nalPattern.begin(), nalPattern.end());
+            if (!rewritten.empty())
+                marked.insert(marked.end(), rewritten.begin(), rewritten.end());
+            else {
+                marked.insert(marked.end(), Nal::kNalMarker4.begin(), Nal::kNalMarker4.end());
+                marked.insert(marked.end(), nal.begin(), nal.end());
+            }
         }
-    }
-
 
+        gopData = std::move(marked);
+    }
 
     void Stitcher::addPicOutputFlagIfNecessaryKeepingFrames(const std::unordered_set<int> &framesToKeep) {
         for (const auto &nals : tile_nals_) {
             std::vector<std::unique_ptr<Nal>> nalObjects;
             nalObjects.reserve(nals.size());
             for (const auto &nalData : nals) {
-                nalObjects.emplace_back(LoadNal(context_, nalData, headers_));
+                nalObjects.emplace_back(LoadNal(context_, bytestring(nalData.begin(), nalData.end()), *headers_));
             }
 
             // Now go through nals.
@@ -415,8 +337,8 @@ const std::vector<std::list<bytestring>> &Stitcher::GetNals(std::vector<std::sha
         return allData;
     }
 
-    SliceSegmentLayer Stitcher::loadPFrameSegment(bytestring &data) {
-        return TrailRSliceSegmentLayer(context_, data, headers_);
+    SliceSegmentLayer Stitcher::loadPFrameSegment(bytestring_view data) {
+        return TrailRSliceSegmentLayer(context_, bytestring(data.begin(), data.end()), *headers_);
     }
 
 void IdenticalFrameRetriever::getPFrameData(Stitcher &stitcher) {
@@ -429,13 +351,11 @@ void IdenticalFrameRetriever::getPFrameData(Stitcher &stitcher) {
     auto pFrameSegment = stitcher.loadPFrameSegment(segments.back());
 
     picOutputCntLsbBitOffset_ = pFrameSegment.originalOffsetOfPicOrderCnt();
-    numberOfBitsForPicOutputCntLsb_ = stitcher.headers_.GetSequence()->GetMaxPicOrder();
+    numberOfBitsForPicOutputCntLsb_ = stitcher.headers_->GetSequence()->GetMaxPicOrder();
 
     pFrameHeader_ = pFrameSegment.GetHeaderBytes();
 
     auto endOfHeader = pFrameSegment.getEnd() / 8;
-    auto sizeOfData = segments.back().size() - endOfHeader;
-    pFrameData_.reserve(sizeOfData);
-    std::copy(segments.back().begin() + endOfHeader, segments.back().end(), pFrameData_.begin());
+    pFrameData_.assign(segments.back().begin() + endOfHeader, segments.back().end());
 }
 }; //namespace stitching
@@ -0,0 +1,1021 @@
+#include "TileExtractor.h"
+#include "ByteScan.h"
+#include "Emulation.h"
+#include "Nal.h"
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+
+namespace stitching {
+
+    // Parameter sets and slice segment headers are parsed from at most this many bytes at first, so that the
+    // emulation prevention bytes of the slice data do not have to be removed
+    static constexpr size_t kSliceHeaderPrefixLength = 256;
+
+    static constexpr unsigned int kSliceTypeB = 0;
+    static constexpr unsigned int kSliceTypeP = 1;
+    static constexpr unsigned int kSliceTypeI = 2;
+
+    /**
+     * Finds the nal that follows position, without its start code. Unlike the stitcher's tiles, streams from other
+     * encoders may use three byte start codes, so both lengths are accepted
+     * @param position The first byte to search. Set to the end of the nal that is found, or to last if there is none
+     * @return The nal, or nothing if there are no more nals
+     */
+    static std::optional<bytestring_view> NextNal(const char *&position, const char *last) {
+        const char *start = nullptr;
+        auto p = FindZeroPair(position, last);
+        for (; p != last && last - p >= 3; p = FindZeroPair(p + 1, last)) {
+            if (p[2] != 1)
+                continue;
+            if (start)
+                break;
+            start = p + 3;
+            p += 2;
+        }
+        if (!start)
+            p = last;
+
+        // Trailing zero bytes belong to the next start code.
+        auto end = p == last || last - p < 3 ? last : p;
+        position = end;
+        if (!start)
+            return {};
+        while (end > start && !end[-1])
+            --end;
+        return bytestring_view(start, end - start);
+    }
+
+    std::vector<bytestring_view> TileExtractor::SplitAnnexB(bytestring_view data) {
+        std::vector<bytestring_view> nals;
+        auto position = data.data();
+        while (auto nal = NextNal(position, data.data() + data.size()))
+            nals.push_back(*nal);
+        return nals;
+    }
+
+    static inline bool IsIRAP(unsigned int type) {
+        return type >= NalUnitCodedSliceBLAWLP && type <= NalUnitReservedIRAPVCL23;
+    }
+
+    static inline bool IsSupportedSliceType(unsigned int type) {
+        return type <= NalUnitCodedSliceRASLR || (type >= NalUnitCodedSliceBLAWLP && type <= NalUnitCodedSliceCRA);
+    }
+
+    static inline bool IsLeadingPicture(unsigned int type) {
+        return type >= NalUnitCodedSliceRADLN && type <= NalUnitCodedSliceRASLR;
+    }
+
+    static inline unsigned int CeilLog2(unsigned int value) {
+        return value <= 1 ? 0 : FloorLog2(value - 1) + 1;
+    }
+
+    static bytestring RawByteSequencePayload(bytestring_view nal, size_t length) {
+        length = std::min(length, nal.size());
+        return RemoveEmulationPreventionBytes(bytestring(nal.begin(), nal.begin() + length), GetHeaderSize(), length);
+    }
+
+    static size_t StopBitOffset(const bytestring &rbsp) {
+        auto last = std::find_if(rbsp.rbegin(), rbsp.rend(), [](char c) { return c; });
+        if (last == rbsp.rend())
+            throw std::runtime_error("Parameter set is missing its rbsp_stop_one_bit");
+
+        auto byteOffset = static_cast<size_t>(rbsp.rend() - last - 1);
+        return byteOffset * CHAR_BIT + CHAR_BIT - 1 - __builtin_ctz(static_cast<unsigned char>(*last));
+    }
+
+    /**
+     * Maps the code number of a signed exponential golomb (se(v)) to its value, as in 9.2.2
+     */
+    static inline int SignedValue(uint64_t codeNumber) {
+        auto magnitude = static_cast<int>((codeNumber + 1) / 2);
+        return codeNumber % 2 ? magnitude : -magnitude;
+    }
+
+    static void CopyBits(BitReader &reader, BitWriter &writer, size_t count) {
+        while (count) {
+            auto size = std::min(count, size_t{32});
+            writer.WriteBits(reader.ReadBits(size), size);
+            count -= size;
+        }
+    }
+
+    static bytestring Finish(BitWriter &writer) {
+        // rbsp_trailing_bits() or byte_alignment().
+        writer.WriteBit(true);
+        writer.ByteAlign();
+        auto bytes = writer.GetBytes();
+        return AddEmulationPreventionAndMarker(bytes, GetHeaderSize(), bytes.size());
+    }
+
+    static void SkipProfileTierLevel(BitReader &reader, unsigned int maxSubLayersMinus1) {
+        // general_profile_space through general_level_idc.
+        reader.SkipBits(96);
+
+        std::vector<bool> subLayerProfilePresent(maxSubLayersMinus1);
+        std::vector<bool> subLayerLevelPresent(maxSubLayersMinus1);
+        for (auto i = 0u; i < maxSubLayersMinus1; i++) {
+            subLayerProfilePresent[i] = reader.ReadBit();
+            subLayerLevelPresent[i] = reader.ReadBit();
+        }
+        if (maxSubLayersMinus1)
+            reader.SkipBits(2 * (8 - maxSubLayersMinus1));
+
+        for (auto i = 0u; i < maxSubLayersMinus1; i++) {
+            if (subLayerProfilePresent[i])
+                reader.SkipBits(88);
+            if (subLayerLevelPresent[i])
+                reader.SkipBits(8);
+        }
+    }
+
+    static void SkipScalingListData(BitReader &reader) {
+        for (auto sizeId = 0u; sizeId < 4; sizeId++) {
+            for (auto matrixId = 0u; matrixId < 6; matrixId += sizeId == 3 ? 3 : 1) {
+                if (!reader.ReadBit()) {
+                    reader.ReadExponentialGolomb(); // scaling_list_pred_matrix_id_delta
+                    continue;
+                }
+
+                auto coefficients = std::min(64u, 1u << (4 + (sizeId << 1)));
+                if (sizeId > 1)
+                    reader.ReadExponentialGolomb(); // scaling_list_dc_coef_minus8
+                for (auto i = 0u; i < coefficients; i++)
+                    reader.ReadExponentialGolomb(); // scaling_list_delta_coef
+            }
+        }
+    }
+
+    static void SkipPredWeightTable(BitReader &reader, unsigned int chromaArrayType, bool isB,
+                                    unsigned int numRefIdxL0Active, unsigned int numRefIdxL1Active) {
+        reader.ReadExponentialGolomb(); // luma_log2_weight_denom
+        if (chromaArrayType)
+            reader.ReadExponentialGolomb(); // delta_chroma_log2_weight_denom
+
+        for (auto numRefIdxActive : {numRefIdxL0Active, isB ? numRefIdxL1Active : 0u}) {
+            std::vector<bool> lumaWeight(numRefIdxActive);
+            std::vector<bool> chromaWeight(numRefIdxActive, false);
+            for (auto i = 0u; i < numRefIdxActive; i++)
+                lumaWeight[i] = reader.ReadBit();
+            if (chromaArrayType) {
+                for (auto i = 0u; i < numRefIdxActive; i++)
+                    chromaWeight[i] = reader.ReadBit();
+            }
+
+            for (auto i = 0u; i < numRefIdxActive; i++) {
+                auto numberOfGolombs = (lumaWeight[i] ? 2u : 0u) + (chromaWeight[i] ? 4u : 0u);
+                for (auto j = 0u; j < numberOfGolombs; j++)
+                    reader.ReadExponentialGolomb();
+            }
+        }
+    }
+
+    TileExtractor::ShortTermRefPicSet TileExtractor::ParseShortTermRefPicSet(BitReader &reader, const unsigned int index,
+                                                                             const unsigned int numberOfSetsInSps,
+                                                                             const std::vector<ShortTermRefPicSet> &sets) {
+        ShortTermRefPicSet rps;
+        if (index && reader.ReadBit()) {
+            // inter_ref_pic_set_prediction_flag
+            auto deltaIndex = index == numberOfSetsInSps ? reader.ReadExponentialGolomb() + 1 : 1;
+            if (deltaIndex > index)
+                throw std::runtime_error("Short-term reference picture set refers to a set that does not exist");
+            auto sign = reader.ReadBit();
+            auto deltaRps = (sign ? -1 : 1) * static_cast<int>(reader.ReadExponentialGolomb() + 1);
+
+            auto &reference = sets[index - deltaIndex];
+            auto numberOfNegative = reference.deltaPocS0.size();
+            auto numberOfDeltaPocs = reference.NumDeltaPocs();
+            std::vector<bool> usedByCurrPic(numberOfDeltaPocs + 1);
+            std::vector<bool> useDelta(numberOfDeltaPocs + 1, true);
+            for (auto j = 0u; j <= numberOfDeltaPocs; j++) {
+                usedByCurrPic[j] = reader.ReadBit();
+                if (!usedByCurrPic[j])
+                    useDelta[j] = reader.ReadBit();
+            }
+
+            // Derived as in (7-61) and (7-62).
+            for (auto j = static_cast<int>(reference.deltaPocS1.size()) - 1; j >= 0; j--) {
+                auto deltaPoc = reference.deltaPocS1[j] + deltaRps;
+                if (deltaPoc < 0 && useDelta[numberOfNegative + j]) {
+                    rps.deltaPocS0.push_back(deltaPoc);
+                    rps.usedByCurrPicS0.push_back(usedByCurrPic[numberOfNegative + j]);
+                }
+            }
+            if (deltaRps < 0 && useDelta[numberOfDeltaPocs]) {
+                rps.deltaPocS0.push_back(deltaRps);
+                rps.usedByCurrPicS0.push_back(usedByCurrPic[numberOfDeltaPocs]);
+            }
+            for (auto j = 0u; j < numberOfNegative; j++) {
+                auto deltaPoc = reference.deltaPocS0[j] + deltaRps;
+                if (deltaPoc < 0 && useDelta[j]) {
+                    rps.deltaPocS0.push_back(deltaPoc);
+                    rps.usedByCurrPicS0.push_back(usedByCurrPic[j]);
+                }
+            }
+
+            for (auto j = static_cast<int>(numberOfNegative) - 1; j >= 0; j--) {
+                auto deltaPoc = reference.deltaPocS0[j] + deltaRps;
+                if (deltaPoc > 0 && useDelta[j]) {
+                    rps.deltaPocS1.push_back(deltaPoc);
+                    rps.usedByCurrPicS1.push_back(usedByCurrPic[j]);
+                }
+            }
+            if (deltaRps > 0 && useDelta[numberOfDeltaPocs]) {
+                rps.deltaPocS1.push_back(deltaRps);
+                rps.usedByCurrPicS1.push_back(usedByCurrPic[numberOfDeltaPocs]);
+            }
+            for (auto j = 0u; j < reference.deltaPocS1.size(); j++) {
+                auto deltaPoc = reference.deltaPocS1[j] + deltaRps;
+                if (deltaPoc > 0 && useDelta[numberOfNegative + j]) {
+                    rps.deltaPocS1.push_back(deltaPoc);
+                    rps.usedByCurrPicS1.push_back(usedByCurrPic[numberOfNegative + j]);
+                }
+            }
+            return rps;
+        }
+
+        auto numberOfNegative = reader.ReadExponentialGolomb();
+        auto numberOfPositive = reader.ReadExponentialGolomb();
+        auto poc = 0;
+        for (auto i = 0u; i < numberOfNegative; i++) {
+            poc -= reader.ReadExponentialGolomb() + 1;
+            rps.deltaPocS0.push_back(poc);
+            rps.usedByCurrPicS0.push_back(reader.ReadBit());
+        }
+        poc = 0;
+        for (auto i = 0u; i < numberOfPositive; i++) {
+            poc += reader.ReadExponentialGolomb() + 1;
+            rps.deltaPocS1.push_back(poc);
+            rps.usedByCurrPicS1.push_back(reader.ReadBit());
+        }
+        return rps;
+    }
+
+    void TileExtractor::ParseVideoParameterSet(bytestring_view nal) {
+        if (nal.size() <= GetHeaderSize())
+            throw std::runtime_error("VPS is too short");
+        auto id = static_cast<unsigned char>(nal[GetHeaderSize()]) >> 4;
+        videoParameterSets_[id] = AddEmulationPreventionAndMarker(bytestring(nal.begin(), nal.end()), 0, 0);
+    }
+
+    void TileExtractor::ParseSequenceParameterSet(bytestring_view nal) {
+        SequenceParameters sps;
+        sps.rbsp = RawByteSequencePayload(nal, nal.size());
+        BitReader reader(reinterpret_cast<const unsigned char*>(sps.rbsp.data()), sps.rbsp.size(), GetHeaderSizeInBits());
+
+        sps.vpsId = reader.ReadBits(4);
+        auto maxSubLayersMinus1 = reader.ReadBits(3);
+        reader.SkipBits(1); // sps_temporal_id_nesting_flag
+        SkipProfileTierLevel(reader, maxSubLayersMinus1);
+        auto id = reader.ReadExponentialGolomb();
+
+        auto chromaFormatIdc = reader.ReadExponentialGolomb();
+        sps.separateColourPlane = chromaFormatIdc == 3 && reader.ReadBit();
+        sps.chromaArrayType = sps.separateColourPlane ? 0 : chromaFormatIdc;
+        sps.subWidthC = chromaFormatIdc == 1 || chromaFormatIdc == 2 ? 2 : 1;
+        sps.subHeightC = chromaFormatIdc == 1 ? 2 : 1;
+
+        sps.dimensionsOffset = reader.Position();
+        sps.width = reader.ReadExponentialGolomb();
+        sps.height = reader.ReadExponentialGolomb();
+        auto hasConformanceWindow = reader.ReadBit();
+        for (auto &offset : sps.conformanceWindow)
+            offset = hasConformanceWindow ? reader.ReadExponentialGolomb() : 0;
+        sps.afterConformanceWindowOffset = reader.Position();
+
+        reader.ReadExponentialGolomb(); // bit_depth_luma_minus8
+        reader.ReadExponentialGolomb(); // bit_depth_chroma_minus8
+        sps.log2MaxPicOrderCntLsb = reader.ReadExponentialGolomb() + 4;
+        auto subLayerOrderingInfoPresent = reader.ReadBit();
+        for (auto i = subLayerOrderingInfoPresent ? 0 : maxSubLayersMinus1; i <= maxSubLayersMinus1; i++) {
+            reader.ReadExponentialGolomb(); // sps_max_dec_pic_buffering_minus1
+            sps.maxNumReorderPics = reader.ReadExponentialGolomb();
+            reader.ReadExponentialGolomb(); // sps_max_latency_increase_plus1
+        }
+
+        sps.log2MinCbSize = reader.ReadExponentialGolomb() + 3;
+        sps.log2CtbSize = sps.log2MinCbSize + reader.ReadExponentialGolomb();
+        sps.log2MinTbSize = reader.ReadExponentialGolomb() + 2;
+        sps.log2MaxTbSize = sps.log2MinTbSize + reader.ReadExponentialGolomb();
+        reader.ReadExponentialGolomb(); // max_transform_hierarchy_depth_inter
+        sps.maxTransformHierarchyDepthIntra = reader.ReadExponentialGolomb();
+        if (reader.ReadBit() && reader.ReadBit())
+            SkipScalingListData(reader);
+        reader.SkipBits(1); // amp_enabled_flag
+        sps.sampleAdaptiveOffsetEnabled = reader.ReadBit();
+        sps.pcmEnabled = reader.ReadBit();
+        sps.log2MinPcmCbSize = 0;
+        sps.log2MaxPcmCbSize = 0;
+        if (sps.pcmEnabled) {
+            reader.SkipBits(8); // pcm_sample_bit_depth_luma_minus1, pcm_sample_bit_depth_chroma_minus1
+            sps.log2MinPcmCbSize = reader.ReadExponentialGolomb() + 3;
+            sps.log2MaxPcmCbSize = sps.log2MinPcmCbSize + reader.ReadExponentialGolomb();
+            reader.SkipBits(1); // pcm_loop_filter_disabled_flag
+        }
+
+        auto numberOfShortTermRefPicSets = reader.ReadExponentialGolomb();
+        for (auto i = 0u; i < numberOfShortTermRefPicSets; i++)
+            sps.shortTermRefPicSets.push_back(ParseShortTermRefPicSet(reader, i, numberOfShortTermRefPicSets, sps.shortTermRefPicSets));
+        sps.longTermRefPicsPresent = reader.ReadBit();
+        if (sps.longTermRefPicsPresent) {
+            auto numberOfLongTermRefPics = reader.ReadExponentialGolomb();
+            for (auto i = 0u; i < numberOfLongTermRefPics; i++) {
+                reader.SkipBits(sps.log2MaxPicOrderCntLsb);
+                sps.usedByCurrPicLongTermSps.push_back(reader.ReadBit());
+            }
+        }
+        sps.temporalMvpEnabled = reader.ReadBit();
+
+        sps.stopBitOffset = StopBitOffset(sps.rbsp);
+        sequenceParameterSets_[id] = std::move(sps);
+    }
+
+    unsigned int TileExtractor::ParsePictureParameterSet(bytestring_view nal) {
+        PictureParameters pps;
+        pps.rbsp = RawByteSequencePayload(nal, nal.size());
+        BitReader reader(reinterpret_cast<const unsigned char*>(pps.rbsp.data()), pps.rbsp.size(), GetHeaderSizeInBits());
+
+        auto id = reader.ReadExponentialGolomb();
+        pps.spsId = reader.ReadExponentialGolomb();
+        pps.dependentSliceSegmentsEnabled = reader.ReadBit();
+        pps.outputFlagPresentOffset = reader.Position();
+        pps.outputFlagPresent = reader.ReadBit();
+        pps.numExtraSliceHeaderBits = reader.ReadBits(3);
+        reader.SkipBits(1); // sign_data_hiding_enabled_flag
+        pps.cabacInitPresent = reader.ReadBit();
+        pps.numRefIdxL0DefaultActive = reader.ReadExponentialGolomb() + 1;
+        pps.numRefIdxL1DefaultActive = reader.ReadExponentialGolomb() + 1;
+        pps.initQp = 26 + SignedValue(reader.ReadExponentialGolomb());
+        reader.SkipBits(2); // constrained_intra_pred_flag, transform_skip_enabled_flag
+        if (reader.ReadBit())
+            reader.ReadExponentialGolomb(); // diff_cu_qp_delta_depth
+        reader.ReadExponentialGolomb(); // pps_cb_qp_offset
+        reader.ReadExponentialGolomb(); // pps_cr_qp_offset
+        pps.sliceChromaQpOffsetsPresent = reader.ReadBit();
+        pps.weightedPred = reader.ReadBit();
+        pps.weightedBipred = reader.ReadBit();
+        pps.transquantBypassEnabled = reader.ReadBit();
+
+        pps.tilesEnabledOffset = reader.Position();
+        pps.tilesEnabled = reader.ReadBit();
+        pps.entropyCodingSyncEnabled = reader.ReadBit();
+        pps.numberOfColumns = 1;
+        pps.numberOfRows = 1;
+        pps.uniformSpacing = true;
+        pps.loopFilterAcrossTilesEnabled = false;
+        if (pps.tilesEnabled) {
+            pps.numberOfColumns = reader.ReadExponentialGolomb() + 1;
+            pps.numberOfRows = reader.ReadExponentialGolomb() + 1;
+            pps.uniformSpacing = reader.ReadBit();
+            if (!pps.uniformSpacing) {
+                for (auto i = 0u; i + 1 < pps.numberOfColumns; i++)
+                    pps.columnWidthsInCtbs.push_back(reader.ReadExponentialGolomb() + 1);
+                for (auto i = 0u; i + 1 < pps.numberOfRows; i++)
+                    pps.rowHeightsInCtbs.push_back(reader.ReadExponentialGolomb() + 1);
+            }
+            pps.loopFilterAcrossTilesEnabled = reader.ReadBit();
+        }
+        pps.afterTilesOffset = reader.Position();
+
+        pps.loopFilterAcrossSlicesEnabled = reader.ReadBit();
+        pps.deblockingFilterOverrideEnabled = false;
+        pps.deblockingFilterDisabled = false;
+        if (reader.ReadBit()) {
+            // deblocking_filter_control_present_flag
+            pps.deblockingFilterOverrideEnabled = reader.ReadBit();
+            pps.deblockingFilterDisabled = reader.ReadBit();
+            if (!pps.deblockingFilterDisabled) {
+                reader.ReadExponentialGolomb(); // pps_beta_offset_div2
+                reader.ReadExponentialGolomb(); // pps_tc_offset_div2
+            }
+        }
+        if (reader.ReadBit())
+            SkipScalingListData(reader);
+        pps.listsModificationPresent = reader.ReadBit();
+        reader.ReadExponentialGolomb(); // log2_parallel_merge_level_minus2
+        pps.sliceSegmentHeaderExtensionPresent = reader.ReadBit();
+
+        // The range and screen content coding extensions add syntax elements to slice segment headers.
+        pps.hasUnsupportedExtension = false;
+        if (reader.ReadBit()) {
+            auto rangeExtension = reader.ReadBit();
+            reader.SkipBits(2); // pps_multilayer_extension_flag, pps_3d_extension_flag
+            auto screenContentCodingExtension = reader.ReadBit();
+            pps.hasUnsupportedExtension = rangeExtension || screenContentCodingExtension;
+        }
+
+        pps.stopBitOffset = StopBitOffset(pps.rbsp);
+        pictureParameterSets_[id] = std::move(pps);
+        return id;
+    }
+
+    std::vector<unsigned int> TileExtractor::TileBoundaries(const unsigned int numberOfTiles, const unsigned int sizeInCtbs, const bool uniform,
+                                                            const std::vector<unsigned int> &explicitSizes) {
+        std::vector<unsigned int> boundaries{0};
+        for (auto i = 0u; i < numberOfTiles; i++) {
+            unsigned int size;
+            if (uniform)
+                size = ((i + 1) * sizeInCtbs) / numberOfTiles - (i * sizeInCtbs) / numberOfTiles;
+            else
+                size = i + 1 < numberOfTiles ? explicitSizes[i] : sizeInCtbs - boundaries.back();
+            if (!size || boundaries.back() + size > sizeInCtbs)
+                throw std::runtime_error("Tile sizes do not fit in the picture");
+            boundaries.push_back(boundaries.back() + size);
+        }
+        return boundaries;
+    }
+
+    unsigned int TileExtractor::PeekPictureParameterSetId(bytestring_view nal) {
+        auto prefix = RawByteSequencePayload(nal, GetHeaderSize() + 8);
+        BitReader reader(reinterpret_cast<const unsigned char*>(prefix.data()), prefix.size(), GetHeaderSizeInBits() + 1);
+        if (IsIRAP(PeekType(nal)))
+            reader.SkipBits(1); // no_output_of_prior_pics_flag
+        return reader.ReadExponentialGolomb();
+    }
+
+    void TileExtractor::Activate(const unsigned int ppsId) {
+        auto pps = pictureParameterSets_.find(ppsId);
+        if (pps == pictureParameterSets_.end())
+            throw std::runtime_error("Slice segment refers to a PPS that has not been seen");
+        auto sps = sequenceParameterSets_.find(pps->second.spsId);
+        if (sps == sequenceParameterSets_.end())
+            throw std::runtime_error("PPS refers to an SPS that has not been seen");
+        auto vps = videoParameterSets_.find(sps->second.vpsId);
+        if (vps == videoParameterSets_.end())
+            throw std::runtime_error("SPS refers to a VPS that has not been seen");
+
+        if (pps->second.entropyCodingSyncEnabled)
+            throw std::runtime_error("Tiles cannot be extracted from streams that use wavefront parallel processing");
+        if (pps->second.loopFilterAcrossTilesEnabled)
+            throw std::runtime_error("Tiles cannot be extracted from streams that filter across tile boundaries");
+        if (pps->second.hasUnsupportedExtension)
+            throw std::runtime_error("Tiles cannot be extracted from streams that use PPS range or screen content extensions");
+        if (sps->second.conformanceWindow[0] || sps->second.conformanceWindow[2])
+            throw std::runtime_error("Tiles cannot be extracted from streams that crop the top or left of the picture");
+
+        auto active = std::make_unique<ActiveParameters>();
+        active->spsId = pps->second.spsId;
+        active->ppsId = ppsId;
+
+        auto &sequence = sps->second;
+        auto &picture = pps->second;
+        active->columnBoundaries = TileBoundaries(picture.numberOfColumns, sequence.WidthInCtbs(), picture.uniformSpacing, picture.columnWidthsInCtbs);
+        active->rowBoundaries = TileBoundaries(picture.numberOfRows, sequence.HeightInCtbs(), picture.uniformSpacing, picture.rowHeightsInCtbs);
+
+        // The last column and row extend to the edge of the picture, which is cropped by the conformance window.
+        auto tilePictureParameterSet = TilePictureParameterSet(picture);
+        std::vector<unsigned int> codedWidths;
+        std::vector<unsigned int> codedHeights;
+        for (auto column = 0u; column < picture.numberOfColumns; column++) {
+            auto isLast = column + 1 == picture.numberOfColumns;
+            auto start = active->columnBoundaries[column] * sequence.CtbSize();
+            codedWidths.push_back(isLast ? sequence.width - start : active->columnBoundaries[column + 1] * sequence.CtbSize() - start);
+            active->grid.widthsOfColumns.push_back(codedWidths.back() - (isLast ? sequence.conformanceWindow[1] * sequence.subWidthC : 0));
+        }
+        for (auto row = 0u; row < picture.numberOfRows; row++) {
+            auto isLast = row + 1 == picture.numberOfRows;
+            auto start = active->rowBoundaries[row] * sequence.CtbSize();
+            codedHeights.push_back(isLast ? sequence.height - start : active->rowBoundaries[row + 1] * sequence.CtbSize() - start);
+            active->grid.heightsOfRows.push_back(codedHeights.back() - (isLast ? sequence.conformanceWindow[3] * sequence.subHeightC : 0));
+        }
+
+        for (auto row = 0u; row < picture.numberOfRows; row++) {
+            for (auto column = 0u; column < picture.numberOfColumns; column++) {
+                auto parameterSets = vps->second;
+                auto tileSequenceParameterSet = TileSequenceParameterSet(sequence, codedWidths[column], codedHeights[row],
+                        column + 1 == picture.numberOfColumns ? sequence.conformanceWindow[1] : 0,
+                        row + 1 == picture.numberOfRows ? sequence.conformanceWindow[3] : 0);
+                parameterSets.insert(parameterSets.end(), tileSequenceParameterSet.begin(), tileSequenceParameterSet.end());
+                parameterSets.insert(parameterSets.end(), tilePictureParameterSet.begin(), tilePictureParameterSet.end());
+                active->tileParameterSets.push_back(std::move(parameterSets));
+            }
+        }
+
+        active_ = std::move(active);
+    }
+
+    bytestring TileExtractor::TileSequenceParameterSet(const SequenceParameters &sps, const unsigned int width, const unsigned int height,
+                                                       const unsigned int conformanceWindowRight, const unsigned int conformanceWindowBottom) {
+        auto data = reinterpret_cast<const unsigned char*>(sps.rbsp.data());
+        BitReader reader(data, sps.rbsp.size());
+        BitWriter writer;
+        CopyBits(reader, writer, sps.dimensionsOffset);
+
+        writer.WriteExponentialGolomb(width);
+        writer.WriteExponentialGolomb(height);
+        auto hasConformanceWindow = conformanceWindowRight || conformanceWindowBottom;
+        writer.WriteBit(hasConformanceWindow);
+        if (hasConformanceWindow) {
+            writer.WriteExponentialGolomb(0);
+            writer.WriteExponentialGolomb(conformanceWindowRight);
+            writer.WriteExponentialGolomb(0);
+            writer.WriteExponentialGolomb(conformanceWindowBottom);
+        }
+
+        BitReader rest(data, sps.rbsp.size(), sps.afterConformanceWindowOffset);
+        CopyBits(rest, writer, sps.stopBitOffset - sps.afterConformanceWindowOffset);
+        return Finish(writer);
+    }
+
+    bytestring TileExtractor::TilePictureParameterSet(const PictureParameters &pps) {
+        auto data = reinterpret_cast<const unsigned char*>(pps.rbsp.data());
+        BitReader reader(data, pps.rbsp.size());
+        BitWriter writer;
+        CopyBits(reader, writer, pps.tilesEnabledOffset);
+
+        // Each tile becomes a picture with a single tile, which drops the tile information.
+        writer.WriteBit(false);
+        writer.WriteBit(pps.entropyCodingSyncEnabled);
+
+        BitReader rest(data, pps.rbsp.size(), pps.afterTilesOffset);
+        CopyBits(rest, writer, pps.stopBitOffset - pps.afterTilesOffset);
+        return Finish(writer);
+    }
+
+    bytestring TileExtractor::OutputFlagPictureParameterSet(const PictureParameters &pps) {
+        auto data = reinterpret_cast<const unsigned char*>(pps.rbsp.data());
+        BitReader reader(data, pps.rbsp.size());
+        BitWriter writer;
+        CopyBits(reader, writer, pps.outputFlagPresentOffset);
+        writer.WriteBit(true);
+
+        BitReader rest(data, pps.rbsp.size(), pps.outputFlagPresentOffset + 1);
+        CopyBits(rest, writer, pps.stopBitOffset - pps.outputFlagPresentOffset - 1);
+        return Finish(writer);
+    }
+
+    TileExtractor::SliceSegmentHeader TileExtractor::ParseSliceSegmentHeader(bytestring_view nal) const {
+        auto type = PeekType(nal);
+        auto &sps = sequenceParameterSets_.at(active_->spsId);
+        auto &pps = pictureParameterSets_.at(active_->ppsId);
+
+        // Parse the slice segment header (7.3.6.1), recording where the syntax elements that change are.
+        SliceSegmentHeader header;
+        auto parse = [&](const bytestring &rbsp) {
+            header.isDependent = false;
+            header.address = 0;
+            header.sliceType = kSliceTypeI;
+            header.saoLuma = false;
+            header.saoChroma = false;
+            header.cabacInit = false;
+            header.maxNumMergeCand = 0;
+            header.sliceQpDelta = 0;
+            header.numberOfEntryPoints = 0;
+
+            BitReader reader(reinterpret_cast<const unsigned char*>(rbsp.data()), rbsp.size(), GetHeaderSizeInBits());
+            header.isFirst = reader.ReadBit();
+            if (IsIRAP(type))
+                reader.SkipBits(1); // no_output_of_prior_pics_flag
+            if (reader.ReadExponentialGolomb() != active_->ppsId)
+                throw std::runtime_error("Slice segments of a picture refer to different PPSs");
+
+            header.addressOffset = reader.Position();
+            if (!header.isFirst) {
+                if (pps.dependentSliceSegmentsEnabled)
+                    header.isDependent = reader.ReadBit();
+                header.address = reader.ReadBits(CeilLog2(sps.WidthInCtbs() * sps.HeightInCtbs()));
+            }
+            header.afterAddressOffset = reader.Position();
+            header.picOutputFlagOffset = header.afterAddressOffset;
+
+            if (!header.isDependent) {
+                reader.SkipBits(pps.numExtraSliceHeaderBits);
+                auto sliceType = reader.ReadExponentialGolomb();
+                header.sliceType = sliceType;
+                auto isB = sliceType == kSliceTypeB;
+                header.picOutputFlagOffset = reader.Position();
+                if (pps.outputFlagPresent)
+                    reader.SkipBits(1);
+                if (sps.separateColourPlane)
+                    reader.SkipBits(2);
+
+                auto sliceTemporalMvpEnabled = false;
+                auto numPicTotalCurr = 0u;
+                if (type != NalUnitCodedSliceIDRWRADL && type != NalUnitCodedSliceIDRNLP) {
+                    reader.SkipBits(sps.log2MaxPicOrderCntLsb);
+
+                    auto numberOfSets = static_cast<unsigned int>(sps.shortTermRefPicSets.size());
+                    ShortTermRefPicSet sliceSet;
+                    const ShortTermRefPicSet *set;
+                    if (!reader.ReadBit()) {
+                        sliceSet = ParseShortTermRefPicSet(reader, numberOfSets, numberOfSets, sps.shortTermRefPicSets);
+                        set = &sliceSet;
+                    } else {
+                        auto index = numberOfSets > 1 ? reader.ReadBits(CeilLog2(numberOfSets)) : 0;
+                        if (index >= numberOfSets)
+                            throw std::runtime_error("Slice segment refers to a short-term reference picture set that does not exist");
+                        set = &sps.shortTermRefPicSets[index];
+                    }
+                    numPicTotalCurr += std::count(set->usedByCurrPicS0.begin(), set->usedByCurrPicS0.end(), true);
+                    numPicTotalCurr += std::count(set->usedByCurrPicS1.begin(), set->usedByCurrPicS1.end(), true);
+
+                    if (sps.longTermRefPicsPresent) {
+                        auto &usedInSps = sps.usedByCurrPicLongTermSps;
+                        auto numberOfLongTermSps = usedInSps.empty() ? 0 : reader.ReadExponentialGolomb();
+                        auto numberOfLongTermPics = reader.ReadExponentialGolomb();
+                        for (auto i = 0u; i < numberOfLongTermSps + numberOfLongTermPics; i++) {
+                            bool used;
+                            if (i < numberOfLongTermSps) {
+                                auto index = usedInSps.size() > 1 ? reader.ReadBits(CeilLog2(usedInSps.size())) : 0;
+                                if (index >= usedInSps.size())
+                                    throw std::runtime_error("Slice segment refers to a long-term reference picture that does not exist");
+                                used = usedInSps[index];
+                            } else {
+                                reader.SkipBits(sps.log2MaxPicOrderCntLsb);
+                                used = reader.ReadBit();
+                            }
+                            numPicTotalCurr += used;
+                            if (reader.ReadBit())
+                                reader.ReadExponentialGolomb(); // delta_poc_msb_cycle_lt
+                        }
+                    }
+                    if (sps.temporalMvpEnabled)
+                        sliceTemporalMvpEnabled = reader.ReadBit();
+                }
+
+                if (sps.sampleAdaptiveOffsetEnabled) {
+                    header.saoLuma = reader.ReadBit();
+                    if (sps.chromaArrayType)
+                        header.saoChroma = reader.ReadBit();
+                }
+
+                if (sliceType == kSliceTypeP || isB) {
+                    auto numRefIdxL0Active = pps.numRefIdxL0DefaultActive;
+                    auto numRefIdxL1Active = pps.numRefIdxL1DefaultActive;
+                    if (reader.ReadBit()) {
+                        numRefIdxL0Active = reader.ReadExponentialGolomb() + 1;
+                        if (isB)
+                            numRefIdxL1Active = reader.ReadExponentialGolomb() + 1;
+                    }
+                    if (pps.listsModificationPresent && numPicTotalCurr > 1) {
+                        auto entrySize = CeilLog2(numPicTotalCurr);
+                        if (reader.ReadBit())
+                            reader.SkipBits(numRefIdxL0Active * entrySize);
+                        if (isB && reader.ReadBit())
+                            reader.SkipBits(numRefIdxL1Active * entrySize);
+                    }
+                    if (isB)
+                        reader.SkipBits(1); // mvd_l1_zero_flag
+                    if (pps.cabacInitPresent)
+                        header.cabacInit = reader.ReadBit();
+                    if (sliceTemporalMvpEnabled) {
+                        auto collocatedFromL0 = isB ? reader.ReadBit() : true;
+                        if ((collocatedFromL0 && numRefIdxL0Active > 1) || (!collocatedFromL0 && numRefIdxL1Active > 1))
+                            reader.ReadExponentialGolomb(); // collocated_ref_idx
+                    }
+                    if ((pps.weightedPred && sliceType == kSliceTypeP) || (pps.weightedBipred && isB))
+                        SkipPredWeightTable(reader, sps.chromaArrayType, isB, numRefIdxL0Active, numRefIdxL1Active);
+                    header.maxNumMergeCand = 5 - reader.ReadExponentialGolomb();
+                }
+
+                header.sliceQpDelta = SignedValue(reader.ReadExponentialGolomb());
+                if (pps.sliceChromaQpOffsetsPresent) {
+                    reader.ReadExponentialGolomb();
+                    reader.ReadExponentialGolomb();
+                }
+                auto deblockingFilterDisabled = pps.deblockingFilterDisabled;
+                if (pps.deblockingFilterOverrideEnabled && reader.ReadBit()) {
+                    deblockingFilterDisabled = reader.ReadBit();
+                    if (!deblockingFilterDisabled) {
+                        reader.ReadExponentialGolomb();
+                        reader.ReadExponentialGolomb();
+                    }
+                }
+                if (pps.loopFilterAcrossSlicesEnabled && (header.saoLuma || header.saoChroma || !deblockingFilterDisabled))
+                    reader.SkipBits(1);
+            }
+
+            // Entry points are present with tiles or with wavefront parallel processing.
+            header.entryPointOffset = reader.Position();
+            if (pps.tilesEnabled || pps.entropyCodingSyncEnabled) {
+                header.numberOfEntryPoints = reader.ReadExponentialGolomb();
+                if (header.numberOfEntryPoints) {
+                    auto offsetLength = reader.ReadExponentialGolomb() + 1;
+                    if (offsetLength > 32)
+                        throw std::runtime_error("Slice segment entry point offsets are longer than 32 bits");
+                    reader.SkipBits(static_cast<size_t>(header.numberOfEntryPoints) * offsetLength);
+                }
+            }
+            header.afterEntryPointOffset = reader.Position();
+
+            if (pps.sliceSegmentHeaderExtensionPresent)
+                reader.SkipBits(CHAR_BIT * reader.ReadExponentialGolomb());
+            header.endOfHeaderSyntax = reader.Position();
+            return header.endOfHeaderSyntax < rbsp.size() * CHAR_BIT;
+        };
+
+        header.rbsp = RawByteSequencePayload(nal, kSliceHeaderPrefixLength);
+        auto parsed = false;
+        try {
+            parsed = parse(header.rbsp);
+        } catch (const std::out_of_range&) {
+        }
+        if (!parsed && nal.size() > kSliceHeaderPrefixLength) {
+            header.rbsp = RawByteSequencePayload(nal, nal.size());
+            parsed = parse(header.rbsp);
+        }
+        if (!parsed)
+            throw std::runtime_error("Slice segment header extends past the end of the slice segment");
+        return header;
+    }
+
+    bytestring TileExtractor::RewriteSliceSegment(bytestring_view nal, unsigned int &tile) const {
+        auto &sps = sequenceParameterSets_.at(active_->spsId);
+        auto &pps = pictureParameterSets_.at(active_->ppsId);
+        auto pictureWidthInCtbs = sps.WidthInCtbs();
+        auto header = ParseSliceSegmentHeader(nal);
+        auto &rbsp = header.rbsp;
+        if (header.numberOfEntryPoints)
+            throw std::runtime_error("Tiles cannot be extracted from slice segments that span several tiles");
+
+        // Find the tile that contains the first CTB of the slice segment.
+        auto ctbX = header.address % pictureWidthInCtbs;
+        auto ctbY = header.address / pictureWidthInCtbs;
+        auto &columns = active_->columnBoundaries;
+        auto &rows = active_->rowBoundaries;
+        auto column = static_cast<unsigned int>(std::upper_bound(columns.begin(), columns.end(), ctbX) - columns.begin() - 1);
+        auto row = static_cast<unsigned int>(std::upper_bound(rows.begin(), rows.end(), ctbY) - rows.begin() - 1);
+        if (row + 1 >= rows.size())
+            throw std::runtime_error("Slice segment address is outside of the picture");
+        tile = row * (columns.size() - 1) + column;
+
+        auto tileWidthInCtbs = columns[column + 1] - columns[column];
+        auto tileHeightInCtbs = rows[row + 1] - rows[row];
+        auto tileAddress = (ctbY - rows[row]) * tileWidthInCtbs + ctbX - columns[column];
+        auto isFirstInTile = !tileAddress;
+        if (isFirstInTile && header.isDependent)
+            throw std::runtime_error("Tiles cannot be extracted when a tile starts with a dependent slice segment");
+
+        // Write the header with the address relative to the tile, and without entry points.
+        auto data = reinterpret_cast<const unsigned char*>(rbsp.data());
+        BitReader reader(data, rbsp.size());
+        BitWriter writer;
+        CopyBits(reader, writer, GetHeaderSizeInBits());
+        writer.WriteBit(isFirstInTile);
+        reader.SkipBits(1);
+        CopyBits(reader, writer, header.addressOffset - reader.Position());
+        if (!isFirstInTile) {
+            if (pps.dependentSliceSegmentsEnabled)
+                writer.WriteBit(header.isDependent);
+            writer.WriteBits(tileAddress, CeilLog2(tileWidthInCtbs * tileHeightInCtbs));
+        }
+
+        BitReader afterAddress(data, rbsp.size(), header.afterAddressOffset);
+        CopyBits(afterAddress, writer, header.entryPointOffset - header.afterAddressOffset);
+        BitReader afterEntryPoints(data, rbsp.size(), header.afterEntryPointOffset);
+        CopyBits(afterEntryPoints, writer, header.endOfHeaderSyntax - header.afterEntryPointOffset);
+        writer.WriteBit(true);
+        writer.ByteAlign();
+
+        // The header ends with byte_alignment(), so the slice data starts at the next byte.
+        return ReplaceSliceSegmentHeader(writer.GetBytes(), nal, (header.endOfHeaderSyntax + CHAR_BIT) / CHAR_BIT);
+    }
+
+    bytestring TileExtractor::OutputFlagSliceSegment(const SliceSegmentHeader &header, const PictureParameters &pps,
+                                                     bytestring_view nal, const bool output) {
+        assert(!header.isDependent);
+        auto data = reinterpret_cast<const unsigned char*>(header.rbsp.data());
+        BitReader reader(data, header.rbsp.size());
+        BitWriter writer;
+        CopyBits(reader, writer, header.picOutputFlagOffset);
+        writer.WriteBit(output);
+
+        auto afterFlagOffset = header.picOutputFlagOffset + (pps.outputFlagPresent ? 1 : 0);
+        BitReader rest(data, header.rbsp.size(), afterFlagOffset);
+        CopyBits(rest, writer, header.endOfHeaderSyntax - afterFlagOffset);
+        writer.WriteBit(true);
+        writer.ByteAlign();
+
+        return ReplaceSliceSegmentHeader(writer.GetBytes(), nal, (header.endOfHeaderSyntax + CHAR_BIT) / CHAR_BIT);
+    }
+
+    bytestring TileExtractor::ReplaceSliceSegmentHeader(bytestring header, bytestring_view nal, const size_t endOfHeader) {
+        // The slice data is copied without removing its emulation prevention, starting after a byte that leaves no
+        // zeros pending, so that the copied bytes need the same emulation prevention after the new header as they did
+        // after the old one.
+        auto &segment = header;
+        auto startOfRawData = OffsetBeforeEmulationPreventionRemoval(nal, GetHeaderSize(), endOfHeader);
+        auto isSplitPoint = [&](size_t offset) {
+            auto previous = static_cast<unsigned char>(nal[offset - 1]);
+            return previous && !(previous == 3 && !nal[offset - 2] && !nal[offset - 3]);
+        };
+        while (startOfRawData < nal.size() && !isSplitPoint(startOfRawData))
+            ++startOfRawData;
+
+        auto payload = RemoveEmulationPreventionBytes(bytestring(nal.begin(), nal.begin() + startOfRawData), GetHeaderSize(), startOfRawData);
+        segment.insert(segment.end(), payload.begin() + endOfHeader, payload.end());
+        segment = AddEmulationPreventionAndMarker(segment, GetHeaderSize(), segment.size());
+        segment.insert(segment.end(), nal.begin() + startOfRawData, nal.end());
+        return segment;
+    }
+
+    std::vector<ExtractedTiles> TileExtractor::Extract(bytestring_view data) {
+        std::vector<ExtractedTiles> extracted;
+        auto needsParameterSets = false;
+
+        for (auto nal : SplitAnnexB(data)) {
+            if (nal.size() <= GetHeaderSize())
+                continue;
+
+            auto type = PeekType(nal);
+            if (type == NalUnitVPS || type == NalUnitSPS || type == NalUnitPPS) {
+                if (type == NalUnitVPS)
+                    ParseVideoParameterSet(nal);
+                else if (type == NalUnitSPS)
+                    ParseSequenceParameterSet(nal);
+                else
+                    ParsePictureParameterSet(nal);
+                parameterSetsChanged_ = true;
+                continue;
+            } else if (type > NalUnitReservedIRAPVCL23) {
+                // SEI messages describe the whole picture, and the other non-VCL nals are not needed to decode a tile.
+                continue;
+            } else if (!IsSupportedSliceType(type)) {
+                throw std::runtime_error("Unsupported slice segment type " + std::to_string(type));
+            }
+
+            auto isFirstInPicture = static_cast<unsigned char>(nal[GetHeaderSize()]) & 0x80u;
+            if (isFirstInPicture) {
+                auto ppsId = PeekPictureParameterSetId(nal);
+
+                std::optional<TileGrid> previousGrid;
+                if (active_)
+                    previousGrid = active_->grid;
+                if (!active_ || parameterSetsChanged_ || active_->ppsId != ppsId) {
+                    Activate(ppsId);
+                    parameterSetsChanged_ = false;
+                    needsParameterSets = true;
+                }
+
+                auto &grid = active_->grid;
+                if (previousGrid && *previousGrid != grid && !IsIRAP(type))
+                    throw std::runtime_error("The tile grid can only change at an IRAP picture");
+                if (extracted.empty() || extracted.back().grid != grid) {
+                    extracted.push_back({grid, sequenceParameterSets_.at(active_->spsId).CtbSize(), 0, true, std::vector<bytestring>(active_->tileParameterSets.size())});
+                    needsParameterSets = true;
+                }
+
+                auto &group = extracted.back();
+                if (sequenceParameterSets_.at(active_->spsId).maxNumReorderPics || IsLeadingPicture(type))
+                    group.outputsInDecodingOrder = false;
+                if (needsParameterSets || IsIRAP(type)) {
+                    for (auto i = 0u; i < group.tiles.size(); i++)
+                        group.tiles[i].insert(group.tiles[i].end(), active_->tileParameterSets[i].begin(), active_->tileParameterSets[i].end());
+                    needsParameterSets = false;
+                }
+                ++group.numberOfPictures;
+            } else if (extracted.empty()) {
+                throw std::runtime_error("Data must start with the first slice segment of a picture");
+            }
+
+            unsigned int tile;
+            auto segment = RewriteSliceSegment(nal, tile);
+            auto &tileData = extracted.back().tiles[tile];
+            tileData.insert(tileData.end(), segment.begin(), segment.end());
+        }
+
+        return extracted;
+    }
+
+    unsigned int TileExtractor::MaxNumReorderPics(bytestring_view nal) {
+        TileExtractor extractor;
+        extractor.ParseSequenceParameterSet(nal);
+        return extractor.sequenceParameterSets_.begin()->second.maxNumReorderPics;
+    }
+
+    unsigned int TileExtractor::CtbSize(bytestring_view data) {
+        auto position = data.data();
+        while (auto nal = NextNal(position, data.data() + data.size())) {
+            if (nal->size() <= GetHeaderSize())
+                continue;
+
+            auto type = PeekType(*nal);
+            if (type == NalUnitSPS) {
+                TileExtractor extractor;
+                extractor.ParseSequenceParameterSet(*nal);
+                return extractor.sequenceParameterSets_.begin()->second.CtbSize();
+            } else if (type <= NalUnitReservedVCL31) {
+                break;
+            }
+        }
+        throw std::runtime_error("Data does not start with an SPS");
+    }
+
+    bool TileExtractor::HasTiles(bytestring_view data) {
+        auto position = data.data();
+        while (auto nal = NextNal(position, data.data() + data.size())) {
+            if (nal->size() <= GetHeaderSize())
+                continue;
+
+            auto type = PeekType(*nal);
+            if (type == NalUnitPPS) {
+                TileExtractor extractor;
+                extractor.ParsePictureParameterSet(*nal);
+                return extractor.pictureParameterSets_.begin()->second.tilesEnabled;
+            } else if (type <= NalUnitReservedVCL31) {
+                // Slice segments follow their PPS, so there is none.
+                return false;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Splits the sizes in CTBs of the tiles of a column or row of the coarse grid into the sizes of the tiles inside them
+     * @param coarseSizes The sizes of every coarse tile but the last
+     * @param innerSizes For each coarse tile, the sizes in samples of the tiles inside it, or nothing if no tile in the
+     * column or row has tiles of its own
+     * @return The sizes of every fine tile but the last
+     */
+    static std::vector<unsigned int> SplitSizes(const std::vector<unsigned int> &coarseSizes,
+                                                const std::vector<std::optional<std::vector<unsigned int>>> &innerSizes,
+                                                unsigned int ctbSize) {
+        std::vector<unsigned int> sizes;
+        for (auto i = 0u; i < innerSizes.size(); i++) {
+            auto isLast = i + 1 == innerSizes.size();
+            auto remaining = isLast ? 0 : coarseSizes[i];
+            if (innerSizes[i]) {
+                for (auto j = 0u; j + 1 < innerSizes[i]->size(); j++) {
+                    auto size = (*innerSizes[i])[j] / ctbSize;
+                    if (!isLast && size >= remaining)
+                        throw std::runtime_error("The tiles inside a stitched tile do not fit in it");
+                    sizes.push_back(size);
+                    remaining -= size;
+                }
+            }
+            if (!isLast)
+                sizes.push_back(remaining);
+        }
+        return sizes;
+    }
+
+    std::optional<StitchContext> ExpandStitchedTiles(const StitchContext &context, std::vector<std::shared_ptr<const bytestring>> &tiles) {
+        if (std::none_of(tiles.begin(), tiles.end(), [](const auto &tile) { return tile && TileExtractor::HasTiles(bytestring_view(tile->data(), tile->size())); }))
+            return {};
+        if (context.GetShouldUseUniformTiles())
+            throw std::runtime_error("Stitched tiles can only be expanded for contexts with explicit tile sizes");
+
+        auto numberOfRows = context.GetTileDimensions().first;
+        auto numberOfColumns = context.GetTileDimensions().second;
+        assert(tiles.size() == numberOfRows * numberOfColumns);
+
+        // Split the tiles that have tiles of their own, and collect the grid inside each coarse column and row.
+        std::vector<std::optional<ExtractedTiles>> extracted(tiles.size());
+        std::vector<std::optional<std::vector<unsigned int>>> innerWidths(numberOfColumns);
+        std::vector<std::optional<std::vector<unsigned int>>> innerHeights(numberOfRows);
+        unsigned int ctbSize = 0;
+        for (auto i = 0u; i < tiles.size(); i++) {
+            if (!tiles[i] || !TileExtractor::HasTiles(bytestring_view(tiles[i]->data(), tiles[i]->size())))
+                continue;
+
+            auto groups = TileExtractor().Extract(bytestring_view(tiles[i]->data(), tiles[i]->size()));
+            if (groups.size() != 1)
+                throw std::runtime_error("The tile grid of a stitched tile changes within a GOP");
+            extracted[i] = std::move(groups.front());
+            if (ctbSize && ctbSize != extracted[i]->ctbSize)
+                throw std::runtime_error("Stitched tiles have different CTB sizes");
+            ctbSize = extracted[i]->ctbSize;
+
+            auto &widths = innerWidths[i % numberOfColumns];
+            auto &heights = innerHeights[i / numberOfColumns];
+            if ((widths && *widths != extracted[i]->grid.widthsOfColumns) || (heights && *heights != extracted[i]->grid.heightsOfRows))
+                throw std::runtime_error("Stitched tiles in the same column or row contain different tiles");
+            widths = extracted[i]->grid.widthsOfColumns;
+            heights = extracted[i]->grid.heightsOfRows;
+        }
+
+        // Order the tiles by the finer grid. A tile without tiles of its own has to span one column and row of it,
+        // unless it was not read, in which case it becomes a missing tile for each tile of the finer grid it covers.
+        std::vector<std::shared_ptr<const bytestring>> expanded;
+        for (auto row = 0u; row < numberOfRows; row++) {
+            auto innerRows = innerHeights[row] ? innerHeights[row]->size() : 1;
+            for (auto innerRow = 0u; innerRow < innerRows; innerRow++) {
+                for (auto column = 0u; column < numberOfColumns; column++) {
+                    auto tile = row * numberOfColumns + column;
+                    auto innerColumns = innerWidths[column] ? innerWidths[column]->size() : 1;
+                    if (!extracted[tile] && tiles[tile] && (innerRows > 1 || innerColumns > 1))
+                        throw std::runtime_error("A tile that is not stitched shares a column or row with one that is");
+
+                    for (auto innerColumn = 0u; innerColumn < innerColumns; innerColumn++) {
+                        if (extracted[tile])
+                            expanded.push_back(std::make_shared<bytestring>(std::move(extracted[tile]->tiles[innerRow * innerColumns + innerColumn])));
+                        else
+                            expanded.push_back(tiles[tile]);
+                    }
+                }
+            }
+        }
+
+        auto heights = SplitSizes(context.GetHeightsOfTiles(), innerHeights, ctbSize);
+        auto widths = SplitSizes(context.GetWidthsOfTiles(), innerWidths, ctbSize);
+        tiles = std::move(expanded);
+        return StitchContext({static_cast<unsigned int>(heights.size() + 1), static_cast<unsigned int>(widths.size() + 1)},
+                             context.GetVideoDimensions(),
+                             {context.GetVideoDisplayHeight(), context.GetVideoDisplayWidth()},
+                             false,
+                             heights,
+                             widths,
+                             context.GetPPSId());
+    }
+
+}; //namespace stitching
@@ -1,17 +1,36 @@
 #ifndef TASM_WRAPPERS_H
 #define TASM_WRAPPERS_H
 
+#include "EncodedGOPCache.h"
 #include "EnvironmentConfiguration.h"
+#include "ImageBatch.h"
+#include "ImagePrefetcher.h"
 #include "ImageUtilities.h"
 #include "utilities.h"
 #include "Tasm.h"
 #include "Video.h"
 #include <boost/python/numpy.hpp>
+#include <mutex>
+#include <shared_mutex>
 
 namespace p = boost::python;
 namespace np = boost::python::numpy;
 
 namespace tasm::python {
+// Returns a capsule that deletes `owned` when Python releases it.
+// Arrays that view memory owned by `owned` use it as their base, so the memory lives as long as they do.
+template <typename T>
+p::object makeOwner(T *owned) {
+    auto capsule = PyCapsule_New(owned, nullptr, [](PyObject *capsule) {
+        delete static_cast<T *>(PyCapsule_GetPointer(capsule, nullptr));
+    });
+    if (!capsule) {
+        delete owned;
+        p::throw_error_already_set();
+    }
+    return p::object(p::handle<>(capsule));
+}
+
 class PythonImage {
 public:
     PythonImage(ImagePtr image)
@@ -20,32 +39,131 @@ public:
     bool isEmpty() const { return !image_; }
     unsigned int width() const { return image_->width(); }
     unsigned int height() const { return image_->height(); }
+    PixelFormat format() const { return image_->format(); }
 
     np::ndarray array() { return makeArray(); }
 
 private:
+    // The array views the image's pixels without copying them, and keeps the image alive.
     np::ndarray makeArray() {
         np::dtype dt = np::dtype::get_builtin<uint8_t>();
-        p::tuple shape = p::make_tuple(height() * width() * 4);
+        p::tuple shape = p::make_tuple(image_->size());
         p::tuple stride = p::make_tuple(sizeof(uint8_t));
-        return np::from_data(image_->pixels(), dt, shape, stride, own_);
+        return np::from_data(image_->pixels(), dt, shape, stride, makeOwner(new ImagePtr(image_)));
     }
 
     ImagePtr image_;
-    p::object own_;
 };
 
+// Images are produced with the GIL released, so Python can run inference on one result while the next is decoded.
+// With a prefetch depth, a background thread keeps up to that many images ready.
+// Images are produced while holding the TASM's lock as a reader, so calls that store or add metadata wait for them.
 class SelectionResults {
 public:
-    SelectionResults(std::unique_ptr<ImageIterator> imageIterator)
-            : imageIterator_(std::move(imageIterator)) {}
+    SelectionResults(std::unique_ptr<ImageIterator> imageIterator,
+                     std::shared_ptr<std::shared_mutex> tasmLock,
+                     unsigned int prefetchDepth = EnvironmentConfiguration::instance().selectionPrefetchDepth())
+            : state_(new State(withReadLock(std::move(imageIterator), std::move(tasmLock)), prefetchDepth), [](State *state) {
+                // Stopping the prefetch thread waits for the image that it is producing.
+                ScopedGILRelease release;
+                delete state;
+            }) {}
 
     PythonImage next() {
-        return PythonImage(imageIterator_->next());
+        ImagePtr image;
+        {
+            ScopedGILRelease release;
+            std::scoped_lock lock(state_->mutex);
+            image = state_->batcher.nextImage();
+        }
+        return PythonImage(image);
+    }
+
+    // Returns (pixels, frame numbers, boxes) for up to `maxImages` instances.
+    // `pixels` has one image per row, shaped like numpy_array; boxes are rows of x1, y1, x2, y2.
+    p::tuple nextBatch(unsigned int maxImages) {
+        return nextBatch(maxImages, 0, 0);
+    }
+
+    p::tuple nextBatch(unsigned int maxImages, unsigned int height, unsigned int width) {
+        std::optional<ImageBatch> batch;
+        {
+            ScopedGILRelease release;
+            std::scoped_lock lock(state_->mutex);
+            batch = state_->batcher.next(maxImages, height, width);
+        }
+        return makeBatch(std::move(*batch));
     }
 
 private:
-    std::shared_ptr<ImageIterator> imageIterator_;
+    struct State {
+        State(std::shared_ptr<ImageIterator> imageIterator, unsigned int prefetchDepth)
+            : prefetcher(prefetchDepth ? std::make_unique<ImagePrefetcher>(imageIterator, prefetchDepth) : nullptr),
+            batcher(prefetcher
+                    ? ImageBatcher([prefetcher = prefetcher.get()] { return prefetcher->next(); }, imageIterator->format())
+                    : ImageBatcher(imageIterator))
+        {}
+
+        std::mutex mutex;
+        std::unique_ptr<ImagePrefetcher> prefetcher;
+        ImageBatcher batcher;
+    };
+
+    static std::unique_ptr<ImageIterator> withReadLock(std::unique_ptr<ImageIterator> imageIterator, std::shared_ptr<std::shared_mutex> tasmLock) {
+        imageIterator->setReadLock(std::move(tasmLock));
+        return imageIterator;
+    }
+
+    static p::tuple batchShape(const ImageBatch &batch) {
+        auto count = batch.numberOfImages;
+        switch (batch.format) {
+            case PixelFormat::RGBA:
+                return p::make_tuple(count, batch.height, batch.width, 4);
+            case PixelFormat::RGB:
+            case PixelFormat::BGR:
+                return p::make_tuple(count, batch.height, batch.width, 3);
+            case PixelFormat::PlanarRGB:
+                return p::make_tuple(count, 3, batch.height, batch.width);
+            case PixelFormat::Gray:
+                return p::make_tuple(count, batch.height, batch.width);
+            case PixelFormat::NV12:
+                break;
+        }
+        return p::make_tuple(count, batch.imageSize());
+    }
+
+    // The arrays view the batch's buffers without copying them. They share ownership of the batch.
+    static p::tuple makeBatch(ImageBatch &&batch) {
+        auto count = batch.numberOfImages;
+        if (!count) {
+            return p::make_tuple(np::empty(batchShape(batch), np::dtype::get_builtin<uint8_t>()),
+                                 np::empty(p::make_tuple(0), np::dtype::get_builtin<int>()),
+                                 np::empty(p::make_tuple(0, 4), np::dtype::get_builtin<unsigned int>()));
+        }
+
+        auto shape = batchShape(batch);
+        auto ownedBatch = new ImageBatch(std::move(batch));
+        auto owner = makeOwner(ownedBatch);
+
+        // Compute the strides of the tightly packed pixels from the innermost dimension out.
+        auto dimensions = p::len(shape);
+        p::list strides;
+        Py_ssize_t stride = 1;
+        for (auto i = dimensions - 1; i >= 0; --i) {
+            strides.insert(0, stride);
+            stride *= p::extract<Py_ssize_t>(shape[i])();
+        }
+
+        auto pixels = np::from_data(ownedBatch->pixels.get(), np::dtype::get_builtin<uint8_t>(), shape, p::tuple(strides), owner);
+        auto frameNumbers = np::from_data(ownedBatch->frameNumbers.data(), np::dtype::get_builtin<int>(),
+                                          p::make_tuple(count), p::make_tuple(sizeof(int)), owner);
+        auto boxes = np::from_data(ownedBatch->boxes.data(), np::dtype::get_builtin<unsigned int>(),
+                                   p::make_tuple(count, 4), p::make_tuple(4 * sizeof(unsigned int), sizeof(unsigned int)), owner);
+        return p::make_tuple(pixels, frameNumbers, boxes);
+    }
+
+    // Shared because Boost.Python copies results when it returns them.
+    std::shared_ptr<State> state_;
 };
 
 class PythonTASM : public TASM {
@@ -58,76 +176,151 @@ public:
         : TASM(indexType, dbPath)
     {}
 
+    void pythonAddMetadata(const std::string &video, const std::string &label, unsigned int frame,
+                           unsigned int x1, unsigned int y1, unsigned int x2, unsigned int y2) {
+        withoutGIL([&] { addMetadata(video, label, frame, x1, y1, x2, y2); });
+    }
+
     void addBulkMetadataFromList(boost::python::list metadataInfo) {
-        addBulkMetadata(extract<MetadataInfo>(metadataInfo));
+        auto metadata = extract<MetadataInfo>(metadataInfo);
+        withoutGIL([&] { addBulkMetadata(metadata); });
+    }
+
+    void pythonStore(const std::string &videoPath, const std::string &savedName) {
+        withoutGIL([&] { store(videoPath, savedName); });
+    }
+
+    void pythonStoreWithUniformLayout(const std::string &videoPath, const std::string &savedName, unsigned int rows, unsigned int columns) {
+        withoutGIL([&] { storeWithUniformLayout(videoPath, savedName, rows, columns); });
+    }
+
+    void pythonStorePreTiled(const std::string &videoPath, const std::string &savedName) {
+        withoutGIL([&] { storePreTiled(videoPath, savedName); });
     }
 
     void pythonStoreWithNonUniformLayout(const std::string &videoPath, const std::string &savedName, const std::string &metadataIdentifier, const std::string &labelToTileAround) {
         // If "force" isn't specified, do the tiling.
-        storeWithNonUniformLayout(videoPath, savedName, metadataIdentifier, labelToTileAround, true);
+        pythonStoreWithNonUniformLayout(videoPath, savedName, metadataIdentifier, labelToTileAround, true);
     }
 
     void pythonStoreWithNonUniformLayout(const std::string &videoPath, const std::string &savedName, const std::string &metadataIdentifier, const std::string &labelToTileAround, bool force) {
-        storeWithNonUniformLayout(videoPath, savedName, metadataIdentifier, labelToTileAround, force);
+        withoutGIL([&] { storeWithNonUniformLayout(videoPath, savedName, metadataIdentifier, labelToTileAround, force); });
     }
 
+    // Python callers get RGB by default, which is what numpy_array used to slice out of RGBA.
     SelectionResults pythonSelect(const std::string &video,
                                        const std::string &label,
                                        unsigned int firstFrameInclusive,
                                        unsigned int lastFrameExclusive) {
-        return SelectionResults(select(video, label, firstFrameInclusive, lastFrameExclusive));
+        return withoutGIL([&] { return SelectionResults(select(video, label, firstFrameInclusive, lastFrameExclusive, "", PixelFormat::RGB), mutex_); });
     }
 
     SelectionResults pythonSelect(const std::string &video,
                                   const std::string &label) {
-        return SelectionResults(select(video, label));
+        return withoutGIL([&] { return SelectionResults(select(video, label, "", PixelFormat::RGB), mutex_); });
     }
 
     SelectionResults pythonSelect(const std::string &video,
                                   const std::string &label,
                                   unsigned int frame) {
-        return SelectionResults(select(video, label, frame));
+        return withoutGIL([&] { return SelectionResults(select(video, label, frame, "", PixelFormat::RGB), mutex_); });
     }
 
     SelectionResults pythonSelect(const std::string &video,
                                   const std::string &metadataIdentifier,
                                   const std::string &label,
                                   unsigned int firstFrameInclusive,
-                                  unsigned int lastFrameExclusive) {
-        return SelectionResults(select(video, label, firstFrameInclusive, lastFrameExclusive, metadataIdentifier));
+                                  unsigned int lastFrameExclusive,
+                                  PixelFormat format) {
+        return withoutGIL([&] { return SelectionResults(select(video, label, firstFrameInclusive, lastFrameExclusive, metadataIdentifier, format), mutex_); });
     }
 
     SelectionResults pythonSelect(const std::string &video,
                                   const std::string &metadataIdentifier,
-                                  const std::string &label) {
-        return SelectionResults(select(video, label, metadataIdentifier));
+                                  const std::string &label,
+                                  PixelFormat format) {
+        return withoutGIL([&] { return SelectionResults(select(video, label, metadataIdentifier, format), mutex_); });
     }
 
     SelectionResults pythonSelect(const std::string &video,
                                   const std::string &metadataIdentifier,
                                   const std::string &label,
-                                  unsigned int frame) {
-        return SelectionResults(select(video, label, frame, metadataIdentifier));
+                                  unsigned int frame,
+                                  PixelFormat format) {
+        return withoutGIL([&] { return SelectionResults(select(video, label, frame, metadataIdentifier, format), mutex_); });
     }
 
     SelectionResults pythonSelectTiles(const std::string &video,
                                         const std::string &metadataIdentifier,
                                         const std::string &label,
                                         unsigned int firstFrameInclusive,
-                                        unsigned int lastFrameExclusive) {
-        return SelectionResults(selectTiles(video, label, firstFrameInclusive, lastFrameExclusive, metadataIdentifier));
+                                        unsigned int lastFrameExclusive,
+                                        PixelFormat format) {
+        return withoutGIL([&] { return SelectionResults(selectTiles(video, label, firstFrameInclusive, lastFrameExclusive, metadataIdentifier, format), mutex_); });
+    }
+
+    SelectionResults pythonSelectTiles(const std::string &video,
+                                       const std::string &metadataIdentifier,
+                                       const std::string &label,
+                                       PixelFormat format) {
+        return withoutGIL([&] { return SelectionResults(selectTiles(video, label, metadataIdentifier, format), mutex_); });
+    }
+
+    SelectionResults pythonSelectFrames(const std::string &video,
+                                        const std::string &metadataIdentifier,
+                                        const std::string &label,
+                                        PixelFormat format) {
+        return withoutGIL([&] { return SelectionResults(selectFrames(video, label, metadataIdentifier, format), mutex_); });
+    }
+
+    SelectionResults pythonSelectFrames(const std::string &video,
+                                        const std::string &metadataIdentifier,
+                                        const std::string &label,
+                                        unsigned int firstFrameInclusive,
+                                        unsigned int lastFrameExclusive,
+                                        PixelFormat format) {
+        return withoutGIL([&] { return SelectionResults(selectFrames(video, label, firstFrameInclusive, lastFrameExclusive, metadataIdentifier, format), mutex_); });
+    }
+
+    SelectionResults pythonSelect(const std::string &video,
+                                  const std::string &metadataIdentifier,
+                                  const std::string &label,
+                                  unsigned int firstFrameInclusive,
+                                  unsigned int lastFrameExclusive) {
+        return pythonSelect(video, metadataIdentifier, label, firstFrameInclusive, lastFrameExclusive, PixelFormat::RGB);
+    }
+
+    SelectionResults pythonSelect(const std::string &video,
+                                  const std::string &metadataIdentifier,
+                                  const std::string &label) {
+        return pythonSelect(video, metadataIdentifier, label, PixelFormat::RGB);
+    }
+
+    SelectionResults pythonSelect(const std::string &video,
+                                  const std::string &metadataIdentifier,
+                                  const std::string &label,
+                                  unsigned int frame) {
+        return pythonSelect(video, metadataIdentifier, label, frame, PixelFormat::RGB);
+    }
+
+    SelectionResults pythonSelectTiles(const std::string &video,
+                                       const std::string &metadataIdentifier,
+                                       const std::string &label,
+                                       unsigned int firstFrameInclusive,
+                                       unsigned int lastFrameExclusive) {
+        return pythonSelectTiles(video, metadataIdentifier, label, firstFrameInclusive, lastFrameExclusive, PixelFormat::RGB);
     }
 
     SelectionResults pythonSelectTiles(const std::string &video,
                                        const std::string &metadataIdentifier,
                                        const std::string &label) {
-        return SelectionResults(selectTiles(video, label, metadataIdentifier));
+        return pythonSelectTiles(video, metadataIdentifier, label, PixelFormat::RGB);
     }
 
     SelectionResults pythonSelectFrames(const std::string &video,
                                         const std::string &metadataIdentifier,
                                         const std::string &label) {
-        return SelectionResults(selectFrames(video, label, metadataIdentifier));
+        return pythonSelectFrames(video, metadataIdentifier, label, PixelFormat::RGB);
     }
 
     SelectionResults pythonSelectFrames(const std::string &video,
@@ -135,24 +328,58 @@ public:
                                         const std::string &label,
                                         unsigned int firstFrameInclusive,
                                         unsigned int lastFrameExclusive) {
-        return SelectionResults(selectFrames(video, label, firstFrameInclusive, lastFrameExclusive, metadataIdentifier));
+        return pythonSelectFrames(video, metadataIdentifier, label, firstFrameInclusive, lastFrameExclusive, PixelFormat::RGB);
+    }
+
+    void pythonRetileVideoBasedOnRegret(const std::string &video) {
+        withoutGIL([&] { retileVideoBasedOnRegret(video); });
+    }
+
+    unsigned int pythonCompactTileVersions(const std::string &video) {
+        return withoutGIL([&] { return compactTileVersions(video); });
     }
 
+    void pythonStartBackgroundCompaction(unsigned int intervalInSeconds) {
+        withoutGIL([&] { startBackgroundCompaction(intervalInSeconds); });
+    }
+
+    void pythonStopBackgroundCompaction() {
+        // Waits for a compaction that is in progress.
+        withoutGIL([&] { stopBackgroundCompaction(); });
+    }
+
+    // Regret accumulators are read by selections and retiling, so they are only changed while holding the lock.
     void pythonActivateRegretBasedTilingForVideo(const std::string &video) {
-        return activateRegretBasedTilingForVideo(video);
+        withoutGIL([&] { activateRegretBasedTilingForVideo(video); });
     }
 
     void pythonActivateRegretBasedTilingForVideo(const std::string &video,
                                                 const std::string &metadataIdentifier) {
-        return activateRegretBasedTilingForVideo(video, metadataIdentifier);
+        withoutGIL([&] { activateRegretBasedTilingForVideo(video, metadataIdentifier); });
     }
 
     void pythonActivateRegretBasedTilingForVideo(const std::string &video,
                                                  const std::string &metadataIdentifier,
                                                  double threshold) {
-        return activateRegretBasedTilingForVideo(video, metadataIdentifier, threshold);
+        withoutGIL([&] { activateRegretBasedTilingForVideo(video, metadataIdentifier, threshold); });
     }
 
+    void pythonDeactivateRegretBasedTilingForVideo(const std::string &video) {
+        withoutGIL([&] { deactivateRegretBasedTilingForVideo(video); });
+    }
+
+private:
+    // Runs `work` with the GIL released. Calls from different Python threads still run one at a time, and they wait
+    // for selections to finish producing the images that they are decoding.
+    template <typename Work>
+    auto withoutGIL(Work work) -> decltype(work()) {
+        ScopedGILRelease release;
+        std::unique_lock lock(*mutex_);
+        return work();
+    }
+
+    // Shared with selections, which can outlive the TASM.
+    std::shared_ptr<std::shared_mutex> mutex_ = std::make_shared<std::shared_mutex>();
 };
 
 PythonTASM *tasmFromWH(const std::string &whDBPath) {
@@ -165,9 +392,69 @@ void configureEnvironment(const boost::python::dict &kwargs) {
         options[EnvironmentConfiguration::DefaultLabelsDB] = boost::python::extract<std::string>(kwargs["default_db_path"]);
     if (kwargs.contains("catalog_path"))
         options[EnvironmentConfiguration::CatalogPath] = boost::python::extract<std::string>(kwargs["catalog_path"]);
+    if (kwargs.contains("pack_tiles"))
+        options[EnvironmentConfiguration::PackTiles] = boost::python::extract<bool>(kwargs["pack_tiles"]) ? "true" : "false";
+    if (kwargs.contains("read_ahead_depth"))
+        options[EnvironmentConfiguration::ReadAheadDepth] = std::to_string(boost::python::extract<unsigned int>(kwargs["read_ahead_depth"])());
+    if (kwargs.contains("read_ahead_threads"))
+        options[EnvironmentConfiguration::ReadAheadThreads] = std::to_string(boost::python::extract<unsigned int>(kwargs["read_ahead_threads"])());
+    if (kwargs.contains("stitch_ahead_depth"))
+        options[EnvironmentConfiguration::StitchAheadDepth] = std::to_string(boost::python::extract<unsigned int>(kwargs["stitch_ahead_depth"])());
+    if (kwargs.contains("stitch_threads"))
+        options[EnvironmentConfiguration::StitchThreads] = std::to_string(boost::python::extract<unsigned int>(kwargs["stitch_threads"])());
+    if (kwargs.contains("stitch_plan_cache_size"))
+        options[EnvironmentConfiguration::StitchPlanCacheSize] = std::to_string(boost::python::extract<unsigned int>(kwargs["stitch_plan_cache_size"])());
+    if (kwargs.contains("planning_window"))
+        options[EnvironmentConfiguration::PlanningWindow] = std::to_string(boost::python::extract<unsigned int>(kwargs["planning_window"])());
+    if (kwargs.contains("decoder_instances"))
+        options[EnvironmentConfiguration::DecoderInstances] = std::to_string(boost::python::extract<unsigned int>(kwargs["decoder_instances"])());
+    if (kwargs.contains("software_decode"))
+        options[EnvironmentConfiguration::SoftwareDecode] = boost::python::extract<bool>(kwargs["software_decode"]) ? "true" : "false";
+    if (kwargs.contains("software_decode_threads"))
+        options[EnvironmentConfiguration::SoftwareDecodeThreads] = std::to_string(boost::python::extract<unsigned int>(kwargs["software_decode_threads"])());
+    if (kwargs.contains("selection_prefetch_depth"))
+        options[EnvironmentConfiguration::SelectionPrefetchDepth] = std::to_string(boost::python::extract<unsigned int>(kwargs["selection_prefetch_depth"])());
+    if (kwargs.contains("ingest_tiled_sources"))
+        options[EnvironmentConfiguration::IngestTiledSources] = boost::python::extract<bool>(kwargs["ingest_tiled_sources"]) ? "true" : "false";
+    if (kwargs.contains("encoded_gop_cache_size")) {
+        unsigned long long cacheSize = boost::python::extract<unsigned long long>(kwargs["encoded_gop_cache_size"]);
+        options[EnvironmentConfiguration::EncodedGOPCacheSize] = std::to_string(cacheSize);
+        EncodedGOPCache::instance().setCapacity(cacheSize);
+    }
+    if (kwargs.contains("image_buffer_pool_size")) {
+        unsigned long long poolSize = boost::python::extract<unsigned long long>(kwargs["image_buffer_pool_size"]);
+        options[EnvironmentConfiguration::ImageBufferPoolSize] = std::to_string(poolSize);
+        ImageBufferPool::instance().setCapacity(poolSize);
+    }
     EnvironmentConfiguration::instance(EnvironmentConfiguration(options));
 }
 
+boost::python::dict encodedGOPCacheStatistics() {
+    auto stats = EncodedGOPCache::instance().statistics();
+    boost::python::dict result;
+    result["hits"] = stats.hits;
+    result["misses"] = stats.misses;
+    result["bytes_served"] = stats.bytesServed;
+    result["bytes_inserted"] = stats.bytesInserted;
+    result["bytes_evicted"] = stats.bytesEvicted;
+    result["bytes_cached"] = stats.bytesCached;
+    result["capacity"] = stats.capacityInBytes;
+    result["num_entries"] = stats.numberOfEntries;
+    return result;
+}
+
+boost::python::dict imageBufferPoolStatistics() {
+    auto stats = ImageBufferPool::instance().statistics();
+    boost::python::dict result;
+    result["allocations"] = stats.allocations;
+    result["reuses"] = stats.reuses;
+    result["bytes_allocated"] = stats.bytesAllocated;
+    result["bytes_in_use"] = stats.bytesInUse;
+    result["bytes_pooled"] = stats.bytesPooled;
+    result["capacity"] = stats.capacityInBytes;
+    return result;
+}
+
 } // namespace tasm::python;
 
 #endif //TASM_WRAPPERS_H
@@ -4,6 +4,26 @@
 #include <vector>
 #include <boost/python/list.hpp>
 
+// Releases the GIL until it is destroyed, so other Python threads run while TASM does native work.
+// Python objects must not be touched while the GIL is released. Does nothing if the GIL is not held.
+class ScopedGILRelease {
+public:
+    ScopedGILRelease()
+        : state_(PyGILState_Check() ? PyEval_SaveThread() : nullptr)
+    {}
+
+    ~ScopedGILRelease() {
+        if (state_)
+            PyEval_RestoreThread(state_);
+    }
+
+    ScopedGILRelease(const ScopedGILRelease &) = delete;
+    ScopedGILRelease &operator=(const ScopedGILRelease &) = delete;
+
+private:
+    PyThreadState *state_;
+};
+
 template <typename T>
 std::vector<T> extract(boost::python::list l) {
     std::vector<T> result;
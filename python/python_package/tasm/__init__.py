@@ -2,6 +2,17 @@
 from tasm._tasm import *
 
 def numpy_array(self):
-    return self.array().reshape(self.height(), self.width(), -1)[:,:,:3]
+    array = self.array()
+    format = self.format()
+    if format == PixelFormat.RGBA:
+        return array.reshape(self.height(), self.width(), 4)
+    elif format == PixelFormat.RGB or format == PixelFormat.BGR:
+        return array.reshape(self.height(), self.width(), 3)
+    elif format == PixelFormat.PlanarRGB:
+        return array.reshape(3, self.height(), self.width())
+    elif format == PixelFormat.Gray:
+        return array.reshape(self.height(), self.width())
+    # NV12 chroma planes are not a whole number of rows when the width or height is odd, so it stays flat.
+    return array
 
 Image.numpy_array = numpy_array
\ No newline at end of file
@@ -20,6 +20,15 @@ tasm::python::SelectionResults (tasm::python::PythonTASM::*selectAllTiles)(const
 tasm::python::SelectionResults (tasm::python::PythonTASM::*selectRangeTiles)(const std::string&, const std::string&, const std::string&, unsigned int, unsigned int) = &tasm::python::PythonTASM::pythonSelectTiles;
 tasm::python::SelectionResults (tasm::python::PythonTASM::*selectAllFrames)(const std::string&, const std::string&, const std::string&) = &tasm::python::PythonTASM::pythonSelectFrames;
 tasm::python::SelectionResults (tasm::python::PythonTASM::*selectRangeFrames)(const std::string&, const std::string&, const std::string&, unsigned int, unsigned int) = &tasm::python::PythonTASM::pythonSelectFrames;
+tasm::python::SelectionResults (tasm::python::PythonTASM::*selectRangeWithFormat)(const std::string&, const std::string&, const std::string&, unsigned int, unsigned int, tasm::PixelFormat) = &tasm::python::PythonTASM::pythonSelect;
+tasm::python::SelectionResults (tasm::python::PythonTASM::*selectEqualWithFormat)(const std::string&, const std::string&, const std::string&, unsigned int, tasm::PixelFormat) = &tasm::python::PythonTASM::pythonSelect;
+tasm::python::SelectionResults (tasm::python::PythonTASM::*selectAllWithFormat)(const std::string&, const std::string&, const std::string&, tasm::PixelFormat) = &tasm::python::PythonTASM::pythonSelect;
+tasm::python::SelectionResults (tasm::python::PythonTASM::*selectAllTilesWithFormat)(const std::string&, const std::string&, const std::string&, tasm::PixelFormat) = &tasm::python::PythonTASM::pythonSelectTiles;
+tasm::python::SelectionResults (tasm::python::PythonTASM::*selectRangeTilesWithFormat)(const std::string&, const std::string&, const std::string&, unsigned int, unsigned int, tasm::PixelFormat) = &tasm::python::PythonTASM::pythonSelectTiles;
+tasm::python::SelectionResults (tasm::python::PythonTASM::*selectAllFramesWithFormat)(const std::string&, const std::string&, const std::string&, tasm::PixelFormat) = &tasm::python::PythonTASM::pythonSelectFrames;
+tasm::python::SelectionResults (tasm::python::PythonTASM::*selectRangeFramesWithFormat)(const std::string&, const std::string&, const std::string&, unsigned int, unsigned int, tasm::PixelFormat) = &tasm::python::PythonTASM::pythonSelectFrames;
+boost::python::tuple (tasm::python::SelectionResults::*nextBatch)(unsigned int) = &tasm::python::SelectionResults::nextBatch;
+boost::python::tuple (tasm::python::SelectionResults::*nextResizedBatch)(unsigned int, unsigned int, unsigned int) = &tasm::python::SelectionResults::nextBatch;
 void (tasm::python::PythonTASM::*storeForceNonUniformLayout)(const std::string&, const std::string&, const std::string&, const std::string&) = &tasm::python::PythonTASM::pythonStoreWithNonUniformLayout;
 void (tasm::python::PythonTASM::*storeDoNotForceNonUniformLayout)(const std::string&, const std::string&, const std::string&, const std::string&, bool) = &tasm::python::PythonTASM::pythonStoreWithNonUniformLayout;
 void (tasm::python::PythonTASM::*activateRegretBasedTilingWithoutMetadataIdentifier)(const std::string&) = &tasm::python::PythonTASM::pythonActivateRegretBasedTilingForVideo;
@@ -36,10 +45,13 @@ BOOST_PYTHON_MODULE(_tasm) {
             .def("is_empty", &tasm::python::PythonImage::isEmpty)
             .def("width", &tasm::python::PythonImage::width)
             .def("height", &tasm::python::PythonImage::height)
+            .def("format", &tasm::python::PythonImage::format)
             .def("array", &tasm::python::PythonImage::array);
 
     class_<tasm::python::SelectionResults>("ObjectIterator", no_init)
-            .def("next", &tasm::python::SelectionResults::next);
+            .def("next", &tasm::python::SelectionResults::next)
+            .def("next_batch", nextBatch)
+            .def("next_batch", nextResizedBatch);
 
     class_<tasm::MetadataInfo>("MetadataInfo", init<std::string, std::string, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int>())
             .def_readonly("video", &tasm::MetadataInfo::video)
@@ -50,6 +62,14 @@ BOOST_PYTHON_MODULE(_tasm) {
             .def_readonly("x2", &tasm::MetadataInfo::x2)
             .def_readonly("y2", &tasm::MetadataInfo::y2);
 
+    enum_<tasm::PixelFormat>("PixelFormat")
+            .value("RGBA", tasm::PixelFormat::RGBA)
+            .value("RGB", tasm::PixelFormat::RGB)
+            .value("BGR", tasm::PixelFormat::BGR)
+            .value("PlanarRGB", tasm::PixelFormat::PlanarRGB)
+            .value("Gray", tasm::PixelFormat::Gray)
+            .value("NV12", tasm::PixelFormat::NV12);
+
     enum_<tasm::SemanticIndex::IndexType>("IndexType")
             .value("XY", tasm::SemanticIndex::IndexType::XY)
             .value("InMemory", tasm::SemanticIndex::IndexType::InMemory);
@@ -59,14 +79,17 @@ BOOST_PYTHON_MODULE(_tasm) {
     // Warning: The WH-type of index does not have a "video" column for legacy reasons.
     def("tasm_from_db", &tasm::python::tasmFromWH, return_value_policy<manage_new_object>());
     def("configure_environment", &tasm::python::configureEnvironment);
+    def("encoded_gop_cache_stats", &tasm::python::encodedGOPCacheStatistics);
+    def("image_buffer_pool_stats", &tasm::python::imageBufferPoolStatistics);
 
     class_<tasm::python::PythonTASM, std::shared_ptr<tasm::python::PythonTASM>, bases<tasm::TASM>, boost::noncopyable>("TASM")
         .def(init<>())
         .def(init<tasm::SemanticIndex::IndexType, optional<std::string>>())
-        .def("add_metadata", &tasm::python::PythonTASM::addMetadata)
+        .def("add_metadata", &tasm::python::PythonTASM::pythonAddMetadata)
         .def("add_bulk_metadata", &tasm::python::PythonTASM::addBulkMetadataFromList)
-        .def("store", &tasm::python::PythonTASM::store)
-        .def("store_with_uniform_layout", &tasm::python::PythonTASM::storeWithUniformLayout)
+        .def("store", &tasm::python::PythonTASM::pythonStore)
+        .def("store_with_uniform_layout", &tasm::python::PythonTASM::pythonStoreWithUniformLayout)
+        .def("store_pre_tiled", &tasm::python::PythonTASM::pythonStorePreTiled)
         .def("store_with_nonuniform_layout", storeForceNonUniformLayout)
         .def("store_with_nonuniform_layout", storeDoNotForceNonUniformLayout)
         .def("select", selectRange)
@@ -79,11 +102,23 @@ BOOST_PYTHON_MODULE(_tasm) {
         .def("select_tiles", selectRangeTiles)
         .def("select_frames", selectAllFrames)
         .def("select_frames", selectRangeFrames)
+        // Boost.Python tries the overloads that are defined last first. These must come after the overloads
+        // that take frame numbers, or else a PixelFormat would be converted to a frame number.
+        .def("select", selectRangeWithFormat)
+        .def("select", selectEqualWithFormat)
+        .def("select", selectAllWithFormat)
+        .def("select_tiles", selectAllTilesWithFormat)
+        .def("select_tiles", selectRangeTilesWithFormat)
+        .def("select_frames", selectAllFramesWithFormat)
+        .def("select_frames", selectRangeFramesWithFormat)
         .def("activate_regret_based_tiling", activateRegretBasedTilingWithMetadataIdentifier)
         .def("activate_regret_based_tiling", activateRegretBasedTilingWithoutMetadataIdentifier)
         .def("activate_regret_based_tiling", activateRegretBasedTilingWithThreshold)
-        .def("deactivate_regret_based_tiling", &tasm::python::PythonTASM::deactivateRegretBasedTilingForVideo)
-        .def("retile_based_on_regret", &tasm::python::PythonTASM::retileVideoBasedOnRegret);
+        .def("deactivate_regret_based_tiling", &tasm::python::PythonTASM::pythonDeactivateRegretBasedTilingForVideo)
+        .def("retile_based_on_regret", &tasm::python::PythonTASM::pythonRetileVideoBasedOnRegret)
+        .def("compact_tile_versions", &tasm::python::PythonTASM::pythonCompactTileVersions)
+        .def("start_background_compaction", &tasm::python::PythonTASM::pythonStartBackgroundCompaction)
+        .def("stop_background_compaction", &tasm::python::PythonTASM::pythonStopBackgroundCompaction);
 
     class_<tasm::python::Query>("Query", init<std::string, std::string, unsigned int, unsigned int>())
         .def(init<std::string, std::string>())
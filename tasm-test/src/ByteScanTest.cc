@@ -0,0 +1,149 @@
+#include "ByteScan.h"
+#include "Emulation.h"
+#include <gtest/gtest.h>
+
+#include <cassert>
+#include <random>
+
+using namespace stitching;
+
+namespace {
+
+const char *FindZeroPairByteByByte(const char *begin, const char *end) {
+    for (auto p = begin; p + 1 < end; ++p) {
+        if (!p[0] && !p[1])
+            return p;
+    }
+    return end;
+}
+
+const char *FindStartCodeByteByByte(const char *begin, const char *end) {
+    for (auto p = begin; p + 3 < end; ++p) {
+        if (!p[0] && !p[1] && !p[2] && p[3] == 1)
+            return p;
+    }
+    return end;
+}
+
+std::vector<ByteScanPath> supportedPaths() {
+    std::vector<ByteScanPath> paths;
+    for (auto path : {ByteScanPath::Scalar, ByteScanPath::SSE2, ByteScanPath::AVX2}) {
+        if (IsByteScanPathSupported(path))
+            paths.push_back(path);
+    }
+    assert(!paths.empty() && paths.front() == ByteScanPath::Scalar);
+    return paths;
+}
+
+// Checks every path against the byte-by-byte scans for each range of data that starts in the first 40 bytes, so that
+// matches fall at every offset from a vector boundary and ranges end with tails of every length.
+void assertPathsAgree(const bytestring &data) {
+    auto paths = supportedPaths();
+    for (auto first = 0u; first < std::min<size_t>(data.size(), 40); ++first) {
+        for (auto last = first; last <= data.size(); ++last) {
+            auto begin = data.data() + first;
+            auto end = data.data() + last;
+            auto zeroPair = FindZeroPairByteByByte(begin, end);
+            auto startCode = FindStartCodeByteByByte(begin, end);
+            assert(FindZeroPair(begin, end) == zeroPair);
+            assert(FindStartCode(begin, end) == startCode);
+            for (auto path : paths) {
+                assert(FindZeroPair(begin, end, path) == zeroPair);
+                assert(FindStartCode(begin, end, path) == startCode);
+            }
+        }
+    }
+}
+
+// Random bytes in which zeroes and the bytes that follow two zeroes in start codes and emulation prevention
+// sequences are common.
+bytestring randomBytes(std::mt19937 &generator, size_t size) {
+    static const char values[] = {0, 0, 0, 1, 2, 3, 4, 0x7f, static_cast<char>(0x80), static_cast<char>(0xff)};
+    std::uniform_int_distribution<size_t> distribution(0, sizeof(values) - 1);
+    bytestring bytes(size);
+    for (auto &byte : bytes)
+        byte = values[distribution(generator)];
+    return bytes;
+}
+
+} // namespace
+
+class ByteScanTestFixture : public testing::Test {
+public:
+    ByteScanTestFixture() {}
+};
+
+TEST_F(ByteScanTestFixture, testZeroPairAtEachPosition) {
+    // Single zeroes must not match, so they are placed between the non-zero bytes.
+    for (auto position = 0u; position < 100; ++position) {
+        bytestring data(100, 0x5a);
+        for (auto i = 1u; i < data.size(); i += 3)
+            data[i] = 0;
+        data[position] = data[position + 1 < data.size() ? position + 1 : position] = 0;
+        assertPathsAgree(data);
+    }
+}
+
+TEST_F(ByteScanTestFixture, testStartCodeAcrossVectorBoundaries) {
+    // A start code whose first bytes end one vector and whose last bytes start the next.
+    for (auto boundary : {16u, 32u, 64u}) {
+        for (auto shift = 0u; shift < 4; ++shift) {
+            bytestring data(boundary + 40, 0x11);
+            auto position = boundary - shift;
+            data[position] = data[position + 1] = data[position + 2] = 0;
+            data[position + 3] = 1;
+            // An emulation prevention sequence before it, which is a zero pair but not a start code.
+            data[position - 10] = data[position - 9] = 0;
+            data[position - 8] = 3;
+            assertPathsAgree(data);
+        }
+    }
+}
+
+TEST_F(ByteScanTestFixture, testRandomData) {
+    std::mt19937 generator(20);
+    for (auto size : {0u, 1u, 2u, 3u, 4u, 15u, 16u, 17u, 31u, 32u, 33u, 63u, 64u, 65u, 200u})
+        assertPathsAgree(randomBytes(generator, size));
+}
+
+TEST_F(ByteScanTestFixture, testNoZeroPair) {
+    // Every scan runs to the end, including the scalar tail after the last vector.
+    bytestring data(150, 0);
+    for (auto i = 0u; i < data.size(); i += 2)
+        data[i] = 0x42;
+    assertPathsAgree(data);
+}
+
+TEST_F(ByteScanTestFixture, testEmulationPreventionRoundTrips) {
+    std::mt19937 generator(33);
+    for (auto size : {0u, 1u, 3u, 16u, 33u, 100u, 1000u}) {
+        for (auto i = 0u; i < 20; ++i) {
+            auto data = randomBytes(generator, size);
+            auto start = size ? std::uniform_int_distribution<size_t>(0, size)(generator) : 0;
+
+            unsigned int numberOfEmulationBytesAdded = 0;
+            auto escaped = AddEmulationPreventionAndMarker(data, start, data.size(), &numberOfEmulationBytesAdded);
+            assert(std::equal(Nal::kNalMarker4.begin(), Nal::kNalMarker4.end(), escaped.begin()));
+            escaped.erase(escaped.begin(), escaped.begin() + Nal::kNalMarker4.size());
+            assert(escaped.size() == data.size() + numberOfEmulationBytesAdded);
+
+            // Bytes before start are copied as they are.
+            assert(std::equal(data.begin(), data.begin() + start, escaped.begin()));
+            // After start, two zeroes are only ever followed by an emulation_prevention_three_byte or a byte above it.
+            for (auto j = start; j + 2 < escaped.size(); ++j) {
+                if (!escaped[j] && !escaped[j + 1])
+                    assert(static_cast<unsigned char>(escaped[j + 2]) >= 3);
+            }
+
+            assert(RemoveEmulationPreventionBytes(escaped, start, escaped.size()) == data);
+            // Each prefix of the escaped bytes that ends at a mapped offset removes to the prefix of data that ends there.
+            for (auto offset = 0u; offset <= data.size(); ++offset) {
+                auto escapedOffset = OffsetBeforeEmulationPreventionRemoval({escaped.data(), escaped.size()}, start, offset);
+                assert(escapedOffset <= escaped.size());
+                assert(RemoveEmulationPreventionBytes(bytestring(escaped.begin(), escaped.begin() + escapedOffset),
+                                                      std::min<size_t>(start, escapedOffset), escapedOffset)
+                        == bytestring(data.begin(), data.begin() + offset));
+            }
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#include "CatalogSnapshots.h"
+#include "Files.h"
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <thread>
+
+using namespace tasm;
+
+class CatalogSnapshotsTestFixture : public testing::Test {
+public:
+    CatalogSnapshotsTestFixture() {}
+};
+
+TEST_F(CatalogSnapshotsTestFixture, testWriterWaitsForUnpublishedWrite) {
+    TiledEntry entry("catalog-snapshots-write-lock");
+    std::optional<CatalogSnapshots::WriteLock> firstWriter(CatalogSnapshots::instance().lockForWriting(entry));
+
+    // Start a write that has not been published yet.
+    auto directory = TileFiles::directoryForTilesInFrames(entry, 0, 29);
+    std::experimental::filesystem::create_directory(directory);
+
+    std::atomic<bool> secondWriterStarted(false);
+    std::thread secondWriter([&] {
+        TiledEntry sameEntry("catalog-snapshots-write-lock");
+        auto writeLock = CatalogSnapshots::instance().lockForWriting(sameEntry);
+        secondWriterStarted = true;
+    });
+
+    // The second writer must not discard the first writer's directory while it is still writing.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    assert(!secondWriterStarted);
+    assert(std::experimental::filesystem::exists(directory));
+
+    // Once the first writer stops without publishing, its directory is left over and is discarded.
+    firstWriter.reset();
+    secondWriter.join();
+    assert(secondWriterStarted);
+    assert(!std::experimental::filesystem::exists(directory));
+}
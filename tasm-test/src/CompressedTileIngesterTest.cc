@@ -0,0 +1,132 @@
+#include "CompressedTileIngester.h"
+#include "DecodeReader.h"
+#include "EncodedData.h"
+#include "Files.h"
+#include "MP4Reader.h"
+#include "SoftwareVideoDecoder.h"
+#include "VideoManager.h"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iterator>
+
+using namespace tasm;
+
+namespace {
+
+std::vector<CPUFramePtr> decode(const std::vector<char> &data) {
+    // The configuration is only read by the GPU decoder.
+    CPUEncodedFrameData encodedData(Configuration{}, DecodeReaderPacket(data));
+    SoftwareVideoDecoder decoder;
+    std::vector<CPUFramePtr> frames;
+    decoder.decode(encodedData, frames);
+    decoder.flush(frames);
+    return frames;
+}
+
+std::vector<CPUFramePtr> decodeFile(const std::experimental::filesystem::path &path) {
+    if (path.extension() != ".mp4") {
+        std::ifstream file(path, std::ios::binary);
+        return decode(std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()));
+    }
+
+    MP4Reader reader(path);
+    return decode(*reader.dataForSamples(1, reader.numberOfSamples()));
+}
+
+bool lumaMatches(const CPUDecodedFrame &tile, const CPUDecodedFrame &frame, const Rectangle &rectangle) {
+    for (auto row = 0u; row < rectangle.height; ++row) {
+        for (auto column = 0u; column < rectangle.width; ++column) {
+            if (tile.luma()[row * tile.pitch() + column] != frame.luma()[(rectangle.y + row) * frame.pitch() + rectangle.x + column])
+                return false;
+        }
+    }
+    return true;
+}
+
+// The published tile directories of a stored video, in frame order.
+std::vector<std::experimental::filesystem::path> publishedDirectories(const std::string &name) {
+    TiledEntry entry(name);
+    std::vector<std::experimental::filesystem::path> directories;
+    for (auto &dir : std::experimental::filesystem::directory_iterator(entry.path())) {
+        if (std::experimental::filesystem::is_directory(dir.status())
+                && !TileFiles::isObsoleteDirectory(dir.path())
+                && TileFiles::tileVersionFromPath(dir.path()) < entry.loadPublishedTileVersion())
+            directories.push_back(dir.path());
+    }
+    std::sort(directories.begin(), directories.end(), [](const auto &first, const auto &second) {
+        return TileFiles::firstAndLastFramesFromPath(first).first < TileFiles::firstAndLastFramesFromPath(second).first;
+    });
+    return directories;
+}
+
+// Encoded with 2x2 motion-constrained tiles, no loop filtering across tiles, and no B-frames.
+const std::string TiledSourcePath = "/home/maureen/home_videos/birds-2x2-mcts.hevc";
+// Encoded like TiledSourcePath, but with B-frames that are output out of decoding order.
+const std::string ReorderedSourcePath = "/home/maureen/home_videos/birds-2x2-mcts-bframes.hevc";
+
+} // namespace
+
+class CompressedTileIngesterTestFixture : public testing::Test {
+public:
+    CompressedTileIngesterTestFixture() {}
+};
+
+TEST_F(CompressedTileIngesterTestFixture, testIngestMatchesSource) {
+    auto video = std::make_shared<Video>(TiledSourcePath);
+    CompressedTileIngester ingester(video, "birds-2x2-ingested");
+    auto layout = ingester.sourceTileLayout();
+    assert(layout);
+    assert(layout->numberOfTiles() == 4);
+    ingester.ingest();
+
+    auto source = decodeFile(TiledSourcePath);
+    auto directories = publishedDirectories("birds-2x2-ingested");
+    // Each GOP of the source is written to its own directory.
+    assert(directories.size() > 1);
+
+    auto nextFrame = 0u;
+    for (auto &directory : directories) {
+        auto frames = TileFiles::firstAndLastFramesFromPath(directory);
+        assert(frames.first == nextFrame);
+        nextFrame = frames.second + 1;
+
+        for (auto tile = 0u; tile < layout->numberOfTiles(); ++tile) {
+            auto decoded = decodeFile(TileFiles::tileFilename(directory, tile));
+            assert(decoded.size() == frames.second - frames.first + 1);
+
+            // The tiles are motion-constrained, so each decodes exactly as its region of the source does.
+            for (auto i = 0u; i < decoded.size(); ++i)
+                assert(lumaMatches(*decoded[i], *source[frames.first + i], layout->rectangleForTile(tile)));
+        }
+    }
+    assert(nextFrame == source.size());
+}
+
+TEST_F(CompressedTileIngesterTestFixture, testReorderedSourceIsNotIngested) {
+    auto video = std::make_shared<Video>(ReorderedSourcePath);
+    CompressedTileIngester ingester(video, "birds-2x2-reordered");
+    assert(!ingester.sourceTileLayout());
+}
+
+TEST_F(CompressedTileIngesterTestFixture, testUniformStoreFallsBackToReencoding) {
+    EnvironmentConfiguration::instance(EnvironmentConfiguration(std::unordered_map<std::string, std::string>{
+        {EnvironmentConfiguration::IngestTiledSources, "true"},
+    }));
+
+    VideoManager manager;
+    manager.storeWithUniformLayout(ReorderedSourcePath, "birds-2x2-reencoded", 2, 2);
+
+    // Re-encoding stores every frame, even though the source's tiles could not be extracted.
+    auto numberOfFrames = 0u;
+    for (auto &directory : publishedDirectories("birds-2x2-reencoded")) {
+        auto frames = TileFiles::firstAndLastFramesFromPath(directory);
+        assert(decodeFile(TileFiles::tileFilename(directory, 0)).size() == frames.second - frames.first + 1);
+        numberOfFrames += frames.second - frames.first + 1;
+    }
+    assert(numberOfFrames == decodeFile(ReorderedSourcePath).size());
+
+    EnvironmentConfiguration::instance(EnvironmentConfiguration());
+}
@@ -0,0 +1,102 @@
+#include "DecodeReader.h"
+#include "EncodedData.h"
+#include "EncodedGOPCache.h"
+#include "SoftwareVideoDecoder.h"
+#include "StitchedGOPPipeline.h"
+#include <gtest/gtest.h>
+
+#include <cassert>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+
+using namespace tasm;
+
+class EncodedGOPCacheTestFixture : public testing::Test {
+public:
+    EncodedGOPCacheTestFixture() {}
+};
+
+static EncodedGOPCache::Data makeData(unsigned int size) {
+    return std::make_shared<const std::vector<char>>(size, 'a');
+}
+
+TEST_F(EncodedGOPCacheTestFixture, testEvictsLeastRecentlyUsed) {
+    EncodedGOPCache cache(100);
+    EncodedGOPKey first{"video/0-29-0/orig-tile-0.mp4", 0, 1, 30};
+    EncodedGOPKey second{"video/0-29-0/orig-tile-1.mp4", 0, 1, 30};
+    EncodedGOPKey third{"video/0-29-0/orig-tile-2.mp4", 0, 1, 30};
+
+    cache.put(first, makeData(40));
+    cache.put(second, makeData(40));
+    assert(cache.get(first));
+
+    // Inserting the third entry should evict the second, which was used least recently.
+    cache.put(third, makeData(40));
+    assert(cache.get(first));
+    assert(!cache.get(second));
+    assert(cache.get(third));
+
+    auto stats = cache.statistics();
+    assert(stats.hits == 3);
+    assert(stats.misses == 1);
+    assert(stats.bytesCached == 80);
+    assert(stats.bytesEvicted == 40);
+    assert(stats.numberOfEntries == 2);
+}
+
+TEST_F(EncodedGOPCacheTestFixture, testKeyIncludesVersionAndSamples) {
+    EncodedGOPCache cache(100);
+    cache.put({"video/0-29-1/orig-tile-0.mp4", 1, 1, 30}, makeData(10));
+
+    assert(!cache.get({"video/0-29-1/orig-tile-0.mp4", 2, 1, 30}));
+    assert(!cache.get({"video/0-29-1/orig-tile-0.mp4", 1, 1, 15}));
+    assert(cache.get({"video/0-29-1/orig-tile-0.mp4", 1, 1, 30}));
+}
+
+TEST_F(EncodedGOPCacheTestFixture, testInvalidateDirectory) {
+    EncodedGOPCache cache(100);
+    cache.put({"video/0-29-1/orig-tile-0.mp4", 1, 1, 30}, makeData(10));
+    cache.put({"video/30-59-1/orig-tile-0.mp4", 1, 1, 30}, makeData(10));
+
+    cache.invalidateDirectory("video/0-29-1");
+    assert(!cache.get({"video/0-29-1/orig-tile-0.mp4", 1, 1, 30}));
+    assert(cache.get({"video/30-59-1/orig-tile-0.mp4", 1, 1, 30}));
+    assert(cache.statistics().bytesCached == 10);
+}
+
+TEST_F(EncodedGOPCacheTestFixture, testTileVersionForTileFile) {
+    assert(EncodedGOPCache::tileVersionForTileFile("resources/video/0-29-3/orig-tile-0.mp4") == 3);
+    assert(EncodedGOPCache::tileVersionForTileFile("resources/video.mp4") == 0);
+}
+
+TEST_F(EncodedGOPCacheTestFixture, testMarkingFramesCopiesCachedData) {
+    std::ifstream file("/home/maureen/home_videos/birds-gop.hevc", std::ios::binary);
+    assert(file);
+    EncodedGOPCache cache(1024 * 1024 * 1024);
+    EncodedGOPKey key{"video/0-29-0/orig-tile-0.mp4", 0, 1, 30};
+    cache.put(key, std::make_shared<const std::vector<char>>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()));
+    auto cached = cache.get(key);
+    auto original = *cached;
+
+    // The configuration is only read by the GPU decoder.
+    CPUEncodedFrameData encodedData(Configuration{}, DecodeReaderPacket(cached));
+    SoftwareVideoDecoder decoder;
+    std::vector<CPUFramePtr> frames;
+    decoder.decode(encodedData, frames);
+    decoder.flush(frames);
+    auto numberOfFrames = static_cast<unsigned int>(frames.size());
+    assert(numberOfFrames > 1);
+
+    // When every frame is output, the cached data is used as-is.
+    std::vector<int> allFrames(numberOfFrames);
+    std::iota(allFrames.begin(), allFrames.end(), 0);
+    auto gopData = cached;
+    assert(!markFramesToOutput(gopData, 0, numberOfFrames, allFrames));
+    assert(gopData == cached);
+
+    // Otherwise only a copy is marked, so later readers of the cache still see every frame.
+    assert(markFramesToOutput(gopData, 0, numberOfFrames, {0}));
+    assert(gopData != cached);
+    assert(*cache.get(key) == original);
+}
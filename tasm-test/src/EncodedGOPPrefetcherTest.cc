@@ -0,0 +1,83 @@
+#include "EncodedGOPPrefetcher.h"
+#include <gtest/gtest.h>
+
+#include <cassert>
+#include <chrono>
+#include <thread>
+
+using namespace tasm;
+
+namespace {
+
+const std::string VideoPath = "/home/maureen/NFLX_dataset/BirdsInCage_hevc.mp4";
+
+// Each request reads the GOP that contains one frame, so the requests are for different GOPs of the same file.
+std::vector<TileReadRequest> requestsForFrames(const std::vector<int> &frames) {
+    std::vector<TileReadRequest> requests;
+    for (auto frame : frames)
+        requests.push_back({VideoPath, std::make_shared<std::vector<int>>(1, frame), 0, true});
+    return requests;
+}
+
+} // namespace
+
+class EncodedGOPPrefetcherTestFixture : public testing::Test {
+public:
+    EncodedGOPPrefetcherTestFixture() {}
+};
+
+TEST_F(EncodedGOPPrefetcherTestFixture, testGOPsAreReturnedInRequestOrder) {
+    std::vector<int> frames{0, 30, 60, 90, 120, 150, 180, 210};
+    auto requests = requestsForFrames(frames);
+    // Several threads read the requests at once, but the consumer sees the order of a single reader.
+    EncodedGOPPrefetcher prefetcher(requestsForFrames(frames), 2, 4);
+
+    for (auto i = 0u; i < requests.size(); ++i) {
+        EncodedFrameReader reader(requests[i].filename, requests[i].framesToRead, requests[i].frameOffsetInFile, requests[i].shouldReadEntireGOPs);
+        while (!reader.isEos()) {
+            auto expected = reader.read();
+            auto gop = prefetcher.next();
+            assert(gop.has_value());
+            assert(gop->requestIndex == i);
+            assert(gop->packet.firstFrameIndex() == expected->firstFrameIndex());
+            assert(gop->packet.numberOfFrames() == expected->numberOfFrames());
+            assert(*gop->packet.data() == *expected->data());
+        }
+    }
+    assert(!prefetcher.next().has_value());
+}
+
+TEST_F(EncodedGOPPrefetcherTestFixture, testBufferedGOPsAreBounded) {
+    const unsigned int depth = 2;
+    std::vector<int> frames{0, 30, 60, 90, 120, 150, 180, 210};
+    EncodedGOPPrefetcher prefetcher(requestsForFrames(frames), depth, 4);
+
+    // Give the threads time to read as far ahead as they are allowed to.
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    // Each request has one GOP, so at most one GOP of the request being consumed is buffered beyond the depth.
+    assert(prefetcher.maxNumberOfBufferedGOPs() >= depth);
+    assert(prefetcher.maxNumberOfBufferedGOPs() <= depth + 1);
+
+    auto numberOfGOPs = 0u;
+    while (prefetcher.next()) {
+        ++numberOfGOPs;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    assert(numberOfGOPs == frames.size());
+    assert(prefetcher.maxNumberOfBufferedGOPs() <= depth + 1);
+}
+
+TEST_F(EncodedGOPPrefetcherTestFixture, testReadErrorIsThrownByNext) {
+    auto requests = requestsForFrames({0, 30});
+    requests.push_back({"/tmp/does-not-exist.mp4", std::make_shared<std::vector<int>>(1, 0), 0, true});
+    EncodedGOPPrefetcher prefetcher(std::move(requests), 2, 2);
+
+    // The error is raised by the consumer's thread rather than ending the sequence early.
+    bool didThrow = false;
+    try {
+        while (prefetcher.next()) {}
+    } catch (const std::runtime_error &) {
+        didThrow = true;
+    }
+    assert(didThrow);
+}
@@ -0,0 +1,92 @@
+#include "DecodeReader.h"
+#include "EncodedData.h"
+#include "Gpac.h"
+#include "MP4Reader.h"
+#include "SoftwareVideoDecoder.h"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iterator>
+
+using namespace tasm;
+
+namespace {
+
+std::vector<char> readFile(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    assert(file);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+std::vector<unsigned long long> decodedChecksums(const std::vector<char> &data) {
+    // The configuration is only read by the GPU decoder.
+    CPUEncodedFrameData encodedData(Configuration{}, DecodeReaderPacket(data));
+    SoftwareVideoDecoder decoder;
+    std::vector<CPUFramePtr> frames;
+    decoder.decode(encodedData, frames);
+    decoder.flush(frames);
+
+    std::vector<unsigned long long> checksums;
+    for (const auto &frame : frames) {
+        unsigned long long checksum = 0;
+        for (auto row = 0u; row < frame->height(); ++row) {
+            for (auto column = 0u; column < frame->width(); ++column)
+                checksum = checksum * 31 + frame->luma()[row * frame->pitch() + column];
+        }
+        checksums.push_back(checksum);
+    }
+    return checksums;
+}
+
+// Splits data into chunks of chunkSize bytes, so that NALs and start codes span chunks.
+gpac::EncodedChunks chunksOf(const std::vector<char> &data, size_t chunkSize) {
+    gpac::EncodedChunks chunks;
+    for (auto offset = 0u; offset < data.size(); offset += chunkSize) {
+        auto end = std::min(data.size(), offset + chunkSize);
+        chunks.push_back(std::make_unique<std::vector<char>>(data.begin() + offset, data.begin() + end));
+    }
+    return chunks;
+}
+
+// One GOP without B-frames.
+const std::string GOPPath = "/home/maureen/home_videos/birds-gop.hevc";
+// Encoded with B-frames that are output out of decoding order.
+const std::string ReorderedPath = "/home/maureen/home_videos/birds-2x2-mcts-bframes.hevc";
+const std::string MuxedPath = "gpac-test-muxed.mp4";
+
+} // namespace
+
+class GpacTestFixture : public testing::Test {
+public:
+    GpacTestFixture() {}
+};
+
+TEST_F(GpacTestFixture, testMuxFromMemoryRoundTrips) {
+    auto data = readFile(GOPPath);
+    auto expected = decodedChecksums(data);
+    assert(!expected.empty());
+
+    for (auto chunkSize : {1ul, 7ul, 4096ul, data.size()}) {
+        auto chunks = chunksOf(data, chunkSize);
+        gpac::mux_hevc_from_memory({&chunks}, 30, MuxedPath);
+
+        MP4Reader reader(MuxedPath);
+        assert(reader.numberOfSamples() == expected.size());
+        assert(decodedChecksums(*reader.dataForSamples(1, reader.numberOfSamples())) == expected);
+    }
+    std::experimental::filesystem::remove(MuxedPath);
+}
+
+TEST_F(GpacTestFixture, testMuxRejectsReorderedPictures) {
+    auto chunks = chunksOf(readFile(ReorderedPath), 4096);
+    auto threw = false;
+    try {
+        gpac::mux_hevc_from_memory({&chunks}, 30, MuxedPath);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    std::experimental::filesystem::remove(MuxedPath);
+}
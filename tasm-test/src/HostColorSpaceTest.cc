@@ -0,0 +1,106 @@
+#include "HostColorSpace.h"
+#include <gtest/gtest.h>
+
+#include <cassert>
+#include <optional>
+#include <random>
+#include <vector>
+
+using namespace tasm;
+
+namespace {
+
+// A frame whose pitch is wider than the frame, with random luma and chroma.
+struct Nv12Frame {
+    Nv12Frame(std::mt19937 &generator, unsigned int width, unsigned int height, unsigned int pitch)
+        : width(width),
+        height(height),
+        pitch(pitch),
+        luma(pitch * height),
+        chroma(pitch * ((height + 1) / 2))
+    {
+        std::uniform_int_distribution<int> distribution(0, 255);
+        for (auto &value : luma)
+            value = distribution(generator);
+        for (auto &value : chroma)
+            value = distribution(generator);
+    }
+
+    unsigned int width;
+    unsigned int height;
+    unsigned int pitch;
+    std::vector<uint8_t> luma;
+    std::vector<uint8_t> chroma;
+};
+
+const unsigned int RGBAPadding = 12;
+
+// Converts a region into a destination with padding at the end of each row, which must be left untouched.
+// Without a kernel, the region is converted with the kernel that Nv12ToRGBA picks.
+std::vector<uint8_t> convert(const Nv12Frame &frame, unsigned int xOffset, unsigned int yOffset,
+                             unsigned int width, unsigned int height, std::optional<ColorConversionKernel> kernel) {
+    static const uint8_t padding = 0xa5;
+    auto rgbaPitch = 4 * width + RGBAPadding;
+    std::vector<uint8_t> rgba(rgbaPitch * height, padding);
+    if (kernel)
+        Nv12ToRGBA(frame.luma.data(), frame.chroma.data(), frame.pitch, xOffset, yOffset, width, height, rgba.data(), rgbaPitch, *kernel);
+    else
+        Nv12ToRGBA(frame.luma.data(), frame.chroma.data(), frame.pitch, xOffset, yOffset, width, height, rgba.data(), rgbaPitch);
+
+    for (auto row = 0u; row < height; ++row) {
+        for (auto column = 4 * width; column < rgbaPitch; ++column)
+            assert(rgba[row * rgbaPitch + column] == padding);
+    }
+    return rgba;
+}
+
+// Every supported kernel, and the default one. Without the AVX2 kernel, the default has to be the scalar kernel.
+std::vector<std::optional<ColorConversionKernel>> kernelsToCompare() {
+    std::vector<std::optional<ColorConversionKernel>> kernels{std::nullopt, ColorConversionKernel::Scalar};
+    if (IsColorConversionKernelSupported(ColorConversionKernel::AVX2))
+        kernels.push_back(ColorConversionKernel::AVX2);
+    return kernels;
+}
+
+} // namespace
+
+class HostColorSpaceTestFixture : public testing::Test {
+public:
+    HostColorSpaceTestFixture() {}
+};
+
+TEST_F(HostColorSpaceTestFixture, testKernelsProduceIdenticalPixels) {
+    std::mt19937 generator(45);
+    Nv12Frame frame(generator, 120, 66, 128);
+    std::uniform_int_distribution<unsigned int> offsets(0, 40);
+    for (auto i = 0u; i < 200; ++i) {
+        auto xOffset = offsets(generator);
+        auto yOffset = offsets(generator);
+        // Widths cover every tail length after the eight-pixel vectors, and crops that are narrower than one vector.
+        auto width = std::uniform_int_distribution<unsigned int>(1, frame.width - xOffset)(generator);
+        auto height = std::uniform_int_distribution<unsigned int>(1, frame.height - yOffset)(generator);
+
+        auto expected = convert(frame, xOffset, yOffset, width, height, ColorConversionKernel::Scalar);
+        for (auto kernel : kernelsToCompare())
+            assert(convert(frame, xOffset, yOffset, width, height, kernel) == expected);
+    }
+}
+
+TEST_F(HostColorSpaceTestFixture, testOddOffsetsUseTheCoveringChroma) {
+    // Each pixel uses the chroma pair that covers its column in the frame, not its column in the crop.
+    std::mt19937 generator(709);
+    Nv12Frame frame(generator, 64, 8, 64);
+    auto whole = convert(frame, 0, 0, frame.width, frame.height, ColorConversionKernel::Scalar);
+    const unsigned int width = 33;
+    const unsigned int height = 5;
+    for (auto xOffset : {1u, 3u, 7u, 9u}) {
+        for (auto kernel : kernelsToCompare()) {
+            auto cropped = convert(frame, xOffset, 1, width, height, kernel);
+            for (auto row = 0u; row < height; ++row) {
+                auto croppedRow = cropped.begin() + row * (4 * width + RGBAPadding);
+                auto wholeRow = whole.begin() + (row + 1) * (4 * frame.width + RGBAPadding) + 4 * xOffset;
+                assert(std::equal(croppedRow, croppedRow + 4 * width, wholeRow));
+            }
+        }
+    }
+}
@@ -0,0 +1,134 @@
+#include "ImageBatch.h"
+#include "ImagePrefetcher.h"
+#include <gtest/gtest.h>
+
+#include <cassert>
+#include <cstring>
+
+using namespace tasm;
+
+namespace {
+
+// Returns each image in its own set.
+class ImagesOperator : public Operator<std::unique_ptr<std::vector<ImagePtr>>> {
+public:
+    ImagesOperator(std::vector<ImagePtr> images)
+        : images_(std::move(images)), index_(0)
+    {}
+
+    bool isComplete() override { return index_ == images_.size(); }
+
+    std::optional<std::unique_ptr<std::vector<ImagePtr>>> next() override {
+        if (isComplete())
+            return std::nullopt;
+        return std::make_unique<std::vector<ImagePtr>>(1, images_[index_++]);
+    }
+
+private:
+    std::vector<ImagePtr> images_;
+    unsigned int index_;
+};
+
+ImagePtr makeImage(unsigned int width, unsigned int height, PixelFormat format, uint8_t value, int frameNumber) {
+    auto size = PixelFormatSize(format, width, height);
+    PooledBuffer pixels(new uint8_t[size]);
+    memset(pixels.get(), value, size);
+    return std::make_shared<Image>(width, height, std::move(pixels), format, frameNumber, 10, 20);
+}
+
+ImageBatcher makeBatcher(std::vector<ImagePtr> images, PixelFormat format) {
+    auto op = std::make_shared<ImagesOperator>(std::move(images));
+    return ImageBatcher(std::make_shared<ImageIterator>(op, format));
+}
+
+} // namespace
+
+class ImageBatchTestFixture : public testing::Test {
+public:
+    ImageBatchTestFixture() {}
+};
+
+TEST_F(ImageBatchTestFixture, testBatchesStopAtSizeChanges) {
+    auto batcher = makeBatcher({
+        makeImage(4, 2, PixelFormat::RGB, 1, 0),
+        makeImage(4, 2, PixelFormat::RGB, 2, 1),
+        makeImage(3, 3, PixelFormat::RGB, 3, 2),
+    }, PixelFormat::RGB);
+
+    auto first = batcher.next(8);
+    assert(first.numberOfImages == 2);
+    assert(first.width == 4);
+    assert(first.height == 2);
+    assert(first.frameNumbers == std::vector<int>({0, 1}));
+    assert(first.boxes == std::vector<unsigned int>({10, 20, 14, 22, 10, 20, 14, 22}));
+    assert(first.pixels[0] == 1);
+    assert(first.pixels[first.imageSize()] == 2);
+
+    auto second = batcher.next(8);
+    assert(second.numberOfImages == 1);
+    assert(second.width == 3);
+    assert(second.frameNumbers == std::vector<int>({2}));
+
+    auto last = batcher.next(8);
+    assert(last.numberOfImages == 0);
+    assert(!last.pixels);
+}
+
+TEST_F(ImageBatchTestFixture, testResizeLetterboxes) {
+    auto batcher = makeBatcher({
+        makeImage(8, 4, PixelFormat::Gray, 200, 0),
+        makeImage(2, 2, PixelFormat::Gray, 100, 1),
+    }, PixelFormat::Gray);
+
+    auto batch = batcher.next(2, 4, 4);
+    assert(batch.numberOfImages == 2);
+    assert(batch.width == 4);
+    assert(batch.height == 4);
+
+    // The wide image is scaled to 4x2 and centered vertically.
+    auto wide = batch.pixels.get();
+    for (auto row = 0u; row < 4; ++row) {
+        for (auto column = 0u; column < 4; ++column)
+            assert(wide[row * 4 + column] == (row == 1 || row == 2 ? 200 : 0));
+    }
+
+    // The square image fills the whole batch image.
+    auto square = batch.pixels.get() + batch.imageSize();
+    for (auto i = 0u; i < 16; ++i)
+        assert(square[i] == 100);
+
+    // Boxes are in frame coordinates, before resizing.
+    assert(batch.boxes == std::vector<unsigned int>({10, 20, 18, 24, 10, 20, 12, 22}));
+}
+
+TEST_F(ImageBatchTestFixture, testNextImageReturnsPendingImage) {
+    auto batcher = makeBatcher({
+        makeImage(2, 2, PixelFormat::RGBA, 1, 0),
+        makeImage(4, 4, PixelFormat::RGBA, 2, 1),
+    }, PixelFormat::RGBA);
+
+    assert(batcher.next(4).numberOfImages == 1);
+    auto image = batcher.nextImage();
+    assert(image);
+    assert(image->frameNumber() == 1);
+    assert(!batcher.nextImage());
+}
+
+TEST_F(ImageBatchTestFixture, testPrefetcherPreservesOrder) {
+    std::vector<ImagePtr> images;
+    for (auto i = 0; i < 20; ++i)
+        images.push_back(makeImage(2, 2, PixelFormat::Gray, i, i));
+    auto op = std::make_shared<ImagesOperator>(std::move(images));
+    auto prefetcher = std::make_shared<ImagePrefetcher>(std::make_shared<ImageIterator>(op, PixelFormat::Gray), 3);
+
+    ImageBatcher batcher([prefetcher] { return prefetcher->next(); }, prefetcher->format());
+    auto batch = batcher.next(16);
+    assert(batch.numberOfImages == 16);
+    for (auto i = 0; i < 16; ++i)
+        assert(batch.frameNumbers[i] == i);
+
+    for (auto i = 16; i < 20; ++i)
+        assert(batcher.nextImage()->frameNumber() == i);
+    assert(!batcher.nextImage());
+    assert(!prefetcher->next());
+}
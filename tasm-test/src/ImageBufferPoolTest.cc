@@ -0,0 +1,58 @@
+#include "ImageBufferPool.h"
+#include <gtest/gtest.h>
+
+#include <cassert>
+
+using namespace tasm;
+
+class ImageBufferPoolTestFixture : public testing::Test {
+public:
+    ImageBufferPoolTestFixture() {}
+};
+
+TEST_F(ImageBufferPoolTestFixture, testSizeClasses) {
+    assert(ImageBufferPool::sizeForClass(ImageBufferPool::sizeClassForSize(1)) == 256);
+    assert(ImageBufferPool::sizeForClass(ImageBufferPool::sizeClassForSize(256)) == 256);
+    assert(ImageBufferPool::sizeForClass(ImageBufferPool::sizeClassForSize(257)) == 320);
+    assert(ImageBufferPool::sizeForClass(ImageBufferPool::sizeClassForSize(512)) == 512);
+    assert(ImageBufferPool::sizeForClass(ImageBufferPool::sizeClassForSize(513)) == 640);
+
+    for (auto size = 1ull; size < 1000000; size += 997) {
+        auto classSize = ImageBufferPool::sizeForClass(ImageBufferPool::sizeClassForSize(size));
+        assert(classSize >= size);
+        assert(size <= 256 || classSize <= size * 5 / 4);
+    }
+}
+
+TEST_F(ImageBufferPoolTestFixture, testReusesReleasedBuffers) {
+    ImageBufferPool pool(1024 * 1024);
+    auto first = pool.allocate(1000);
+    auto firstBuffer = first.get();
+    first.reset();
+
+    // A request in the same size class gets the released buffer back.
+    auto second = pool.allocate(900);
+    assert(second.get() == firstBuffer);
+
+    auto stats = pool.statistics();
+    assert(stats.allocations == 1);
+    assert(stats.reuses == 1);
+    assert(stats.bytesInUse == 1024);
+    assert(stats.bytesPooled == 0);
+}
+
+TEST_F(ImageBufferPoolTestFixture, testFreesBuffersBeyondCapacity) {
+    ImageBufferPool pool(1024);
+    {
+        auto first = pool.allocate(1024);
+        auto second = pool.allocate(1024);
+    }
+
+    // Only one of the buffers fits in the pool.
+    auto stats = pool.statistics();
+    assert(stats.bytesInUse == 0);
+    assert(stats.bytesPooled == 1024);
+
+    pool.setCapacity(0);
+    assert(pool.statistics().bytesPooled == 0);
+}
@@ -0,0 +1,105 @@
+#include "NalType.h"
+#include "SoftwareVideoDecoder.h"
+#include "Stitcher.h"
+#include <gtest/gtest.h>
+
+#include <cassert>
+#include <fstream>
+#include <iterator>
+
+using namespace tasm;
+
+namespace {
+
+stitching::bytestring readFile(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    assert(file);
+    return stitching::bytestring(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// The nals of Annex B data, without their start codes or trailing zero bytes.
+std::vector<stitching::bytestring_view> splitNals(const stitching::bytestring &bytes) {
+    static const stitching::bytestring_view startCode("\0\0\1", 3);
+    stitching::bytestring_view data(bytes.data(), bytes.size());
+    std::vector<stitching::bytestring_view> nals;
+    auto start = data.find(startCode);
+    while (start != stitching::bytestring_view::npos) {
+        start += startCode.size();
+        auto end = data.find(startCode, start);
+        auto nal = data.substr(start, end == stitching::bytestring_view::npos ? stitching::bytestring_view::npos : end - start);
+        nals.push_back(nal.substr(0, nal.find_last_not_of('\0') + 1));
+        start = end;
+    }
+    return nals;
+}
+
+std::vector<unsigned long long> decodedChecksums(const stitching::bytestring &data) {
+    SoftwareVideoDecoder decoder;
+    std::vector<CPUFramePtr> frames;
+    decoder.decode(reinterpret_cast<const uint8_t *>(data.data()), data.size(), {}, -1, frames);
+    decoder.flush(frames);
+
+    std::vector<unsigned long long> checksums;
+    for (const auto &frame : frames) {
+        unsigned long long checksum = 0;
+        for (auto row = 0u; row < frame->height(); ++row) {
+            for (auto column = 0u; column < frame->width(); ++column)
+                checksum = checksum * 31 + frame->luma()[row * frame->pitch() + column];
+        }
+        checksums.push_back(checksum);
+    }
+    return checksums;
+}
+
+// One GOP without B-frames, so frames are numbered in decoding order.
+const std::string GOPPath = "/home/maureen/home_videos/birds-gop.hevc";
+// Slice segment headers of the GOP are shorter than this, so the rest of each slice segment is its slice data.
+const size_t MaximumSliceSegmentHeaderSize = 16;
+
+} // namespace
+
+class PicOutputFlagTestFixture : public testing::Test {
+public:
+    PicOutputFlagTestFixture() {}
+};
+
+TEST_F(PicOutputFlagTestFixture, testOnlyKeptFramesAreOutput) {
+    auto original = readFile(GOPPath);
+    auto expected = decodedChecksums(original);
+    assert(expected.size() > 5);
+
+    // Frames are numbered from the GOP's first frame.
+    const int firstFrameIndex = 30;
+    std::vector<int> framesToOutput{firstFrameIndex, firstFrameIndex + 2, firstFrameIndex + 3, firstFrameIndex + static_cast<int>(expected.size()) - 1};
+    std::unordered_set<int> framesToKeep(framesToOutput.begin(), framesToOutput.end());
+    auto marked = original;
+    stitching::PicOutputFlagAdder adder(framesToKeep);
+    adder.addPicOutputFlagToGOP(marked, firstFrameIndex, framesToKeep);
+
+    // The pictures that are not kept are still decoded as references, so the kept ones are unchanged.
+    auto checksums = decodedChecksums(marked);
+    assert(checksums.size() == framesToOutput.size());
+    for (auto i = 0u; i < checksums.size(); ++i)
+        assert(checksums[i] == expected[framesToOutput[i] - firstFrameIndex]);
+
+    // Only the PPSs and slice segment headers are rewritten.
+    auto originalNals = splitNals(original);
+    auto markedNals = splitNals(marked);
+    assert(originalNals.size() == markedNals.size());
+    for (auto i = 0u; i < originalNals.size(); ++i) {
+        auto originalNal = originalNals[i];
+        auto markedNal = markedNals[i];
+        auto type = stitching::PeekType(originalNal);
+        assert(stitching::PeekType(markedNal) == type);
+        if (type == stitching::NalUnitPPS)
+            continue;
+        else if (type <= stitching::NalUnitReservedIRAPVCL23) {
+            assert(originalNal.size() > MaximumSliceSegmentHeaderSize);
+            auto sliceData = originalNal.substr(MaximumSliceSegmentHeaderSize);
+            assert(markedNal.size() >= sliceData.size());
+            assert(markedNal.compare(markedNal.size() - sliceData.size(), sliceData.size(), sliceData) == 0);
+        } else {
+            assert(markedNal == originalNal);
+        }
+    }
+}
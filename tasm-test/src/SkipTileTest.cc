@@ -0,0 +1,106 @@
+#include "DecodeReader.h"
+#include "EncodedData.h"
+#include "SkipTileGenerator.h"
+#include "SoftwareVideoDecoder.h"
+#include "Stitcher.h"
+#include <gtest/gtest.h>
+
+#include <cassert>
+#include <fstream>
+#include <iterator>
+
+using namespace tasm;
+
+namespace {
+
+std::shared_ptr<const stitching::bytestring> readTile(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    assert(file);
+    return std::make_shared<stitching::bytestring>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+std::vector<CPUFramePtr> decode(const std::vector<iovec> &data) {
+    // The configuration is only read by the GPU decoder.
+    CPUEncodedFrameData encodedData(Configuration{}, DecodeReaderPacket(data));
+    SoftwareVideoDecoder decoder;
+    std::vector<CPUFramePtr> frames;
+    decoder.decode(encodedData, frames);
+    decoder.flush(frames);
+    return frames;
+}
+
+std::vector<CPUFramePtr> decode(const stitching::bytestring &tile) {
+    return decode(std::vector<iovec>{{const_cast<char *>(tile.data()), tile.size()}});
+}
+
+std::vector<CPUFramePtr> stitchAndDecode(const stitching::StitchContext &context, std::vector<std::shared_ptr<const stitching::bytestring>> &tiles) {
+    stitching::StitchPlanCache cache;
+    stitching::Stitcher stitcher(context, tiles, cache);
+    // The segments refer to the tiles, which are still alive.
+    return decode(stitcher.StitchSegments().GetIovecs());
+}
+
+unsigned long long lumaChecksum(const CPUDecodedFrame &frame, unsigned int x, unsigned int y, unsigned int width, unsigned int height) {
+    unsigned long long checksum = 0;
+    for (auto row = 0u; row < height; ++row) {
+        for (auto column = 0u; column < width; ++column)
+            checksum = checksum * 31 + frame.luma()[(y + row) * frame.pitch() + x + column];
+    }
+    return checksum;
+}
+
+// One GOP of a tile that is coded at 1088x1920 and displayed at 1080x1920, so its conformance window crops the right edge.
+const std::string TilePath = "/home/maureen/home_videos/birds-gop.hevc";
+const unsigned int TileWidth = 1080;
+const unsigned int TileHeight = 1920;
+const unsigned int CodedTileWidth = 1088;
+
+// Stacks two tiles, so the skip tile is generated for the last row and must be cropped like the real tile.
+stitching::StitchContext stackedContext() {
+    return stitching::StitchContext({2, 1}, {2 * TileHeight, CodedTileWidth}, {2 * TileHeight, TileWidth}, false, {TileHeight / 32}, {});
+}
+
+} // namespace
+
+class SkipTileTestFixture : public testing::Test {
+public:
+    SkipTileTestFixture() {}
+};
+
+TEST_F(SkipTileTestFixture, testStitchRealAndSkipTiles) {
+    auto tile = readTile(TilePath);
+    auto expected = decode(*tile);
+    assert(!expected.empty());
+
+    std::vector<std::shared_ptr<const stitching::bytestring>> tiles{tile, nullptr};
+    assert(stitching::FillSkipTiles(stackedContext(), tiles) == 1);
+    auto frames = stitchAndDecode(stackedContext(), tiles);
+    assert(frames.size() == expected.size());
+
+    // The keyframe only predicts from within its tile, so the real tile decodes exactly as it does on its own.
+    assert(frames[0]->width() == TileWidth);
+    assert(frames[0]->height() == 2 * TileHeight);
+    assert(lumaChecksum(*frames[0], 0, 0, TileWidth, TileHeight) == lumaChecksum(*expected[0], 0, 0, TileWidth, TileHeight));
+
+    // Every frame of the skip tile copies the keyframe.
+    auto skipChecksum = lumaChecksum(*frames[0], 0, TileHeight, TileWidth, TileHeight);
+    for (const auto &frame : frames)
+        assert(lumaChecksum(*frame, 0, TileHeight, TileWidth, TileHeight) == skipChecksum);
+}
+
+TEST_F(SkipTileTestFixture, testStitchSkipTiles) {
+    auto tile = readTile(TilePath);
+    auto numberOfFrames = decode(*tile).size();
+
+    std::vector<std::shared_ptr<const stitching::bytestring>> generated{tile, nullptr};
+    stitching::FillSkipTiles(stackedContext(), generated);
+
+    // Both tiles were generated for the last row, but they are coded at the same size as the first.
+    std::vector<std::shared_ptr<const stitching::bytestring>> tiles{generated[1], generated[1]};
+    auto frames = stitchAndDecode(stackedContext(), tiles);
+    assert(frames.size() == numberOfFrames);
+
+    auto checksum = lumaChecksum(*frames[0], 0, 0, TileWidth, 2 * TileHeight);
+    for (const auto &frame : frames)
+        assert(lumaChecksum(*frame, 0, 0, TileWidth, 2 * TileHeight) == checksum);
+}
@@ -0,0 +1,80 @@
+#include "SoftwareVideoDecoder.h"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+
+using namespace tasm;
+
+namespace {
+
+std::vector<char> readFile(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    assert(file);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Decodes the data in chunks of chunkSize bytes, so that pictures are reordered across calls to decode().
+std::vector<CPUFramePtr> decode(const std::vector<char> &data, size_t chunkSize, const std::vector<int> &outputFrames = {}) {
+    SoftwareVideoDecoder decoder;
+    std::vector<CPUFramePtr> frames;
+    for (auto offset = 0u; offset < data.size(); offset += chunkSize) {
+        auto size = std::min(chunkSize, data.size() - offset);
+        decoder.decode(reinterpret_cast<const uint8_t *>(data.data()) + offset, size,
+                       offset ? std::vector<int>{} : outputFrames, 0, frames);
+    }
+    decoder.flush(frames);
+    return frames;
+}
+
+unsigned long long lumaDifference(const CPUDecodedFrame &first, const CPUDecodedFrame &second) {
+    assert(first.width() == second.width());
+    assert(first.height() == second.height());
+
+    unsigned long long difference = 0;
+    for (auto row = 0u; row < first.height(); ++row) {
+        for (auto column = 0u; column < first.width(); ++column)
+            difference += std::abs(first.luma()[row * first.pitch() + column] - second.luma()[row * second.pitch() + column]);
+    }
+    return difference;
+}
+
+// Encoded with 2x2 motion-constrained tiles and no B-frames, so pictures are output in decoding order.
+const std::string InOrderPath = "/home/maureen/home_videos/birds-2x2-mcts.hevc";
+// Encoded from the same frames, but with B-frames that are output out of decoding order.
+const std::string ReorderedPath = "/home/maureen/home_videos/birds-2x2-mcts-bframes.hevc";
+
+} // namespace
+
+class SoftwareVideoDecoderTestFixture : public testing::Test {
+public:
+    SoftwareVideoDecoderTestFixture() {}
+};
+
+TEST_F(SoftwareVideoDecoderTestFixture, testBFramesAreOutputInDisplayOrder) {
+    auto expected = decode(readFile(InOrderPath), 4096);
+    auto data = readFile(ReorderedPath);
+    auto numberOfFrames = decode(data, data.size()).size();
+    assert(numberOfFrames == expected.size());
+
+    std::vector<int> outputFrames(numberOfFrames);
+    std::iota(outputFrames.begin(), outputFrames.end(), 0);
+    auto frames = decode(data, 4096, outputFrames);
+    assert(frames.size() == numberOfFrames);
+
+    for (auto i = 0u; i < frames.size(); ++i) {
+        // Frames are numbered in the order they are output.
+        assert(frames[i]->frameNumber() == static_cast<int>(i));
+
+        // Each frame looks more like the frame that is displayed at the same time than like its neighbors.
+        auto difference = lumaDifference(*frames[i], *expected[i]);
+        if (i)
+            assert(difference < lumaDifference(*frames[i], *expected[i - 1]));
+        if (i + 1 < expected.size())
+            assert(difference < lumaDifference(*frames[i], *expected[i + 1]));
+    }
+}
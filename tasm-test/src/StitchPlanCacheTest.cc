@@ -0,0 +1,65 @@
+#include "StitchPlan.h"
+#include "Stitcher.h"
+#include <gtest/gtest.h>
+
+#include <cassert>
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+std::shared_ptr<const stitching::bytestring> readTile(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    assert(file);
+    return std::make_shared<stitching::bytestring>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// One GOP of a tile that is coded at 1088x1920 and displayed at 1080x1920.
+const std::string TilePath = "/home/maureen/home_videos/birds-gop.hevc";
+
+// Contexts that only differ in their PPS id need different plans.
+void stitchWithPPSId(const std::shared_ptr<const stitching::bytestring> &tile, stitching::StitchPlanCache &cache, unsigned int ppsId) {
+    stitching::StitchContext context({1, 1}, {1920, 1088}, {1920, 1080}, false, {1920 / 32}, {}, ppsId);
+    std::vector<std::shared_ptr<const stitching::bytestring>> tiles{tile};
+    stitching::Stitcher stitcher(context, tiles, cache);
+    assert(!stitcher.StitchSegments().GetIovecs().empty());
+}
+
+} // namespace
+
+class StitchPlanCacheTestFixture : public testing::Test {
+public:
+    StitchPlanCacheTestFixture() {}
+};
+
+TEST_F(StitchPlanCacheTestFixture, testEvictsLeastRecentlyUsedPlan) {
+    auto tile = readTile(TilePath);
+    stitching::StitchPlanCache cache(2);
+
+    stitchWithPPSId(tile, cache, 1);
+    stitchWithPPSId(tile, cache, 2);
+    stitchWithPPSId(tile, cache, 1);
+    assert(cache.hits() == 1);
+
+    // The plan for PPS 2 was used least recently, so it is evicted.
+    stitchWithPPSId(tile, cache, 3);
+    assert(cache.size() == 2);
+    assert(cache.evictions() == 1);
+
+    stitchWithPPSId(tile, cache, 1);
+    assert(cache.hits() == 2);
+    stitchWithPPSId(tile, cache, 2);
+    assert(cache.misses() == 4);
+    assert(cache.evictions() == 2);
+}
+
+TEST_F(StitchPlanCacheTestFixture, testZeroSizeDoesNotCache) {
+    auto tile = readTile(TilePath);
+    stitching::StitchPlanCache cache(0);
+
+    stitchWithPPSId(tile, cache, 1);
+    stitchWithPPSId(tile, cache, 1);
+    assert(!cache.hits());
+    assert(cache.misses() == 2);
+    assert(!cache.size());
+}
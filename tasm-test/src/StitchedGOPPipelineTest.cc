@@ -0,0 +1,141 @@
+#include "MP4Reader.h"
+#include "StitchedGOPPipeline.h"
+#include "TileExtractor.h"
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cassert>
+#include <fstream>
+#include <iterator>
+
+using namespace tasm;
+
+namespace {
+
+// A single-tile video, so every group stitches one tile into a 1x1 layout.
+const std::string TilePath = "/home/maureen/lightdb-wip/cmake-build-debug-remote/test/resources/red10/1-0-stream.mp4";
+
+// Reads every frame of the tile as if it started at `firstFrame`, so each group's GOPs have distinct frame numbers.
+StitchGroup groupStartingAt(unsigned int firstFrame, unsigned int numberOfFrames) {
+    auto frames = std::make_shared<std::vector<int>>();
+    for (auto i = 0u; i < numberOfFrames; ++i)
+        frames->push_back(firstFrame + i);
+    auto framesToOutput = std::make_shared<const std::vector<int>>(*frames);
+
+    return StitchGroup{{{TilePath, frames, firstFrame, true}},
+                       stitching::StitchContext({1, 1}, {256, 320}, {240, 320}, false, {}, {}, 1),
+                       {240},
+                       {320},
+                       {},
+                       std::move(framesToOutput)};
+}
+
+const unsigned int FramesBetweenGroups = 1000;
+
+// One GOP of a tile that is coded at 1088x1920 and displayed at 1080x1920, so its width is not a multiple of its CTB size.
+const std::string UnalignedTilePath = "/home/maureen/home_videos/birds-gop.hevc";
+
+std::shared_ptr<const std::vector<char>> readFile(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    assert(file);
+    return std::make_shared<std::vector<char>>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+class StitchedGOPPipelineTestFixture : public testing::Test {
+public:
+    StitchedGOPPipelineTestFixture() {}
+};
+
+TEST_F(StitchedGOPPipelineTestFixture, testGroupsArePlannedAsTheyAreRead) {
+    auto numberOfFrames = MP4Reader(TilePath).numberOfSamples();
+    const unsigned int numberOfGroups = 8;
+    std::atomic<unsigned int> numberOfGroupsPlanned(0);
+    stitching::StitchPlanCache stitchPlans;
+
+    StitchedGOPPipeline pipeline([&]() -> std::optional<StitchGroup> {
+        if (numberOfGroupsPlanned == numberOfGroups)
+            return {};
+        return groupStartingAt(FramesBetweenGroups * numberOfGroupsPlanned++, numberOfFrames);
+    }, stitchPlans, 1, 4);
+
+    auto gop = pipeline.next();
+    assert(gop);
+    assert(gop->firstFrameIndex == 0);
+    // Only one GOP is read ahead, so the later groups have not been planned yet.
+    assert(numberOfGroupsPlanned < numberOfGroups);
+
+    // GOPs are stitched on several threads but returned in the order of their groups.
+    auto numberOfFramesReturned = gop->numberOfFrames;
+    auto lastFirstFrame = gop->firstFrameIndex;
+    while ((gop = pipeline.next())) {
+        assert(gop->firstFrameIndex > lastFirstFrame);
+        lastFirstFrame = gop->firstFrameIndex;
+        numberOfFramesReturned += gop->numberOfFrames;
+    }
+    assert(lastFirstFrame >= FramesBetweenGroups * (numberOfGroups - 1));
+    assert(numberOfFramesReturned == numberOfGroups * numberOfFrames);
+    assert(numberOfGroupsPlanned == numberOfGroups);
+}
+
+TEST_F(StitchedGOPPipelineTestFixture, testPlanningErrorIsRethrownAfterEarlierGOPs) {
+    auto numberOfFrames = MP4Reader(TilePath).numberOfSamples();
+    bool didPlanFirstGroup = false;
+    stitching::StitchPlanCache stitchPlans;
+
+    StitchedGOPPipeline pipeline([&]() -> std::optional<StitchGroup> {
+        if (didPlanFirstGroup)
+            throw std::runtime_error("Failed to plan group");
+        didPlanFirstGroup = true;
+        return groupStartingAt(0, numberOfFrames);
+    }, stitchPlans, 2, 4);
+
+    // Every GOP of the first group is returned before the failure to plan the second one.
+    auto numberOfFramesReturned = 0u;
+    auto threw = false;
+    try {
+        while (auto gop = pipeline.next())
+            numberOfFramesReturned += gop->numberOfFrames;
+    } catch (const std::runtime_error &error) {
+        threw = std::string(error.what()) == "Failed to plan group";
+    }
+    assert(threw);
+    assert(numberOfFramesReturned == numberOfFrames);
+
+    // The pipeline stays failed.
+    threw = false;
+    try {
+        pipeline.next();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+TEST_F(StitchedGOPPipelineTestFixture, testTileSizesAreRoundedUpToCtbs) {
+    assert(stitching::TileSizesInCtbs({1080, 1080}, 32) == std::vector<unsigned int>({34}));
+    assert(stitching::TileSizesInCtbs({1088, 100, 100}, 64) == std::vector<unsigned int>({17, 2}));
+    assert(stitching::TileSizesInCtbs({1080}, 32).empty());
+
+    auto tile = readFile(UnalignedTilePath);
+    auto ctbSize = stitching::TileExtractor::CtbSize(stitching::bytestring_view(tile->data(), tile->size()));
+    assert(ctbSize >= 16 && ctbSize <= 64);
+
+    // Two columns of the tile side by side. Only the second column is read, so the first is a skip tile.
+    StitchGroup group{{},
+                      stitching::StitchContext({1, 2}, {1920, 2 * 1088}, {1920, 2 * 1080}, false, {}, {}, 1),
+                      {1920},
+                      {1080, 1080},
+                      {1},
+                      {}};
+    std::vector<std::shared_ptr<const std::vector<char>>> tileData{tile};
+    auto context = prepareTilesForStitching(group, tileData);
+
+    // The first column is as wide as the tile is coded, not one CTB narrower.
+    assert(context.GetWidthsOfTiles() == std::vector<unsigned int>({1088 / ctbSize}));
+    assert(context.GetHeightsOfTiles().empty());
+    assert(context.GetPPSId() == 1);
+    assert(tileData.size() == 2);
+    assert(tileData[0] && tileData[1] == tile);
+}
@@ -1,8 +1,11 @@
+#include "ImagePrefetcher.h"
 #include "Tasm.h"
 #include "Video.h"
 #include <gtest/gtest.h>
 #include "sqlite3.h"
 
+#include <thread>
+
 using namespace tasm;
 
 #define ASSERT_SQLITE_OK(i) (assert(i == SQLITE_OK))
@@ -97,3 +100,44 @@ TEST_F(TasmTestFixture, testScanBirdsFullFrame) {
         ++count;
     std::cout << "Tiled vid: retrieved " << count << " frames" << std::endl;
 }
+
+TEST_F(TasmTestFixture, testStoreWhileIterating) {
+    tasm::TASM tasm(SemanticIndex::IndexType::InMemory);
+    std::string video("birdsincage-iterate");
+    std::string label("bird");
+    for (int i = 0; i < 30; ++i)
+        tasm.addMetadata(video, label, i, 0, 0, 100, 100);
+    tasm.storeWithUniformLayout("/home/maureen/NFLX_dataset/BirdsInCage_hevc.mp4", video, 2, 2);
+
+    auto countImages = [](auto &selection) {
+        auto count = 0u;
+        while (selection.next())
+            ++count;
+        return count;
+    };
+    auto expected = countImages(*tasm.select(video, label, 0, 30));
+    assert(expected);
+
+    // Like the Python bindings, the selection is decoded on a prefetch thread while holding the lock as a reader,
+    // and calls that change the catalog or the semantic index hold it as a writer.
+    auto lock = std::make_shared<std::shared_mutex>();
+    std::shared_ptr<ImageIterator> selection = tasm.select(video, label, 0, 30);
+    selection->setReadLock(lock);
+    ImagePrefetcher prefetcher(selection, 4);
+
+    std::thread writer([&] {
+        for (int i = 0; i < 3; ++i) {
+            std::unique_lock writeLock(*lock);
+            // Metadata outside of the selected frames does not change what the selection returns.
+            tasm.addMetadata(video, label, 100 + i, 0, 0, 100, 100);
+            tasm.store("/home/maureen/NFLX_dataset/BirdsInCage_hevc.mp4", video + "-copy" + std::to_string(i));
+        }
+    });
+    auto count = countImages(prefetcher);
+    writer.join();
+    assert(count == expected);
+
+    std::experimental::filesystem::remove_all(tasm::files::PathForVideo(video));
+    for (int i = 0; i < 3; ++i)
+        std::experimental::filesystem::remove_all(tasm::files::PathForVideo(video + "-copy" + std::to_string(i)));
+}
@@ -0,0 +1,134 @@
+#include "TileCoarsener.h"
+#include "CompressedTileIngester.h"
+#include "DecodeReader.h"
+#include "EncodedData.h"
+#include "Files.h"
+#include "MP4Reader.h"
+#include "SoftwareVideoDecoder.h"
+#include "TileLocationProvider.h"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cassert>
+
+using namespace tasm;
+
+namespace {
+
+// Encoded with 2x2 motion-constrained tiles, no loop filtering across tiles, and no B-frames.
+const std::string TiledSourcePath = "/home/maureen/home_videos/birds-2x2-mcts.hevc";
+
+class FixedLayoutProvider : public TileLayoutProvider {
+public:
+    explicit FixedLayoutProvider(const TileLayout &layout)
+        : layout_(std::make_shared<TileLayout>(layout)) {}
+
+    std::shared_ptr<TileLayout> tileLayoutForFrame(unsigned int frame) override {
+        return layout_;
+    }
+
+private:
+    std::shared_ptr<TileLayout> layout_;
+};
+
+std::vector<CPUFramePtr> decodeFile(const std::experimental::filesystem::path &path) {
+    MP4Reader reader(path);
+    // The configuration is only read by the GPU decoder.
+    CPUEncodedFrameData encodedData(Configuration{}, DecodeReaderPacket(*reader.dataForSamples(1, reader.numberOfSamples())));
+    SoftwareVideoDecoder decoder;
+    std::vector<CPUFramePtr> frames;
+    decoder.decode(encodedData, frames);
+    decoder.flush(frames);
+    return frames;
+}
+
+// Ingests the source without decoding it, and returns the path of the directory that holds its first GOP.
+std::experimental::filesystem::path ingestFirstGOP(const std::string &name) {
+    CompressedTileIngester(std::make_shared<Video>(TiledSourcePath), name).ingest();
+    SingleTileLocationProvider tiles(std::make_shared<TiledVideoManager>(std::make_shared<TiledEntry>(name)));
+    return tiles.locationOfTileForFrame(0, 0).parent_path();
+}
+
+} // namespace
+
+class TileCoarsenerTestFixture : public testing::Test {
+public:
+    TileCoarsenerTestFixture() {}
+};
+
+TEST_F(TileCoarsenerTestFixture, testIsCoarseningOf) {
+    TileLayout current(3, 2, {320, 320, 640}, {256, 464});
+
+    // Dropping boundaries merges tiles.
+    assert(TileCoarsener::isCoarseningOf(current, TileLayout(1, 1, {1280}, {720})));
+    assert(TileCoarsener::isCoarseningOf(current, TileLayout(2, 1, {640, 640}, {720})));
+    assert(TileCoarsener::isCoarseningOf(current, TileLayout(2, 2, {320, 960}, {256, 464})));
+    assert(TileCoarsener::isCoarseningOf(current, current));
+
+    // A boundary that the current layout does not have would split a tile.
+    assert(!TileCoarsener::isCoarseningOf(current, TileLayout(2, 1, {480, 800}, {720})));
+    assert(!TileCoarsener::isCoarseningOf(current, TileLayout(1, 2, {1280}, {360, 360})));
+    assert(!TileCoarsener::isCoarseningOf(TileLayout(1, 1, {1280}, {720}), current));
+
+    // The layouts have to cover the same frame.
+    assert(!TileCoarsener::isCoarseningOf(current, TileLayout(1, 1, {1280}, {704})));
+    assert(!TileCoarsener::isCoarseningOf(current, TileLayout(1, 1, {1296}, {720})));
+}
+
+TEST_F(TileCoarsenerTestFixture, testMergedTilesAreStitched) {
+    const std::string name = "birds-2x2-coarsened";
+    auto directory = ingestFirstGOP(name);
+    auto frames = TileFiles::firstAndLastFramesFromPath(directory);
+    auto gopLength = frames.second - frames.first + 1;
+    auto entry = std::make_shared<TiledEntry>(name);
+    auto currentLayout = SingleTileLocationProvider(std::make_shared<TiledVideoManager>(entry)).tileLayoutForFrame(0);
+    assert(currentLayout->numberOfTiles() == 4);
+
+    SingleTileConfigurationProvider newLayoutProvider(currentLayout->totalWidth(), currentLayout->totalHeight());
+    auto framesToTranscode = TileCoarsener(entry).coarsen({0}, newLayoutProvider, gopLength, Video(TiledSourcePath).configuration().frameRate);
+    assert(framesToTranscode->empty());
+
+    // The single tile decodes as the whole frame, since it is stitched from every tile of the GOP.
+    SingleTileLocationProvider tiles(std::make_shared<TiledVideoManager>(std::make_shared<TiledEntry>(name)));
+    assert(*tiles.tileLayoutForFrame(0) == *newLayoutProvider.tileLayoutForFrame(0));
+    auto stitched = decodeFile(tiles.locationOfTileForFrame(0, 0));
+    assert(stitched.size() == gopLength);
+    for (auto tile = 0u; tile < currentLayout->numberOfTiles(); ++tile) {
+        auto rectangle = currentLayout->rectangleForTile(tile);
+        auto decoded = decodeFile(TileFiles::tileFilename(directory, tile));
+        assert(decoded.size() == gopLength);
+        for (auto i = 0u; i < decoded.size(); ++i) {
+            for (auto row = 0u; row < rectangle.height; ++row) {
+                for (auto column = 0u; column < rectangle.width; ++column)
+                    assert(decoded[i]->luma()[row * decoded[i]->pitch() + column]
+                            == stitched[i]->luma()[(rectangle.y + row) * stitched[i]->pitch() + rectangle.x + column]);
+            }
+        }
+    }
+}
+
+TEST_F(TileCoarsenerTestFixture, testNewBoundaryFallsBackToTranscoding) {
+    const std::string name = "birds-2x2-not-coarsened";
+    auto directory = ingestFirstGOP(name);
+    auto frames = TileFiles::firstAndLastFramesFromPath(directory);
+    auto entry = std::make_shared<TiledEntry>(name);
+    auto publishedVersion = entry->loadPublishedTileVersion();
+    auto currentLayout = SingleTileLocationProvider(std::make_shared<TiledVideoManager>(entry)).tileLayoutForFrame(0);
+
+    // Moving the column boundary splits the left tiles, so they cannot be stitched.
+    auto width = currentLayout->totalWidth();
+    auto leftWidth = currentLayout->widthsOfColumns().front() / 2;
+    TileLayout newLayout(2, 1, {leftWidth, width - leftWidth}, {currentLayout->totalHeight()});
+    assert(!TileCoarsener::isCoarseningOf(*currentLayout, newLayout));
+    FixedLayoutProvider newLayoutProvider(newLayout);
+
+    auto framesToTranscode = TileCoarsener(entry).coarsen({0}, newLayoutProvider, frames.second - frames.first + 1,
+                                                           Video(TiledSourcePath).configuration().frameRate);
+    assert(*framesToTranscode == std::vector<int>{0});
+
+    // Nothing is written, so the GOP keeps its tiles until it is re-encoded.
+    assert(entry->loadPublishedTileVersion() == publishedVersion);
+    SingleTileLocationProvider tiles(std::make_shared<TiledVideoManager>(std::make_shared<TiledEntry>(name)));
+    assert(*tiles.tileLayoutForFrame(0) == *currentLayout);
+    assert(tiles.locationOfTileForFrame(0, 0).parent_path() == directory);
+}
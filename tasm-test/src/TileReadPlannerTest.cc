@@ -0,0 +1,110 @@
+#include "ScanTiledVideoOperator.h"
+#include "SemanticIndex.h"
+#include "SemanticSelection.h"
+#include <gtest/gtest.h>
+
+#include <cassert>
+#include <map>
+#include <thread>
+
+using namespace tasm;
+
+namespace {
+
+const unsigned int NumberOfFrames = 100;
+const unsigned int FramesPerGOP = 10;
+const std::string Video = "planner-test";
+
+// Every frame has a 2x2 layout of 64x64 tiles, and each GOP is stored in its own directory.
+class GOPTileLocationProvider : public TileLocationProvider {
+public:
+    GOPTileLocationProvider()
+        : layout_(std::make_shared<TileLayout>(2, 2, std::vector<unsigned int>{64, 64}, std::vector<unsigned int>{64, 64}))
+    {}
+
+    std::experimental::filesystem::path locationOfTileForFrame(unsigned int tileNumber, unsigned int frame) const override {
+        auto firstFrame = frame / FramesPerGOP * FramesPerGOP;
+        auto directory = std::to_string(firstFrame) + "-" + std::to_string(firstFrame + FramesPerGOP - 1) + "-0";
+        return TileFiles::tileFilename(std::experimental::filesystem::path(Video) / directory, tileNumber);
+    }
+
+    std::shared_ptr<TileLayout> tileLayoutForFrame(unsigned int) override { return layout_; }
+
+    unsigned int lastFrameWithLayout() const override { return NumberOfFrames - 1; }
+
+private:
+    std::shared_ptr<TileLayout> layout_;
+};
+
+std::shared_ptr<SemanticDataManager> semanticDataManager() {
+    auto semanticIndex = SemanticIndexFactory::createInMemory();
+    for (auto frame = 0u; frame < NumberOfFrames; ++frame) {
+        // An object in one tile that moves between tiles, and on some frames another that spans every tile.
+        auto x = frame % 2 ? 70 : 10;
+        auto y = frame % 4 > 1 ? 70 : 10;
+        semanticIndex->addMetadata(Video, "bird", frame, x, y, x + 20, y + 20);
+        if (!(frame % 3))
+            semanticIndex->addMetadata(Video, "bird", frame, 50, 50, 80, 80);
+    }
+    return std::make_shared<SemanticDataManager>(semanticIndex, Video, std::make_shared<SingleMetadataSelection>("bird"));
+}
+
+// The number of times each frame of each tile file is read.
+using ReadCounts = std::map<std::pair<std::string, int>, unsigned int>;
+
+void countReads(const std::vector<TileReadPlanner::TileInformation> &reads, ReadCounts &counts) {
+    for (const auto &read : reads) {
+        for (auto frame : *read.framesToRead)
+            ++counts[{read.filename.string(), frame}];
+    }
+}
+
+} // namespace
+
+class TileReadPlannerTestFixture : public testing::Test {
+public:
+    TileReadPlannerTestFixture() {}
+};
+
+TEST_F(TileReadPlannerTestFixture, testEveryReadIsTakenByOneDecoder) {
+    // Plan several windows, so that decoders take reads from windows that other decoders planned.
+    EnvironmentConfiguration::instance(EnvironmentConfiguration(std::unordered_map<std::string, std::string>{
+        {EnvironmentConfiguration::PlanningWindow, "25"},
+    }));
+
+    ReadCounts expected;
+    TileReadPlanner singleDecoderPlanner(semanticDataManager(), std::make_shared<GOPTileLocationProvider>());
+    std::vector<TileReadPlanner::TileInformation> singleDecoderReads;
+    while (singleDecoderPlanner.takeReads(0, singleDecoderReads)) { }
+    countReads(singleDecoderReads, expected);
+    assert(!expected.empty());
+
+    // Each decoder takes its reads on its own thread, like the scans do.
+    const unsigned int numberOfDecoders = 3;
+    TileReadPlanner planner(semanticDataManager(), std::make_shared<GOPTileLocationProvider>(), numberOfDecoders);
+    std::vector<std::vector<TileReadPlanner::TileInformation>> readsForDecoder(numberOfDecoders);
+    std::vector<std::thread> decoders;
+    for (auto decoder = 0u; decoder < numberOfDecoders; ++decoder) {
+        decoders.emplace_back([&, decoder] {
+            while (planner.takeReads(decoder, readsForDecoder[decoder])) { }
+            assert(!planner.hasMoreReads(decoder));
+        });
+    }
+    for (auto &decoder : decoders)
+        decoder.join();
+
+    // Every frame of every tile is read exactly once, by one of the decoders.
+    ReadCounts counts;
+    auto numberOfDecodersWithReads = 0u;
+    for (const auto &reads : readsForDecoder) {
+        countReads(reads, counts);
+        if (!reads.empty())
+            ++numberOfDecodersWithReads;
+    }
+    assert(counts == expected);
+    for (const auto &count : counts)
+        assert(count.second == 1);
+    assert(numberOfDecodersWithReads > 1);
+
+    EnvironmentConfiguration::instance(EnvironmentConfiguration());
+}
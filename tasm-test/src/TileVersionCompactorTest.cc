@@ -0,0 +1,57 @@
+#include "TileVersionCompactor.h"
+#include "Files.h"
+#include "Gpac.h"
+#include "TiledVideoManager.h"
+#include <gtest/gtest.h>
+
+#include <cassert>
+
+using namespace tasm;
+
+namespace {
+
+// Writes an empty directory for frames 0-29 with the entry's current tile version, and allocates the next version.
+std::experimental::filesystem::path writeDirectory(TiledEntry &entry) {
+    auto directory = TileFiles::directoryForTilesInFrames(entry, 0, 29);
+    std::experimental::filesystem::create_directory(directory);
+    gpac::write_tile_configuration(TileFiles::tileMetadataFilename(directory), TileLayout(1, 1, {320}, {240}));
+    entry.incrementTileVersion();
+    return directory;
+}
+
+} // namespace
+
+class TileVersionCompactorTestFixture : public testing::Test {
+public:
+    TileVersionCompactorTestFixture() {}
+};
+
+TEST_F(TileVersionCompactorTestFixture, testShadowedDirectoryIsRemovedOnceUnpinned) {
+    auto entry = std::make_shared<TiledEntry>("tile-version-compactor");
+    std::experimental::filesystem::remove_all(entry->path());
+    entry = std::make_shared<TiledEntry>("tile-version-compactor");
+
+    auto source = writeDirectory(*entry);
+    auto shadowed = writeDirectory(*entry);
+    entry->publishTileVersion();
+
+    // This reader sees the directory that is about to be shadowed.
+    auto reader = std::make_unique<TiledVideoManager>(entry);
+    auto newest = writeDirectory(*entry);
+    entry->publishTileVersion();
+
+    TileVersionCompactor compactor(entry);
+    assert(compactor.shadowedDirectories() == std::vector<std::experimental::filesystem::path>({shadowed}));
+    assert(!compactor.compact());
+    assert(std::experimental::filesystem::exists(shadowed));
+    assert(CatalogSnapshots::instance().numberOfPendingReclamations(entry->path()) == 1);
+
+    // The directory is removed when the last reader that can see it finishes.
+    reader.reset();
+    assert(!std::experimental::filesystem::exists(shadowed));
+    assert(!CatalogSnapshots::instance().numberOfPendingReclamations(entry->path()));
+
+    // The retiling source and the newest version are kept.
+    assert(std::experimental::filesystem::exists(source));
+    assert(std::experimental::filesystem::exists(newest));
+}
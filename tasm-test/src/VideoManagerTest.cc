@@ -1,6 +1,8 @@
 #include "VideoManager.h"
 #include <gtest/gtest.h>
 
+#include "Files.h"
+#include "MP4Reader.h"
 #include "SemanticIndex.h"
 #include "Video.h"
 #include <cassert>
@@ -71,3 +73,46 @@ TEST_F(VideoManagerTestFixture, testAccumulateRegret) {
     videoManager.retileVideoBasedOnRegret(video);
 }
 
+
+TEST_F(VideoManagerTestFixture, testPackedTilesShareContainer) {
+    EnvironmentConfiguration::instance(EnvironmentConfiguration(std::unordered_map<std::string, std::string>{
+        {EnvironmentConfiguration::PackTiles, "true"},
+    }));
+
+    VideoManager manager;
+    manager.storeWithUniformLayout("/home/maureen/red102k.mp4", "red10-2x2-packed", 2, 2);
+    EnvironmentConfiguration::instance(EnvironmentConfiguration());
+
+    TiledEntry entry("red10-2x2-packed");
+    for (auto &dir : std::experimental::filesystem::directory_iterator(entry.path())) {
+        if (!std::experimental::filesystem::is_directory(dir.status()))
+            continue;
+
+        auto directory = dir.path();
+        assert(TileFiles::directoryHasPackedTiles(directory));
+
+        // The readers for every tile in the directory read through one open container.
+        std::vector<std::unique_ptr<MP4Reader>> readers;
+        for (auto tile = 0u; tile < 4; ++tile) {
+            auto containerAndTrack = TileFiles::containerAndTrackForTile(TileFiles::tileFilename(directory, tile));
+            assert(containerAndTrack.first == TileFiles::packedTilesFilename(directory));
+            assert(containerAndTrack.second == tile + 1);
+            readers.push_back(std::make_unique<MP4Reader>(containerAndTrack.first, containerAndTrack.second));
+        }
+        for (auto &reader : readers) {
+            assert(reader->numberOfReadersSharingFile() == readers.size());
+            assert(!reader->dataForSamples(1, reader->numberOfSamples())->empty());
+        }
+
+        // Whether the directory is packed is remembered until it is forgotten.
+        auto packedFilename = TileFiles::packedTilesFilename(directory);
+        auto movedFilename = directory / "moved-packed-tiles.mp4";
+        std::experimental::filesystem::rename(packedFilename, movedFilename);
+        assert(TileFiles::directoryHasPackedTiles(directory));
+        TileFiles::forgetPackedTiles(directory);
+        assert(!TileFiles::directoryHasPackedTiles(directory));
+
+        std::experimental::filesystem::rename(movedFilename, packedFilename);
+        TileFiles::forgetPackedTiles(directory);
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef TASM_CPUDECODEDFRAME_H
+#define TASM_CPUDECODEDFRAME_H
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace tasm {
+
+// A frame decoded into host memory. It is stored as NV12, like the frames that NVDEC decodes,
+// so that frames from either decoder are converted the same way.
+// It has no CUDA dependencies, so the software decoder can be used on hosts without a GPU.
+class CPUDecodedFrame {
+public:
+    CPUDecodedFrame(unsigned int width, unsigned int height, int frameNumber, int tileNumber)
+        : width_(width),
+        height_(height),
+        pitch_((width + 1) & ~1u),
+        frameNumber_(frameNumber),
+        tileNumber_(tileNumber),
+        pixels_(new uint8_t[pitch_ * (height_ + (height_ + 1) / 2)])
+    { }
+
+    unsigned int width() const { return width_; }
+    unsigned int height() const { return height_; }
+    unsigned int pitch() const { return pitch_; }
+    int frameNumber() const { return frameNumber_; }
+    int tileNumber() const { return tileNumber_; }
+
+    uint8_t *luma() { return pixels_.get(); }
+    const uint8_t *luma() const { return pixels_.get(); }
+    // Interleaved U and V samples, one pair for every 2x2 block of luma samples.
+    uint8_t *chroma() { return pixels_.get() + pitch_ * height_; }
+    const uint8_t *chroma() const { return pixels_.get() + pitch_ * height_; }
+
+private:
+    unsigned int width_;
+    unsigned int height_;
+    unsigned int pitch_;
+    int frameNumber_;
+    int tileNumber_;
+    std::unique_ptr<uint8_t[]> pixels_;
+};
+
+using CPUFramePtr = std::shared_ptr<CPUDecodedFrame>;
+class CPUDecodedFrameData {
+public:
+    CPUDecodedFrameData(std::unique_ptr<std::vector<CPUFramePtr>> frames)
+        : frames_(std::move(frames))
+    {
+        assert(frames_);
+    }
+
+    std::vector<CPUFramePtr> &frames() { return *frames_; }
+
+private:
+    std::unique_ptr<std::vector<CPUFramePtr>> frames_;
+};
+
+} // namespace tasm
+
+#endif //TASM_CPUDECODEDFRAME_H
@@ -1,15 +1,19 @@
 #ifndef TASM_DECODEREADER_H
 #define TASM_DECODEREADER_H
 
+#include "EncodedGOPCache.h"
+#include "Files.h"
 #include "GPUContext.h"
 #include "MP4Reader.h"
 #include "spsc_queue.h"
 
 #include "nvcuvid.h"
+#include <cstring>
 #include <experimental/filesystem>
 #include <iostream>
 #include <memory>
 #include <optional>
+#include <sys/uio.h>
 #include <thread>
 #include <vector>
 
@@ -33,16 +37,42 @@ public:
                                                        reinterpret_cast<const unsigned char*>(data.data()), timestamp})
     { }
 
+    // Shares ownership of data rather than copying it, e.g. for GOPs that are also held by the encoded GOP cache.
+    explicit DecodeReaderPacket(std::shared_ptr<const std::vector<char>> data, const unsigned long flags=0,
+                                const CUvideotimestamp timestamp=0)
+            : CUVIDSOURCEDATAPACKET{flags, data->size(), reinterpret_cast<const unsigned char*>(data->data()), timestamp},
+              sharedData_(std::move(data))
+    { }
+
+    // Gathers data that is split across several buffers, e.g. stitched tiles, with a single copy.
+    explicit DecodeReaderPacket(const std::vector<iovec> &data, const unsigned long flags=0,
+                                const CUvideotimestamp timestamp=0)
+            : CUVIDSOURCEDATAPACKET{flags, 0, nullptr, timestamp},
+              buffer_(std::make_shared<std::vector<unsigned char>>()) {
+        for (const auto &range : data)
+            payload_size += range.iov_len;
+        buffer_->resize(payload_size);
+
+        auto destination = buffer_->data();
+        for (const auto &range : data) {
+            memcpy(destination, range.iov_base, range.iov_len);
+            destination += range.iov_len;
+        }
+        payload = buffer_->data();
+    }
+
     DecodeReaderPacket& operator=(const DecodeReaderPacket &packet) = default;
     bool operator==(const DecodeReaderPacket &packet) const noexcept {
         return this->payload_size == packet.payload_size &&
                this->flags == packet.flags &&
                this->timestamp == packet.timestamp &&
-               this->buffer_ == packet.buffer_;
+               this->buffer_ == packet.buffer_ &&
+               this->sharedData_ == packet.sharedData_;
     }
 
 private:
     std::shared_ptr<std::vector<unsigned char>> buffer_;
+    std::shared_ptr<const std::vector<char>> sharedData_;
 };
 
 class DecodeReader {
@@ -215,23 +245,24 @@ private:
 struct GOPReaderPacket {
 public:
     explicit GOPReaderPacket(std::vector<char> data, unsigned int firstFrameIndex, unsigned int numberOfFrames)
-            : data_(std::make_unique<std::vector<char>>(data)),
+            : data_(std::make_shared<const std::vector<char>>(std::move(data))),
               firstFrameIndex_(firstFrameIndex),
               numberOfFrames_(numberOfFrames)
     {}
 
-    explicit GOPReaderPacket(std::unique_ptr<std::vector<char>> data, unsigned int firstFrameIndex, unsigned int numberOfFrames)
+    // The data may be shared with the encoded GOP cache, so it is never modified in place.
+    explicit GOPReaderPacket(std::shared_ptr<const std::vector<char>> data, unsigned int firstFrameIndex, unsigned int numberOfFrames)
             : data_(std::move(data)),
               firstFrameIndex_(firstFrameIndex),
               numberOfFrames_(numberOfFrames)
     { }
 
-    std::unique_ptr<std::vector<char>> &data() { return data_; }
+    std::shared_ptr<const std::vector<char>> &data() { return data_; }
     unsigned int firstFrameIndex() const { return firstFrameIndex_; }
     unsigned int numberOfFrames() const { return numberOfFrames_; }
 
 public:
-    std::unique_ptr<std::vector<char>> data_;
+    std::shared_ptr<const std::vector<char>> data_;
     unsigned int firstFrameIndex_;
     unsigned int numberOfFrames_;
 };
@@ -242,7 +273,7 @@ public:
     // Frames is in global frame numbers (e.g. starting from frameOffsetInFile, not 0).
     explicit EncodedFrameReader(const std::experimental::filesystem::path &filename, std::shared_ptr<std::vector<int>> frames, int frameOffsetInFile = 0, bool shouldReadEntireGOPs=false)
             : filename_(filename),
-              mp4Reader_(filename_),
+              mp4Reader_(openTile(filename_)),
               frames_(frames),
               numberOfSamplesRead_(0),
               shouldReadFramesExactly_(false),
@@ -261,7 +292,9 @@ public:
     }
 
     void setNewFileWithSameKeyframes(const std::experimental::filesystem::path &newFilename) {
-        mp4Reader_.setNewFileWithSameKeyframes(newFilename);
+        filename_ = newFilename;
+        auto containerAndTrack = tasm::TileFiles::containerAndTrackForTile(filename_);
+        mp4Reader_.setNewFileWithSameKeyframes(containerAndTrack.first, containerAndTrack.second);
 
         frameIterator_ = frames_->begin();
         keyframeIterator_ = mp4Reader_.keyframeNumbers().begin();
@@ -269,7 +302,8 @@ public:
 
     void setNewFileWithSameKeyframesButNewFrames(const std::experimental::filesystem::path &newFilename, std::shared_ptr<std::vector<int>> frames, int frameOffsetInFile) {
         filename_ = newFilename;
-        mp4Reader_.setNewFileWithSameKeyframes(newFilename);
+        auto containerAndTrack = tasm::TileFiles::containerAndTrackForTile(filename_);
+        mp4Reader_.setNewFileWithSameKeyframes(containerAndTrack.first, containerAndTrack.second);
         frames_ = frames;
         frameOffsetInFile_ = frameOffsetInFile;
 
@@ -375,13 +409,34 @@ public:
 //    }
 
 private:
+    // Tiles may be stored in their own file or as a track of a packed container.
+    static MP4Reader openTile(const std::experimental::filesystem::path &tileFilename) {
+        auto containerAndTrack = tasm::TileFiles::containerAndTrackForTile(tileFilename);
+        return MP4Reader(containerAndTrack.first, containerAndTrack.second);
+    }
+
     bool haveMoreFrames() const { return frameIterator_ != frames_->end(); }
     bool haveMoreKeyframes() const { return keyframeIterator_ != mp4Reader_.keyframeNumbers().end(); }
     bool haveMoreGlobalFrames() const { return globalFramesIterator_ != globalFrames_.end(); }
 
     std::optional<GOPReaderPacket> dataForSamples(unsigned int firstSampleToRead, unsigned int lastSampleToRead) {
         // -1 from firstSampleToRead to go from sample number -> index.
-        return { GOPReaderPacket(mp4Reader_.dataForSamples(firstSampleToRead, lastSampleToRead), MP4Reader::sampleNumberToFrameNumber(firstSampleToRead + frameOffsetInFile_), lastSampleToRead - firstSampleToRead + 1) };
+        return { GOPReaderPacket(encodedDataForSamples(firstSampleToRead, lastSampleToRead), MP4Reader::sampleNumberToFrameNumber(firstSampleToRead + frameOffsetInFile_), lastSampleToRead - firstSampleToRead + 1) };
+    }
+
+    // Hits and newly-cached GOPs are shared with the cache rather than copied.
+    std::shared_ptr<const std::vector<char>> encodedDataForSamples(unsigned int firstSampleToRead, unsigned int lastSampleToRead) {
+        auto &cache = tasm::EncodedGOPCache::instance();
+        if (!cache.isEnabled())
+            return mp4Reader_.dataForSamples(firstSampleToRead, lastSampleToRead);
+
+        tasm::EncodedGOPKey key{filename_.string(), tasm::EncodedGOPCache::tileVersionForTileFile(filename_), firstSampleToRead, lastSampleToRead};
+        if (auto cached = cache.get(key))
+            return cached;
+
+        std::shared_ptr<const std::vector<char>> data = mp4Reader_.dataForSamples(firstSampleToRead, lastSampleToRead);
+        cache.put(key, data);
+        return data;
     }
 
     std::experimental::filesystem::path filename_;
@@ -19,6 +19,14 @@ public:
 
     virtual unsigned int yOffset() const = 0;
 
+    // The handle points at an NV12 frame whose chroma plane starts at this row.
+    virtual unsigned int frameHeight() const = 0;
+
+    // The frame that the region is from, and where its top-left corner is in the full frame.
+    virtual int frameNumber() const = 0;
+    virtual unsigned int frameX() const = 0;
+    virtual unsigned int frameY() const = 0;
+
     virtual ~GPUPixelData() = default;
 };
 
@@ -28,9 +36,11 @@ using GPUPixelDataContainer = std::unique_ptr<std::vector<GPUPixelDataPtr>>;
 class GPUPixelDataFromDecodedFrame : public GPUPixelData {
 public:
     GPUPixelDataFromDecodedFrame(GPUFramePtr frame, unsigned int width, unsigned int height,
-                                 unsigned int xOffset, unsigned int yOffset)
+                                 unsigned int xOffset, unsigned int yOffset,
+                                 int frameNumber, unsigned int frameX, unsigned int frameY)
             : frame_(frame), width_(width), height_(height),
-              xOffset_(xOffset), yOffset_(yOffset) {}
+              xOffset_(xOffset), yOffset_(yOffset),
+              frameNumber_(frameNumber), frameX_(frameX), frameY_(frameY) {}
 
     CUdeviceptr handle() const override { return frame_->cuda()->handle(); }
     unsigned int pitch() const override { return frame_->cuda()->pitch(); }
@@ -38,6 +48,10 @@ public:
     unsigned int height() const override { return height_; }
     unsigned int xOffset() const override { return xOffset_; }
     unsigned int yOffset() const override { return yOffset_; }
+    unsigned int frameHeight() const override { return frame_->height(); }
+    int frameNumber() const override { return frameNumber_; }
+    unsigned int frameX() const override { return frameX_; }
+    unsigned int frameY() const override { return frameY_; }
 
 private:
     GPUFramePtr frame_;
@@ -45,8 +59,43 @@ private:
     unsigned int height_;
     unsigned int xOffset_;
     unsigned int yOffset_;
+    int frameNumber_;
+    unsigned int frameX_;
+    unsigned int frameY_;
+};
+
+// A region of a frame that was decoded into host memory.
+class CPUPixelData {
+public:
+    CPUPixelData(CPUFramePtr frame, unsigned int width, unsigned int height,
+                 unsigned int xOffset, unsigned int yOffset,
+                 unsigned int frameX, unsigned int frameY)
+            : frame_(frame), width_(width), height_(height),
+              xOffset_(xOffset), yOffset_(yOffset),
+              frameX_(frameX), frameY_(frameY) {}
+
+    const CPUDecodedFrame &frame() const { return *frame_; }
+    unsigned int width() const { return width_; }
+    unsigned int height() const { return height_; }
+    unsigned int xOffset() const { return xOffset_; }
+    unsigned int yOffset() const { return yOffset_; }
+    // Where the region's top-left corner is in the full frame.
+    unsigned int frameX() const { return frameX_; }
+    unsigned int frameY() const { return frameY_; }
+
+private:
+    CPUFramePtr frame_;
+    unsigned int width_;
+    unsigned int height_;
+    unsigned int xOffset_;
+    unsigned int yOffset_;
+    unsigned int frameX_;
+    unsigned int frameY_;
 };
 
+using CPUPixelDataPtr = std::shared_ptr<CPUPixelData>;
+using CPUPixelDataContainer = std::unique_ptr<std::vector<CPUPixelDataPtr>>;
+
 } // namespace tasm
 
 #endif //TASM_DECODEDPIXELDATA_H
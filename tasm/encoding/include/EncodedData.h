@@ -1,6 +1,7 @@
 #ifndef TASM_ENCODEDDATA_H
 #define TASM_ENCODEDDATA_H
 
+#include "CPUDecodedFrame.h"
 #include "Configuration.h"
 #include "DecodeReader.h"
 #include "Frame.h"
@@ -14,7 +15,8 @@ public:
               packet_(packet),
               firstFrameIndex_(-1),
               numberOfFrames_(-1),
-              tileNumber_(-1) {}
+              tileNumber_(-1),
+              hasOutputFrames_(false) {}
 
     const DecodeReaderPacket &packet() const { return packet_; }
 
@@ -31,6 +33,13 @@ public:
         tileNumber_ = tileNumber;
     }
 
+    // Set when some frames of the packet are marked as not output, so the decoder only outputs these.
+    void setOutputFrames(std::vector<int> outputFrames) {
+        assert(!hasOutputFrames_);
+        outputFrames_ = std::move(outputFrames);
+        hasOutputFrames_ = true;
+    }
+
     bool getFirstFrameIndexIfSet(int &outFirstFrameIndex) const {
         if (firstFrameIndex_ == -1)
             return false;
@@ -55,6 +64,14 @@ public:
         return true;
     }
 
+    bool getOutputFramesIfSet(std::vector<int> &outOutputFrames) const {
+        if (!hasOutputFrames_)
+            return false;
+
+        outOutputFrames = outputFrames_;
+        return true;
+    }
+
     const Configuration &configuration() const { return configuration_; }
 
 private:
@@ -63,6 +80,8 @@ private:
     int firstFrameIndex_;
     int numberOfFrames_;
     int tileNumber_;
+    bool hasOutputFrames_;
+    std::vector<int> outputFrames_;
 };
 
 using CPUEncodedFrameDataPtr = std::shared_ptr<CPUEncodedFrameData>;
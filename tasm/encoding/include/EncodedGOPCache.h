@@ -0,0 +1,108 @@
+#ifndef TASM_ENCODEDGOPCACHE_H
+#define TASM_ENCODEDGOPCACHE_H
+
+#include <boost/functional/hash.hpp>
+#include <experimental/filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace tasm {
+
+// Identifies the encoded bytes for a run of samples in a single tile file.
+struct EncodedGOPKey {
+    std::string filename;
+    unsigned int tileVersion;
+    unsigned int firstSample;
+    unsigned int lastSample;
+
+    bool operator==(const EncodedGOPKey &other) const {
+        return filename == other.filename
+                && tileVersion == other.tileVersion
+                && firstSample == other.firstSample
+                && lastSample == other.lastSample;
+    }
+};
+
+struct EncodedGOPCacheStatistics {
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long bytesServed;
+    unsigned long long bytesInserted;
+    unsigned long long bytesEvicted;
+    unsigned long long bytesCached;
+    unsigned long long capacityInBytes;
+    unsigned long long numberOfEntries;
+};
+
+// Process-wide LRU cache of encoded GOP data read from tile files.
+// The byte budget comes from EnvironmentConfiguration; a budget of 0 disables caching.
+class EncodedGOPCache {
+public:
+    using Data = std::shared_ptr<const std::vector<char>>;
+
+    static EncodedGOPCache &instance();
+
+    explicit EncodedGOPCache(unsigned long long capacityInBytes)
+        : capacityInBytes_(capacityInBytes),
+        bytesCached_(0),
+        hits_(0), misses_(0),
+        bytesServed_(0), bytesInserted_(0), bytesEvicted_(0)
+    {}
+
+    bool isEnabled() const { return capacityInBytes_ > 0; }
+
+    // Returns nullptr on a miss.
+    Data get(const EncodedGOPKey &key);
+    void put(const EncodedGOPKey &key, Data data);
+
+    // Drops every entry read from a file under `directory`, e.g. after a tile version is removed.
+    void invalidateDirectory(const std::experimental::filesystem::path &directory);
+    void setCapacity(unsigned long long capacityInBytes);
+    void clear();
+
+    EncodedGOPCacheStatistics statistics() const;
+    void resetStatistics();
+
+    // Parses the tile version from a path of the form <video>/<first>-<last>-<version>/<tile>.mp4.
+    // Returns 0 when the parent directory does not follow that pattern.
+    static unsigned int tileVersionForTileFile(const std::experimental::filesystem::path &tileFile);
+
+private:
+    struct KeyHash {
+        size_t operator()(const EncodedGOPKey &key) const {
+            size_t seed = 0;
+            boost::hash_combine(seed, key.filename);
+            boost::hash_combine(seed, key.tileVersion);
+            boost::hash_combine(seed, key.firstSample);
+            boost::hash_combine(seed, key.lastSample);
+            return seed;
+        }
+    };
+
+    using Entry = std::pair<EncodedGOPKey, Data>;
+
+    void evictUntilFits(unsigned long long additionalBytes);
+    void erase(std::list<Entry>::iterator it);
+
+    unsigned long long capacityInBytes_;
+    unsigned long long bytesCached_;
+
+    // Most recently used entries are at the front.
+    std::list<Entry> lru_;
+    std::unordered_map<EncodedGOPKey, std::list<Entry>::iterator, KeyHash> keyToEntry_;
+
+    unsigned long long hits_;
+    unsigned long long misses_;
+    unsigned long long bytesServed_;
+    unsigned long long bytesInserted_;
+    unsigned long long bytesEvicted_;
+
+    mutable std::mutex mutex_;
+};
+
+} // namespace tasm
+
+#endif //TASM_ENCODEDGOPCACHE_H
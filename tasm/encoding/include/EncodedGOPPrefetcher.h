@@ -0,0 +1,78 @@
+#ifndef TASM_ENCODEDGOPPREFETCHER_H
+#define TASM_ENCODEDGOPPREFETCHER_H
+
+#include "DecodeReader.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace tasm {
+
+struct TileReadRequest {
+    std::experimental::filesystem::path filename;
+    std::shared_ptr<std::vector<int>> framesToRead;
+    unsigned int frameOffsetInFile;
+    bool shouldReadEntireGOPs;
+};
+
+struct PrefetchedGOP {
+    GOPReaderPacket packet;
+    unsigned int requestIndex;
+};
+
+// Reads GOPs for a sequence of tiles on a small pool of I/O threads.
+// GOPs are returned in the same order as reading each request's EncodedFrameReader to EOS, one request after another.
+// At most `depth` GOPs are buffered, except that the request currently being consumed can always make progress.
+// When `moreRequestsFollow` is set, the sequence is extended with addRequests() as it is planned.
+class EncodedGOPPrefetcher {
+public:
+    EncodedGOPPrefetcher(std::vector<TileReadRequest> requests, unsigned int depth, unsigned int numberOfThreads, bool moreRequestsFollow = false);
+    ~EncodedGOPPrefetcher();
+
+    // Appends requests to the sequence. Their indices continue from the requests that were already added.
+    void addRequests(std::vector<TileReadRequest> requests, bool moreRequestsFollow);
+
+    // Returns nothing once every request that has been added is consumed.
+    std::optional<PrefetchedGOP> next();
+
+    // The most GOPs that were buffered at once, counting those of the request being consumed.
+    unsigned int maxNumberOfBufferedGOPs() const;
+
+    void printStatistics() const;
+
+private:
+    void readRequests();
+    bool canBuffer(unsigned int requestIndex) const;
+
+    std::vector<TileReadRequest> requests_;
+    const unsigned int depth_;
+
+    // Per-request buffers of GOPs that have been read but not yet consumed.
+    std::deque<std::deque<GOPReaderPacket>> buffers_;
+    std::vector<bool> requestIsDone_;
+    bool moreRequestsFollow_;
+    unsigned int nextRequestToRead_;
+    unsigned int currentRequest_;
+    unsigned int numberOfBufferedGOPs_;
+    bool shouldStop_;
+    std::exception_ptr error_;
+
+    unsigned long long numberOfGOPsRead_;
+    unsigned long long numberOfBytesRead_;
+    unsigned int maxNumberOfBufferedGOPs_;
+    unsigned int numberOfStalls_;
+    std::chrono::microseconds timeStalled_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable gopAvailable_;
+    std::condition_variable spaceAvailable_;
+    std::condition_variable requestAvailable_;
+    std::vector<std::thread> threads_;
+};
+
+} // namespace tasm
+
+#endif //TASM_ENCODEDGOPPREFETCHER_H
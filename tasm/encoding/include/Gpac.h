@@ -3,9 +3,22 @@
 
 #include "TileLayout.h"
 #include <experimental/filesystem>
+#include <list>
+#include <memory>
+#include <vector>
 
 namespace tasm::gpac {
 void mux_media(const std::experimental::filesystem::path &source, const std::experimental::filesystem::path &destination);
+// Imports each source as its own track of destination, in order, so sources[i] is stored in track i + 1.
+void mux_media_as_tracks(const std::vector<std::experimental::filesystem::path> &sources, const std::experimental::filesystem::path &destination);
+
+// Annex B HEVC data in the order it was produced by an encoder.
+using EncodedChunks = std::list<std::unique_ptr<std::vector<char>>>;
+
+// Writes each in-memory bitstream as its own track of destination, so tracks[i] is stored in track i + 1.
+// Parameter sets are moved into the track's hvcC configuration, matching the layout mux_media produces.
+void mux_hevc_from_memory(const std::vector<const EncodedChunks*> &tracks, unsigned int frameRate, const std::experimental::filesystem::path &destination);
+
 void write_tile_configuration(const std::experimental::filesystem::path &metadata_filename, const TileLayout &tileLayouts);
 TileLayout load_tile_configuration(const std::experimental::filesystem::path &metadataFilename);
 } // namespace tasm::gpac
@@ -4,23 +4,29 @@
 #include "gpac/isomedia.h"
 #include "gpac/internal/isomedia_dev.h"
 #include "gpac/list.h"
+#include <cassert>
 #include <experimental/filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 
 class MP4Reader {
 public:
-    explicit MP4Reader(const std::experimental::filesystem::path &filename)
-            : filename_(filename),
+    // trackNumber is 1-indexed. Packed tile containers store tile N in track N + 1.
+    explicit MP4Reader(const std::experimental::filesystem::path &filename, unsigned int trackNumber = 1)
+            : trackNumber_(trackNumber),
+              filename_(filename),
               invalidFile_(false)
     {
         if (filename_.extension() != ".mp4") {
             invalidFile_ = true;
-            file_ = NULL;
             return;
         }
 
         setUpGFIsomFile();
 
-        GF_TrackBox *trak = gf_isom_get_track_from_file2(file_, trackNumber_);
+        std::scoped_lock lock(container_->mutex);
+        GF_TrackBox *trak = gf_isom_get_track_from_file2(container_->file, trackNumber_);
         GF_SyncSampleBox *sampleBox = trak->Media->information->sampleTable->SyncSample;
         // If !sampleBox, then every frame is a keyframe.
         if (!sampleBox)
@@ -31,43 +37,31 @@ public:
                 keyframeNumbers_[i] = sampleBox->sampleNumbers[i] - 1;
         }
 
-        numberOfSamples_ = gf_isom_get_sample_count(file_, trackNumber_);
+        numberOfSamples_ = gf_isom_get_sample_count(container_->file, trackNumber_);
     }
 
     MP4Reader(const MP4Reader &other)
-            : filename_(other.filename_),
+            : trackNumber_(other.trackNumber_),
+              filename_(other.filename_),
               keyframeNumbers_(other.keyframeNumbers_),
               numberOfSamples_(other.numberOfSamples_),
               numberOfSamplesRead_(other.numberOfSamplesRead_),
-              invalidFile_(other.invalidFile_)
-    {
-        other.closeFile();
-        if (invalidFile_)
-            file_ = NULL;
-        else
-            setUpGFIsomFile();
-    }
-
-    ~MP4Reader() {
-        if (file_) {
-            gf_isom_close(file_);
-            file_ = NULL;
-        }
-    }
+              invalidFile_(other.invalidFile_),
+              container_(other.container_)
+    { }
 
     void closeFile() const {
-        if (file_) {
-            gf_isom_close(file_);
-            file_ = NULL;
-        }
+        container_.reset();
     }
 
-    void setNewFileWithSameKeyframes(const std::experimental::filesystem::path &filename) {
+    void setNewFileWithSameKeyframes(const std::experimental::filesystem::path &filename, unsigned int trackNumber = 1) {
         closeFile();
         filename_ = filename;
+        trackNumber_ = trackNumber;
         setUpGFIsomFile();
 
-        numberOfSamples_ = gf_isom_get_sample_count(file_, trackNumber_);
+        std::scoped_lock lock(container_->mutex);
+        numberOfSamples_ = gf_isom_get_sample_count(container_->file, trackNumber_);
     }
 
     const std::vector<int> &keyframeNumbers() const {
@@ -90,24 +84,52 @@ public:
         return frameNumber + 1;
     }
 
+    // The number of readers, including this one, that read through the same open file.
+    unsigned int numberOfReadersSharingFile() const;
+
     std::unique_ptr<std::vector<char>> dataForSamples(unsigned int firstSampleToRead, unsigned int lastSampleToRead) const;
 
 private:
+    // The tiles of a packed directory are tracks of one container, so the readers for a group's tiles share a single
+    // handle to it rather than each opening the container. Reads through a shared handle are serialized by its mutex.
+    struct Container {
+        explicit Container(const std::experimental::filesystem::path &filename)
+                : file(gf_isom_open(filename.c_str(), GF_ISOM_OPEN_READ, nullptr))
+        {
+            if (!file)
+                throw std::runtime_error("Failed to open tile file: " + filename.string());
+        }
+
+        ~Container() {
+            if (file)
+                gf_isom_close(file);
+        }
+
+        GF_ISOFile *file;
+        std::mutex mutex;
+    };
+
+    // Returns the open handle to filename if another reader holds one, and opens it otherwise.
+    static std::shared_ptr<Container> openContainer(const std::experimental::filesystem::path &filename);
+
     void setUpGFIsomFile() {
-        file_ = gf_isom_open(filename_.c_str(), GF_ISOM_OPEN_READ, nullptr);
+        container_ = openContainer(filename_);
         u32 flags = GF_ISOM_NALU_EXTRACT_INBAND_PS_FLAG | GF_ISOM_NALU_EXTRACT_ANNEXB_FLAG;
         // I think the ANNEXB flag adds AUD NALS.
-        auto result = gf_isom_set_nalu_extract_mode(file_, 1, flags);
+        // The extract mode is set per track, so readers of other tracks in the same container are unaffected.
+        std::scoped_lock lock(container_->mutex);
+        auto result = gf_isom_set_nalu_extract_mode(container_->file, trackNumber_, flags);
         assert(result == GF_OK);
     }
 
     static GF_TrackBox *gf_isom_get_track_from_file2(GF_ISOFile *the_file, u32 trackNumber) {
         auto count = gf_list_count(the_file->moov->trackList);
         assert(trackNumber <= count);
+        auto trackID = gf_isom_get_track_id(the_file, trackNumber);
         unsigned int position = 0;
         void *box = NULL;
         while ((box = gf_list_enum(the_file->moov->trackList, &position))) {
-            if (reinterpret_cast<GF_TrackBox*>(box)->Header->trackID == trackNumber)
+            if (reinterpret_cast<GF_TrackBox*>(box)->Header->trackID == trackID)
                 break;
         }
         assert(box);
@@ -115,13 +137,13 @@ private:
         return reinterpret_cast<GF_TrackBox*>(box);
     }
 
-    static const unsigned int trackNumber_ = 1;
+    unsigned int trackNumber_;
     std::experimental::filesystem::path filename_;
-    mutable GF_ISOFile *file_;
     std::vector<int> keyframeNumbers_;
     unsigned int numberOfSamples_;
     unsigned int numberOfSamplesRead_ = 0;
     bool invalidFile_;
+    mutable std::shared_ptr<Container> container_;
 };
 
 #endif //TASM_MP4READER_H
@@ -0,0 +1,80 @@
+#ifndef TASM_SOFTWAREVIDEODECODER_H
+#define TASM_SOFTWAREVIDEODECODER_H
+
+#include "CPUDecodedFrame.h"
+#include <deque>
+#include <map>
+#include <unordered_map>
+
+struct AVCodecContext;
+struct AVCodecParserContext;
+struct AVFrame;
+struct AVPacket;
+
+namespace tasm {
+
+class CPUEncodedFrameData;
+
+// Decodes HEVC on the CPU with libavcodec.
+// It is built into its own library that only links libavcodec, so hosts without CUDA can load it.
+// Frames are returned in output order: each picture is buffered until more pictures than the stream can reorder are
+// waiting, and then the one with the lowest picture order count is returned.
+// Like VideoDecoder, frames are numbered in output order with the output frames of the packets they were decoded from,
+// so frames that are marked as not output are decoded as references but never returned.
+class SoftwareVideoDecoder {
+public:
+    explicit SoftwareVideoDecoder(unsigned int numberOfThreads = 1);
+    ~SoftwareVideoDecoder();
+
+    SoftwareVideoDecoder(const SoftwareVideoDecoder &) = delete;
+    SoftwareVideoDecoder &operator=(const SoftwareVideoDecoder &) = delete;
+
+    // Decodes `size` bytes of Annex B data and appends the frames that are ready to `frames`.
+    // The frames that the data outputs are numbered with `outputFrames` and `tileNumber`; without them, they are -1.
+    // Because frames are reordered, a packet's last frames may only be returned by the next call or by flush().
+    void decode(const uint8_t *data, size_t size, const std::vector<int> &outputFrames, int tileNumber,
+                std::vector<CPUFramePtr> &frames);
+
+    // Decodes a packet, numbering its frames with the packet's frame range, output frames, and tile number.
+    // It is defined with the decode operators, because CPUEncodedFrameData depends on CUDA.
+    void decode(const CPUEncodedFrameData &data, std::vector<CPUFramePtr> &frames);
+
+    // Returns the frames that are still buffered. The decoder cannot be used afterwards.
+    void flush(std::vector<CPUFramePtr> &frames);
+
+    unsigned long long numberOfFramesDecoded() const { return numberOfFramesDecoded_; }
+
+private:
+    // Pictures are ordered by picture order count within each coded video sequence, which starts at an IRAP picture
+    // that resets it.
+    using OutputOrder = std::pair<unsigned long long, int>;
+
+    void sendAccessUnit(const uint8_t *data, int size, std::vector<CPUFramePtr> &frames);
+    void sendPacket(const uint8_t *data, int size, std::vector<CPUFramePtr> &frames);
+    void receiveFrames(std::vector<CPUFramePtr> &frames);
+    void outputFrames(bool isFlushing, std::vector<CPUFramePtr> &frames);
+    CPUFramePtr copyFrame(const AVFrame &frame, int frameNumber, int tileNumber) const;
+
+    AVCodecContext *context_;
+    AVCodecParserContext *parser_;
+    AVFrame *frame_;
+    AVPacket *packet_;
+
+    // The output order of each access unit that was sent to the decoder but not received, by its pts.
+    long long nextPts_;
+    std::unordered_map<long long, OutputOrder> outputOrderForPts_;
+    unsigned long long sequence_;
+    int maximumPictureOrderCount_;
+    bool sequenceHasPictures_;
+
+    // Decoded frames that are waiting for the pictures that are output before them. They are numbered when output.
+    std::map<OutputOrder, AVFrame *> reorderedFrames_;
+
+    std::deque<int> frameNumbers_;
+    std::deque<int> tileNumbers_;
+    unsigned long long numberOfFramesDecoded_;
+};
+
+} // namespace tasm
+
+#endif //TASM_SOFTWAREVIDEODECODER_H
@@ -8,6 +8,7 @@
 #include "VideoDecoder.h"
 
 #include <cstring>
+#include <numeric>
 #include <thread>
 
 namespace tasm {
@@ -164,6 +165,14 @@ private:
                     bool gotTileNumber = encodedData.value()->getTileNumberIfSet(tileNumber);
 
                     if (gotFirstFrameIndex && gotNumberOfFrames) {
+                        // Frames that are marked as not output are decoded but never displayed, so they get no frame number.
+                        std::vector<int> outputFrames;
+                        if (!encodedData.value()->getOutputFramesIfSet(outputFrames)) {
+                            outputFrames.resize(numberOfFrames);
+                            std::iota(outputFrames.begin(), outputFrames.end(), firstFrameIndex);
+                        }
+                        numberOfFrames = outputFrames.size();
+
                         if (decoder.frameNumberQueue()->write_available() <
                             static_cast<unsigned int>(numberOfFrames)) {
                             if (!nextDataQueue.read_available()) {
@@ -177,7 +186,7 @@ private:
                             }
                         }
 
-                        for (int i = firstFrameIndex; i < firstFrameIndex + numberOfFrames; i++) {
+                        for (auto i : outputFrames) {
                             assert(decoder.frameNumberQueue()->push(i));
                             if (gotTileNumber)
                                 assert(decoder.tileNumberQueue()->push(tileNumber));
@@ -0,0 +1,104 @@
+#include "nvcuvid.h"
+
+#include <dlfcn.h>
+
+// TASM does not link the CUDA driver or NVDEC, so that hosts without a GPU can load it and run queries with the
+// software decoder. Instead, the driver and NVDEC functions that TASM calls are defined here, and forward to the
+// libraries, which are opened the first time one of their functions is called. NVENC is opened the same way by
+// EncodeAPI::Initialize.
+// When a library cannot be opened, its functions return CUDA_ERROR_NOT_INITIALIZED, so GPUContext::device_count()
+// reports that there are no GPUs. Other driver functions have to be forwarded here before TASM can call them.
+
+namespace {
+
+class SharedLibrary {
+public:
+    explicit SharedLibrary(const char *filename)
+        : handle_(dlopen(filename, RTLD_NOW | RTLD_LOCAL))
+    { }
+
+    // Returns nullptr if the library or the symbol does not exist.
+    template<typename Function>
+    Function *symbol(const char *name) const {
+        return handle_ ? reinterpret_cast<Function*>(dlsym(handle_, name)) : nullptr;
+    }
+
+private:
+    void *handle_;
+};
+
+const SharedLibrary &Driver() {
+    static const SharedLibrary driver("libcuda.so.1");
+    return driver;
+}
+
+const SharedLibrary &NVDEC() {
+    static const SharedLibrary nvdec("libnvcuvid.so.1");
+    return nvdec;
+}
+
+} // namespace
+
+#define TASM_STRINGIFY(name) #name
+#define TASM_SYMBOL_NAME(name) TASM_STRINGIFY(name)
+
+// Defines `name` to call the function of the same name in `library`. cuda.h maps some driver functions to versioned
+// names such as cuMemAlloc_v2, so the expanded name is looked up. The forwarders are hidden so that they do not
+// replace the driver's functions for other libraries in the process.
+#define TASM_FORWARD(library, name, parameters, arguments) \
+    __attribute__((visibility("hidden"))) CUresult CUDAAPI name parameters { \
+        static const auto function = library().symbol<decltype(name)>(TASM_SYMBOL_NAME(name)); \
+        return function ? function arguments : CUDA_ERROR_NOT_INITIALIZED; \
+    }
+
+extern "C" {
+
+// The CUDA driver.
+TASM_FORWARD(Driver, cuInit, (unsigned int flags), (flags))
+TASM_FORWARD(Driver, cuGetErrorName, (CUresult error, const char **name), (error, name))
+TASM_FORWARD(Driver, cuDeviceGetCount, (int *count), (count))
+TASM_FORWARD(Driver, cuDeviceGet, (CUdevice *device, int ordinal), (device, ordinal))
+TASM_FORWARD(Driver, cuCtxCreate, (CUcontext *context, unsigned int flags, CUdevice device), (context, flags, device))
+TASM_FORWARD(Driver, cuCtxDestroy, (CUcontext context), (context))
+TASM_FORWARD(Driver, cuCtxGetCurrent, (CUcontext *context), (context))
+TASM_FORWARD(Driver, cuCtxSetCurrent, (CUcontext context), (context))
+TASM_FORWARD(Driver, cuMemAlloc, (CUdeviceptr *pointer, size_t size), (pointer, size))
+TASM_FORWARD(Driver, cuMemAllocPitch, (CUdeviceptr *pointer, size_t *pitch, size_t widthInBytes, size_t height, unsigned int elementSize),
+             (pointer, pitch, widthInBytes, height, elementSize))
+TASM_FORWARD(Driver, cuMemFree, (CUdeviceptr pointer), (pointer))
+TASM_FORWARD(Driver, cuMemcpy2D, (const CUDA_MEMCPY2D *copy), (copy))
+
+// NVDEC, as declared by nvcuvid.h and cuviddec.h.
+TASM_FORWARD(NVDEC, cuvidCreateVideoSource, (CUvideosource *source, const char *filename, CUVIDSOURCEPARAMS *parameters),
+             (source, filename, parameters))
+TASM_FORWARD(NVDEC, cuvidCreateVideoSourceW, (CUvideosource *source, const wchar_t *filename, CUVIDSOURCEPARAMS *parameters),
+             (source, filename, parameters))
+TASM_FORWARD(NVDEC, cuvidDestroyVideoSource, (CUvideosource source), (source))
+TASM_FORWARD(NVDEC, cuvidSetVideoSourceState, (CUvideosource source, cudaVideoState state), (source, state))
+TASM_FORWARD(NVDEC, cuvidGetSourceVideoFormat, (CUvideosource source, CUVIDEOFORMAT *format, unsigned int flags), (source, format, flags))
+TASM_FORWARD(NVDEC, cuvidGetSourceAudioFormat, (CUvideosource source, CUAUDIOFORMAT *format, unsigned int flags), (source, format, flags))
+TASM_FORWARD(NVDEC, cuvidCreateVideoParser, (CUvideoparser *parser, CUVIDPARSERPARAMS *parameters), (parser, parameters))
+TASM_FORWARD(NVDEC, cuvidParseVideoData, (CUvideoparser parser, CUVIDSOURCEDATAPACKET *packet), (parser, packet))
+TASM_FORWARD(NVDEC, cuvidDestroyVideoParser, (CUvideoparser parser), (parser))
+TASM_FORWARD(NVDEC, cuvidGetDecoderCaps, (CUVIDDECODECAPS *capabilities), (capabilities))
+TASM_FORWARD(NVDEC, cuvidCreateDecoder, (CUvideodecoder *decoder, CUVIDDECODECREATEINFO *parameters), (decoder, parameters))
+TASM_FORWARD(NVDEC, cuvidDestroyDecoder, (CUvideodecoder decoder), (decoder))
+TASM_FORWARD(NVDEC, cuvidDecodePicture, (CUvideodecoder decoder, CUVIDPICPARAMS *parameters), (decoder, parameters))
+TASM_FORWARD(NVDEC, cuvidGetDecodeStatus, (CUvideodecoder decoder, int pictureIndex, CUVIDGETDECODESTATUS *status),
+             (decoder, pictureIndex, status))
+TASM_FORWARD(NVDEC, cuvidReconfigureDecoder, (CUvideodecoder decoder, CUVIDRECONFIGUREDECODERINFO *parameters), (decoder, parameters))
+TASM_FORWARD(NVDEC, cuvidMapVideoFrame64, (CUvideodecoder decoder, int pictureIndex, unsigned long long *pointer, unsigned int *pitch, CUVIDPROCPARAMS *parameters),
+             (decoder, pictureIndex, pointer, pitch, parameters))
+TASM_FORWARD(NVDEC, cuvidUnmapVideoFrame64, (CUvideodecoder decoder, unsigned long long pointer), (decoder, pointer))
+TASM_FORWARD(NVDEC, cuvidCtxLockCreate, (CUvideoctxlock *lock, CUcontext context), (lock, context))
+TASM_FORWARD(NVDEC, cuvidCtxLockDestroy, (CUvideoctxlock lock), (lock))
+TASM_FORWARD(NVDEC, cuvidCtxLock, (CUvideoctxlock lock, unsigned int flags), (lock, flags))
+TASM_FORWARD(NVDEC, cuvidCtxUnlock, (CUvideoctxlock lock, unsigned int flags), (lock, flags))
+
+// The state is the only NVDEC result that is not a CUresult.
+__attribute__((visibility("hidden"))) cudaVideoState CUDAAPI cuvidGetVideoSourceState(CUvideosource source) {
+    static const auto function = NVDEC().symbol<decltype(cuvidGetVideoSourceState)>("cuvidGetVideoSourceState");
+    return function ? function(source) : cudaVideoState_Error;
+}
+
+} // extern "C"
@@ -0,0 +1,102 @@
+#include "EncodedGOPCache.h"
+
+#include "EnvironmentConfiguration.h"
+#include <algorithm>
+
+namespace tasm {
+
+EncodedGOPCache &EncodedGOPCache::instance() {
+    static EncodedGOPCache cache(EnvironmentConfiguration::instance().encodedGOPCacheSize());
+    return cache;
+}
+
+EncodedGOPCache::Data EncodedGOPCache::get(const EncodedGOPKey &key) {
+    std::scoped_lock lock(mutex_);
+    auto it = keyToEntry_.find(key);
+    if (it == keyToEntry_.end()) {
+        ++misses_;
+        return nullptr;
+    }
+
+    // Move the entry to the front of the LRU list.
+    lru_.splice(lru_.begin(), lru_, it->second);
+    ++hits_;
+    bytesServed_ += it->second->second->size();
+    return it->second->second;
+}
+
+void EncodedGOPCache::put(const EncodedGOPKey &key, Data data) {
+    std::scoped_lock lock(mutex_);
+    if (!capacityInBytes_ || data->size() > capacityInBytes_)
+        return;
+
+    auto existing = keyToEntry_.find(key);
+    if (existing != keyToEntry_.end())
+        erase(existing->second);
+
+    evictUntilFits(data->size());
+    lru_.emplace_front(key, data);
+    keyToEntry_[key] = lru_.begin();
+    bytesCached_ += data->size();
+    bytesInserted_ += data->size();
+}
+
+void EncodedGOPCache::invalidateDirectory(const std::experimental::filesystem::path &directory) {
+    std::scoped_lock lock(mutex_);
+    for (auto it = lru_.begin(); it != lru_.end();) {
+        auto next = std::next(it);
+        if (std::experimental::filesystem::path(it->first.filename).parent_path() == directory)
+            erase(it);
+        it = next;
+    }
+}
+
+void EncodedGOPCache::setCapacity(unsigned long long capacityInBytes) {
+    std::scoped_lock lock(mutex_);
+    capacityInBytes_ = capacityInBytes;
+    evictUntilFits(0);
+}
+
+void EncodedGOPCache::clear() {
+    std::scoped_lock lock(mutex_);
+    lru_.clear();
+    keyToEntry_.clear();
+    bytesCached_ = 0;
+}
+
+EncodedGOPCacheStatistics EncodedGOPCache::statistics() const {
+    std::scoped_lock lock(mutex_);
+    return {hits_, misses_, bytesServed_, bytesInserted_, bytesEvicted_, bytesCached_, capacityInBytes_, keyToEntry_.size()};
+}
+
+void EncodedGOPCache::resetStatistics() {
+    std::scoped_lock lock(mutex_);
+    hits_ = misses_ = bytesServed_ = bytesInserted_ = bytesEvicted_ = 0;
+}
+
+unsigned int EncodedGOPCache::tileVersionForTileFile(const std::experimental::filesystem::path &tileFile) {
+    std::string directoryName = tileFile.parent_path().filename();
+    auto lastSeparator = directoryName.rfind('-');
+    if (lastSeparator == std::string::npos || lastSeparator + 1 == directoryName.size())
+        return 0;
+
+    auto version = directoryName.substr(lastSeparator + 1);
+    if (!std::all_of(version.begin(), version.end(), ::isdigit))
+        return 0;
+    return std::stoul(version);
+}
+
+void EncodedGOPCache::evictUntilFits(unsigned long long additionalBytes) {
+    while (!lru_.empty() && bytesCached_ + additionalBytes > capacityInBytes_) {
+        bytesEvicted_ += lru_.back().second->size();
+        erase(std::prev(lru_.end()));
+    }
+}
+
+void EncodedGOPCache::erase(std::list<Entry>::iterator it) {
+    bytesCached_ -= it->second->size();
+    keyToEntry_.erase(it->first);
+    lru_.erase(it);
+}
+
+} // namespace tasm
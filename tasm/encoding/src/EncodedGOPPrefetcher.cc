@@ -0,0 +1,148 @@
+#include "EncodedGOPPrefetcher.h"
+
+#include <cassert>
+#include <iostream>
+#include <thread>
+
+namespace tasm {
+
+EncodedGOPPrefetcher::EncodedGOPPrefetcher(std::vector<TileReadRequest> requests, unsigned int depth, unsigned int numberOfThreads, bool moreRequestsFollow)
+    : requests_(std::move(requests)),
+    depth_(depth),
+    buffers_(requests_.size()),
+    requestIsDone_(requests_.size(), false),
+    moreRequestsFollow_(moreRequestsFollow),
+    nextRequestToRead_(0),
+    currentRequest_(0),
+    numberOfBufferedGOPs_(0),
+    shouldStop_(false),
+    numberOfGOPsRead_(0),
+    numberOfBytesRead_(0),
+    maxNumberOfBufferedGOPs_(0),
+    numberOfStalls_(0),
+    timeStalled_(0)
+{
+    assert(depth_);
+    assert(numberOfThreads);
+    for (auto i = 0u; i < numberOfThreads; ++i)
+        threads_.emplace_back(&EncodedGOPPrefetcher::readRequests, this);
+}
+
+EncodedGOPPrefetcher::~EncodedGOPPrefetcher() {
+    {
+        std::scoped_lock lock(mutex_);
+        shouldStop_ = true;
+    }
+    spaceAvailable_.notify_all();
+    requestAvailable_.notify_all();
+    for (auto &thread : threads_)
+        thread.join();
+}
+
+void EncodedGOPPrefetcher::addRequests(std::vector<TileReadRequest> requests, bool moreRequestsFollow) {
+    {
+        std::scoped_lock lock(mutex_);
+        assert(moreRequestsFollow_);
+        requests_.insert(requests_.end(), std::make_move_iterator(requests.begin()), std::make_move_iterator(requests.end()));
+        buffers_.resize(requests_.size());
+        requestIsDone_.resize(requests_.size(), false);
+        moreRequestsFollow_ = moreRequestsFollow;
+    }
+    requestAvailable_.notify_all();
+}
+
+bool EncodedGOPPrefetcher::canBuffer(unsigned int requestIndex) const {
+    // The consumer waits on currentRequest_, so it must never be blocked by GOPs buffered for later requests.
+    return shouldStop_ || requestIndex == currentRequest_ || numberOfBufferedGOPs_ < depth_;
+}
+
+void EncodedGOPPrefetcher::readRequests() {
+    while (true) {
+        unsigned int requestIndex;
+        std::optional<TileReadRequest> request;
+        {
+            std::unique_lock lock(mutex_);
+            requestAvailable_.wait(lock, [&] { return shouldStop_ || nextRequestToRead_ < requests_.size() || !moreRequestsFollow_; });
+            if (shouldStop_ || nextRequestToRead_ == requests_.size())
+                return;
+            // Copied because addRequests() may reallocate the requests while this one is read.
+            requestIndex = nextRequestToRead_++;
+            request = requests_[requestIndex];
+        }
+
+        try {
+            EncodedFrameReader reader(request->filename, request->framesToRead, request->frameOffsetInFile, request->shouldReadEntireGOPs);
+            while (!reader.isEos()) {
+                auto gop = reader.read();
+                assert(gop.has_value());
+
+                std::unique_lock lock(mutex_);
+                spaceAvailable_.wait(lock, [&] { return canBuffer(requestIndex); });
+                if (shouldStop_)
+                    return;
+
+                ++numberOfGOPsRead_;
+                numberOfBytesRead_ += gop->data()->size();
+                buffers_[requestIndex].push_back(std::move(*gop));
+                maxNumberOfBufferedGOPs_ = std::max(maxNumberOfBufferedGOPs_, ++numberOfBufferedGOPs_);
+                gopAvailable_.notify_all();
+            }
+        } catch (...) {
+            std::scoped_lock lock(mutex_);
+            if (!error_)
+                error_ = std::current_exception();
+        }
+
+        std::scoped_lock lock(mutex_);
+        requestIsDone_[requestIndex] = true;
+        gopAvailable_.notify_all();
+    }
+}
+
+std::optional<PrefetchedGOP> EncodedGOPPrefetcher::next() {
+    std::unique_lock lock(mutex_);
+    while (currentRequest_ < requests_.size()) {
+        auto hasData = [&] { return error_ || !buffers_[currentRequest_].empty() || requestIsDone_[currentRequest_]; };
+        if (!hasData()) {
+            ++numberOfStalls_;
+            auto start = std::chrono::steady_clock::now();
+            gopAvailable_.wait(lock, hasData);
+            timeStalled_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        }
+
+        if (error_)
+            std::rethrow_exception(error_);
+
+        auto &buffer = buffers_[currentRequest_];
+        if (!buffer.empty()) {
+            PrefetchedGOP gop{std::move(buffer.front()), currentRequest_};
+            buffer.pop_front();
+            --numberOfBufferedGOPs_;
+            spaceAvailable_.notify_all();
+            return {std::move(gop)};
+        }
+
+        // The current request is done and has no buffered GOPs left.
+        ++currentRequest_;
+        spaceAvailable_.notify_all();
+    }
+    return {};
+}
+
+unsigned int EncodedGOPPrefetcher::maxNumberOfBufferedGOPs() const {
+    std::scoped_lock lock(mutex_);
+    return maxNumberOfBufferedGOPs_;
+}
+
+void EncodedGOPPrefetcher::printStatistics() const {
+    std::scoped_lock lock(mutex_);
+    std::cout << "ANALYSIS: read-ahead-depth " << depth_ << std::endl;
+    std::cout << "ANALYSIS: read-ahead-threads " << threads_.size() << std::endl;
+    std::cout << "ANALYSIS: read-ahead-gops-read " << numberOfGOPsRead_ << std::endl;
+    std::cout << "ANALYSIS: read-ahead-bytes-read " << numberOfBytesRead_ << std::endl;
+    std::cout << "ANALYSIS: read-ahead-max-buffered-gops " << maxNumberOfBufferedGOPs_ << std::endl;
+    std::cout << "ANALYSIS: read-ahead-stalls " << numberOfStalls_ << std::endl;
+    std::cout << "ANALYSIS: read-ahead-stall-time-us " << timeStalled_.count() << std::endl;
+}
+
+} // namespace tasm
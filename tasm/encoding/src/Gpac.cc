@@ -1,9 +1,15 @@
 #include "Gpac.h"
 
 #include "TileConfiguration.pb.h"
+#include "TileExtractor.h"
 #include "gpac/isomedia.h"
 #include "gpac/media_tools.h"
+#include "gpac/internal/media_dev.h"
+#include <cassert>
+#include <cstring>
 #include <fstream>
+#include <memory>
+#include <optional>
 
 namespace tasm::gpac {
 
@@ -28,6 +34,272 @@ void mux_media(const std::experimental::filesystem::path &source, const std::exp
         throw std::runtime_error("Error deleting source file");
 }
 
+void mux_media_as_tracks(const std::vector<std::experimental::filesystem::path> &sources, const std::experimental::filesystem::path &destination) {
+    GF_ISOFile *file;
+    GF_Err result;
+
+    if((file = gf_isom_open(destination.c_str(), GF_ISOM_OPEN_WRITE, nullptr)) == nullptr)
+        throw std::runtime_error("Error opening destination file");
+
+    for (const auto &source : sources) {
+        GF_MediaImporter import{};
+        auto input = source.string();
+        auto extension = source.extension().string();
+
+        import.in_name = input.data();
+        import.force_ext = extension.data();
+        import.dest = file;
+
+        if ((result = gf_media_import(&import)) != GF_OK) {
+            gf_isom_delete(file);
+            throw std::runtime_error("Error importing track: " + std::to_string(result));
+        }
+    }
+
+    assert(gf_isom_get_track_count(file) == sources.size());
+    if((result = gf_isom_close(file)) != GF_OK)
+        throw std::runtime_error("Error closing file: " + std::to_string(result));
+
+    for (const auto &source : sources) {
+        if (!std::experimental::filesystem::remove(source))
+            throw std::runtime_error("Error deleting source file");
+    }
+}
+
+namespace {
+
+enum HEVCNalType {
+    FIRST_IRAP = 16,
+    LAST_IRAP = 23,
+    VPS = 32,
+    SPS = 33,
+    PPS = 34,
+    AUD = 35,
+    PREFIX_SEI = 39,
+};
+
+struct Nal {
+    const char *data;
+    unsigned int size;
+
+    unsigned int type() const { return (static_cast<unsigned char>(data[0]) >> 1) & 0x3F; }
+    bool isVCL() const { return type() < VPS; }
+    bool isIRAP() const { return type() >= FIRST_IRAP && type() <= LAST_IRAP; }
+    bool isFirstSliceSegmentInPicture() const { return size > 2 && (static_cast<unsigned char>(data[2]) & 0x80); }
+};
+
+// Splits Annex B data that arrives in chunks into NALs. A NAL or its start code may span chunks, so each NAL is
+// held back until the start code after it, or the end of the data, is seen.
+class NalAssembler {
+public:
+    // Calls visit with each NAL that ends in chunk. The NALs are only valid during the call.
+    template<typename Visit>
+    void append(const std::vector<char> &chunk, Visit &&visit) {
+        buffer_.insert(buffer_.end(), chunk.begin(), chunk.end());
+
+        auto size = buffer_.size();
+        auto *data = buffer_.data();
+        auto i = position_;
+        for (; i + 2 < size; ++i) {
+            if (data[i] || data[i + 1] || data[i + 2] != 1)
+                continue;
+
+            if (start_) {
+                // Trailing zeros belong to the next (possibly four-byte) start code.
+                auto end = i;
+                while (end > *start_ && !data[end - 1])
+                    --end;
+                visit(Nal{data + *start_, static_cast<unsigned int>(end - *start_)});
+            }
+            start_ = i + 3;
+            i += 2;
+        }
+        position_ = i;
+
+        // Drop the NALs that have been visited, keeping the start code of the current one.
+        if (start_ && *start_ > 3) {
+            auto consumed = *start_ - 3;
+            buffer_.erase(buffer_.begin(), buffer_.begin() + consumed);
+            *start_ -= consumed;
+            position_ -= consumed;
+        }
+    }
+
+    // Calls visit with the last NAL, which ends with the data.
+    template<typename Visit>
+    void finish(Visit &&visit) {
+        if (start_ && *start_ < buffer_.size())
+            visit(Nal{buffer_.data() + *start_, static_cast<unsigned int>(buffer_.size() - *start_)});
+        buffer_.clear();
+        start_.reset();
+        position_ = 0;
+    }
+
+private:
+    std::vector<char> buffer_;
+    // Where the current NAL starts, after its start code.
+    std::optional<size_t> start_;
+    // Where to look for the next start code.
+    size_t position_ = 0;
+};
+
+struct AccessUnit {
+    std::vector<char> data;
+    bool isRAP = false;
+    bool hasVCL = false;
+
+    void append(const Nal &nal) {
+        // Samples use four-byte NAL lengths instead of start codes.
+        for (auto shift : {24, 16, 8, 0})
+            data.push_back(static_cast<char>((nal.size >> shift) & 0xFF));
+        data.insert(data.end(), nal.data, nal.data + nal.size);
+    }
+};
+
+void AddParameterSet(GF_HEVCConfig *config, const Nal &nal) {
+    GF_HEVCParamArray *array = nullptr;
+    for (auto i = 0u; i < gf_list_count(config->param_array); ++i) {
+        auto *candidate = reinterpret_cast<GF_HEVCParamArray*>(gf_list_get(config->param_array, i));
+        if (candidate->type == nal.type())
+            array = candidate;
+    }
+
+    if (!array) {
+        GF_SAFEALLOC(array, GF_HEVCParamArray);
+        array->array_completeness = 1;
+        array->type = nal.type();
+        array->nalus = gf_list_new();
+        gf_list_add(config->param_array, array);
+    }
+
+    // The encoder repeats the parameter sets at every keyframe; only store each distinct one once.
+    for (auto i = 0u; i < gf_list_count(array->nalus); ++i) {
+        auto *existing = reinterpret_cast<GF_AVCConfigSlot*>(gf_list_get(array->nalus, i));
+        if (existing->size == nal.size && !memcmp(existing->data, nal.data, nal.size))
+            return;
+    }
+
+    GF_AVCConfigSlot *slot;
+    GF_SAFEALLOC(slot, GF_AVCConfigSlot);
+    slot->size = nal.size;
+    slot->data = reinterpret_cast<char*>(gf_malloc(nal.size));
+    memcpy(slot->data, nal.data, nal.size);
+    gf_list_add(array->nalus, slot);
+}
+
+void WriteHEVCTrack(GF_ISOFile *file, const EncodedChunks &chunks, unsigned int frameRate) {
+    GF_Err result;
+    auto track = gf_isom_new_track(file, 0, GF_ISOM_MEDIA_VISUAL, frameRate);
+    if (!track)
+        throw std::runtime_error("Error creating track");
+    gf_isom_set_track_enabled(file, track, 1);
+
+    std::unique_ptr<GF_HEVCConfig, decltype(&gf_odf_hevc_cfg_del)> config(gf_odf_hevc_cfg_new(), gf_odf_hevc_cfg_del);
+    config->configurationVersion = 1;
+    config->nal_unit_size = 4;
+
+    std::vector<AccessUnit> accessUnits(1);
+    auto state = std::make_unique<HEVCState>();
+    memset(state.get(), 0, sizeof(HEVCState));
+    s32 spsIndex = -1;
+
+    auto addNal = [&](const Nal &nal) {
+        auto type = nal.type();
+        if (type == VPS || type == SPS || type == PPS) {
+            if (type == SPS) {
+                // Samples only get decoding times, so their output order must match their decoding order.
+                if (stitching::TileExtractor::MaxNumReorderPics(stitching::bytestring_view(nal.data, nal.size)))
+                    throw std::runtime_error("Cannot mux HEVC streams whose pictures are output out of decoding order");
+                spsIndex = gf_media_hevc_read_sps(const_cast<char*>(nal.data), nal.size, state.get());
+            }
+            AddParameterSet(config.get(), nal);
+            return;
+        } else if (type == AUD) {
+            return;
+        }
+
+        // A new picture or a prefix NAL after the current picture's slices starts a new access unit.
+        bool startsAccessUnit = (nal.isVCL() && nal.isFirstSliceSegmentInPicture()) || type == PREFIX_SEI;
+        if (startsAccessUnit && accessUnits.back().hasVCL)
+            accessUnits.emplace_back();
+
+        auto &accessUnit = accessUnits.back();
+        accessUnit.append(nal);
+        accessUnit.hasVCL |= nal.isVCL();
+        accessUnit.isRAP |= nal.isIRAP();
+    };
+
+    NalAssembler assembler;
+    for (const auto &chunk : chunks)
+        assembler.append(*chunk, addNal);
+    assembler.finish(addNal);
+
+    if (spsIndex < 0)
+        throw std::runtime_error("No SPS found in encoded data");
+
+    auto &sps = state->sps[spsIndex];
+    config->profile_space = sps.ptl.profile_space;
+    config->tier_flag = sps.ptl.tier_flag;
+    config->profile_idc = sps.ptl.profile_idc;
+    config->general_profile_compatibility_flags = sps.ptl.profile_compatibility_flag;
+    config->progressive_source_flag = sps.ptl.general_progressive_source_flag;
+    config->interlaced_source_flag = sps.ptl.general_interlaced_source_flag;
+    config->non_packed_constraint_flag = sps.ptl.general_non_packed_constraint_flag;
+    config->frame_only_constraint_flag = sps.ptl.general_frame_only_constraint_flag;
+    config->constraint_indicator_flags = sps.ptl.general_reserved_44bits;
+    config->level_idc = sps.ptl.level_idc;
+    config->chromaFormat = sps.chroma_format_idc;
+    config->luma_bit_depth = sps.bit_depth_luma;
+    config->chroma_bit_depth = sps.bit_depth_chroma;
+
+    u32 descriptionIndex;
+    result = gf_isom_hevc_config_new(file, track, config.get(), nullptr, nullptr, &descriptionIndex);
+    if (result != GF_OK)
+        throw std::runtime_error("Error creating HEVC configuration: " + std::to_string(result));
+    gf_isom_set_visual_info(file, track, descriptionIndex, sps.width, sps.height);
+
+    // One sample per picture, with a duration of one tick at a timescale of frameRate.
+    u64 decodeTime = 0;
+    for (auto &accessUnit : accessUnits) {
+        if (!accessUnit.hasVCL)
+            continue;
+
+        GF_ISOSample *sample = gf_isom_sample_new();
+        sample->data = accessUnit.data.data();
+        sample->dataLength = accessUnit.data.size();
+        sample->DTS = decodeTime++;
+        sample->IsRAP = accessUnit.isRAP ? RAP : RAP_NO;
+        result = gf_isom_add_sample(file, track, descriptionIndex, sample);
+
+        // The sample does not own the access unit's buffer.
+        sample->data = nullptr;
+        gf_isom_sample_del(&sample);
+        if (result != GF_OK)
+            throw std::runtime_error("Error adding sample: " + std::to_string(result));
+    }
+}
+
+} // namespace
+
+void mux_hevc_from_memory(const std::vector<const EncodedChunks*> &tracks, unsigned int frameRate, const std::experimental::filesystem::path &destination) {
+    GF_ISOFile *file;
+    GF_Err result;
+
+    if((file = gf_isom_open(destination.c_str(), GF_ISOM_OPEN_WRITE, nullptr)) == nullptr)
+        throw std::runtime_error("Error opening destination file");
+
+    try {
+        for (const auto *chunks : tracks)
+            WriteHEVCTrack(file, *chunks, frameRate);
+    } catch (const std::exception&) {
+        gf_isom_delete(file);
+        throw;
+    }
+
+    if((result = gf_isom_close(file)) != GF_OK)
+        throw std::runtime_error("Error closing file: " + std::to_string(result));
+}
+
 static void write_tile_configuration(const std::experimental::filesystem::path &metadata_filename,
                                      const lightdb::serialization::TileConfiguration &tileConfiguration) {
     std::fstream output(metadata_filename, std::ios::out | std::ios::trunc | std::ios::binary);
@@ -1,11 +1,40 @@
 #include "MP4Reader.h"
 
+#include <unordered_map>
+
+std::shared_ptr<MP4Reader::Container> MP4Reader::openContainer(const std::experimental::filesystem::path &filename) {
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::weak_ptr<Container>> openContainers;
+
+    std::scoped_lock lock(mutex);
+    auto &entry = openContainers[filename.string()];
+    if (auto container = entry.lock())
+        return container;
+
+    // Drop entries for containers that every reader has closed, so the map does not grow with each file read.
+    for (auto it = openContainers.begin(); it != openContainers.end();) {
+        if (it->second.expired() && it->first != filename.string())
+            it = openContainers.erase(it);
+        else
+            ++it;
+    }
+
+    auto container = std::make_shared<Container>(filename);
+    entry = container;
+    return container;
+}
+
+unsigned int MP4Reader::numberOfReadersSharingFile() const {
+    return container_.use_count();
+}
+
 std::unique_ptr<std::vector<char>> MP4Reader::dataForSamples(unsigned int firstSampleToRead, unsigned int lastSampleToRead) const {
     unsigned long size = 0;
+    std::scoped_lock lock(container_->mutex);
 
     // First read to get sizes.
     for (auto i = firstSampleToRead; i <= lastSampleToRead; i++) {
-        GF_ISOSample *sample = gf_isom_get_sample_info(file_, trackNumber_, i, NULL, NULL);
+        GF_ISOSample *sample = gf_isom_get_sample_info(container_->file, trackNumber_, i, NULL, NULL);
         size += sample->dataLength;
         gf_isom_sample_del(&sample);
     }
@@ -14,7 +43,7 @@ std::unique_ptr<std::vector<char>> MP4Reader::dataForSamples(unsigned int firstS
     std::unique_ptr<std::vector<char>> videoData(new std::vector<char>);
     videoData->reserve(size);
     for (auto i = firstSampleToRead; i <= lastSampleToRead; i++) {
-        GF_ISOSample *sample = gf_isom_get_sample(file_, trackNumber_, i, NULL);
+        GF_ISOSample *sample = gf_isom_get_sample(container_->file, trackNumber_, i, NULL);
         videoData->insert(videoData->end(), sample->data, sample->data + sample->dataLength);
         gf_isom_sample_del(&sample);
     }
@@ -0,0 +1,231 @@
+#include "SoftwareVideoDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace tasm {
+
+static std::string ErrorString(int result) {
+    char error[AV_ERROR_MAX_STRING_SIZE];
+    return av_make_error_string(error, AV_ERROR_MAX_STRING_SIZE, result);
+}
+
+static void Release(AVCodecContext *&context, AVCodecParserContext *&parser, AVFrame *&frame, AVPacket *&packet) {
+    av_packet_free(&packet);
+    av_frame_free(&frame);
+    if (parser) {
+        av_parser_close(parser);
+        parser = nullptr;
+    }
+    avcodec_free_context(&context);
+}
+
+SoftwareVideoDecoder::SoftwareVideoDecoder(unsigned int numberOfThreads)
+    : context_(nullptr),
+    parser_(nullptr),
+    frame_(nullptr),
+    packet_(nullptr),
+    nextPts_(0),
+    sequence_(0),
+    maximumPictureOrderCount_(0),
+    sequenceHasPictures_(false),
+    numberOfFramesDecoded_(0)
+{
+    auto codec = avcodec_find_decoder(AV_CODEC_ID_HEVC);
+    if (!codec)
+        throw std::runtime_error("libavcodec was built without an HEVC decoder");
+
+    try {
+        int result;
+        if (!(context_ = avcodec_alloc_context3(codec)))
+            throw std::runtime_error("Call to avcodec_alloc_context3 failed");
+        else if (!(parser_ = av_parser_init(AV_CODEC_ID_HEVC)))
+            throw std::runtime_error("Call to av_parser_init failed");
+        else if (!(frame_ = av_frame_alloc()) || !(packet_ = av_packet_alloc()))
+            throw std::runtime_error("Failed to allocate a frame or packet for decoding");
+
+        context_->thread_count = std::max(1u, numberOfThreads);
+        if ((result = avcodec_open2(context_, codec, nullptr)) < 0)
+            throw std::runtime_error("Call to avcodec_open2 failed: " + ErrorString(result));
+    } catch (const std::exception &) {
+        Release(context_, parser_, frame_, packet_);
+        throw;
+    }
+}
+
+SoftwareVideoDecoder::~SoftwareVideoDecoder() {
+    for (auto &reordered : reorderedFrames_)
+        av_frame_free(&reordered.second);
+    Release(context_, parser_, frame_, packet_);
+}
+
+void SoftwareVideoDecoder::decode(const uint8_t *data, size_t size, const std::vector<int> &outputFrames, int tileNumber,
+                                  std::vector<CPUFramePtr> &frames) {
+    for (auto frame : outputFrames) {
+        frameNumbers_.push_back(frame);
+        tileNumbers_.push_back(tileNumber);
+    }
+
+    // The parser splits the data into access units. It holds on to the last one until it sees the start of the next.
+    while (size > 0) {
+        uint8_t *unit;
+        int unitSize;
+        auto used = av_parser_parse2(parser_, context_, &unit, &unitSize, data,
+                                     static_cast<int>(std::min<size_t>(size, std::numeric_limits<int>::max())),
+                                     AV_NOPTS_VALUE, AV_NOPTS_VALUE, 0);
+        if (used < 0)
+            throw std::runtime_error("Call to av_parser_parse2 failed: " + ErrorString(used));
+
+        data += used;
+        size -= used;
+        if (unitSize)
+            sendAccessUnit(unit, unitSize, frames);
+    }
+}
+
+void SoftwareVideoDecoder::flush(std::vector<CPUFramePtr> &frames) {
+    uint8_t *unit;
+    int unitSize;
+    av_parser_parse2(parser_, context_, &unit, &unitSize, nullptr, 0, AV_NOPTS_VALUE, AV_NOPTS_VALUE, 0);
+    if (unitSize)
+        sendAccessUnit(unit, unitSize, frames);
+
+    // Sending no data drains the frames that the decoder is holding.
+    sendPacket(nullptr, 0, frames);
+    outputFrames(true, frames);
+    // Pictures that were never output, e.g. ones that are not needed for output, are no longer expected.
+    outputOrderForPts_.clear();
+}
+
+void SoftwareVideoDecoder::sendAccessUnit(const uint8_t *data, int size, std::vector<CPUFramePtr> &frames) {
+    // The parser describes the access unit it returned. An IRAP picture whose picture order count does not follow
+    // the sequence's pictures resets it, so it starts a new coded video sequence that is output after this one.
+    auto pictureOrderCount = parser_->output_picture_number;
+    if (parser_->key_frame == 1 && sequenceHasPictures_ && pictureOrderCount <= maximumPictureOrderCount_) {
+        ++sequence_;
+        sequenceHasPictures_ = false;
+    }
+    maximumPictureOrderCount_ = sequenceHasPictures_ ? std::max(maximumPictureOrderCount_, pictureOrderCount) : pictureOrderCount;
+    sequenceHasPictures_ = true;
+
+    // libavcodec passes the packet's pts on to the frame that is decoded from it.
+    outputOrderForPts_[nextPts_] = {sequence_, pictureOrderCount};
+    packet_->pts = nextPts_++;
+    sendPacket(data, size, frames);
+}
+
+void SoftwareVideoDecoder::sendPacket(const uint8_t *data, int size, std::vector<CPUFramePtr> &frames) {
+    packet_->data = const_cast<uint8_t *>(data);
+    packet_->size = size;
+
+    int result;
+    // The decoder does not accept more data until the frames it has decoded are received.
+    while ((result = avcodec_send_packet(context_, data ? packet_ : nullptr)) == AVERROR(EAGAIN))
+        receiveFrames(frames);
+    if (result < 0)
+        throw std::runtime_error("Call to avcodec_send_packet failed: " + ErrorString(result));
+
+    receiveFrames(frames);
+}
+
+void SoftwareVideoDecoder::receiveFrames(std::vector<CPUFramePtr> &frames) {
+    while (true) {
+        auto result = avcodec_receive_frame(context_, frame_);
+        if (result == AVERROR(EAGAIN) || result == AVERROR_EOF)
+            return;
+        else if (result < 0)
+            throw std::runtime_error("Call to avcodec_receive_frame failed: " + ErrorString(result));
+
+        auto outputOrder = outputOrderForPts_.find(frame_->pts);
+        if (outputOrder == outputOrderForPts_.end()) {
+            av_frame_unref(frame_);
+            throw std::runtime_error("Decoded a frame that was not sent to the decoder");
+        }
+
+        // Keep a reference to the decoded picture rather than copying it until it is output.
+        auto &reordered = reorderedFrames_[outputOrder->second];
+        if (reordered)
+            av_frame_free(&reordered);
+        if (!(reordered = av_frame_alloc())) {
+            av_frame_unref(frame_);
+            reorderedFrames_.erase(outputOrder->second);
+            throw std::runtime_error("Failed to allocate a frame for reordering");
+        }
+        av_frame_move_ref(reordered, frame_);
+        outputOrderForPts_.erase(outputOrder);
+
+        outputFrames(false, frames);
+    }
+}
+
+void SoftwareVideoDecoder::outputFrames(bool isFlushing, std::vector<CPUFramePtr> &frames) {
+    while (!reorderedFrames_.empty()) {
+        auto next = reorderedFrames_.begin();
+        auto sequence = next->first.first;
+
+        // Like the bumping process, output a picture once more pictures are waiting than the stream can reorder.
+        // Pictures of an earlier sequence are also output once the rest of that sequence has been decoded.
+        auto shouldOutput = isFlushing || reorderedFrames_.size() > static_cast<size_t>(std::max(0, context_->has_b_frames));
+        if (!shouldOutput && sequence < sequence_) {
+            shouldOutput = std::none_of(outputOrderForPts_.begin(), outputOrderForPts_.end(), [&](const auto &pending) {
+                return pending.second.first == sequence;
+            });
+        }
+        if (!shouldOutput)
+            return;
+
+        auto frameNumber = -1;
+        auto tileNumber = -1;
+        if (!frameNumbers_.empty()) {
+            frameNumber = frameNumbers_.front();
+            tileNumber = tileNumbers_.front();
+            frameNumbers_.pop_front();
+            tileNumbers_.pop_front();
+        }
+
+        auto frame = next->second;
+        reorderedFrames_.erase(next);
+        try {
+            frames.push_back(copyFrame(*frame, frameNumber, tileNumber));
+        } catch (...) {
+            av_frame_free(&frame);
+            throw;
+        }
+        av_frame_free(&frame);
+        ++numberOfFramesDecoded_;
+    }
+}
+
+CPUFramePtr SoftwareVideoDecoder::copyFrame(const AVFrame &frame, int frameNumber, int tileNumber) const {
+    if (frame.format != AV_PIX_FMT_YUV420P && frame.format != AV_PIX_FMT_YUVJ420P) {
+        auto name = av_get_pix_fmt_name(static_cast<AVPixelFormat>(frame.format));
+        throw std::runtime_error(std::string("Software decoding does not support pixel format ") + (name ? name : "unknown"));
+    }
+
+    auto decodedFrame = std::make_shared<CPUDecodedFrame>(frame.width, frame.height, frameNumber, tileNumber);
+    auto pitch = decodedFrame->pitch();
+    for (auto y = 0; y < frame.height; ++y)
+        memcpy(decodedFrame->luma() + y * pitch, frame.data[0] + y * frame.linesize[0], frame.width);
+
+    // Interleave the planar chroma into NV12.
+    auto chromaWidth = (frame.width + 1) / 2;
+    auto chromaHeight = (frame.height + 1) / 2;
+    for (auto y = 0; y < chromaHeight; ++y) {
+        auto u = frame.data[1] + y * frame.linesize[1];
+        auto v = frame.data[2] + y * frame.linesize[2];
+        auto chroma = decodedFrame->chroma() + y * pitch;
+        for (auto x = 0; x < chromaWidth; ++x) {
+            chroma[2 * x] = u[x];
+            chroma[2 * x + 1] = v[x];
+        }
+    }
+    return decodedFrame;
+}
+
+} // namespace tasm
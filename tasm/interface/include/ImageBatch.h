@@ -0,0 +1,59 @@
+#ifndef TASM_IMAGEBATCH_H
+#define TASM_IMAGEBATCH_H
+
+#include "ImageBufferPool.h"
+#include "ImageUtilities.h"
+#include "PixelFormat.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace tasm {
+
+// Images packed back to back in one buffer, so they can be handed to a model as a single tensor.
+struct ImageBatch {
+    unsigned int numberOfImages;
+    unsigned int width;
+    unsigned int height;
+    PixelFormat format;
+    // `numberOfImages` images of PixelFormatSize(format, width, height) bytes each.
+    PooledBuffer pixels;
+    // For each image, the frame it is from and its box in the frame as x1, y1, x2, y2.
+    // Boxes are in frame coordinates, before any resizing.
+    std::vector<int> frameNumbers;
+    std::vector<unsigned int> boxes;
+
+    unsigned int imageSize() const { return PixelFormatSize(format, width, height); }
+};
+
+// Groups the images from an iterator into batches.
+class ImageBatcher {
+public:
+    explicit ImageBatcher(std::shared_ptr<ImageIterator> imageIterator)
+        : ImageBatcher([imageIterator] { return imageIterator->next(); }, imageIterator->format())
+    {}
+
+    // `nextImage` returns images in `format` until it returns an empty pointer.
+    ImageBatcher(std::function<ImagePtr()> nextImage, PixelFormat format)
+        : nextImage_(std::move(nextImage)), format_(format)
+    {}
+
+    // Returns the next image that has not been put in a batch, or an empty pointer when there are none left.
+    ImagePtr nextImage();
+
+    // Returns up to `maxImages` images.
+    // When `height` and `width` are 0, images keep their size, and the batch ends before the first image whose size differs.
+    // Otherwise every image is scaled to fit in `width` x `height`, keeping its aspect ratio, and centered on a black border.
+    // The batch is empty when there are no images left.
+    ImageBatch next(unsigned int maxImages, unsigned int height = 0, unsigned int width = 0);
+
+private:
+    std::function<ImagePtr()> nextImage_;
+    PixelFormat format_;
+    ImagePtr pending_;
+};
+
+} // namespace tasm
+
+#endif //TASM_IMAGEBATCH_H
@@ -0,0 +1,94 @@
+#ifndef TASM_IMAGEBUFFERPOOL_H
+#define TASM_IMAGEBUFFERPOOL_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace tasm {
+
+class ImageBufferPool;
+
+// Returns a buffer to the pool it came from, or frees it if it did not come from a pool.
+class PooledBufferDeleter {
+public:
+    PooledBufferDeleter()
+        : pool_(nullptr), sizeClass_(0)
+    {}
+
+    PooledBufferDeleter(ImageBufferPool *pool, unsigned int sizeClass)
+        : pool_(pool), sizeClass_(sizeClass)
+    {}
+
+    void operator()(uint8_t *buffer) const;
+
+private:
+    ImageBufferPool *pool_;
+    unsigned int sizeClass_;
+};
+
+using PooledBuffer = std::unique_ptr<uint8_t[], PooledBufferDeleter>;
+
+struct ImageBufferPoolStatistics {
+    unsigned long long allocations;
+    unsigned long long reuses;
+    unsigned long long bytesAllocated;
+    unsigned long long bytesInUse;
+    unsigned long long bytesPooled;
+    unsigned long long capacityInBytes;
+};
+
+// Recycles the pixel buffers of images, so steady-state queries do not allocate pixels on the heap.
+// Buffers are grouped into size classes, four for each power of two, so a recycled buffer is at most 25% larger than requested.
+// Released buffers are kept until the pool holds `capacityInBytes` of idle buffers; a capacity of 0 disables pooling.
+// Buffers must be released before the pool that they came from is destroyed.
+class ImageBufferPool {
+public:
+    static ImageBufferPool &instance();
+
+    explicit ImageBufferPool(unsigned long long capacityInBytes)
+        : capacityInBytes_(capacityInBytes),
+        bytesInUse_(0), bytesPooled_(0),
+        allocations_(0), reuses_(0), bytesAllocated_(0)
+    {}
+
+    ~ImageBufferPool();
+
+    ImageBufferPool(const ImageBufferPool &) = delete;
+    ImageBufferPool &operator=(const ImageBufferPool &) = delete;
+
+    // Returns a buffer of at least `size` bytes.
+    PooledBuffer allocate(unsigned long long size);
+
+    void setCapacity(unsigned long long capacityInBytes);
+    void clear();
+
+    ImageBufferPoolStatistics statistics() const;
+    void resetStatistics();
+
+    static unsigned int sizeClassForSize(unsigned long long size);
+    static unsigned long long sizeForClass(unsigned int sizeClass);
+
+private:
+    friend class PooledBufferDeleter;
+    void release(uint8_t *buffer, unsigned int sizeClass);
+    void shrinkToCapacity();
+
+    static constexpr unsigned long long MinimumBufferSize = 256;
+
+    unsigned long long capacityInBytes_;
+    unsigned long long bytesInUse_;
+    unsigned long long bytesPooled_;
+    std::vector<std::vector<uint8_t *>> buffersForSizeClass_;
+
+    unsigned long long allocations_;
+    unsigned long long reuses_;
+    unsigned long long bytesAllocated_;
+
+    mutable std::mutex mutex_;
+};
+
+} // namespace tasm
+
+#endif //TASM_IMAGEBUFFERPOOL_H
@@ -0,0 +1,47 @@
+#ifndef TASM_IMAGEPREFETCHER_H
+#define TASM_IMAGEPREFETCHER_H
+
+#include "ImageUtilities.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace tasm {
+
+// Pulls images from an iterator on a background thread, so up to `depth` images are ready when they are asked for.
+// Images are returned in the same order as the iterator returns them.
+class ImagePrefetcher {
+public:
+    ImagePrefetcher(std::shared_ptr<ImageIterator> imageIterator, unsigned int depth);
+    ~ImagePrefetcher();
+
+    ImagePrefetcher(const ImagePrefetcher &) = delete;
+    ImagePrefetcher &operator=(const ImagePrefetcher &) = delete;
+
+    PixelFormat format() const { return imageIterator_->format(); }
+
+    // Returns an empty pointer once the iterator is done.
+    ImagePtr next();
+
+private:
+    void readImages();
+
+    std::shared_ptr<ImageIterator> imageIterator_;
+    const unsigned int depth_;
+
+    std::deque<ImagePtr> images_;
+    bool isDone_;
+    bool shouldStop_;
+    std::exception_ptr error_;
+
+    std::mutex mutex_;
+    std::condition_variable imageAvailable_;
+    std::condition_variable spaceAvailable_;
+    std::thread thread_;
+};
+
+} // namespace tasm
+
+#endif //TASM_IMAGEPREFETCHER_H
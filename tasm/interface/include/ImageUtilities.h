@@ -1,34 +1,69 @@
 #ifndef TASM_IMAGEITERATOR_H
 #define TASM_IMAGEITERATOR_H
 
+#include "ImageBufferPool.h"
 #include "Operator.h"
+#include "PixelFormat.h"
 
 #include <memory>
+#include <shared_mutex>
 
 using PixelPtr = uint8_t[];
 class Image {
 public:
-    Image(unsigned int width, unsigned int height, std::unique_ptr<PixelPtr> pixels)
-            : width_(width), height_(height), pixels_(std::move(pixels))
+    Image(unsigned int width, unsigned int height, std::unique_ptr<PixelPtr> pixels, tasm::PixelFormat format = tasm::PixelFormat::RGBA)
+            : Image(width, height, tasm::PooledBuffer(pixels.release()), format)
+    {}
+
+    // The buffer goes back to its pool when the image is destroyed.
+    // `frameNumber`, `x`, and `y` locate the image in the video; the frame number is -1 when it is not known.
+    Image(unsigned int width, unsigned int height, tasm::PooledBuffer pixels, tasm::PixelFormat format = tasm::PixelFormat::RGBA,
+          int frameNumber = -1, unsigned int x = 0, unsigned int y = 0)
+            : width_(width), height_(height), format_(format),
+            frameNumber_(frameNumber), x_(x), y_(y),
+            pixels_(std::move(pixels))
     {}
 
     unsigned int width() const { return width_; }
     unsigned int height() const { return height_; }
+    tasm::PixelFormat format() const { return format_; }
+    // Number of bytes of pixels.
+    unsigned int size() const { return tasm::PixelFormatSize(format_, width_, height_); }
     uint8_t* pixels() const { return pixels_.get(); }
 
+    int frameNumber() const { return frameNumber_; }
+    // The top-left corner of the image in the full frame.
+    unsigned int x() const { return x_; }
+    unsigned int y() const { return y_; }
+
 private:
     unsigned int width_;
     unsigned int height_;
-    std::unique_ptr<PixelPtr> pixels_;
+    tasm::PixelFormat format_;
+    int frameNumber_;
+    unsigned int x_;
+    unsigned int y_;
+    tasm::PooledBuffer pixels_;
 };
 using ImagePtr = std::shared_ptr<Image>;
 
 class ImageIterator {
 public:
-    ImageIterator(std::shared_ptr<Operator<std::unique_ptr<std::vector<ImagePtr>>>> parent)
-    : parent_(parent) {}
+    ImageIterator(std::shared_ptr<Operator<std::unique_ptr<std::vector<ImagePtr>>>> parent, tasm::PixelFormat format = tasm::PixelFormat::RGBA)
+    : parent_(parent), format_(format) {}
+
+    // The format of every image that the iterator returns.
+    tasm::PixelFormat format() const { return format_; }
+
+    // Each image is produced while holding `readLock` as a reader, including when it is produced on a prefetch thread.
+    // Callers that change the catalog or the semantic index while holding it as a writer then do not race the decode.
+    void setReadLock(std::shared_ptr<std::shared_mutex> readLock) { readLock_ = std::move(readLock); }
 
     ImagePtr next() {
+        std::shared_lock<std::shared_mutex> lock;
+        if (readLock_)
+            lock = std::shared_lock<std::shared_mutex>(*readLock_);
+
         if (!currentImages_ || imageIterator_ == currentImages_->end())
             getNextSetOfImages();
 
@@ -53,6 +88,8 @@ private:
     }
 
     std::shared_ptr<Operator<std::unique_ptr<std::vector<ImagePtr>>>> parent_;
+    tasm::PixelFormat format_;
+    std::shared_ptr<std::shared_mutex> readLock_;
     std::unique_ptr<std::vector<ImagePtr>> currentImages_;
     std::vector<ImagePtr>::const_iterator imageIterator_;
 };
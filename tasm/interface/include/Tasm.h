@@ -41,52 +41,61 @@ public:
         videoManager_.storeWithUniformLayout(videoPath, savedName, rows, columns);
     }
 
+    virtual void storePreTiled(const std::string &videoPath, const std::string &savedName) {
+        videoManager_.storePreTiled(videoPath, savedName);
+    }
+
     virtual void storeWithNonUniformLayout(const std::string &videoPath, const std::string &savedName, const std::string &metadataIdentifier, const std::string &labelToTileAround, bool force = true) {
         videoManager_.storeWithNonUniformLayout(videoPath, savedName, metadataIdentifier, std::make_shared<SingleMetadataSelection>(labelToTileAround), semanticIndex_, force);
     }
 
-    virtual std::unique_ptr<ImageIterator> select(const std::string &video, const std::string &label, const std::string &metadataIdentifier = "") {
-        return select(video, label, std::shared_ptr<TemporalSelection>(), metadataIdentifier);
+    virtual std::unique_ptr<ImageIterator> select(const std::string &video, const std::string &label, const std::string &metadataIdentifier = "", PixelFormat format = PixelFormat::RGBA) {
+        return select(video, label, std::shared_ptr<TemporalSelection>(), metadataIdentifier, SelectStrategy::Objects, format);
     }
 
-    virtual std::unique_ptr<ImageIterator> select(const std::string &video, const std::string &label, unsigned int frame, const std::string &metadataIdentifier = "") {
-        return select(video, label, std::make_shared<EqualTemporalSelection>(frame), metadataIdentifier);
+    virtual std::unique_ptr<ImageIterator> select(const std::string &video, const std::string &label, unsigned int frame, const std::string &metadataIdentifier = "", PixelFormat format = PixelFormat::RGBA) {
+        return select(video, label, std::make_shared<EqualTemporalSelection>(frame), metadataIdentifier, SelectStrategy::Objects, format);
     }
 
     virtual std::unique_ptr<ImageIterator> select(const std::string &video,
                          const std::string &label,
                          unsigned int firstFrameInclusive,
                          unsigned int lastFrameExclusive,
-                         const std::string &metadataIdentifier = "") {
-        return select(video, label, std::make_shared<RangeTemporalSelection>(firstFrameInclusive, lastFrameExclusive), metadataIdentifier);
+                         const std::string &metadataIdentifier = "",
+                         PixelFormat format = PixelFormat::RGBA) {
+        return select(video, label, std::make_shared<RangeTemporalSelection>(firstFrameInclusive, lastFrameExclusive), metadataIdentifier, SelectStrategy::Objects, format);
     }
 
     virtual std::unique_ptr<ImageIterator> selectTiles(const std::string &video,
                 const std::string &label,
-                const std::string &metadataIdentifier = "") {
-        return select(video, label, std::shared_ptr<TemporalSelection>(), metadataIdentifier, SelectStrategy::Tiles);
+                const std::string &metadataIdentifier = "",
+                PixelFormat format = PixelFormat::RGBA) {
+        return select(video, label, std::shared_ptr<TemporalSelection>(), metadataIdentifier, SelectStrategy::Tiles, format);
     }
 
     virtual std::unique_ptr<ImageIterator> selectTiles(const std::string &video,
                                                        const std::string &label,
                                                        unsigned int firstFrameInclusive,
                                                        unsigned int lastFrameExclusive,
-                                                       const std::string &metadataIdentifier = "") {
-        return select(video, label, std::make_shared<RangeTemporalSelection>(firstFrameInclusive, lastFrameExclusive), metadataIdentifier, SelectStrategy::Tiles);
+                                                       const std::string &metadataIdentifier = "",
+                                                       PixelFormat format = PixelFormat::RGBA) {
+        return select(video, label, std::make_shared<RangeTemporalSelection>(firstFrameInclusive, lastFrameExclusive), metadataIdentifier, SelectStrategy::Tiles, format);
     }
 
     virtual std::unique_ptr<ImageIterator> selectFrames(const std::string &video,
             const std::string &label,
-            const std::string &metadataIdentifier = "") {
-        return select(video, label, std::shared_ptr<TemporalSelection>(), metadataIdentifier, SelectStrategy::Frames);
+            const std::string &metadataIdentifier = "",
+            PixelFormat format = PixelFormat::RGBA) {
+        return select(video, label, std::shared_ptr<TemporalSelection>(), metadataIdentifier, SelectStrategy::Frames, format);
     }
 
     virtual std::unique_ptr<ImageIterator> selectFrames(const std::string &video,
                                                         const std::string &label,
                                                         unsigned int firstFrameInclusive,
                                                         unsigned int lastFrameExclusive,
-                                                        const std::string &metadataIdentifier = "") {
-        return select(video, label, std::make_shared<RangeTemporalSelection>(firstFrameInclusive, lastFrameExclusive), metadataIdentifier, SelectStrategy::Frames);
+                                                        const std::string &metadataIdentifier = "",
+                                                        PixelFormat format = PixelFormat::RGBA) {
+        return select(video, label, std::make_shared<RangeTemporalSelection>(firstFrameInclusive, lastFrameExclusive), metadataIdentifier, SelectStrategy::Frames, format);
     }
 
     void retileVideoBasedOnRegret(const std::string &video) {
@@ -101,6 +110,19 @@ public:
         videoManager_.deactivateRegretBasedRetilingForVideo(video);
     }
 
+    // Removes tile versions that are fully shadowed by newer versions.
+    unsigned int compactTileVersions(const std::string &video) {
+        return videoManager_.compactTileVersions(video);
+    }
+
+    void startBackgroundCompaction(unsigned int intervalInSeconds) {
+        videoManager_.startBackgroundCompaction(std::chrono::seconds(intervalInSeconds));
+    }
+
+    void stopBackgroundCompaction() {
+        videoManager_.stopBackgroundCompaction();
+    }
+
     virtual ~TASM() = default;
 
     std::shared_ptr<SemanticIndex> semanticIndex() const {
@@ -108,14 +130,15 @@ public:
     }
 
 private:
-    std::unique_ptr<ImageIterator> select(const std::string &video, const std::string &label, std::shared_ptr<TemporalSelection> temporalSelection, const std::string &metadataIdentifier, SelectStrategy strategy=SelectStrategy::Objects) {
+    std::unique_ptr<ImageIterator> select(const std::string &video, const std::string &label, std::shared_ptr<TemporalSelection> temporalSelection, const std::string &metadataIdentifier, SelectStrategy strategy, PixelFormat format) {
         return videoManager_.select(
                 video,
                 metadataIdentifier.length() ? metadataIdentifier : video,
                 std::make_shared<SingleMetadataSelection>(label),
                 temporalSelection,
                 semanticIndex_,
-                strategy);
+                strategy,
+                format);
     }
 
     std::shared_ptr<SemanticIndex> semanticIndex_;
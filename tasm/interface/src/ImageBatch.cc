@@ -0,0 +1,159 @@
+#include "ImageBatch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace tasm {
+
+namespace {
+
+struct Sample {
+    unsigned int first;
+    unsigned int second;
+    float weight;
+};
+
+// Finds the two source pixels that surround each destination pixel, matching their centers.
+std::vector<Sample> Samples(unsigned int sourceSize, unsigned int destinationSize) {
+    std::vector<Sample> samples(destinationSize);
+    auto scale = static_cast<float>(sourceSize) / destinationSize;
+    for (auto i = 0u; i < destinationSize; ++i) {
+        auto position = std::min(std::max((i + 0.5f) * scale - 0.5f, 0.0f), static_cast<float>(sourceSize - 1));
+        auto first = static_cast<unsigned int>(position);
+        samples[i] = {first, std::min(first + 1, sourceSize - 1), position - first};
+    }
+    return samples;
+}
+
+// Scales a plane of `channels` interleaved bytes per pixel with bilinear interpolation.
+void ResizeBilinear(const uint8_t *source, unsigned int sourceWidth, unsigned int sourceHeight, unsigned int channels,
+                    uint8_t *destination, unsigned int destinationWidth, unsigned int destinationHeight, unsigned int destinationPitch) {
+    if (sourceWidth == destinationWidth && sourceHeight == destinationHeight) {
+        for (auto row = 0u; row < sourceHeight; ++row)
+            memcpy(destination + row * destinationPitch, source + row * sourceWidth * channels, sourceWidth * channels);
+        return;
+    }
+
+    auto columns = Samples(sourceWidth, destinationWidth);
+    auto rows = Samples(sourceHeight, destinationHeight);
+    auto sourcePitch = sourceWidth * channels;
+    for (auto row = 0u; row < destinationHeight; ++row) {
+        auto top = source + rows[row].first * sourcePitch;
+        auto bottom = source + rows[row].second * sourcePitch;
+        auto fy = rows[row].weight;
+        auto out = destination + row * destinationPitch;
+        for (auto column = 0u; column < destinationWidth; ++column) {
+            auto left = columns[column].first * channels;
+            auto right = columns[column].second * channels;
+            auto fx = columns[column].weight;
+            for (auto channel = 0u; channel < channels; ++channel) {
+                auto upper = top[left + channel] + fx * (top[right + channel] - top[left + channel]);
+                auto lower = bottom[left + channel] + fx * (bottom[right + channel] - bottom[left + channel]);
+                out[column * channels + channel] = static_cast<uint8_t>(upper + fy * (lower - upper) + 0.5f);
+            }
+        }
+    }
+}
+
+unsigned int InterleavedChannels(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::RGBA:
+            return 4;
+        case PixelFormat::RGB:
+        case PixelFormat::BGR:
+            return 3;
+        case PixelFormat::PlanarRGB:
+        case PixelFormat::Gray:
+            return 1;
+        case PixelFormat::NV12:
+            break;
+    }
+    throw std::runtime_error("Batches of NV12 images cannot be resized");
+}
+
+// Scales `image` to fit in a `width` x `height` image at `destination`, keeping its aspect ratio and centering it.
+// `destination` must already be black.
+void Letterbox(const Image &image, unsigned int width, unsigned int height, uint8_t *destination) {
+    auto scale = std::min(static_cast<float>(width) / image.width(), static_cast<float>(height) / image.height());
+    auto scaledWidth = std::min(std::max(static_cast<unsigned int>(std::lround(image.width() * scale)), 1u), width);
+    auto scaledHeight = std::min(std::max(static_cast<unsigned int>(std::lround(image.height() * scale)), 1u), height);
+    auto left = (width - scaledWidth) / 2;
+    auto top = (height - scaledHeight) / 2;
+
+    auto channels = InterleavedChannels(image.format());
+    auto planes = image.format() == PixelFormat::PlanarRGB ? 3u : 1u;
+    auto sourcePlaneSize = image.width() * image.height();
+    auto destinationPlaneSize = width * height;
+    for (auto plane = 0u; plane < planes; ++plane) {
+        ResizeBilinear(image.pixels() + plane * sourcePlaneSize, image.width(), image.height(), channels,
+                       destination + plane * destinationPlaneSize + (top * width + left) * channels,
+                       scaledWidth, scaledHeight, width * channels);
+    }
+}
+
+} // namespace
+
+ImagePtr ImageBatcher::nextImage() {
+    if (pending_)
+        return std::move(pending_);
+    return nextImage_();
+}
+
+ImageBatch ImageBatcher::next(unsigned int maxImages, unsigned int height, unsigned int width) {
+    if (!maxImages)
+        throw std::runtime_error("A batch must hold at least one image");
+    if (!height != !width)
+        throw std::runtime_error("Both the height and width of a batch must be specified to resize it");
+
+    auto format = format_;
+    auto resize = height && width;
+    if (resize && format == PixelFormat::NV12)
+        throw std::runtime_error("Batches of NV12 images cannot be resized");
+
+    std::vector<ImagePtr> images;
+    while (images.size() < maxImages) {
+        auto image = nextImage();
+        if (!image)
+            break;
+
+        if (!resize && !images.empty()
+                && (image->width() != images.front()->width() || image->height() != images.front()->height())) {
+            pending_ = std::move(image);
+            break;
+        }
+        images.push_back(std::move(image));
+    }
+
+    ImageBatch batch{static_cast<unsigned int>(images.size()), width, height, format, PooledBuffer(), {}, {}};
+    if (images.empty())
+        return batch;
+
+    if (!resize) {
+        batch.width = images.front()->width();
+        batch.height = images.front()->height();
+    }
+
+    auto imageSize = batch.imageSize();
+    batch.pixels = ImageBufferPool::instance().allocate(static_cast<unsigned long long>(imageSize) * images.size());
+    if (resize)
+        memset(batch.pixels.get(), 0, static_cast<unsigned long long>(imageSize) * images.size());
+
+    batch.frameNumbers.reserve(images.size());
+    batch.boxes.reserve(4 * images.size());
+    for (auto i = 0u; i < images.size(); ++i) {
+        auto &image = *images[i];
+        auto destination = batch.pixels.get() + static_cast<unsigned long long>(i) * imageSize;
+        if (resize)
+            Letterbox(image, width, height, destination);
+        else
+            memcpy(destination, image.pixels(), imageSize);
+
+        batch.frameNumbers.push_back(image.frameNumber());
+        batch.boxes.insert(batch.boxes.end(), {image.x(), image.y(), image.x() + image.width(), image.y() + image.height()});
+    }
+    return batch;
+}
+
+} // namespace tasm
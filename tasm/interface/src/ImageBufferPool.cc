@@ -0,0 +1,118 @@
+#include "ImageBufferPool.h"
+
+#include "EnvironmentConfiguration.h"
+#include <cassert>
+
+namespace tasm {
+
+void PooledBufferDeleter::operator()(uint8_t *buffer) const {
+    if (pool_)
+        pool_->release(buffer, sizeClass_);
+    else
+        delete[] buffer;
+}
+
+ImageBufferPool &ImageBufferPool::instance() {
+    // Images can outlive static destructors, e.g. when Python frees them at exit, so the pool is never destroyed.
+    static auto pool = new ImageBufferPool(EnvironmentConfiguration::instance().imageBufferPoolSize());
+    return *pool;
+}
+
+ImageBufferPool::~ImageBufferPool() {
+    clear();
+}
+
+unsigned int ImageBufferPool::sizeClassForSize(unsigned long long size) {
+    if (size <= MinimumBufferSize)
+        return 0;
+
+    // Find the power of two below the size, then the quarter of it that the size falls in.
+    unsigned int octave = 63 - __builtin_clzll((size - 1) / MinimumBufferSize);
+    auto base = MinimumBufferSize << octave;
+    auto step = (size - base + base / 4 - 1) / (base / 4);
+    return octave * 4 + step;
+}
+
+unsigned long long ImageBufferPool::sizeForClass(unsigned int sizeClass) {
+    return (MinimumBufferSize << (sizeClass / 4)) / 4 * (4 + sizeClass % 4);
+}
+
+PooledBuffer ImageBufferPool::allocate(unsigned long long size) {
+    auto sizeClass = sizeClassForSize(size);
+    auto classSize = sizeForClass(sizeClass);
+    assert(classSize >= size);
+
+    {
+        std::scoped_lock lock(mutex_);
+        bytesInUse_ += classSize;
+        if (sizeClass < buffersForSizeClass_.size() && !buffersForSizeClass_[sizeClass].empty()) {
+            auto buffer = buffersForSizeClass_[sizeClass].back();
+            buffersForSizeClass_[sizeClass].pop_back();
+            bytesPooled_ -= classSize;
+            ++reuses_;
+            return PooledBuffer(buffer, PooledBufferDeleter(this, sizeClass));
+        }
+
+        ++allocations_;
+        bytesAllocated_ += classSize;
+    }
+
+    return PooledBuffer(new uint8_t[classSize], PooledBufferDeleter(this, sizeClass));
+}
+
+void ImageBufferPool::release(uint8_t *buffer, unsigned int sizeClass) {
+    auto classSize = sizeForClass(sizeClass);
+    {
+        std::scoped_lock lock(mutex_);
+        bytesInUse_ -= classSize;
+        if (bytesPooled_ + classSize <= capacityInBytes_) {
+            if (sizeClass >= buffersForSizeClass_.size())
+                buffersForSizeClass_.resize(sizeClass + 1);
+            buffersForSizeClass_[sizeClass].push_back(buffer);
+            bytesPooled_ += classSize;
+            return;
+        }
+    }
+
+    delete[] buffer;
+}
+
+void ImageBufferPool::shrinkToCapacity() {
+    // Free the largest buffers first.
+    for (auto sizeClass = buffersForSizeClass_.size(); sizeClass-- > 0 && bytesPooled_ > capacityInBytes_;) {
+        auto &buffers = buffersForSizeClass_[sizeClass];
+        while (!buffers.empty() && bytesPooled_ > capacityInBytes_) {
+            delete[] buffers.back();
+            buffers.pop_back();
+            bytesPooled_ -= sizeForClass(sizeClass);
+        }
+    }
+}
+
+void ImageBufferPool::setCapacity(unsigned long long capacityInBytes) {
+    std::scoped_lock lock(mutex_);
+    capacityInBytes_ = capacityInBytes;
+    shrinkToCapacity();
+}
+
+void ImageBufferPool::clear() {
+    std::scoped_lock lock(mutex_);
+    for (auto &buffers : buffersForSizeClass_) {
+        for (auto buffer : buffers)
+            delete[] buffer;
+    }
+    buffersForSizeClass_.clear();
+    bytesPooled_ = 0;
+}
+
+ImageBufferPoolStatistics ImageBufferPool::statistics() const {
+    std::scoped_lock lock(mutex_);
+    return {allocations_, reuses_, bytesAllocated_, bytesInUse_, bytesPooled_, capacityInBytes_};
+}
+
+void ImageBufferPool::resetStatistics() {
+    std::scoped_lock lock(mutex_);
+    allocations_ = reuses_ = bytesAllocated_ = 0;
+}
+
+} // namespace tasm
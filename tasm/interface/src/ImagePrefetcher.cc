@@ -0,0 +1,72 @@
+#include "ImagePrefetcher.h"
+
+#include <cassert>
+
+namespace tasm {
+
+ImagePrefetcher::ImagePrefetcher(std::shared_ptr<ImageIterator> imageIterator, unsigned int depth)
+    : imageIterator_(imageIterator),
+    depth_(depth),
+    isDone_(false),
+    shouldStop_(false)
+{
+    assert(depth_);
+    thread_ = std::thread(&ImagePrefetcher::readImages, this);
+}
+
+ImagePrefetcher::~ImagePrefetcher() {
+    {
+        std::scoped_lock lock(mutex_);
+        shouldStop_ = true;
+    }
+    spaceAvailable_.notify_all();
+    thread_.join();
+}
+
+void ImagePrefetcher::readImages() {
+    try {
+        while (true) {
+            {
+                std::unique_lock lock(mutex_);
+                spaceAvailable_.wait(lock, [&] { return shouldStop_ || images_.size() < depth_; });
+                if (shouldStop_)
+                    return;
+            }
+
+            // Only this thread reads from the iterator, so it does not need to hold the lock.
+            auto image = imageIterator_->next();
+
+            std::scoped_lock lock(mutex_);
+            if (!image) {
+                isDone_ = true;
+                imageAvailable_.notify_all();
+                return;
+            }
+            images_.push_back(std::move(image));
+            imageAvailable_.notify_all();
+        }
+    } catch (...) {
+        std::scoped_lock lock(mutex_);
+        error_ = std::current_exception();
+        imageAvailable_.notify_all();
+    }
+}
+
+ImagePtr ImagePrefetcher::next() {
+    std::unique_lock lock(mutex_);
+    imageAvailable_.wait(lock, [&] { return error_ || !images_.empty() || isDone_; });
+
+    // Images that were read before an error are still returned.
+    if (!images_.empty()) {
+        auto image = std::move(images_.front());
+        images_.pop_front();
+        spaceAvailable_.notify_all();
+        return image;
+    }
+
+    if (error_)
+        std::rethrow_exception(error_);
+    return ImagePtr();
+}
+
+} // namespace tasm
@@ -4,8 +4,12 @@
 #include "Operator.h"
 
 #include "EncodedData.h"
+#include "SoftwareVideoDecoder.h"
 #include "VideoDecoder.h"
 #include "VideoDecoderSession.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 
 namespace tasm {
 
@@ -79,6 +83,94 @@ private:
     int numberOfFramesDecoded_;
 };
 
+// Returns the frames of several decoders as they become available.
+// The decoders are polled in turn so that one that is reconfiguring does not hold up the others.
+class InterleaveDecodedFrames : public ConfigurationOperator<GPUDecodedFrameData> {
+public:
+    InterleaveDecodedFrames(std::vector<std::shared_ptr<ConfigurationOperator<GPUDecodedFrameData>>> decoders)
+        : isComplete_(false),
+        decoders_(std::move(decoders)),
+        nextDecoder_(0)
+    {
+        assert(!decoders_.empty());
+    }
+
+    const Configuration &configuration() override { return decoders_.front()->configuration(); }
+
+    bool isComplete() override { return isComplete_; }
+
+    std::optional<GPUDecodedFrameData> next() override {
+        while (!isComplete_) {
+            auto &decoder = decoders_[nextDecoder_];
+            nextDecoder_ = (nextDecoder_ + 1) % decoders_.size();
+            if (!decoder->isComplete()) {
+                auto decodedData = decoder->next();
+                if (decodedData)
+                    return decodedData;
+            }
+
+            isComplete_ = std::all_of(decoders_.begin(), decoders_.end(), [](auto &decoder) { return decoder->isComplete(); });
+        }
+        return std::nullopt;
+    }
+
+private:
+    bool isComplete_;
+    std::vector<std::shared_ptr<ConfigurationOperator<GPUDecodedFrameData>>> decoders_;
+    unsigned int nextDecoder_;
+};
+
+// Decodes on the CPU with libavcodec, for hosts without a GPU.
+// Each tile is decoded by its own SoftwareVideoDecoder on its own thread, up to `maximumNumberOfStreams` threads;
+// beyond that, tiles share decoders. Frames are returned in the order they are decoded, not in frame order.
+class SoftwareDecodeFromCPU : public Operator<CPUDecodedFrameData> {
+public:
+    SoftwareDecodeFromCPU(std::shared_ptr<Operator<CPUEncodedFrameDataPtr>> scan,
+            unsigned int maximumNumberOfStreams,
+            unsigned int threadsPerStream = 1);
+    ~SoftwareDecodeFromCPU();
+
+    bool isComplete() override { return isComplete_; }
+    std::optional<CPUDecodedFrameData> next() override;
+
+private:
+    struct TileStream {
+        std::deque<CPUEncodedFrameDataPtr> packets;
+        std::thread thread;
+    };
+
+    void readPackets();
+    void decodeStream(TileStream &stream);
+    // Must be called with mutex_ held.
+    TileStream &streamForTile(int tileNumber);
+    bool outputFrames(std::vector<CPUFramePtr> &frames);
+    bool isDoneDecoding() const { return isDoneReading_ && numberOfStreamsDone_ == streams_.size(); }
+
+    bool isComplete_;
+    std::shared_ptr<Operator<CPUEncodedFrameDataPtr>> scan_;
+    const unsigned int maximumNumberOfStreams_;
+    const unsigned int threadsPerStream_;
+
+    std::vector<std::unique_ptr<TileStream>> streams_;
+    std::unordered_map<int, TileStream *> tileToStream_;
+    std::vector<CPUFramePtr> decodedFrames_;
+    bool isDoneReading_;
+    unsigned int numberOfStreamsDone_;
+    bool shouldStop_;
+    std::exception_ptr error_;
+    unsigned long long numberOfFramesDecoded_;
+
+    std::mutex mutex_;
+    std::condition_variable packetAvailable_;
+    std::condition_variable spaceForPackets_;
+    std::condition_variable framesAvailable_;
+    std::condition_variable spaceForFrames_;
+    std::thread reader_;
+
+    static const unsigned int maximumNumberOfPacketsPerStream_ = 4;
+    static const unsigned int maximumNumberOfDecodedFrames_ = 64;
+};
+
 } // namespace tasm
 
 
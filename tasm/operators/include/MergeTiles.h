@@ -10,55 +10,77 @@ namespace tasm {
 class SemanticDataManager;
 class TileLayoutProvider;
 
-class TransformToRGB : public Operator<GPUDecodedFrameData> {
+// Crops the objects out of decoded NV12 tiles.
+// The crops are converted to RGB afterwards, so only the pixels of objects are converted.
+class MergeTilesOperator : public Operator<GPUPixelDataContainer> {
 public:
-    TransformToRGB(
-            std::shared_ptr<ConfigurationOperator<GPUDecodedFrameData>> parent
-    )
-        : isComplete_(false),
-        parent_(parent)
-    { }
+    MergeTilesOperator(
+            std::shared_ptr<Operator<GPUDecodedFrameData>> parent,
+            std::shared_ptr<SemanticDataManager> semanticDataManager,
+            std::shared_ptr<TileLayoutProvider> tileLayoutProvider)
+            : parent_(parent), semanticDataManager_(semanticDataManager),
+            tileLayoutProvider_(tileLayoutProvider), isComplete_(false) {}
 
     bool isComplete() override { return isComplete_; }
-    std::optional<GPUDecodedFrameData> next() override;
+    std::optional<GPUPixelDataContainer> next() override;
 
 private:
+    std::shared_ptr<Operator<GPUDecodedFrameData>> parent_;
+    std::shared_ptr<SemanticDataManager> semanticDataManager_;
+    std::shared_ptr<TileLayoutProvider> tileLayoutProvider_;
     bool isComplete_;
-    std::shared_ptr<ConfigurationOperator<GPUDecodedFrameData>> parent_;
+};
+
+class TilesToPixelsOperator : public Operator<GPUPixelDataContainer> {
+public:
+    TilesToPixelsOperator(std::shared_ptr<Operator<GPUDecodedFrameData>> parent,
+                          std::shared_ptr<TileLayoutProvider> tileLayoutProvider)
+        : parent_(parent),
+        tileLayoutProvider_(tileLayoutProvider),
+        isComplete_(false) {}
+
+    bool isComplete() override { return isComplete_; }
+    std::optional<GPUPixelDataContainer> next() override;
 
-    static const unsigned int numChannels_ = 4;
+private:
+    std::shared_ptr<Operator<GPUDecodedFrameData>> parent_;
+    std::shared_ptr<TileLayoutProvider> tileLayoutProvider_;
+    bool isComplete_;
 };
 
-class MergeTilesOperator : public Operator<GPUPixelDataContainer> {
+// Crops the objects out of tiles that were decoded on the CPU.
+class MergeCPUTilesOperator : public Operator<CPUPixelDataContainer> {
 public:
-    MergeTilesOperator(
-            std::shared_ptr<Operator<GPUDecodedFrameData>> parent,
+    MergeCPUTilesOperator(
+            std::shared_ptr<Operator<CPUDecodedFrameData>> parent,
             std::shared_ptr<SemanticDataManager> semanticDataManager,
             std::shared_ptr<TileLayoutProvider> tileLayoutProvider)
             : parent_(parent), semanticDataManager_(semanticDataManager),
             tileLayoutProvider_(tileLayoutProvider), isComplete_(false) {}
 
     bool isComplete() override { return isComplete_; }
-    std::optional<GPUPixelDataContainer> next() override;
+    std::optional<CPUPixelDataContainer> next() override;
 
 private:
-    std::shared_ptr<Operator<GPUDecodedFrameData>> parent_;
+    std::shared_ptr<Operator<CPUDecodedFrameData>> parent_;
     std::shared_ptr<SemanticDataManager> semanticDataManager_;
     std::shared_ptr<TileLayoutProvider> tileLayoutProvider_;
     bool isComplete_;
 };
 
-class TilesToPixelsOperator : public Operator<GPUPixelDataContainer> {
+class CPUTilesToPixelsOperator : public Operator<CPUPixelDataContainer> {
 public:
-    TilesToPixelsOperator(std::shared_ptr<Operator<GPUDecodedFrameData>> parent)
+    CPUTilesToPixelsOperator(std::shared_ptr<Operator<CPUDecodedFrameData>> parent,
+                             std::shared_ptr<TileLayoutProvider> tileLayoutProvider)
         : parent_(parent),
+        tileLayoutProvider_(tileLayoutProvider),
         isComplete_(false) {}
 
     bool isComplete() override { return isComplete_; }
-    std::optional<GPUPixelDataContainer> next() override;
+    std::optional<CPUPixelDataContainer> next() override;
 
 private:
-    std::shared_ptr<Operator<GPUDecodedFrameData>> parent_;
+    std::shared_ptr<Operator<CPUDecodedFrameData>> parent_;
     std::shared_ptr<TileLayoutProvider> tileLayoutProvider_;
     bool isComplete_;
 };
@@ -57,7 +57,7 @@ public:
         if (frameReader_.isEos())
             flags |= CUVID_PKT_ENDOFSTREAM;
 
-        auto data =std::make_shared<CPUEncodedFrameData>(video_->configuration(), DecodeReaderPacket(*gopPacket->data(), flags));
+        auto data =std::make_shared<CPUEncodedFrameData>(video_->configuration(), DecodeReaderPacket(gopPacket->data(), flags));
         data->setFirstFrameIndexAndNumberOfFrames(gopPacket->firstFrameIndex(), gopPacket->numberOfFrames());
         numberOfFramesRead_ += gopPacket->numberOfFrames();
         return {data};
@@ -76,6 +76,37 @@ private:
     unsigned int numberOfFramesRead_;
 };
 
+// Reads everything from each scan in turn, so that one decoder can decode all of them.
+// Only the end-of-stream packet of the last scan is passed on.
+class ConcatenateScansOperator : public Operator<CPUEncodedFrameDataPtr> {
+public:
+    ConcatenateScansOperator(std::vector<std::shared_ptr<Operator<CPUEncodedFrameDataPtr>>> scans)
+        : scans_(std::move(scans)),
+        currentScan_(0)
+    {
+        assert(!scans_.empty());
+    }
+
+    bool isComplete() override { return currentScan_ == scans_.size(); }
+
+    std::optional<CPUEncodedFrameDataPtr> next() override {
+        while (!isComplete()) {
+            auto &scan = scans_[currentScan_];
+            auto data = scan->isComplete() ? std::nullopt : scan->next();
+            auto isLastScan = currentScan_ == scans_.size() - 1;
+            if (data && (isLastScan || !((*data)->packet().flags & CUVID_PKT_ENDOFSTREAM)))
+                return data;
+            if (scan->isComplete())
+                ++currentScan_;
+        }
+        return std::nullopt;
+    }
+
+private:
+    std::vector<std::shared_ptr<Operator<CPUEncodedFrameDataPtr>>> scans_;
+    unsigned int currentScan_;
+};
+
 } // namespace tasm
 
 
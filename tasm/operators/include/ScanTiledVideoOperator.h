@@ -4,28 +4,135 @@
 #include "Operator.h"
 
 #include "EncodedData.h"
+#include "EncodedGOPPrefetcher.h"
 #include "Rectangle.h"
 #include "SemanticDataManager.h"
+#include "StitchedGOPPipeline.h"
 #include "TileLocationProvider.h"
+#include "TileReadScheduler.h"
 #include "StitchContext.h"
+#include "StitchPlan.h"
 
 namespace tasm {
 
+// Objects are cropped from a single decoded tile, so the GOPs where an object spans tiles are read as stitched frames
+// instead. This decides for each group of frames from the same tile files how it is read, the first time the group is
+// needed rather than for the whole query up front, and describes the decoded frames with the matching layout.
+class ObjectStitchingLayoutProvider : public TileLayoutProvider {
+public:
+    ObjectStitchingLayoutProvider(std::shared_ptr<SemanticDataManager> semanticDataManager,
+                                  std::shared_ptr<TileLocationProvider> tileLocationProvider);
+
+    // Whether the group of frames that `frame` belongs to is read as stitched frames.
+    bool shouldStitchFrame(int frame);
+
+    // Stitched frames have a single tile that covers the whole frame.
+    std::shared_ptr<TileLayout> tileLayoutForFrame(unsigned int frame) override {
+        return shouldStitchFrame(frame) ? fullFrameLayout_ : tileLocationProvider_->tileLayoutForFrame(frame);
+    }
+
+private:
+    bool anyObjectSpansTiles(const std::experimental::filesystem::path &tileDirectory, int frame);
+
+    std::shared_ptr<SemanticDataManager> semanticDataManager_;
+    std::shared_ptr<TileLocationProvider> tileLocationProvider_;
+    std::shared_ptr<TileLayout> fullFrameLayout_;
+    // The scan decides while the merge operator looks up layouts, possibly on another thread.
+    std::mutex mutex_;
+    std::unordered_map<std::string, bool> tileDirectoryToShouldStitch_;
+};
+
+// Plans the tile reads of a query a window of frames at a time, and splits each window's reads between decoders with a
+// TileReadScheduler. The scans for several decoders share one planner, so each window is planned once, by whichever scan
+// first runs out of reads. Scans call it from their decoders' threads.
+class TileReadPlanner {
+public:
+    struct TileInformation {
+        std::experimental::filesystem::path filename;
+        int tileNumber;
+        unsigned int width;
+        unsigned int height;
+        std::shared_ptr<std::vector<int>> framesToRead;
+        unsigned int frameOffsetInFile;
+        Rectangle tileRect;
+        // A copy of framesToRead in global frame numbers, which the readers rewrite in place.
+        // The other frames in the GOPs that are read are marked as not output.
+        std::shared_ptr<const std::vector<int>> framesToOutput;
+    };
+
+    // When `stitchedFrames` is set, the groups of frames that it stitches are left to a scan of full frames.
+    TileReadPlanner(std::shared_ptr<SemanticDataManager> semanticDataManager,
+                    std::shared_ptr<TileLocationProvider> tileLocationProvider,
+                    unsigned int numberOfDecoders = 1,
+                    std::shared_ptr<ObjectStitchingLayoutProvider> stitchedFrames = nullptr);
+
+    unsigned int numberOfDecoders() const { return readsForDecoder_.size(); }
+
+    // Moves the reads that have been planned for `decoder` to the end of `reads`, first planning the next window if there
+    // are none. A window may assign no reads to `decoder`. Returns false once every read for `decoder` has been taken.
+    bool takeReads(unsigned int decoder, std::vector<TileInformation> &reads);
+
+    // Whether takeReads() may return more reads for `decoder`.
+    bool hasMoreReads(unsigned int decoder);
+
+    // Each decoder's scan calls this once it has read everything. The statistics are printed after the last one.
+    void scanDidFinish();
+
+private:
+    void planNextWindow();
+    std::shared_ptr<std::vector<int>> nextGroupOfFramesWithTheSameLayoutAndFromTheSameFile();
+    std::unique_ptr<std::unordered_map<unsigned int, std::shared_ptr<std::vector<int>>>> filterToTileFramesThatContainObject(std::shared_ptr<std::vector<int>> possibleFrames);
+
+    std::shared_ptr<SemanticDataManager> semanticDataManager_;
+    std::shared_ptr<TileLocationProvider> tileLocationProvider_;
+    std::shared_ptr<ObjectStitchingLayoutProvider> stitchedFrames_;
+    TileReadScheduler scheduler_;
+
+    std::mutex mutex_;
+    // The reads that have been planned for each decoder but not taken yet.
+    std::vector<std::vector<TileInformation>> readsForDecoder_;
+    std::vector<int>::const_iterator planningFrameIt_;
+    std::vector<int>::const_iterator planningEndFrameIt_;
+    // The layout and location of the group of frames being planned.
+    std::shared_ptr<const TileLayout> planningTileLayout_;
+    std::experimental::filesystem::path planningTilePath_;
+
+    unsigned int numberOfPlanningWindows_;
+    std::chrono::microseconds planningTime_;
+    double estimatedScheduleCost_;
+    unsigned int numberOfScheduledReconfigurations_;
+    unsigned int numberOfScheduledFileOpens_;
+    unsigned int numberOfFinishedScans_;
+};
+
 class ScanTiledVideoOperator : public Operator<CPUEncodedFrameDataPtr> {
 public:
     ScanTiledVideoOperator(
             std::shared_ptr<TiledEntry> entry,
             std::shared_ptr<SemanticDataManager> semanticDataManager,
             std::shared_ptr<TileLocationProvider> tileLocationProvider,
+            bool shouldReadEntireGOPs = false,
+            std::shared_ptr<ObjectStitchingLayoutProvider> stitchedFrames = nullptr)
+            : ScanTiledVideoOperator(entry, std::make_shared<TileReadPlanner>(semanticDataManager, tileLocationProvider, 1, stitchedFrames), 0, shouldReadEntireGOPs)
+    { }
+
+    // Scans the reads that `planner` assigns to decoder `decoderIndex`.
+    ScanTiledVideoOperator(
+            std::shared_ptr<TiledEntry> entry,
+            std::shared_ptr<TileReadPlanner> planner,
+            unsigned int decoderIndex,
             bool shouldReadEntireGOPs = false)
-            : isComplete_(false), entry_(entry), semanticDataManager_(semanticDataManager),
-            tileLocationProvider_(tileLocationProvider),
+            : isComplete_(false), entry_(entry),
+            planner_(planner),
+            decoderIndex_(decoderIndex),
             shouldReadEntireGOPs_(shouldReadEntireGOPs),
-            totalVideoWidth_(0), totalVideoHeight_(0),
             totalNumberOfPixels_(0), totalNumberOfFrames_(0),
             totalNumberOfBytes_(0), numberOfTilesRead_(0),
+            numberOfFramesNotOutput_(0),
             didSignalEOS_(false),
-            currentTileNumber_(0), currentTileArea_(0)
+            currentTileNumber_(0), nextTileInformationIndex_(0),
+            takenReadsStart_(0), currentTileArea_(0),
+            currentRequestIndex_(-1)
     {
         preprocess();
     }
@@ -34,57 +141,46 @@ public:
     std::optional<CPUEncodedFrameDataPtr> next() override;
 
 private:
+    using TileInformation = TileReadPlanner::TileInformation;
+
     void preprocess();
+    // Appends the next reads that the planner assigns to this scan's decoder to orderedTileInformation_.
+    // Returns false once every read has been taken.
+    bool takeNextReads();
+    void setUpPrefetcher();
+    void setCurrentTile(const TileInformation &tileInformation);
     void setUpNextEncodedFrameReader();
-    std::shared_ptr<std::vector<int>> nextGroupOfFramesWithTheSameLayoutAndFromTheSameFile(std::vector<int>::const_iterator &frameIt, std::vector<int>::const_iterator &endIt);
-    std::unique_ptr<std::unordered_map<unsigned int, std::shared_ptr<std::vector<int>>>> filterToTileFramesThatContainObject(std::shared_ptr<std::vector<int>> possibleFrames);
+    std::optional<GOPReaderPacket> readNextGOP();
 
     bool isComplete_;
     std::shared_ptr<TiledEntry> entry_;
-    std::shared_ptr<SemanticDataManager> semanticDataManager_;
-    std::shared_ptr<TileLocationProvider> tileLocationProvider_;
+    std::shared_ptr<TileReadPlanner> planner_;
+    unsigned int decoderIndex_;
     bool shouldReadEntireGOPs_;
 
-    unsigned int totalVideoWidth_;
-    unsigned int totalVideoHeight_;
-
     unsigned long long int totalNumberOfPixels_;
     unsigned long long int totalNumberOfFrames_;
     unsigned long long int totalNumberOfBytes_;
     unsigned int numberOfTilesRead_;
+    unsigned long long int numberOfFramesNotOutput_;
     bool didSignalEOS_;
 
-    std::shared_ptr<const TileLayout> currentTileLayout_;
     std::unique_ptr<std::experimental::filesystem::path> currentTilePath_;
     unsigned int currentTileNumber_;
+    std::shared_ptr<const std::vector<int>> currentFramesToOutput_;
     std::unique_ptr<EncodedFrameReader> currentEncodedFrameReader_;
     std::unordered_map<std::string, Configuration> tilePathToConfiguration_;
 
-    struct TileInformation {
-        std::experimental::filesystem::path filename;
-        int tileNumber;
-        unsigned int width;
-        unsigned int height;
-        std::shared_ptr<std::vector<int>> framesToRead;
-        unsigned int frameOffsetInFile;
-        Rectangle tileRect;
-
-        // Considers only dimensions for the purposes of ordering reads.
-        bool operator<(const TileInformation &other) {
-            if (height < other.height)
-                return true;
-            else if (height > other.height)
-                return false;
-            else if (width < other.width)
-                return true;
-            else
-                return false;
-        }
-    };
-
+    // The reads taken from the planner so far, in the order the scheduler chose.
     std::vector<TileInformation> orderedTileInformation_;
-    std::vector<TileInformation>::const_iterator orderedTileInformationIt_;
+    unsigned int nextTileInformationIndex_;
+    // The index of the first read that was taken most recently.
+    unsigned int takenReadsStart_;
     unsigned int currentTileArea_;
+
+    // Declared last so that the I/O threads stop before the tile information they read is destroyed.
+    std::unique_ptr<EncodedGOPPrefetcher> prefetcher_;
+    int currentRequestIndex_;
 };
 
 class ScanFullFramesFromTiledVideoOperator : public Operator<CPUEncodedFrameDataPtr> {
@@ -92,25 +188,42 @@ public:
     ScanFullFramesFromTiledVideoOperator(
             std::shared_ptr<TiledEntry> entry,
             std::shared_ptr<SemanticDataManager> semanticDataManager,
-            std::shared_ptr<TileLocationProvider> tileLocationProvider)
+            std::shared_ptr<TileLocationProvider> tileLocationProvider,
+            bool shouldSkipUnneededTiles = false,
+            std::shared_ptr<ObjectStitchingLayoutProvider> stitchedFrames = nullptr)
                 : isComplete_(false),
                 entry_(entry),
                 semanticDataManager_(semanticDataManager),
                 tileLocationProvider_(tileLocationProvider),
+                stitchedFrames_(stitchedFrames),
+                shouldSkipUnneededTiles_(shouldSkipUnneededTiles),
                 didSignalEOS_(false),
+                numberOfTilesSkipped_(0),
+                numberOfFramesNotOutput_(0),
                 frameIt_(semanticDataManager_->orderedFrames().begin()),
                 endFrameIt_(semanticDataManager_->orderedFrames().end()),
                 ppsId_(1),
+                stitchPlans_(EnvironmentConfiguration::instance().stitchPlanCacheSize()),
                   fullFrameConfig_(fullFrameConfig())
-    { }
+    {
+        setUpPipeline();
+    }
 
     bool isComplete() override { return isComplete_; }
     std::optional<CPUEncodedFrameDataPtr> next() override;
 
     const Configuration &configuration() { return *fullFrameConfig_; }
 private:
+    // Returns the tiles and stitch context for the next group of frames with the same layout.
+    // When skipping unneeded tiles, only the tiles that contain an object in one of the frames are read.
+    std::optional<StitchGroup> nextStitchGroup();
+    bool tileContainsObject(const TileLayout &layout, unsigned int tile, const std::vector<int> &frames);
     void setUpNextEncodedFrameReaders();
-    GOPReaderPacket stitchedDataForNextGOP();
+    void setUpPipeline();
+    CPUEncodedFrameDataPtr stitchedData(StitchedGOP &gop);
+    // Both return nullptr once every GOP has been stitched.
+    CPUEncodedFrameDataPtr stitchedDataForNextGOP();
+    CPUEncodedFrameDataPtr pipelinedDataForNextGOP();
     std::experimental::filesystem::path pathForFrame(int frame) {
         return tileLocationProvider_->locationOfTileForFrame(0, frame).parent_path();
     }
@@ -120,15 +233,27 @@ private:
     std::shared_ptr<TiledEntry> entry_;
     std::shared_ptr<SemanticDataManager> semanticDataManager_;
     std::shared_ptr<TileLocationProvider> tileLocationProvider_;
+    // When set, only the groups of frames that it stitches are read.
+    std::shared_ptr<ObjectStitchingLayoutProvider> stitchedFrames_;
+    bool shouldSkipUnneededTiles_;
     bool didSignalEOS_;
+    unsigned int numberOfTilesSkipped_;
+    unsigned long long int numberOfFramesNotOutput_;
     std::vector<int>::const_iterator frameIt_;
     std::vector<int>::const_iterator endFrameIt_;
 
     std::vector<std::unique_ptr<EncodedFrameReader>> currentEncodedFrameReaders_;
-    std::unique_ptr<stitching::StitchContext> currentContext_;
+    std::unique_ptr<StitchGroup> currentGroup_;
     unsigned int ppsId_;
 
+    // Layouts that recur keep their PPS id so that their stitch plans can be reused.
+    std::unordered_map<TileLayout, unsigned int> ppsIdForLayout_;
+    stitching::StitchPlanCache stitchPlans_;
+
     std::unique_ptr<Configuration> fullFrameConfig_;
+
+    // Stitches GOPs ahead of the decoder when stitch-ahead is enabled. Declared last so that it stops before the state it uses is destroyed.
+    std::unique_ptr<StitchedGOPPipeline> pipeline_;
 };
 
 } // namespace tasm
@@ -0,0 +1,112 @@
+#ifndef TASM_STITCHEDGOPPIPELINE_H
+#define TASM_STITCHEDGOPPIPELINE_H
+
+#include "EncodedGOPPrefetcher.h"
+#include "StitchContext.h"
+#include "StitchPlan.h"
+#include <functional>
+#include <map>
+
+namespace tasm {
+
+// The tiles of a group of frames that share a layout, and the context for stitching them into full frames.
+struct StitchGroup {
+    std::vector<TileReadRequest> tiles;
+    // The context's tile sizes are left empty, since they are in CTBs of the size that the tiles' SPS sets.
+    stitching::StitchContext context;
+    // The heights of the layout's rows and the widths of its columns, in luma samples.
+    std::vector<unsigned int> heightsOfRows;
+    std::vector<unsigned int> widthsOfColumns;
+    // The index in the layout of each tile in `tiles`. Empty when every tile is read.
+    // Tiles that are not read are stitched as skip tiles.
+    std::vector<unsigned int> positions;
+    // The sorted global frame numbers that the decoder should output. The other frames read with them are only decoded
+    // as references. Copied before the tiles are read, since the readers rewrite `framesToRead` in place.
+    std::shared_ptr<const std::vector<int>> framesToOutput;
+};
+
+// Places the tiles read for a GOP of the group at their positions in the layout, splits tiles that were coarsened in the
+// compressed domain back into the tiles they were stitched from, and substitutes skip tiles for the tiles that were not read.
+// Returns the context to stitch the resulting tiles with, whose tile sizes are in CTBs of the tiles' size.
+stitching::StitchContext prepareTilesForStitching(const StitchGroup &group, std::vector<std::shared_ptr<const std::vector<char>>> &tileData);
+
+// Marks the frames of a GOP that are not in `framesToOutput` (sorted global frame numbers) as not output.
+// Returns the frames that are still output, or nothing if every frame is output, in which case `gopData` is unchanged.
+std::optional<std::vector<int>> markFramesToOutput(std::vector<char> &gopData, unsigned int firstFrameIndex, unsigned int numberOfFrames,
+                                                   const std::vector<int> &framesToOutput);
+// Same as above for data that may be shared, e.g. with the encoded GOP cache. When frames are marked, `gopData` is
+// replaced with a marked copy, so only GOPs that drop frames are copied.
+std::optional<std::vector<int>> markFramesToOutput(std::shared_ptr<const std::vector<char>> &gopData, unsigned int firstFrameIndex, unsigned int numberOfFrames,
+                                                   const std::vector<int> &framesToOutput);
+
+struct StitchedGOP {
+    DecodeReaderPacket packet;
+    unsigned int firstFrameIndex;
+    unsigned int numberOfFrames;
+    // The frames the decoder outputs, when some are marked as not output.
+    std::optional<std::vector<int>> outputFrames;
+};
+
+// Stitches the tiles read for a GOP of the group, and marks the frames the group does not need as not output.
+StitchedGOP stitchGOP(const StitchGroup &group, std::vector<std::shared_ptr<const std::vector<char>>> &tileData, stitching::StitchPlanCache &stitchPlans,
+                      unsigned int firstFrameIndex, unsigned int numberOfFrames);
+
+// Reads and stitches the GOPs of a sequence of stitch groups on a pool of worker threads.
+// Tile GOPs are read in order by one worker at a time, and then stitched in parallel.
+// GOPs are returned in the same order as stitching them one after another, and at most `depth` GOPs are read ahead of the consumer.
+class StitchedGOPPipeline {
+public:
+    // Returns the next group, or nothing once every group has been returned. It is called by one worker at a time, and only
+    // when the previous group has been read, so groups are planned no further ahead than they are read.
+    // Exceptions it throws are rethrown by next().
+    using StitchGroupSource = std::function<std::optional<StitchGroup>()>;
+
+    StitchedGOPPipeline(StitchGroupSource nextGroup, stitching::StitchPlanCache &stitchPlans, unsigned int depth, unsigned int numberOfThreads);
+    ~StitchedGOPPipeline();
+
+    std::optional<StitchedGOP> next();
+
+    void printStatistics() const;
+
+private:
+    void stitchGOPs();
+    // Reads the next GOP of every tile in the current group, and returns the group. Must be called with readMutex_ held.
+    std::shared_ptr<const StitchGroup> readTilesForNextGOP(std::vector<std::shared_ptr<const std::vector<char>>> &tileData, unsigned int &firstFrameIndex, unsigned int &numberOfFrames);
+    // Records the current exception as the failure of GOP `sequenceNumber` and stops reading. Must be called with mutex_ held.
+    void stopAfterError(unsigned long sequenceNumber);
+
+    StitchGroupSource nextGroup_;
+    stitching::StitchPlanCache &stitchPlans_;
+    const unsigned int depth_;
+
+    // Guards the group source and the readers, which must be read in order.
+    std::mutex readMutex_;
+    // Shared with the GOPs that are being stitched, so a group is released once its last GOP is stitched.
+    std::shared_ptr<const StitchGroup> currentGroup_;
+    std::vector<std::unique_ptr<EncodedFrameReader>> currentReaders_;
+
+    // GOPs that have been stitched but not yet consumed, by sequence number.
+    std::map<unsigned long, StitchedGOP> stitchedGOPs_;
+    unsigned long nextSequenceNumberToRead_;
+    unsigned long nextSequenceNumberToReturn_;
+    bool isDoneReading_;
+    bool shouldStop_;
+    std::exception_ptr error_;
+    // The GOP that failed. The GOPs before it are still returned.
+    unsigned long errorSequenceNumber_;
+
+    unsigned long long numberOfGOPsStitched_;
+    unsigned long long numberOfBytesStitched_;
+    unsigned int maxNumberOfBufferedGOPs_;
+    unsigned int numberOfStalls_;
+    std::chrono::microseconds timeStalled_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable gopAvailable_;
+    std::condition_variable spaceAvailable_;
+    std::vector<std::thread> threads_;
+};
+
+} // namespace tasm
+
+#endif //TASM_STITCHEDGOPPIPELINE_H
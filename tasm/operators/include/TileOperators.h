@@ -1,6 +1,7 @@
 #ifndef TASM_TILEOPERATORS_H
 #define TASM_TILEOPERATORS_H
 
+#include "CatalogSnapshots.h"
 #include "EncodedData.h"
 #include "Files.h"
 #include "MultipleEncoderManager.h"
@@ -24,12 +25,13 @@ public:
             parent_(parent),
             tileConfigurationProvider_(tileConfigurationProvider),
           outputEntry_(new TiledEntry(outputEntryName)),
+          writeLock_(CatalogSnapshots::instance().lockForWriting(*outputEntry_)),
           layoutDuration_(layoutDuration),
           tileEncodersManager_(EncodeConfiguration(parent->configuration(), NV_ENC_HEVC, layoutDuration), *context, *lock),
           firstFrameInGroup_(-1),
           lastFrameInGroup_(-1),
           frameNumber_(0)
-    {}
+    { }
 
     bool isComplete() override { return isComplete_; }
     std::optional<GPUDecodedFrameData> next() override;
@@ -45,6 +47,8 @@ private:
     std::shared_ptr<ConfigurationOperator<GPUDecodedFrameData>> parent_;
     std::shared_ptr<TileLayoutProvider> tileConfigurationProvider_;
     std::shared_ptr<TiledEntry> outputEntry_;
+    // Held until every tile group is published.
+    std::optional<CatalogSnapshots::WriteLock> writeLock_;
     const unsigned int layoutDuration_;
     MultipleEncoderManager tileEncodersManager_;
     std::shared_ptr<const TileLayout> currentTileLayout_;
@@ -0,0 +1,80 @@
+#ifndef TASM_TILEREADSCHEDULER_H
+#define TASM_TILEREADSCHEDULER_H
+
+#include <experimental/filesystem>
+#include <ostream>
+#include <vector>
+
+namespace tasm {
+
+// A read of a range of frames from one tile file.
+struct TileRead {
+    std::experimental::filesystem::path filename;
+    unsigned int width;
+    unsigned int height;
+    unsigned int frameOffsetInFile;
+    // The first and last global frames that are read.
+    int firstFrame;
+    int lastFrame;
+    unsigned int numberOfFrames;
+};
+
+// Estimated costs, in microseconds, that the scheduler trades off.
+struct TileReadCostModel {
+    // Reconfiguring a decoder for new dimensions flushes it and reallocates its surfaces.
+    double reconfigurationCost = 5000;
+    // Opening a tile file and parsing its index.
+    double fileOpenCost = 500;
+    // Seeking within a file that is already open, per frame skipped.
+    double seekCostPerFrame = 2;
+    // Decoding, per pixel. Only used to balance reads across decoders.
+    double decodeCostPerPixel = 0.0005;
+};
+
+struct TileReadSchedule {
+    std::vector<TileRead> reads;
+    // The indices into `reads` that each decoder reads, in order.
+    std::vector<std::vector<unsigned int>> readsForDecoder;
+    std::vector<double> estimatedCostForDecoder;
+    unsigned int numberOfReconfigurations;
+    unsigned int numberOfFileOpens;
+
+    // The decoders run in parallel, so the schedule takes as long as its most expensive decoder.
+    double estimatedCost() const;
+};
+
+std::ostream &operator<<(std::ostream &ostr, const TileReadSchedule &schedule);
+
+// Assigns the tile reads of a query to decoders and orders them.
+// Reads are grouped into a queue per dimension, and each queue is ordered by file and frame offset. Queues are assigned
+// to the decoder that would finish them first, preferring the decoder that is already configured for their dimensions,
+// and queues that are larger than a decoder's share are split. Each decoder then reads its queues one after another,
+// unless reading in file order would be cheaper than the reconfigurations that grouping saves.
+// Decoders keep their state across calls, so a query can be scheduled a window of reads at a time.
+class TileReadScheduler {
+public:
+    TileReadScheduler(unsigned int numberOfDecoders, TileReadCostModel costModel = {});
+
+    TileReadSchedule schedule(std::vector<TileRead> reads);
+
+    unsigned int numberOfDecoders() const { return decoders_.size(); }
+
+private:
+    struct DecoderState {
+        unsigned int width;
+        unsigned int height;
+        std::experimental::filesystem::path filename;
+        int lastFrame;
+    };
+
+    // Returns the cost of performing `order` starting from `state`, and advances `state` past the reads.
+    double estimateCost(DecoderState &state, const std::vector<TileRead> &reads, const std::vector<unsigned int> &order,
+                        unsigned int *numberOfReconfigurations = nullptr, unsigned int *numberOfFileOpens = nullptr) const;
+
+    const TileReadCostModel costModel_;
+    std::vector<DecoderState> decoders_;
+};
+
+} // namespace tasm
+
+#endif //TASM_TILEREADSCHEDULER_H
@@ -8,14 +8,18 @@
 
 namespace tasm {
 
+// Copies regions of NV12 frames that were decoded on the GPU to the host and converts them to images in `format`.
+// Only the pixels in each region are copied and converted.
 class TransformToImage : public Operator<std::unique_ptr<std::vector<ImagePtr>>> {
 public:
     TransformToImage(std::shared_ptr<Operator<GPUPixelDataContainer>> parent,
             unsigned int maxWidth,
-            unsigned int maxHeight)
+            unsigned int maxHeight,
+            PixelFormat format = PixelFormat::RGBA)
             : parent_(parent),
             maxWidth_(maxWidth),
             maxHeight_(maxHeight),
+            format_(format),
             isComplete_(false)
      {}
 
@@ -26,9 +30,29 @@ private:
     std::shared_ptr<Operator<GPUPixelDataContainer>> parent_;
     unsigned int maxWidth_;
     unsigned int maxHeight_;
+    PixelFormat format_;
     bool isComplete_;
+    std::vector<uint8_t> nv12_;
+};
+
+// Converts regions of frames that were decoded on the CPU to images in `format`.
+// Only the pixels in each region are converted.
+class TransformCPUPixelsToImage : public Operator<std::unique_ptr<std::vector<ImagePtr>>> {
+public:
+    TransformCPUPixelsToImage(std::shared_ptr<Operator<CPUPixelDataContainer>> parent,
+                              PixelFormat format = PixelFormat::RGBA)
+            : parent_(parent),
+            format_(format),
+            isComplete_(false)
+    {}
 
-    static const unsigned int numChannels_ = 4;
+    bool isComplete() override { return isComplete_; }
+    std::optional<std::unique_ptr<std::vector<ImagePtr>>> next() override;
+
+private:
+    std::shared_ptr<Operator<CPUPixelDataContainer>> parent_;
+    PixelFormat format_;
+    bool isComplete_;
 };
 
 } // namespace tasm
@@ -0,0 +1,178 @@
+#include "DecodeOperators.h"
+
+#include <numeric>
+
+namespace tasm {
+
+void SoftwareVideoDecoder::decode(const CPUEncodedFrameData &data, std::vector<CPUFramePtr> &frames) {
+    int firstFrameIndex = -1;
+    int numberOfFrames = -1;
+    int tileNumber = -1;
+    data.getTileNumberIfSet(tileNumber);
+
+    // Frames that are marked as not output are decoded but never returned, so they get no frame number.
+    std::vector<int> outputFrames;
+    if (data.getFirstFrameIndexIfSet(firstFrameIndex) && data.getNumberOfFramesIfSet(numberOfFrames)
+            && !data.getOutputFramesIfSet(outputFrames)) {
+        outputFrames.resize(numberOfFrames);
+        std::iota(outputFrames.begin(), outputFrames.end(), firstFrameIndex);
+    }
+
+    decode(data.packet().payload, data.packet().payload_size, outputFrames, tileNumber, frames);
+}
+
+SoftwareDecodeFromCPU::SoftwareDecodeFromCPU(std::shared_ptr<Operator<CPUEncodedFrameDataPtr>> scan,
+        unsigned int maximumNumberOfStreams,
+        unsigned int threadsPerStream)
+    : isComplete_(false),
+    scan_(scan),
+    maximumNumberOfStreams_(std::max(1u, maximumNumberOfStreams)),
+    threadsPerStream_(std::max(1u, threadsPerStream)),
+    isDoneReading_(false),
+    numberOfStreamsDone_(0),
+    shouldStop_(false),
+    numberOfFramesDecoded_(0)
+{
+    reader_ = std::thread(&SoftwareDecodeFromCPU::readPackets, this);
+}
+
+SoftwareDecodeFromCPU::~SoftwareDecodeFromCPU() {
+    {
+        std::scoped_lock lock(mutex_);
+        shouldStop_ = true;
+    }
+    packetAvailable_.notify_all();
+    spaceForPackets_.notify_all();
+    spaceForFrames_.notify_all();
+
+    // Streams are only added by the reader, so they can be joined once it is done.
+    reader_.join();
+    for (auto &stream : streams_)
+        stream->thread.join();
+}
+
+SoftwareDecodeFromCPU::TileStream &SoftwareDecodeFromCPU::streamForTile(int tileNumber) {
+    auto stream = tileToStream_.find(tileNumber);
+    if (stream != tileToStream_.end())
+        return *stream->second;
+
+    TileStream *streamForTile;
+    if (streams_.size() < maximumNumberOfStreams_) {
+        streams_.push_back(std::make_unique<TileStream>());
+        streamForTile = streams_.back().get();
+        streamForTile->thread = std::thread(&SoftwareDecodeFromCPU::decodeStream, this, std::ref(*streamForTile));
+    } else {
+        streamForTile = streams_[tileToStream_.size() % streams_.size()].get();
+    }
+    tileToStream_[tileNumber] = streamForTile;
+    return *streamForTile;
+}
+
+void SoftwareDecodeFromCPU::readPackets() {
+    try {
+        while (!scan_->isComplete()) {
+            auto data = scan_->next();
+            // The scan ends with an empty end-of-stream packet; the decoders are flushed when reading is done instead.
+            if (!data || !(*data)->packet().payload_size)
+                continue;
+
+            int tileNumber = -1;
+            (*data)->getTileNumberIfSet(tileNumber);
+
+            std::unique_lock lock(mutex_);
+            auto &stream = streamForTile(tileNumber);
+            spaceForPackets_.wait(lock, [&] { return shouldStop_ || stream.packets.size() < maximumNumberOfPacketsPerStream_; });
+            if (shouldStop_)
+                break;
+
+            stream.packets.push_back(std::move(*data));
+            packetAvailable_.notify_all();
+        }
+    } catch (...) {
+        std::scoped_lock lock(mutex_);
+        if (!error_)
+            error_ = std::current_exception();
+    }
+
+    std::scoped_lock lock(mutex_);
+    isDoneReading_ = true;
+    packetAvailable_.notify_all();
+    framesAvailable_.notify_all();
+}
+
+void SoftwareDecodeFromCPU::decodeStream(TileStream &stream) {
+    try {
+        SoftwareVideoDecoder decoder(threadsPerStream_);
+        std::vector<CPUFramePtr> frames;
+        while (true) {
+            CPUEncodedFrameDataPtr data;
+            {
+                std::unique_lock lock(mutex_);
+                packetAvailable_.wait(lock, [&] { return shouldStop_ || !stream.packets.empty() || isDoneReading_; });
+                if (shouldStop_)
+                    return;
+                if (stream.packets.empty())
+                    break;
+
+                data = std::move(stream.packets.front());
+                stream.packets.pop_front();
+                spaceForPackets_.notify_all();
+            }
+
+            decoder.decode(*data, frames);
+            if (!outputFrames(frames))
+                return;
+        }
+
+        decoder.flush(frames);
+        outputFrames(frames);
+    } catch (...) {
+        std::scoped_lock lock(mutex_);
+        if (!error_)
+            error_ = std::current_exception();
+    }
+
+    std::scoped_lock lock(mutex_);
+    ++numberOfStreamsDone_;
+    framesAvailable_.notify_all();
+}
+
+bool SoftwareDecodeFromCPU::outputFrames(std::vector<CPUFramePtr> &frames) {
+    if (frames.empty())
+        return true;
+
+    std::unique_lock lock(mutex_);
+    spaceForFrames_.wait(lock, [&] { return shouldStop_ || decodedFrames_.size() < maximumNumberOfDecodedFrames_; });
+    if (shouldStop_)
+        return false;
+
+    decodedFrames_.insert(decodedFrames_.end(), std::make_move_iterator(frames.begin()), std::make_move_iterator(frames.end()));
+    frames.clear();
+    framesAvailable_.notify_all();
+    return true;
+}
+
+std::optional<CPUDecodedFrameData> SoftwareDecodeFromCPU::next() {
+    if (isComplete_)
+        return {};
+
+    std::unique_lock lock(mutex_);
+    framesAvailable_.wait(lock, [&] { return error_ || !decodedFrames_.empty() || isDoneDecoding(); });
+    if (error_)
+        std::rethrow_exception(error_);
+
+    if (decodedFrames_.empty()) {
+        std::cout << "Num-frames-from-decoder: " << numberOfFramesDecoded_ << std::endl;
+        std::cout << "ANALYSIS: software-decode-streams " << streams_.size() << std::endl;
+        isComplete_ = true;
+        return std::nullopt;
+    }
+
+    auto frames = std::make_unique<std::vector<CPUFramePtr>>(std::move(decodedFrames_));
+    decodedFrames_.clear();
+    numberOfFramesDecoded_ += frames->size();
+    spaceForFrames_.notify_all();
+    return {CPUDecodedFrameData(std::move(frames))};
+}
+
+} // namespace tasm
@@ -1,9 +1,8 @@
 #include "MergeTiles.h"
 
-#include "ColorSpace.h"
-#include "NvCodecUtils.h"
 #include "SemanticDataManager.h"
 #include "TileConfigurationProvider.h"
+#include <algorithm>
 
 namespace tasm {
 
@@ -13,24 +12,25 @@ static std::pair<int, int> topAndLeftOffsets(const Rectangle &rect, const Rectan
     return std::make_pair(top, left);
 }
 
-std::optional<GPUDecodedFrameData> TransformToRGB::next() {
-    auto decodedData = parent_->next();
-    if (parent_->isComplete()) {
-        assert(!decodedData.has_value());
-        isComplete_ = true;
-        return std::nullopt;
+// Calls `addObject(boundingBox, xOffset, yOffset)` for each bounding box that lies in the tile.
+template <typename AddObject>
+static void forEachObjectInTile(SemanticDataManager &semanticDataManager, TileLayoutProvider &tileLayoutProvider,
+                                int frameNumber, int tileNumber, AddObject addObject) {
+    auto &boundingBoxesForFrame = semanticDataManager.rectanglesForFrame(frameNumber);
+    auto tileRect = tileLayoutProvider.tileLayoutForFrame(frameNumber)->rectangleForTile(tileNumber);
+
+    // TODO: Cache this work. Because it's also done when determining which tiles to decode.
+    // See if any of the rectangles intersect this tile.
+    for (auto &boundingBox : boundingBoxesForFrame) {
+        if (!boundingBox.intersects(tileRect))
+            continue;
+
+        auto overlappingRect = tileRect.overlappingRectangle(boundingBox);
+        // TODO: Migrate support for objects across tiles.
+        assert(overlappingRect == boundingBox);
+        auto offsetIntoTile = topAndLeftOffsets(boundingBox, tileRect);
+        addObject(boundingBox, offsetIntoTile.second, offsetIntoTile.first);
     }
-    assert(decodedData.has_value());
-    auto frames = std::make_unique<std::vector<GPUFramePtr>>();
-    for (auto &frame : decodedData->frames()) {
-        CUdeviceptr rgbHandle;
-        unsigned int rgbPitch = numChannels_ * frame->width();
-        assert(cuMemAlloc(&rgbHandle, frame->width() * frame->height() * numChannels_) == CUDA_SUCCESS);
-        Nv12ToColor32<RGBA32>((uint8_t *)frame->cuda()->handle(), frame->cuda()->pitch(), (uint8_t *)rgbHandle, rgbPitch, frame->width(), frame->height());
-        frames->push_back(std::make_shared<DecodedFrame>(*frame, rgbHandle, rgbPitch, true));
-    }
-
-    return std::make_optional<GPUDecodedFrameData>(decodedData->configuration(), std::move(frames));
 }
 
 std::optional<GPUPixelDataContainer> MergeTilesOperator::next() {
@@ -47,31 +47,43 @@ std::optional<GPUPixelDataContainer> MergeTilesOperator::next() {
     for (auto frame : decodedData->frames()) {
         // Create a pixel object for each bounding box that lies in the decoded tiles.
 
-        int frameNumber;
-        assert(frame->getFrameNumber(frameNumber));
+        int frameNumber = -1;
+        frame->getFrameNumber(frameNumber);
+        assert(frameNumber != -1);
         int tileNumber = frame->tileNumber();
         assert(tileNumber != static_cast<int>(-1));
 
-        auto &boundingBoxesForFrame = semanticDataManager_->rectanglesForFrame(frameNumber);
-        auto tileRect = tileLayoutProvider_->tileLayoutForFrame(frameNumber)->rectangleForTile(tileNumber);
-
-        // TODO: Cache this work. Because it's also done when determining which tiles to decode.
-        // See if any of the rectangles intersect this tile.
-        for (auto &boundingBox : boundingBoxesForFrame) {
-            if (!boundingBox.intersects(tileRect))
-                continue;
+        forEachObjectInTile(*semanticDataManager_, *tileLayoutProvider_, frameNumber, tileNumber,
+                [&](const Rectangle &boundingBox, auto xOffset, auto yOffset) {
+            pixelData->emplace_back(std::make_shared<GPUPixelDataFromDecodedFrame>(
+                    frame, boundingBox.width, boundingBox.height, xOffset, yOffset,
+                    frameNumber, boundingBox.x, boundingBox.y));
+        });
+    }
+    return pixelData;
+}
 
-            auto overlappingRect = tileRect.overlappingRectangle(boundingBox);
-            // TODO: Migrate support for objects across tiles.
-            assert(overlappingRect == boundingBox);
-            auto offsetIntoTile = topAndLeftOffsets(boundingBox, tileRect);
+std::optional<CPUPixelDataContainer> MergeCPUTilesOperator::next() {
+    auto decodedData = parent_->next();
+    if (parent_->isComplete()) {
+        assert(!decodedData.has_value());
+        isComplete_ = true;
+        return std::nullopt;
+    }
 
-            pixelData->emplace_back(std::make_shared<GPUPixelDataFromDecodedFrame>(
-                    frame,
-                    boundingBox.width, boundingBox.height,
-                    offsetIntoTile.second, offsetIntoTile.first));
+    assert(decodedData.has_value());
 
-        }
+    auto pixelData = std::make_unique<std::vector<CPUPixelDataPtr>>();
+    for (auto &frame : decodedData->frames()) {
+        // Create a pixel object for each bounding box that lies in the decoded tiles.
+        assert(frame->frameNumber() != -1);
+        assert(frame->tileNumber() != -1);
+
+        forEachObjectInTile(*semanticDataManager_, *tileLayoutProvider_, frame->frameNumber(), frame->tileNumber(),
+                [&](const Rectangle &boundingBox, auto xOffset, auto yOffset) {
+            pixelData->emplace_back(std::make_shared<CPUPixelData>(
+                    frame, boundingBox.width, boundingBox.height, xOffset, yOffset, boundingBox.x, boundingBox.y));
+        });
     }
     return pixelData;
 }
@@ -88,10 +100,32 @@ std::optional<GPUPixelDataContainer> TilesToPixelsOperator::next() {
 
     auto pixelData = std::make_unique<std::vector<GPUPixelDataPtr>>();
     for (auto frame : decodedData->frames()) {
+        int frameNumber = -1;
+        frame->getFrameNumber(frameNumber);
+        auto tileRect = tileLayoutProvider_->tileLayoutForFrame(frameNumber)->rectangleForTile(std::max(frame->tileNumber(), 0));
         pixelData->emplace_back(std::make_shared<GPUPixelDataFromDecodedFrame>(
                 frame,
                 frame->width(), frame->height(),
-                0, 0)); // Fake a (0, 0) offset.
+                0, 0, // Fake a (0, 0) offset.
+                frameNumber, tileRect.x, tileRect.y));
+    }
+    return pixelData;
+}
+
+std::optional<CPUPixelDataContainer> CPUTilesToPixelsOperator::next() {
+    auto decodedData = parent_->next();
+    if (parent_->isComplete()) {
+        assert(!decodedData.has_value());
+        isComplete_ = true;
+        return std::nullopt;
+    }
+
+    assert(decodedData.has_value());
+
+    auto pixelData = std::make_unique<std::vector<CPUPixelDataPtr>>();
+    for (auto &frame : decodedData->frames()) {
+        auto tileRect = tileLayoutProvider_->tileLayoutForFrame(frame->frameNumber())->rectangleForTile(std::max(frame->tileNumber(), 0));
+        pixelData->emplace_back(std::make_shared<CPUPixelData>(frame, frame->width(), frame->height(), 0, 0, tileRect.x, tileRect.y));
     }
     return pixelData;
 }
@@ -1,59 +1,185 @@
 #include "ScanTiledVideoOperator.h"
 
+#include "EncodedGOPCache.h"
+#include "EnvironmentConfiguration.h"
 #include "VideoConfiguration.h"
 #include "Stitcher.h"
 
 namespace tasm {
 
 static const unsigned int MAX_PPS_ID = 64;
-static const unsigned int ALIGNMENT = 32;
 
-void ScanTiledVideoOperator::preprocess() {
-    auto frameIt = semanticDataManager_->orderedFrames().cbegin();
-    auto end = semanticDataManager_->orderedFrames().cend();
-    while (frameIt != end) {
-        auto possibleFramesToRead = nextGroupOfFramesWithTheSameLayoutAndFromTheSameFile(frameIt, end);
+static void printEncodedGOPCacheStatistics() {
+    auto &cache = EncodedGOPCache::instance();
+    if (!cache.isEnabled())
+        return;
+
+    auto stats = cache.statistics();
+    std::cout << "ANALYSIS: gop-cache-hits " << stats.hits << std::endl;
+    std::cout << "ANALYSIS: gop-cache-misses " << stats.misses << std::endl;
+    std::cout << "ANALYSIS: gop-cache-bytes-served " << stats.bytesServed << std::endl;
+    std::cout << "ANALYSIS: gop-cache-bytes-evicted " << stats.bytesEvicted << std::endl;
+    std::cout << "ANALYSIS: gop-cache-bytes-cached " << stats.bytesCached << " of " << stats.capacityInBytes << std::endl;
+}
+
+ObjectStitchingLayoutProvider::ObjectStitchingLayoutProvider(std::shared_ptr<SemanticDataManager> semanticDataManager,
+                                                             std::shared_ptr<TileLocationProvider> tileLocationProvider)
+    : semanticDataManager_(semanticDataManager),
+    tileLocationProvider_(tileLocationProvider)
+{
+    auto layout = tileLocationProvider_->tileLayoutForFrame(0);
+    fullFrameLayout_ = std::make_shared<TileLayout>(1, 1, std::vector<unsigned int>{layout->totalWidth()}, std::vector<unsigned int>{layout->totalHeight()});
+}
+
+bool ObjectStitchingLayoutProvider::shouldStitchFrame(int frame) {
+    auto tileDirectory = tileLocationProvider_->locationOfTileForFrame(0, frame).parent_path();
+    std::scoped_lock lock(mutex_);
+    auto shouldStitch = tileDirectoryToShouldStitch_.find(tileDirectory);
+    if (shouldStitch == tileDirectoryToShouldStitch_.end())
+        shouldStitch = tileDirectoryToShouldStitch_.emplace(tileDirectory, anyObjectSpansTiles(tileDirectory, frame)).first;
+    return shouldStitch->second;
+}
+
+bool ObjectStitchingLayoutProvider::anyObjectSpansTiles(const std::experimental::filesystem::path &tileDirectory, int frame) {
+    auto layout = tileLocationProvider_->tileLayoutForFrame(frame);
+    if (layout->numberOfTiles() == 1)
+        return false;
+
+    // The frames that are read from the same tile files are adjacent in the ordered frames.
+    auto &frames = semanticDataManager_->orderedFrames();
+    auto position = std::lower_bound(frames.begin(), frames.end(), frame);
+    auto first = position;
+    while (first != frames.begin() && tileLocationProvider_->locationOfTileForFrame(0, *std::prev(first)).parent_path() == tileDirectory)
+        --first;
+    auto last = position;
+    while (last != frames.end() && tileLocationProvider_->locationOfTileForFrame(0, *last).parent_path() == tileDirectory)
+        ++last;
+
+    return std::any_of(first, last, [&](auto frameInGroup) {
+        auto &rectangles = semanticDataManager_->rectanglesForFrame(frameInGroup);
+        return std::any_of(rectangles.begin(), rectangles.end(), [&](auto &rectangle) {
+            auto numberOfIntersectingTiles = 0u;
+            for (auto tile = 0u; tile < layout->numberOfTiles(); ++tile) {
+                if (layout->rectangleForTile(tile).intersects(rectangle))
+                    ++numberOfIntersectingTiles;
+            }
+            return numberOfIntersectingTiles > 1;
+        });
+    });
+}
+
+TileReadPlanner::TileReadPlanner(std::shared_ptr<SemanticDataManager> semanticDataManager,
+                                 std::shared_ptr<TileLocationProvider> tileLocationProvider,
+                                 unsigned int numberOfDecoders,
+                                 std::shared_ptr<ObjectStitchingLayoutProvider> stitchedFrames)
+    : semanticDataManager_(semanticDataManager),
+    tileLocationProvider_(tileLocationProvider),
+    stitchedFrames_(stitchedFrames),
+    scheduler_(numberOfDecoders),
+    readsForDecoder_(numberOfDecoders),
+    planningFrameIt_(semanticDataManager_->orderedFrames().cbegin()),
+    planningEndFrameIt_(semanticDataManager_->orderedFrames().cend()),
+    numberOfPlanningWindows_(0), planningTime_(0),
+    estimatedScheduleCost_(0), numberOfScheduledReconfigurations_(0),
+    numberOfScheduledFileOpens_(0), numberOfFinishedScans_(0)
+{ }
+
+bool TileReadPlanner::takeReads(unsigned int decoder, std::vector<TileInformation> &reads) {
+    std::scoped_lock lock(mutex_);
+    auto &readsForDecoder = readsForDecoder_[decoder];
+    if (readsForDecoder.empty()) {
+        if (planningFrameIt_ == planningEndFrameIt_)
+            return false;
+        planNextWindow();
+    }
+
+    std::move(readsForDecoder.begin(), readsForDecoder.end(), std::back_inserter(reads));
+    readsForDecoder.clear();
+    return true;
+}
+
+bool TileReadPlanner::hasMoreReads(unsigned int decoder) {
+    std::scoped_lock lock(mutex_);
+    return !readsForDecoder_[decoder].empty() || planningFrameIt_ != planningEndFrameIt_;
+}
+
+void TileReadPlanner::scanDidFinish() {
+    std::scoped_lock lock(mutex_);
+    if (++numberOfFinishedScans_ < numberOfDecoders())
+        return;
+
+    std::cout << "ANALYSIS: planning-windows " << numberOfPlanningWindows_ << std::endl;
+    std::cout << "ANALYSIS: planning-time-us " << planningTime_.count() << std::endl;
+    std::cout << "ANALYSIS: tile-schedule-decoders " << scheduler_.numberOfDecoders() << std::endl;
+    std::cout << "ANALYSIS: tile-schedule-estimated-cost-us " << estimatedScheduleCost_ << std::endl;
+    std::cout << "ANALYSIS: tile-schedule-reconfigurations " << numberOfScheduledReconfigurations_ << std::endl;
+    std::cout << "ANALYSIS: tile-schedule-file-opens " << numberOfScheduledFileOpens_ << std::endl;
+}
+
+void TileReadPlanner::planNextWindow() {
+    auto start = std::chrono::steady_clock::now();
+    auto windowSize = EnvironmentConfiguration::instance().planningWindow();
+    auto numberOfFramesPlanned = 0u;
+    std::vector<TileInformation> windowTileInformation;
+    // Windows end between groups of frames from the same tile files, so a GOP is never read in two windows.
+    while (planningFrameIt_ != planningEndFrameIt_ && (!windowSize || numberOfFramesPlanned < windowSize)) {
+        auto possibleFramesToRead = nextGroupOfFramesWithTheSameLayoutAndFromTheSameFile();
+        numberOfFramesPlanned += possibleFramesToRead->size();
+        if (stitchedFrames_ && stitchedFrames_->shouldStitchFrame(possibleFramesToRead->front()))
+            continue;
         auto tileToFrames = filterToTileFramesThatContainObject(possibleFramesToRead);
 
         for (auto tileNumberIt = tileToFrames->begin(); tileNumberIt != tileToFrames->end(); ++tileNumberIt) {
             if (tileNumberIt->second->empty())
                 continue;
-            auto rectangleForTile = currentTileLayout_->rectangleForTile(tileNumberIt->first);
-            orderedTileInformation_.emplace_back<TileInformation>(
-                    {TileFiles::tileFilename(currentTilePath_->parent_path(), tileNumberIt->first),
+            auto rectangleForTile = planningTileLayout_->rectangleForTile(tileNumberIt->first);
+            windowTileInformation.emplace_back<TileInformation>(
+                    {TileFiles::tileFilename(planningTilePath_.parent_path(), tileNumberIt->first),
                      static_cast<int>(tileNumberIt->first),
                      rectangleForTile.width,
                      rectangleForTile.height,
                      tileNumberIt->second,
-                     tileLocationProvider_->frameOffsetInTileFile(*currentTilePath_),
-                     rectangleForTile});
+                     tileLocationProvider_->frameOffsetInTileFile(planningTilePath_),
+                     rectangleForTile,
+                     std::make_shared<const std::vector<int>>(*tileNumberIt->second)});
         }
     }
 
-    std::sort(orderedTileInformation_.begin(), orderedTileInformation_.end());
-    orderedTileInformationIt_ = orderedTileInformation_.begin();
+    // Ordering reads by dimensions within the window limits how often the decoders are reconfigured.
+    std::vector<TileRead> reads;
+    reads.reserve(windowTileInformation.size());
+    for (const auto &tileInformation : windowTileInformation) {
+        const auto &frames = *tileInformation.framesToRead;
+        reads.push_back({tileInformation.filename, tileInformation.width, tileInformation.height, tileInformation.frameOffsetInFile,
+                         frames.front(), frames.back(), static_cast<unsigned int>(frames.size())});
+    }
+    auto schedule = scheduler_.schedule(std::move(reads));
+    for (auto decoder = 0u; decoder < schedule.readsForDecoder.size(); ++decoder) {
+        for (auto index : schedule.readsForDecoder[decoder])
+            readsForDecoder_[decoder].push_back(std::move(windowTileInformation[index]));
+    }
+    estimatedScheduleCost_ += schedule.estimatedCost();
+    numberOfScheduledReconfigurations_ += schedule.numberOfReconfigurations;
+    numberOfScheduledFileOpens_ += schedule.numberOfFileOpens;
+
+    ++numberOfPlanningWindows_;
+    planningTime_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
 }
 
-std::shared_ptr<std::vector<int>> ScanTiledVideoOperator::nextGroupOfFramesWithTheSameLayoutAndFromTheSameFile(std::vector<int>::const_iterator &frameIt, std::vector<int>::const_iterator &endIt) {
-    assert(frameIt != endIt);
+std::shared_ptr<std::vector<int>> TileReadPlanner::nextGroupOfFramesWithTheSameLayoutAndFromTheSameFile() {
+    assert(planningFrameIt_ != planningEndFrameIt_);
 
     auto fakeTileNumber = 0;
     // Get the configuration and location for the next frame.
     // While the path is the same, it must have the same configuration.
-    currentTilePath_ = std::make_unique<std::experimental::filesystem::path>(tileLocationProvider_->locationOfTileForFrame(fakeTileNumber, *frameIt));
-    currentTileLayout_ = tileLocationProvider_->tileLayoutForFrame(*frameIt);
-
-    if (!totalVideoWidth_) {
-        assert(!totalVideoHeight_);
-        totalVideoWidth_ = currentTileLayout_->totalWidth();
-        totalVideoHeight_ = currentTileLayout_->totalHeight();
-    }
+    planningTilePath_ = tileLocationProvider_->locationOfTileForFrame(fakeTileNumber, *planningFrameIt_);
+    planningTileLayout_ = tileLocationProvider_->tileLayoutForFrame(*planningFrameIt_);
 
     auto framesWithSamePathAndConfiguration = std::make_shared<std::vector<int>>();
-    framesWithSamePathAndConfiguration->push_back(*frameIt++);
-    while (frameIt != endIt) {
-        if (tileLocationProvider_->locationOfTileForFrame(fakeTileNumber, *frameIt) == *currentTilePath_)
-            framesWithSamePathAndConfiguration->push_back(*frameIt++);
+    framesWithSamePathAndConfiguration->push_back(*planningFrameIt_++);
+    while (planningFrameIt_ != planningEndFrameIt_) {
+        if (tileLocationProvider_->locationOfTileForFrame(fakeTileNumber, *planningFrameIt_) == planningTilePath_)
+            framesWithSamePathAndConfiguration->push_back(*planningFrameIt_++);
         else
             break;
     }
@@ -61,17 +187,17 @@ std::shared_ptr<std::vector<int>> ScanTiledVideoOperator::nextGroupOfFramesWithT
     return framesWithSamePathAndConfiguration;
 }
 
-std::unique_ptr<std::unordered_map<unsigned int, std::shared_ptr<std::vector<int>>>> ScanTiledVideoOperator::filterToTileFramesThatContainObject(std::shared_ptr<std::vector<int>> possibleFrames) {
+std::unique_ptr<std::unordered_map<unsigned int, std::shared_ptr<std::vector<int>>>> TileReadPlanner::filterToTileFramesThatContainObject(std::shared_ptr<std::vector<int>> possibleFrames) {
     auto tileNumberToFrames = std::make_unique<std::unordered_map<unsigned int, std::shared_ptr<std::vector<int>>>>();
 
-    // currentTileLayout is set in nextGroupOfFramesWithTheSameLayoutAndFromTheSameFile().
-    if (currentTileLayout_->numberOfTiles() == 1) {
+    // planningTileLayout_ is set in nextGroupOfFramesWithTheSameLayoutAndFromTheSameFile().
+    if (planningTileLayout_->numberOfTiles() == 1) {
         (*tileNumberToFrames)[0] = possibleFrames;
         return tileNumberToFrames;
     }
 
-    for (auto i = 0u; i < currentTileLayout_->numberOfTiles(); ++i) {
-        auto tileRect = currentTileLayout_->rectangleForTile(i);
+    for (auto i = 0u; i < planningTileLayout_->numberOfTiles(); ++i) {
+        auto tileRect = planningTileLayout_->rectangleForTile(i);
         if (!tileNumberToFrames->count(i))
             (*tileNumberToFrames)[i] = std::make_shared<std::vector<int>>();
         (*tileNumberToFrames)[i]->reserve(possibleFrames->size());
@@ -88,23 +214,100 @@ std::unique_ptr<std::unordered_map<unsigned int, std::shared_ptr<std::vector<int
     return tileNumberToFrames;
 }
 
+void ScanTiledVideoOperator::preprocess() {
+    // Only the first reads are planned up front, so that reading starts without waiting for the whole query to be planned.
+    takeNextReads();
+    setUpPrefetcher();
+}
+
+bool ScanTiledVideoOperator::takeNextReads() {
+    auto start = orderedTileInformation_.size();
+    if (!planner_->takeReads(decoderIndex_, orderedTileInformation_))
+        return false;
+    takenReadsStart_ = start;
+
+    if (prefetcher_) {
+        std::vector<TileReadRequest> requests;
+        requests.reserve(orderedTileInformation_.size() - start);
+        for (auto i = start; i < orderedTileInformation_.size(); ++i) {
+            const auto &tileInformation = orderedTileInformation_[i];
+            requests.push_back({tileInformation.filename, tileInformation.framesToRead, tileInformation.frameOffsetInFile, shouldReadEntireGOPs_});
+        }
+        prefetcher_->addRequests(std::move(requests), planner_->hasMoreReads(decoderIndex_));
+    }
+    return true;
+}
+
+void ScanTiledVideoOperator::setUpPrefetcher() {
+    auto &environment = EnvironmentConfiguration::instance();
+    auto hasMoreReads = planner_->hasMoreReads(decoderIndex_);
+    if (!environment.readAheadDepth() || (orderedTileInformation_.empty() && !hasMoreReads))
+        return;
+
+    std::vector<TileReadRequest> requests;
+    requests.reserve(orderedTileInformation_.size());
+    for (const auto &tileInformation : orderedTileInformation_)
+        requests.push_back({tileInformation.filename, tileInformation.framesToRead, tileInformation.frameOffsetInFile, shouldReadEntireGOPs_});
+
+    prefetcher_ = std::make_unique<EncodedGOPPrefetcher>(std::move(requests), environment.readAheadDepth(), std::max(1u, environment.readAheadThreads()), hasMoreReads);
+}
+
+void ScanTiledVideoOperator::setCurrentTile(const TileInformation &tileInformation) {
+    ++numberOfTilesRead_;
+    currentTileArea_ = tileInformation.width * tileInformation.height;
+    currentTilePath_ = std::make_unique<std::experimental::filesystem::path>(tileInformation.filename);
+    currentTileNumber_ = tileInformation.tileNumber;
+    currentFramesToOutput_ = tileInformation.framesToOutput;
+}
+
 void ScanTiledVideoOperator::setUpNextEncodedFrameReader() {
-    if (orderedTileInformationIt_ == orderedTileInformation_.end()) {
-        currentEncodedFrameReader_ = nullptr;
-    } else {
-        ++numberOfTilesRead_;
-        currentEncodedFrameReader_ = std::make_unique<EncodedFrameReader>(
-                orderedTileInformationIt_->filename,
-                orderedTileInformationIt_->framesToRead,
-                orderedTileInformationIt_->frameOffsetInFile,
-                shouldReadEntireGOPs_);
-
-        currentTileArea_ = orderedTileInformationIt_->width * orderedTileInformationIt_->height;
-        currentTilePath_ = std::make_unique<std::experimental::filesystem::path>(orderedTileInformationIt_->filename);
-        currentTileNumber_ = orderedTileInformationIt_->tileNumber;
-
-        ++orderedTileInformationIt_;
+    // Windows where no tile contains an object plan no reads, so keep planning until there is one.
+    while (nextTileInformationIndex_ == orderedTileInformation_.size()) {
+        if (!takeNextReads()) {
+            currentEncodedFrameReader_ = nullptr;
+            return;
+        }
+    }
+
+    const auto &tileInformation = orderedTileInformation_[nextTileInformationIndex_++];
+    currentEncodedFrameReader_ = std::make_unique<EncodedFrameReader>(
+            tileInformation.filename,
+            tileInformation.framesToRead,
+            tileInformation.frameOffsetInFile,
+            shouldReadEntireGOPs_);
+    setCurrentTile(tileInformation);
+}
+
+std::optional<GOPReaderPacket> ScanTiledVideoOperator::readNextGOP() {
+    if (prefetcher_) {
+        auto prefetched = prefetcher_->next();
+        while (!prefetched) {
+            // Every planned read has been consumed, so take the next reads or finish.
+            if (!takeNextReads())
+                return {};
+            prefetched = prefetcher_->next();
+        }
+
+        if (static_cast<int>(prefetched->requestIndex) != currentRequestIndex_) {
+            currentRequestIndex_ = prefetched->requestIndex;
+            setCurrentTile(orderedTileInformation_[currentRequestIndex_]);
+
+            // Stay a window ahead of the consumer so that the I/O threads keep reading across windows.
+            if (static_cast<unsigned int>(currentRequestIndex_) >= takenReadsStart_)
+                takeNextReads();
+        }
+        return {std::move(prefetched->packet)};
     }
+
+    if (!currentEncodedFrameReader_ || currentEncodedFrameReader_->isEos()) {
+        setUpNextEncodedFrameReader();
+        if (!currentEncodedFrameReader_)
+            return {};
+    }
+
+    auto gopPacket = currentEncodedFrameReader_->read();
+    assert(gopPacket.has_value());
+    return gopPacket;
 }
 
 std::optional<CPUEncodedFrameDataPtr> ScanTiledVideoOperator::next() {
@@ -116,31 +319,30 @@ std::optional<CPUEncodedFrameDataPtr> ScanTiledVideoOperator::next() {
         std::cout << "ANALYSIS: num-frames-decoded " << totalNumberOfFrames_ << std::endl;
         std::cout << "ANALYSIS: num-bytes-decoded " << totalNumberOfBytes_ << std::endl;
         std::cout << "ANALYSIS: num-tiles-read " << numberOfTilesRead_ << std::endl;
+        std::cout << "ANALYSIS: num-frames-not-output " << numberOfFramesNotOutput_ << std::endl;
+        planner_->scanDidFinish();
+        printEncodedGOPCacheStatistics();
+        if (prefetcher_)
+            prefetcher_->printStatistics();
         isComplete_ = true;
         return {};
     }
 
-    if (!currentEncodedFrameReader_ || currentEncodedFrameReader_->isEos()) {
-        setUpNextEncodedFrameReader();
-
-        // If the frame reader is still empty, then there are no more frames to read.
-        // Flush the decoder.
-        if (!currentEncodedFrameReader_) {
-            didSignalEOS_ = true;
-            CUVIDSOURCEDATAPACKET packet;
-            memset(&packet, 0, sizeof(packet));
-            packet.flags = CUVID_PKT_ENDOFSTREAM;
-            Configuration configuration;
-            return std::make_shared<CPUEncodedFrameData>(
-                    configuration,
-                    DecodeReaderPacket(packet));
-        }
+    // Read the next GOP, either from the read-ahead queue or directly from the current tile.
+    auto gopPacket = readNextGOP();
+
+    // If there are no more GOPs to read, flush the decoder.
+    if (!gopPacket) {
+        didSignalEOS_ = true;
+        CUVIDSOURCEDATAPACKET packet;
+        memset(&packet, 0, sizeof(packet));
+        packet.flags = CUVID_PKT_ENDOFSTREAM;
+        Configuration configuration;
+        return std::make_shared<CPUEncodedFrameData>(
+                configuration,
+                DecodeReaderPacket(packet));
     }
 
-    // Otherwise, read and decode frames.
-    auto gopPacket = currentEncodedFrameReader_->read();
-    assert(gopPacket.has_value());
-
     Configuration configuration;
     if (tilePathToConfiguration_.count(*currentTilePath_))
         configuration = tilePathToConfiguration_.at(*currentTilePath_);
@@ -153,65 +355,150 @@ std::optional<CPUEncodedFrameDataPtr> ScanTiledVideoOperator::next() {
     totalNumberOfFrames_ += gopPacket->numberOfFrames();
     totalNumberOfBytes_ += gopPacket->data()->size();
 
+    // GOPs are read from their keyframe, so mark the frames before the ones that contain objects as not output.
+    auto outputFrames = markFramesToOutput(gopPacket->data(), gopPacket->firstFrameIndex(), gopPacket->numberOfFrames(), *currentFramesToOutput_);
+
     unsigned long flags = 0;
-    auto data = std::make_shared<CPUEncodedFrameData>(configuration, DecodeReaderPacket(*gopPacket->data(), flags));
+    auto data = std::make_shared<CPUEncodedFrameData>(configuration, DecodeReaderPacket(gopPacket->data(), flags));
     data->setFirstFrameIndexAndNumberOfFrames(gopPacket->firstFrameIndex(), gopPacket->numberOfFrames());
     data->setTileNumber(currentTileNumber_);
+    if (outputFrames) {
+        numberOfFramesNotOutput_ += gopPacket->numberOfFrames() - outputFrames->size();
+        data->setOutputFrames(std::move(*outputFrames));
+    }
 
     return {data};
 }
 
-static std::vector<unsigned int> ToCtbs(const std::vector<unsigned int> &pixelVals) {
-    std::vector<unsigned int> ctbs(pixelVals.size() - 1);
-    std::transform(pixelVals.begin(), std::prev(pixelVals.end(), 1), ctbs.begin(), [](auto &v) { return std::ceil(v / ALIGNMENT); });
-    return ctbs;
-}
-
-void ScanFullFramesFromTiledVideoOperator::setUpNextEncodedFrameReaders() {
-    currentEncodedFrameReaders_.clear();
-    if (frameIt_ == endFrameIt_)
-        return;
-
-    // Get the group of frames with the same layout.
-    auto frames = std::make_shared<std::vector<int>>();
-    frames->push_back(*frameIt_);
-    auto pathOfNextFrameGroup = pathForFrame(*frameIt_++);
-    while (frameIt_ != endFrameIt_) {
-        if (pathForFrame(*frameIt_) == pathOfNextFrameGroup)
-            frames->push_back(*frameIt_++);
-    }
+std::optional<StitchGroup> ScanFullFramesFromTiledVideoOperator::nextStitchGroup() {
+    std::shared_ptr<std::vector<int>> frames;
+    std::experimental::filesystem::path pathOfNextFrameGroup;
+    do {
+        if (frameIt_ == endFrameIt_)
+            return {};
+
+        // Get the group of frames with the same layout.
+        frames = std::make_shared<std::vector<int>>();
+        frames->push_back(*frameIt_);
+        pathOfNextFrameGroup = pathForFrame(*frameIt_++);
+        while (frameIt_ != endFrameIt_) {
+            if (pathForFrame(*frameIt_) == pathOfNextFrameGroup)
+                frames->push_back(*frameIt_++);
+            else
+                break;
+        }
+    } while (stitchedFrames_ && !stitchedFrames_->shouldStitchFrame(frames->front()));
 
-    // Create a reader for each tile.
+    // Describe the reads for each tile.
     auto frame = frames->front();
     auto layout = tileLocationProvider_->tileLayoutForFrame(frame);
+    std::vector<bool> shouldReadTile(layout->numberOfTiles(), true);
+    if (shouldSkipUnneededTiles_) {
+        for (auto t = 0u; t < layout->numberOfTiles(); ++t)
+            shouldReadTile[t] = tileContainsObject(*layout, t, *frames);
+        // Skip tiles copy their headers from a tile that is read, so read at least one.
+        if (std::none_of(shouldReadTile.begin(), shouldReadTile.end(), [](auto shouldRead) { return shouldRead; }))
+            shouldReadTile[0] = true;
+    }
+
+    // Copy the frames before the readers rewrite them so that the frames in between can be marked as not output.
+    auto framesToOutput = std::make_shared<const std::vector<int>>(*frames);
+    std::vector<TileReadRequest> tiles;
+    std::vector<unsigned int> positions;
     for (auto t = 0u; t < layout->numberOfTiles(); ++t) {
+        if (!shouldReadTile[t])
+            continue;
         auto tilePath = TileFiles::tileFilename(pathOfNextFrameGroup, t);
-        currentEncodedFrameReaders_.push_back(std::make_unique<EncodedFrameReader>(
-                tilePath,
-                frames,
-                tileLocationProvider_->frameOffsetInTileFile(tilePath),
-                false));
+        tiles.push_back({tilePath, frames, tileLocationProvider_->frameOffsetInTileFile(tilePath), false});
+        positions.push_back(t);
     }
+    numberOfTilesSkipped_ += layout->numberOfTiles() - tiles.size();
+    if (tiles.size() == layout->numberOfTiles())
+        positions.clear();
 
     // Create the context for this layout.
+    // PPS ids are assigned here, in frame order, so they do not depend on the order in which GOPs are stitched.
     std::pair<unsigned int, unsigned int> tileDimensions{layout->numberOfRows(), layout->numberOfColumns()};
     std::pair<unsigned int, unsigned int> videoCodedDimensions{layout->codedHeight(), layout->codedWidth()};
     std::pair<unsigned int, unsigned int> videoDisplayDimensions{layout->totalHeight(), layout->totalWidth()};
     bool shouldUseUniformTiles = false;
-    currentContext_ = std::make_unique<stitching::StitchContext>(tileDimensions,
-                                videoCodedDimensions,
-                                videoDisplayDimensions,
-                                shouldUseUniformTiles,
-                                ToCtbs(layout->heightsOfRows()),
-                                ToCtbs(layout->widthsOfColumns()),
-                                ppsId_++);
-    if (ppsId_ >= MAX_PPS_ID)
-        ppsId_ = 1;
+    auto ppsId = ppsIdForLayout_.find(*layout);
+    if (ppsId == ppsIdForLayout_.end()) {
+        ppsId = ppsIdForLayout_.emplace(*layout, ppsId_++).first;
+        if (ppsId_ >= MAX_PPS_ID)
+            ppsId_ = 1;
+    }
+    return StitchGroup{std::move(tiles),
+             stitching::StitchContext(tileDimensions,
+                                      videoCodedDimensions,
+                                      videoDisplayDimensions,
+                                      shouldUseUniformTiles,
+                                      {},
+                                      {},
+                                      ppsId->second),
+             layout->heightsOfRows(),
+             layout->widthsOfColumns(),
+             std::move(positions),
+             std::move(framesToOutput)};
+}
+
+bool ScanFullFramesFromTiledVideoOperator::tileContainsObject(const TileLayout &layout, unsigned int tile, const std::vector<int> &frames) {
+    auto tileRect = layout.rectangleForTile(tile);
+    return std::any_of(frames.begin(), frames.end(), [&](auto frame) {
+        auto &rectanglesForFrame = semanticDataManager_->rectanglesForFrame(frame);
+        return std::any_of(rectanglesForFrame.begin(), rectanglesForFrame.end(), [&](auto &rectangle) {
+            return tileRect.intersects(rectangle);
+        });
+    });
+}
+
+void ScanFullFramesFromTiledVideoOperator::setUpNextEncodedFrameReaders() {
+    currentEncodedFrameReaders_.clear();
+    auto group = nextStitchGroup();
+    if (!group)
+        return;
+
+    // Create a reader for each tile.
+    for (const auto &tile : group->tiles)
+        currentEncodedFrameReaders_.push_back(std::make_unique<EncodedFrameReader>(tile.filename, tile.framesToRead, tile.frameOffsetInFile, tile.shouldReadEntireGOPs));
+    currentGroup_ = std::make_unique<StitchGroup>(std::move(*group));
+}
+
+void ScanFullFramesFromTiledVideoOperator::setUpPipeline() {
+    auto &environment = EnvironmentConfiguration::instance();
+    if (!environment.stitchAheadDepth())
+        return;
+
+    // Groups are planned by the pipeline as it reads them, so the scan starts without walking every frame first.
+    // Only the pipeline calls nextStitchGroup() from here on.
+    auto numberOfThreads = environment.stitchThreads() ? environment.stitchThreads() : std::max(1u, std::thread::hardware_concurrency());
+    pipeline_ = std::make_unique<StitchedGOPPipeline>([this] { return nextStitchGroup(); }, stitchPlans_, environment.stitchAheadDepth(), numberOfThreads);
+}
+
+CPUEncodedFrameDataPtr ScanFullFramesFromTiledVideoOperator::stitchedData(StitchedGOP &gop) {
+    auto data = std::make_shared<CPUEncodedFrameData>(*fullFrameConfig_, gop.packet);
+    data->setFirstFrameIndexAndNumberOfFrames(gop.firstFrameIndex, gop.numberOfFrames);
+    // Hardcode tile number 0 because we're simulating a 1x1 tile layout.
+    data->setTileNumber(0);
+    if (gop.outputFrames) {
+        numberOfFramesNotOutput_ += gop.numberOfFrames - gop.outputFrames->size();
+        data->setOutputFrames(std::move(*gop.outputFrames));
+    }
+    return data;
 }
 
-GOPReaderPacket ScanFullFramesFromTiledVideoOperator::stitchedDataForNextGOP() {
+CPUEncodedFrameDataPtr ScanFullFramesFromTiledVideoOperator::stitchedDataForNextGOP() {
+    // Set up frame readers for next group of frames with the same layout.
+    if (currentEncodedFrameReaders_.empty()) {
+        setUpNextEncodedFrameReaders();
+
+        // If the readers list is still empty after the set up call, then we are done reading frames.
+        if (currentEncodedFrameReaders_.empty())
+            return nullptr;
+    }
+
     // Load the data for each tile.
-    std::vector<std::shared_ptr<std::vector<char>>> dataForGOP;
+    std::vector<std::shared_ptr<const std::vector<char>>> dataForGOP;
     int numberOfFrames = -1;
     int firstFrameIndex = -1;
     for (auto &reader : currentEncodedFrameReaders_) {
@@ -236,8 +523,18 @@ GOPReaderPacket ScanFullFramesFromTiledVideoOperator::stitchedDataForNextGOP() {
     }
 
     // Stitch the data for the different GOPs.
-    stitching::Stitcher stitcher(*currentContext_, dataForGOP);
-    return GOPReaderPacket(stitcher.GetStitchedSegments(), firstFrameIndex, numberOfFrames);
+    // Tiles that were coarsened in the compressed domain are split back into the tiles they were stitched from,
+    // and tiles that were not read are replaced with skip tiles. Frames that are only read as references are marked as not output.
+    auto gop = stitchGOP(*currentGroup_, dataForGOP, stitchPlans_, firstFrameIndex, numberOfFrames);
+    return stitchedData(gop);
+}
+
+CPUEncodedFrameDataPtr ScanFullFramesFromTiledVideoOperator::pipelinedDataForNextGOP() {
+    auto gop = pipeline_->next();
+    if (!gop)
+        return nullptr;
+
+    return stitchedData(*gop);
 }
 
 std::optional<CPUEncodedFrameDataPtr> ScanFullFramesFromTiledVideoOperator::next() {
@@ -245,37 +542,33 @@ std::optional<CPUEncodedFrameDataPtr> ScanFullFramesFromTiledVideoOperator::next
         return {};
 
     if (didSignalEOS_) {
+        printEncodedGOPCacheStatistics();
+        if (pipeline_)
+            pipeline_->printStatistics();
+        std::cout << "ANALYSIS: stitch-plan-hits " << stitchPlans_.hits() << std::endl;
+        std::cout << "ANALYSIS: stitch-plan-misses " << stitchPlans_.misses() << std::endl;
+        std::cout << "ANALYSIS: stitch-plan-evictions " << stitchPlans_.evictions() << std::endl;
+        if (shouldSkipUnneededTiles_)
+            std::cout << "ANALYSIS: num-tiles-skipped " << numberOfTilesSkipped_ << std::endl;
+        std::cout << "ANALYSIS: num-frames-not-output " << numberOfFramesNotOutput_ << std::endl;
         isComplete_ = true;
         return {};
     }
 
-    // Set up frame readers for next group of frames with the same layout.
-    if (currentEncodedFrameReaders_.empty()) {
-        setUpNextEncodedFrameReaders();
+    // Stitch data for all tiles for the next GOP.
+    auto data = pipeline_ ? pipelinedDataForNextGOP() : stitchedDataForNextGOP();
+    if (data)
+        return {data};
 
-        // If the readers list is still empty after the set up call, then we are done reading frames.
-        // Flush the decoder.
-        if (currentEncodedFrameReaders_.empty()) {
-            didSignalEOS_ = true;
-            CUVIDSOURCEDATAPACKET packet;
-            memset(&packet, 0, sizeof(packet));
-            packet.flags = CUVID_PKT_ENDOFSTREAM;
-            Configuration configuration;
-            return std::make_shared<CPUEncodedFrameData>(
-                    configuration,
-                    DecodeReaderPacket(packet));
-        }
-    }
-
-    // Stitch data for all tiles for this GOP.
-    auto packet = stitchedDataForNextGOP();
-    unsigned long flags = 0;
-    auto data = std::make_shared<CPUEncodedFrameData>(*fullFrameConfig_, DecodeReaderPacket(*packet.data(), flags));
-    data->setFirstFrameIndexAndNumberOfFrames(packet.firstFrameIndex(), packet.numberOfFrames());
-    // Hardcode tile number 0 because we're simulating a 1x1 tile layout.
-    data->setTileNumber(0);
-
-    return {data};
+    // We are done reading frames, so flush the decoder.
+    didSignalEOS_ = true;
+    CUVIDSOURCEDATAPACKET packet;
+    memset(&packet, 0, sizeof(packet));
+    packet.flags = CUVID_PKT_ENDOFSTREAM;
+    Configuration configuration;
+    return std::make_shared<CPUEncodedFrameData>(
+            configuration,
+            DecodeReaderPacket(packet));
 }
 
 std::unique_ptr<Configuration> ScanFullFramesFromTiledVideoOperator::fullFrameConfig() {
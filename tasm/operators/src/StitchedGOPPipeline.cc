@@ -0,0 +1,275 @@
+#include "StitchedGOPPipeline.h"
+
+#include "SkipTileGenerator.h"
+#include "Stitcher.h"
+#include "TileExtractor.h"
+#include <algorithm>
+#include <unordered_set>
+
+namespace tasm {
+
+static stitching::StitchContext contextWithTileSizes(const StitchGroup &group, const std::vector<std::shared_ptr<const std::vector<char>>> &tileData) {
+    if (group.heightsOfRows.size() <= 1 && group.widthsOfColumns.size() <= 1)
+        return group.context;
+
+    // Every tile of a layout is encoded with the same CTB size, so it is read from any tile that was read.
+    auto tile = std::find_if(tileData.begin(), tileData.end(), [](const auto &data) { return data != nullptr; });
+    assert(tile != tileData.end());
+    auto ctbSize = stitching::TileExtractor::CtbSize(stitching::bytestring_view((*tile)->data(), (*tile)->size()));
+
+    auto &context = group.context;
+    return stitching::StitchContext(context.GetTileDimensions(),
+                                    context.GetVideoDimensions(),
+                                    {context.GetVideoDisplayHeight(), context.GetVideoDisplayWidth()},
+                                    context.GetShouldUseUniformTiles(),
+                                    stitching::TileSizesInCtbs(group.heightsOfRows, ctbSize),
+                                    stitching::TileSizesInCtbs(group.widthsOfColumns, ctbSize),
+                                    context.GetPPSId());
+}
+
+stitching::StitchContext prepareTilesForStitching(const StitchGroup &group, std::vector<std::shared_ptr<const std::vector<char>>> &tileData) {
+    if (!group.positions.empty()) {
+        assert(group.positions.size() == tileData.size());
+        auto tileDimensions = group.context.GetTileDimensions();
+        std::vector<std::shared_ptr<const std::vector<char>>> placedTileData(tileDimensions.first * tileDimensions.second);
+        for (auto i = 0u; i < tileData.size(); ++i)
+            placedTileData[group.positions[i]] = std::move(tileData[i]);
+        tileData = std::move(placedTileData);
+    }
+
+    auto sizedContext = contextWithTileSizes(group, tileData);
+    auto expandedContext = stitching::ExpandStitchedTiles(sizedContext, tileData);
+    auto context = expandedContext ? *expandedContext : sizedContext;
+    stitching::FillSkipTiles(context, tileData);
+    return context;
+}
+
+static std::vector<int> framesToOutputInGOP(const std::vector<int> &framesToOutput, unsigned int firstFrameIndex, unsigned int numberOfFrames) {
+    auto first = std::lower_bound(framesToOutput.begin(), framesToOutput.end(), static_cast<int>(firstFrameIndex));
+    auto last = std::lower_bound(first, framesToOutput.end(), static_cast<int>(firstFrameIndex + numberOfFrames));
+    return std::vector<int>(first, last);
+}
+
+std::optional<std::vector<int>> markFramesToOutput(std::vector<char> &gopData, unsigned int firstFrameIndex, unsigned int numberOfFrames,
+                                                   const std::vector<int> &framesToOutput) {
+    auto outputFrames = framesToOutputInGOP(framesToOutput, firstFrameIndex, numberOfFrames);
+    if (outputFrames.size() == numberOfFrames)
+        return {};
+
+    // Frames are numbered in decoding order, which is also the output order because tiles are encoded without B-frames.
+    std::unordered_set<int> framesToKeep(outputFrames.begin(), outputFrames.end());
+    try {
+        stitching::PicOutputFlagAdder adder(framesToKeep);
+        adder.addPicOutputFlagToGOP(gopData, firstFrameIndex, framesToKeep);
+    } catch (const std::exception &) {
+        // The GOP uses syntax that cannot be rewritten, or its parameter sets are truncated, so decode it as is and
+        // output every frame.
+        return {};
+    }
+    return {std::move(outputFrames)};
+}
+
+std::optional<std::vector<int>> markFramesToOutput(std::shared_ptr<const std::vector<char>> &gopData, unsigned int firstFrameIndex, unsigned int numberOfFrames,
+                                                   const std::vector<int> &framesToOutput) {
+    if (framesToOutputInGOP(framesToOutput, firstFrameIndex, numberOfFrames).size() == numberOfFrames)
+        return {};
+
+    // A failed rewrite may have changed part of the copy, so the original is kept unless every frame was marked.
+    auto markedData = std::make_shared<std::vector<char>>(*gopData);
+    auto outputFrames = markFramesToOutput(*markedData, firstFrameIndex, numberOfFrames, framesToOutput);
+    if (outputFrames)
+        gopData = std::move(markedData);
+    return outputFrames;
+}
+
+StitchedGOP stitchGOP(const StitchGroup &group, std::vector<std::shared_ptr<const std::vector<char>>> &tileData, stitching::StitchPlanCache &stitchPlans,
+                      unsigned int firstFrameIndex, unsigned int numberOfFrames) {
+    // The stitched segments refer to the tiles' data, so the decoder packet is the only copy of the payload.
+    // GOPs with the same layout and parameter sets share a plan, so their headers are only rewritten once.
+    auto context = prepareTilesForStitching(group, tileData);
+    stitching::Stitcher stitcher(context, tileData, stitchPlans);
+    auto segments = stitcher.StitchSegments();
+    unsigned long flags = 0;
+
+    // The stitcher cannot parse headers that have pic_output_flag, so frames are marked after stitching.
+    // This needs a contiguous copy of the GOP, so it is only made when some frames are not needed.
+    if (group.framesToOutput && framesToOutputInGOP(*group.framesToOutput, firstFrameIndex, numberOfFrames).size() != numberOfFrames) {
+        auto gopData = segments.GetBytes();
+        auto outputFrames = markFramesToOutput(*gopData, firstFrameIndex, numberOfFrames, *group.framesToOutput);
+        return {DecodeReaderPacket(std::shared_ptr<const std::vector<char>>(std::move(gopData)), flags), firstFrameIndex, numberOfFrames, std::move(outputFrames)};
+    }
+    return {DecodeReaderPacket(segments.GetIovecs(), flags), firstFrameIndex, numberOfFrames, {}};
+}
+
+StitchedGOPPipeline::StitchedGOPPipeline(StitchGroupSource nextGroup, stitching::StitchPlanCache &stitchPlans, unsigned int depth, unsigned int numberOfThreads)
+    : nextGroup_(std::move(nextGroup)),
+    stitchPlans_(stitchPlans),
+    depth_(depth),
+    nextSequenceNumberToRead_(0),
+    nextSequenceNumberToReturn_(0),
+    isDoneReading_(false),
+    shouldStop_(false),
+    errorSequenceNumber_(0),
+    numberOfGOPsStitched_(0),
+    numberOfBytesStitched_(0),
+    maxNumberOfBufferedGOPs_(0),
+    numberOfStalls_(0),
+    timeStalled_(0)
+{
+    assert(depth_);
+    assert(numberOfThreads);
+    for (auto i = 0u; i < numberOfThreads; ++i)
+        threads_.emplace_back(&StitchedGOPPipeline::stitchGOPs, this);
+}
+
+StitchedGOPPipeline::~StitchedGOPPipeline() {
+    {
+        std::scoped_lock lock(mutex_);
+        shouldStop_ = true;
+    }
+    spaceAvailable_.notify_all();
+    for (auto &thread : threads_)
+        thread.join();
+}
+
+std::shared_ptr<const StitchGroup> StitchedGOPPipeline::readTilesForNextGOP(std::vector<std::shared_ptr<const std::vector<char>>> &tileData, unsigned int &firstFrameIndex, unsigned int &numberOfFrames) {
+    if (currentReaders_.empty()) {
+        auto group = nextGroup_();
+        if (!group)
+            return nullptr;
+
+        currentGroup_ = std::make_shared<const StitchGroup>(std::move(*group));
+        for (const auto &tile : currentGroup_->tiles)
+            currentReaders_.push_back(std::make_unique<EncodedFrameReader>(tile.filename, tile.framesToRead, tile.frameOffsetInFile, tile.shouldReadEntireGOPs));
+    }
+
+    auto group = currentGroup_;
+    for (auto i = 0u; i < currentReaders_.size(); ++i) {
+        auto gopPacket = currentReaders_[i]->read();
+        assert(gopPacket.has_value());
+        if (!i) {
+            firstFrameIndex = gopPacket->firstFrameIndex();
+            numberOfFrames = gopPacket->numberOfFrames();
+        } else {
+            assert(gopPacket->firstFrameIndex() == firstFrameIndex);
+            assert(gopPacket->numberOfFrames() == numberOfFrames);
+        }
+        tileData.push_back(std::shared_ptr(std::move(gopPacket->data())));
+    }
+
+    // Move on to the next group once every tile of this one has been read.
+    if (std::all_of(currentReaders_.begin(), currentReaders_.end(), [](const auto &reader) { return reader->isEos(); })) {
+        currentReaders_.clear();
+        currentGroup_.reset();
+    }
+    return group;
+}
+
+void StitchedGOPPipeline::stitchGOPs() {
+    while (true) {
+        std::vector<std::shared_ptr<const std::vector<char>>> tileData;
+        std::shared_ptr<const StitchGroup> group;
+        unsigned int firstFrameIndex;
+        unsigned int numberOfFrames;
+        unsigned long sequenceNumber;
+        {
+            // Hold readMutex_ while reading so that sequence numbers follow the order of the readers.
+            std::scoped_lock readLock(readMutex_);
+            {
+                std::unique_lock lock(mutex_);
+                spaceAvailable_.wait(lock, [&] {
+                    return shouldStop_ || isDoneReading_ || nextSequenceNumberToRead_ < nextSequenceNumberToReturn_ + depth_;
+                });
+                if (shouldStop_ || isDoneReading_)
+                    return;
+            }
+
+            try {
+                group = readTilesForNextGOP(tileData, firstFrameIndex, numberOfFrames);
+            } catch (...) {
+                std::scoped_lock lock(mutex_);
+                stopAfterError(nextSequenceNumberToRead_);
+                return;
+            }
+
+            std::scoped_lock lock(mutex_);
+            if (!group) {
+                isDoneReading_ = true;
+                gopAvailable_.notify_all();
+                spaceAvailable_.notify_all();
+                return;
+            }
+            sequenceNumber = nextSequenceNumberToRead_++;
+        }
+
+        // Stitching only depends on this GOP's tiles, so it runs outside of the read lock.
+        std::optional<StitchedGOP> gop;
+        try {
+            gop.emplace(stitchGOP(*group, tileData, stitchPlans_, firstFrameIndex, numberOfFrames));
+        } catch (...) {
+            std::scoped_lock lock(mutex_);
+            stopAfterError(sequenceNumber);
+            return;
+        }
+
+        std::scoped_lock lock(mutex_);
+        ++numberOfGOPsStitched_;
+        numberOfBytesStitched_ += gop->packet.payload_size;
+        stitchedGOPs_.emplace(sequenceNumber, std::move(*gop));
+        maxNumberOfBufferedGOPs_ = std::max(maxNumberOfBufferedGOPs_, static_cast<unsigned int>(stitchedGOPs_.size()));
+        gopAvailable_.notify_all();
+    }
+}
+
+void StitchedGOPPipeline::stopAfterError(unsigned long sequenceNumber) {
+    // GOPs are still stitched in parallel, so a later GOP can fail first.
+    if (!error_ || sequenceNumber < errorSequenceNumber_) {
+        error_ = std::current_exception();
+        errorSequenceNumber_ = sequenceNumber;
+    }
+    isDoneReading_ = true;
+    gopAvailable_.notify_all();
+    spaceAvailable_.notify_all();
+}
+
+std::optional<StitchedGOP> StitchedGOPPipeline::next() {
+    std::unique_lock lock(mutex_);
+    auto hasData = [&] {
+        return (error_ && errorSequenceNumber_ <= nextSequenceNumberToReturn_)
+            || stitchedGOPs_.count(nextSequenceNumberToReturn_)
+            || (isDoneReading_ && nextSequenceNumberToReturn_ == nextSequenceNumberToRead_);
+    };
+    if (!hasData()) {
+        ++numberOfStalls_;
+        auto start = std::chrono::steady_clock::now();
+        gopAvailable_.wait(lock, hasData);
+        timeStalled_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    }
+
+    // The GOPs before a failure are returned first, like they are when stitching one GOP after another.
+    auto gop = stitchedGOPs_.find(nextSequenceNumberToReturn_);
+    if (gop == stitchedGOPs_.end()) {
+        if (error_)
+            std::rethrow_exception(error_);
+        return {};
+    }
+
+    StitchedGOP result = std::move(gop->second);
+    stitchedGOPs_.erase(gop);
+    ++nextSequenceNumberToReturn_;
+    spaceAvailable_.notify_all();
+    return {std::move(result)};
+}
+
+void StitchedGOPPipeline::printStatistics() const {
+    std::scoped_lock lock(mutex_);
+    std::cout << "ANALYSIS: stitch-ahead-depth " << depth_ << std::endl;
+    std::cout << "ANALYSIS: stitch-ahead-threads " << threads_.size() << std::endl;
+    std::cout << "ANALYSIS: stitch-ahead-gops-stitched " << numberOfGOPsStitched_ << std::endl;
+    std::cout << "ANALYSIS: stitch-ahead-bytes-stitched " << numberOfBytesStitched_ << std::endl;
+    std::cout << "ANALYSIS: stitch-ahead-max-buffered-gops " << maxNumberOfBufferedGOPs_ << std::endl;
+    std::cout << "ANALYSIS: stitch-ahead-stalls " << numberOfStalls_ << std::endl;
+    std::cout << "ANALYSIS: stitch-ahead-stall-time-us " << timeStalled_.count() << std::endl;
+}
+
+} // namespace tasm
@@ -10,6 +10,10 @@ std::optional<GPUDecodedFrameData> TileOperator::next() {
     if (parent_->isComplete()) {
         readDataFromEncoders(true);
         saveTileGroupsToDisk();
+
+        // Make every tile group written by this operator visible to readers at once.
+        outputEntry_->publishTileVersion();
+        writeLock_.reset();
         isComplete_ = true;
         return {};
     }
@@ -62,17 +66,13 @@ void TileOperator::saveTileGroupsToDisk() {
     TileCrackingTransaction transaction(outputEntry_,
                                       *currentTileLayout_,
                                       firstFrameInGroup_,
-                                      lastFrameInGroup_);
+                                      lastFrameInGroup_,
+                                      video_->configuration().frameRate);
 
     // Get the list of tiles that should be involved in the current tile layout.
-    // Create an output for each.
+    // Hand the encoded data for each to the transaction, which muxes it directly from memory.
     for (auto &tileIndex : tilesCurrentlyBeingEncoded_) {
-        auto &output = transaction.write(tileIndex);
-
-        // Write the encoded data for this tile index to the output stream.
-        for (auto &data : encodedDataForTiles_[tileIndex])
-            output.stream().write(data->data(), data->size());
-
+        transaction.write(tileIndex, std::move(encodedDataForTiles_[tileIndex]));
         encodedDataForTiles_[tileIndex].clear();
     }
 
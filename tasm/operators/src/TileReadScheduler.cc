@@ -0,0 +1,197 @@
+#include "TileReadScheduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <tuple>
+
+namespace tasm {
+
+double TileReadSchedule::estimatedCost() const {
+    if (estimatedCostForDecoder.empty())
+        return 0;
+    return *std::max_element(estimatedCostForDecoder.begin(), estimatedCostForDecoder.end());
+}
+
+std::ostream &operator<<(std::ostream &ostr, const TileReadSchedule &schedule) {
+    ostr << "estimated_cost_us: " << schedule.estimatedCost()
+         << ", reconfigurations: " << schedule.numberOfReconfigurations
+         << ", file_opens: " << schedule.numberOfFileOpens << "\n";
+    for (auto decoder = 0u; decoder < schedule.readsForDecoder.size(); ++decoder) {
+        ostr << "decoder " << decoder << ", estimated_cost_us: " << schedule.estimatedCostForDecoder[decoder] << "\n";
+        for (auto index : schedule.readsForDecoder[decoder]) {
+            const auto &read = schedule.reads[index];
+            ostr << "  " << read.width << "x" << read.height
+                 << " frames " << read.firstFrame << "-" << read.lastFrame
+                 << " from " << read.filename.string() << "\n";
+        }
+    }
+    return ostr;
+}
+
+TileReadScheduler::TileReadScheduler(unsigned int numberOfDecoders, TileReadCostModel costModel)
+    : costModel_(costModel),
+    decoders_(numberOfDecoders, DecoderState{0, 0, {}, -1})
+{
+    assert(numberOfDecoders);
+}
+
+double TileReadScheduler::estimateCost(DecoderState &state, const std::vector<TileRead> &reads, const std::vector<unsigned int> &order,
+                                       unsigned int *numberOfReconfigurations, unsigned int *numberOfFileOpens) const {
+    double cost = 0;
+    for (auto index : order) {
+        const auto &read = reads[index];
+        if (read.width != state.width || read.height != state.height) {
+            cost += costModel_.reconfigurationCost;
+            if (numberOfReconfigurations)
+                ++*numberOfReconfigurations;
+        }
+        if (read.filename != state.filename) {
+            cost += costModel_.fileOpenCost;
+            if (numberOfFileOpens)
+                ++*numberOfFileOpens;
+        } else {
+            cost += costModel_.seekCostPerFrame * std::abs(read.firstFrame - state.lastFrame - 1);
+        }
+        cost += costModel_.decodeCostPerPixel * read.width * read.height * read.numberOfFrames;
+        state = {read.width, read.height, read.filename, read.lastFrame};
+    }
+    return cost;
+}
+
+TileReadSchedule TileReadScheduler::schedule(std::vector<TileRead> reads) {
+    auto isEarlierInFile = [&](unsigned int left, unsigned int right) {
+        const auto &l = reads[left];
+        const auto &r = reads[right];
+        return std::tie(l.frameOffsetInFile, l.filename, l.firstFrame) < std::tie(r.frameOffsetInFile, r.filename, r.firstFrame);
+    };
+    const DecoderState unconfigured{0, 0, {}, -1};
+
+    // Group the reads into a queue per dimension, ordered by file and frame offset.
+    std::map<std::pair<unsigned int, unsigned int>, std::vector<unsigned int>> readsWithDimensions;
+    for (auto i = 0u; i < reads.size(); ++i)
+        readsWithDimensions[{reads[i].height, reads[i].width}].push_back(i);
+
+    struct Queue {
+        // Height, then width, so that queues are ordered the way tile reads always have been.
+        std::pair<unsigned int, unsigned int> dimensions;
+        std::vector<unsigned int> reads;
+        double cost;
+    };
+    std::vector<Queue> queues;
+    double totalCost = 0;
+    for (auto &[dimensions, queueReads] : readsWithDimensions) {
+        std::sort(queueReads.begin(), queueReads.end(), isEarlierInFile);
+        auto state = unconfigured;
+        auto cost = estimateCost(state, reads, queueReads);
+        totalCost += cost;
+        queues.push_back({dimensions, std::move(queueReads), cost});
+    }
+
+    // Split queues that are larger than a decoder's share so that every decoder has work.
+    if (decoders_.size() > 1 && totalCost > 0) {
+        auto share = totalCost / decoders_.size();
+        std::vector<Queue> splitQueues;
+        for (auto &queue : queues) {
+            auto numberOfParts = std::min<std::size_t>(queue.reads.size(), std::ceil(queue.cost / share));
+            if (numberOfParts <= 1) {
+                splitQueues.push_back(std::move(queue));
+                continue;
+            }
+
+            auto costPerPart = queue.cost / numberOfParts;
+            auto numberOfPartsDone = 0u;
+            Queue part{queue.dimensions, {}, 0};
+            auto state = unconfigured;
+            for (auto index : queue.reads) {
+                part.cost += estimateCost(state, reads, {index});
+                part.reads.push_back(index);
+                if (part.cost >= costPerPart && numberOfPartsDone + 1 < numberOfParts) {
+                    splitQueues.push_back(std::move(part));
+                    ++numberOfPartsDone;
+                    part = Queue{queue.dimensions, {}, 0};
+                    state = unconfigured;
+                }
+            }
+            if (!part.reads.empty())
+                splitQueues.push_back(std::move(part));
+        }
+        queues = std::move(splitQueues);
+    }
+
+    // Assign the most expensive queues first, each to the decoder that would finish it earliest.
+    auto isConfiguredFor = [](const DecoderState &decoder, const Queue &queue) {
+        return decoder.height == queue.dimensions.first && decoder.width == queue.dimensions.second;
+    };
+    std::stable_sort(queues.begin(), queues.end(), [](const auto &left, const auto &right) { return left.cost > right.cost; });
+    std::vector<double> load(decoders_.size(), 0);
+    std::vector<std::vector<const Queue *>> queuesForDecoder(decoders_.size());
+    for (const auto &queue : queues) {
+        auto bestDecoder = 0u;
+        auto earliestFinish = std::numeric_limits<double>::max();
+        for (auto decoder = 0u; decoder < decoders_.size(); ++decoder) {
+            auto finish = load[decoder] + queue.cost;
+            if (isConfiguredFor(decoders_[decoder], queue))
+                finish -= costModel_.reconfigurationCost;
+            if (finish < earliestFinish) {
+                earliestFinish = finish;
+                bestDecoder = decoder;
+            }
+        }
+        load[bestDecoder] = earliestFinish;
+        queuesForDecoder[bestDecoder].push_back(&queue);
+    }
+
+    TileReadSchedule schedule{{}, std::vector<std::vector<unsigned int>>(decoders_.size()), std::vector<double>(decoders_.size(), 0), 0, 0};
+    for (auto decoder = 0u; decoder < decoders_.size(); ++decoder) {
+        // Start with the queue the decoder is already configured for, and then read the rest in order of dimensions.
+        auto &decoderQueues = queuesForDecoder[decoder];
+        std::sort(decoderQueues.begin(), decoderQueues.end(), [&](const Queue *left, const Queue *right) {
+            auto leftIsConfigured = isConfiguredFor(decoders_[decoder], *left);
+            auto rightIsConfigured = isConfiguredFor(decoders_[decoder], *right);
+            if (leftIsConfigured != rightIsConfigured)
+                return leftIsConfigured;
+            if (left->dimensions != right->dimensions)
+                return left->dimensions < right->dimensions;
+            return isEarlierInFile(left->reads.front(), right->reads.front());
+        });
+
+        std::vector<unsigned int> groupedOrder;
+        for (const auto *queue : decoderQueues)
+            groupedOrder.insert(groupedOrder.end(), queue->reads.begin(), queue->reads.end());
+        auto fileOrder = groupedOrder;
+        std::sort(fileOrder.begin(), fileOrder.end(), isEarlierInFile);
+
+        // Grouping by dimensions saves reconfigurations at the cost of jumping between files; keep whichever is cheaper.
+        auto groupedState = decoders_[decoder];
+        auto groupedReconfigurations = 0u;
+        auto groupedFileOpens = 0u;
+        auto groupedCost = estimateCost(groupedState, reads, groupedOrder, &groupedReconfigurations, &groupedFileOpens);
+
+        auto fileOrderState = decoders_[decoder];
+        auto fileOrderReconfigurations = 0u;
+        auto fileOrderFileOpens = 0u;
+        auto fileOrderCost = estimateCost(fileOrderState, reads, fileOrder, &fileOrderReconfigurations, &fileOrderFileOpens);
+
+        if (fileOrderCost < groupedCost) {
+            schedule.readsForDecoder[decoder] = std::move(fileOrder);
+            schedule.estimatedCostForDecoder[decoder] = fileOrderCost;
+            schedule.numberOfReconfigurations += fileOrderReconfigurations;
+            schedule.numberOfFileOpens += fileOrderFileOpens;
+            decoders_[decoder] = std::move(fileOrderState);
+        } else {
+            schedule.readsForDecoder[decoder] = std::move(groupedOrder);
+            schedule.estimatedCostForDecoder[decoder] = groupedCost;
+            schedule.numberOfReconfigurations += groupedReconfigurations;
+            schedule.numberOfFileOpens += groupedFileOpens;
+            decoders_[decoder] = std::move(groupedState);
+        }
+    }
+
+    schedule.reads = std::move(reads);
+    return schedule;
+}
+
+} // namespace tasm
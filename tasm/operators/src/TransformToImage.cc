@@ -1,5 +1,6 @@
 #include "TransformToImage.h"
 
+#include "HostColorSpace.h"
 #include <fstream>
 
 namespace tasm {
@@ -37,14 +38,54 @@ std::optional<std::unique_ptr<std::vector<ImagePtr>>> TransformToImage::next() {
     for (auto object : **objectPixels) {
         auto width = object->width();
         auto height = object->height();
-        auto frameSize = width * height * numChannels_;
+        auto frameSize = PixelFormatSize(format_, width, height);
 
-        std::unique_ptr<uint8_t[]> pImage(new uint8_t[frameSize]);
-        GetImage(object->handle(), reinterpret_cast<uint8_t*>(pImage.get()), numChannels_ * width, height, numChannels_ * object->xOffset(), object->yOffset(), object->pitch());
+        // Copy the region out of the NV12 frame, widened to whole chroma samples.
+        auto left = object->xOffset() & ~1u;
+        auto top = object->yOffset() & ~1u;
+        auto regionWidth = (object->xOffset() + width - left + 1) & ~1u;
+        auto regionHeight = object->yOffset() + height - top;
+        auto chromaHeight = (regionHeight + 1) / 2;
+        nv12_.resize(regionWidth * (regionHeight + chromaHeight));
+        auto luma = nv12_.data();
+        auto chroma = luma + regionWidth * regionHeight;
+        GetImage(object->handle(), luma, regionWidth, regionHeight, left, top, object->pitch());
+        GetImage(object->handle(), chroma, regionWidth, chromaHeight, left, object->frameHeight() + top / 2, object->pitch());
+
+        auto pImage = ImageBufferPool::instance().allocate(frameSize);
+        Nv12ToPixelFormat(luma, chroma, regionWidth, object->xOffset() - left, object->yOffset() - top, width, height,
+                          format_, pImage.get());
 
         assert(frameSize);
         assert(pImage);
-        images->emplace_back(std::make_unique<Image>(width, height, std::move(pImage)));
+        images->emplace_back(std::make_unique<Image>(width, height, std::move(pImage), format_,
+                                                     object->frameNumber(), object->frameX(), object->frameY()));
+    }
+    return images;
+}
+
+std::optional<std::unique_ptr<std::vector<ImagePtr>>> TransformCPUPixelsToImage::next() {
+    if (isComplete_)
+        return std::nullopt;
+
+    auto objectPixels = parent_->next();
+    if (parent_->isComplete()) {
+        isComplete_ = true;
+        return std::nullopt;
+    }
+    assert(objectPixels.has_value());
+
+    auto images = std::make_unique<std::vector<ImagePtr>>();
+    for (auto &object : **objectPixels) {
+        auto width = object->width();
+        auto height = object->height();
+        auto &frame = object->frame();
+
+        auto pImage = ImageBufferPool::instance().allocate(PixelFormatSize(format_, width, height));
+        Nv12ToPixelFormat(frame.luma(), frame.chroma(), frame.pitch(), object->xOffset(), object->yOffset(), width, height,
+                          format_, pImage.get());
+        images->emplace_back(std::make_unique<Image>(width, height, std::move(pImage), format_,
+                                                     frame.frameNumber(), object->frameX(), object->frameY()));
     }
     return images;
 }
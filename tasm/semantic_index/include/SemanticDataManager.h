@@ -5,6 +5,7 @@
 #include "SemanticIndex.h"
 #include "SemanticSelection.h"
 #include "TemporalSelection.h"
+#include <mutex>
 
 namespace tasm {
 
@@ -25,6 +26,7 @@ public:
     {}
 
     const std::vector<int> &orderedFrames() {
+        std::scoped_lock lock(mutex_);
         if (orderedFrames_)
             return *orderedFrames_;
 
@@ -32,7 +34,10 @@ public:
         return *orderedFrames_;
     }
 
+    // Scans plan on their decoders' threads while the operators that merge tiles look up rectangles, so lookups are locked.
+    // The rectangles are never moved once they are loaded, so references stay valid after the lock is released.
     const std::list<Rectangle> &rectanglesForFrame(int frame) {
+        std::scoped_lock lock(mutex_);
         if (frameToRectangles_.count(frame))
             return *frameToRectangles_.at(frame);
 
@@ -56,6 +61,7 @@ private:
 
     std::unique_ptr<std::vector<int>> orderedFrames_;
     std::unordered_map<int, std::unique_ptr<std::list<Rectangle>>> frameToRectangles_;
+    std::mutex mutex_;
 };
 
 } // namespace tasm
@@ -0,0 +1,73 @@
+#ifndef TASM_CATALOGSNAPSHOTS_H
+#define TASM_CATALOGSNAPSHOTS_H
+
+#include "Video.h"
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace tasm {
+
+// Tracks the catalog versions pinned by open readers so that tile directories are reclaimed only once no reader can see them.
+// A reader that pins version V sees exactly the tile directories whose tile version is less than V.
+// Writers publish new directories atomically by advancing the entry's published tile version.
+class CatalogSnapshots {
+public:
+    // Held by the single writer of an entry. It may be released from a different thread than the one that acquired it.
+    class WriteLock {
+    public:
+        WriteLock(WriteLock &&other) noexcept;
+        WriteLock &operator=(WriteLock &&other) noexcept;
+        ~WriteLock();
+
+    private:
+        friend class CatalogSnapshots;
+        explicit WriteLock(std::string entryPath);
+        void release();
+
+        std::string entryPath_;
+    };
+
+    static CatalogSnapshots &instance();
+
+    // Waits until no other writer holds the entry, then discards the directories that earlier writes left unpublished.
+    // Tile versions are allocated in memory from the published version, so writers have to hold the lock until they
+    // publish; otherwise one writer could discard or overwrite the directories of another that has not published yet.
+    WriteLock lockForWriting(TiledEntry &entry);
+
+    // Pins and returns the latest published version of the entry.
+    unsigned int pin(const TiledEntry &entry);
+    void release(const std::experimental::filesystem::path &entryPath, unsigned int snapshotVersion);
+
+    // Removes `directory` once every snapshot of the entry is at least `shadowedAsOf`, i.e. once every reader
+    // sees a newer version of all of its frames. Returns true if the directory was removed immediately.
+    bool reclaimWhenUnpinned(const std::experimental::filesystem::path &entryPath,
+                             const std::experimental::filesystem::path &directory,
+                             unsigned int shadowedAsOf);
+
+    unsigned int numberOfPendingReclamations(const std::experimental::filesystem::path &entryPath) const;
+
+private:
+    struct PendingReclamation {
+        std::experimental::filesystem::path directory;
+        unsigned int shadowedAsOf;
+    };
+
+    bool canReclaim(const std::string &entryPath, unsigned int shadowedAsOf) const;
+    std::vector<std::experimental::filesystem::path> takeReclaimableDirectories(const std::string &entryPath);
+    static std::experimental::filesystem::path hide(const std::experimental::filesystem::path &directory);
+    static void remove(const std::vector<std::experimental::filesystem::path> &hiddenDirectories);
+    void releaseWriter(const std::string &entryPath);
+
+    std::set<std::string> writers_;
+    std::condition_variable writerReleased_;
+    std::unordered_map<std::string, std::multiset<unsigned int>> pinnedVersions_;
+    std::unordered_map<std::string, std::vector<PendingReclamation>> pendingReclamations_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace tasm
+
+#endif //TASM_CATALOGSNAPSHOTS_H
@@ -0,0 +1,42 @@
+#ifndef TASM_COMPRESSEDTILEINGESTER_H
+#define TASM_COMPRESSEDTILEINGESTER_H
+
+#include "Gpac.h"
+#include "TileExtractor.h"
+#include "TileLayout.h"
+#include "Video.h"
+#include <functional>
+
+namespace tasm {
+
+// Stores a video that was already encoded with HEVC tiles by splitting its bitstream into one bitstream per tile,
+// without decoding or re-encoding it. Each GOP of the source becomes one tile directory, so only one GOP is held in
+// memory at a time. The tiles can only be decoded on their own if the source was encoded with motion-constrained
+// tiles; see stitching::TileExtractor for the other requirements. Sources whose pictures are output out of decoding
+// order cannot be ingested, since tiles are muxed with their decoding times.
+class CompressedTileIngester {
+public:
+    CompressedTileIngester(std::shared_ptr<Video> video, const std::string &outputEntryName)
+        : video_(video),
+        outputEntryName_(outputEntryName) {}
+
+    // Returns the tile layout of the first GOP, or nullptr if the video is not HEVC or its tiles cannot be extracted.
+    std::shared_ptr<const TileLayout> sourceTileLayout() const;
+
+    // Throws std::runtime_error if a later GOP cannot be extracted, after removing the directories it already wrote.
+    void ingest();
+
+private:
+    // Calls visit with the Annex B data of each GOP of the source, in order, until it returns false.
+    void forEachGOP(const std::function<bool(const std::vector<char>&)> &visit) const;
+    // Raw Annex B files have no sample table, so they are read in blocks and split before each IRAP picture.
+    void forEachAnnexBGOP(const std::function<bool(const std::vector<char>&)> &visit) const;
+    void saveTileGroupToDisk(std::shared_ptr<TiledEntry> entry, stitching::ExtractedTiles &extracted, int firstFrame) const;
+
+    std::shared_ptr<Video> video_;
+    std::string outputEntryName_;
+};
+
+} // namespace tasm
+
+#endif //TASM_COMPRESSEDTILEINGESTER_H
@@ -0,0 +1,34 @@
+#ifndef TASM_TILECOARSENER_H
+#define TASM_TILECOARSENER_H
+
+#include "TileConfigurationProvider.h"
+#include "TileLayout.h"
+#include "Video.h"
+
+namespace tasm {
+
+// Retiles GOPs to a layout that only merges adjacent tiles of the current layout, without decoding them.
+// Each new tile is stitched from the current tiles it covers, so it keeps them as HEVC tiles inside it.
+// Full-frame scans split such tiles back into the tiles they were stitched from before stitching the frame.
+class TileCoarsener {
+public:
+    explicit TileCoarsener(std::shared_ptr<TiledEntry> entry)
+        : entry_(entry) {}
+
+    // Whether every column and row boundary of newLayout is also a boundary of currentLayout.
+    static bool isCoarseningOf(const TileLayout &currentLayout, const TileLayout &newLayout);
+
+    // Retiles the GOPs that start at gopStartFrames and can be coarsened, and publishes them as a new tile version.
+    // GOPs that already have the new layout are left as they are.
+    // Each GOP spans at most gopLength frames; frameRate is the timescale the new tiles are muxed with.
+    // Returns the frames from gopStartFrames whose GOPs introduce a new boundary, and so have to be re-encoded.
+    std::shared_ptr<std::vector<int>> coarsen(const std::vector<int> &gopStartFrames, TileLayoutProvider &newLayoutProvider,
+                                              unsigned int gopLength, unsigned int frameRate);
+
+private:
+    std::shared_ptr<TiledEntry> entry_;
+};
+
+} // namespace tasm
+
+#endif //TASM_TILECOARSENER_H
@@ -0,0 +1,68 @@
+#ifndef TASM_TILEVERSIONCOMPACTOR_H
+#define TASM_TILEVERSIONCOMPACTOR_H
+
+#include "Video.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace tasm {
+
+class TiledVideoManager;
+
+struct ShadowedDirectory {
+    std::experimental::filesystem::path path;
+    // The oldest snapshot version that sees a newer version of every frame in the directory.
+    unsigned int shadowedAsOf;
+};
+
+// Removes tile directories whose frames are all covered by directories with a newer tile version.
+// Such directories are never read because SingleTileLocationProvider always picks the newest version.
+// The compactor only decides which directories are shadowed, and as of which version. CatalogSnapshots decides when they
+// can be removed, because it tracks which versions open readers have pinned.
+class TileVersionCompactor {
+public:
+    explicit TileVersionCompactor(std::shared_ptr<TiledEntry> entry)
+        : entry_(entry) {}
+
+    // Returns the number of directories that were removed immediately.
+    // Directories that are still visible to an open snapshot are removed when the last such snapshot is released.
+    unsigned int compact();
+
+    std::vector<std::experimental::filesystem::path> shadowedDirectories() const;
+
+private:
+    std::vector<ShadowedDirectory> shadowedDirectoriesWithVersions(const TiledVideoManager &tiledVideoManager) const;
+
+    std::shared_ptr<TiledEntry> entry_;
+};
+
+// Periodically compacts every video in the catalog.
+class BackgroundTileVersionCompactor {
+public:
+    explicit BackgroundTileVersionCompactor(std::chrono::seconds interval)
+        : interval_(interval),
+        shouldStop_(false),
+        thread_(&BackgroundTileVersionCompactor::run, this) {}
+
+    ~BackgroundTileVersionCompactor() {
+        stop();
+    }
+
+    void stop();
+
+private:
+    void run();
+    void compactCatalog();
+
+    std::chrono::seconds interval_;
+    bool shouldStop_;
+    std::mutex mutex_;
+    std::condition_variable stopCondition_;
+    std::thread thread_;
+};
+
+} // namespace tasm
+
+#endif //TASM_TILEVERSIONCOMPACTOR_H
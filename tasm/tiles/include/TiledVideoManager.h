@@ -1,6 +1,7 @@
 #ifndef TASM_TILEDVIDEOMANAGER_H
 #define TASM_TILEDVIDEOMANAGER_H
 
+#include "CatalogSnapshots.h"
 #include "IntervalTree.h"
 #include "TileLayout.h"
 #include "Video.h"
@@ -15,10 +16,17 @@ public:
               totalHeight_(0),
               largestWidth_(0),
               largestHeight_(0),
-              maximumFrame_(0) {
+              maximumFrame_(0),
+              snapshotVersion_(CatalogSnapshots::instance().pin(*entry_)) {
         loadAllTileConfigurations();
     }
 
+    ~TiledVideoManager() {
+        CatalogSnapshots::instance().release(entry_->path(), snapshotVersion_);
+    }
+
+    TiledVideoManager(const TiledVideoManager&) = delete;
+
     std::shared_ptr<TiledEntry> entry() const { return entry_; }
     std::vector<int> tileLayoutIdsForFrame(unsigned int frameNumber) const;
     std::shared_ptr<TileLayout> tileLayoutForId(int id) const { return directoryIdToTileLayout_.at(id); }
@@ -29,6 +37,8 @@ public:
     unsigned int largestWidth() const { return largestWidth_; }
     unsigned int largestHeight() const { return largestHeight_; }
     unsigned int maximumFrame() const { return maximumFrame_; }
+    // Only tile directories with a version below the snapshot version are visible through this manager.
+    unsigned int snapshotVersion() const { return snapshotVersion_; }
 
 private:
     void loadAllTileConfigurations();
@@ -48,6 +58,7 @@ private:
     unsigned int largestWidth_;
     unsigned int largestHeight_;
     unsigned int maximumFrame_;
+    unsigned int snapshotVersion_;
 };
 
 } // namespace tasm
@@ -0,0 +1,153 @@
+#include "CatalogSnapshots.h"
+
+#include "EncodedGOPCache.h"
+#include "Files.h"
+#include <algorithm>
+
+namespace tasm {
+
+CatalogSnapshots::WriteLock::WriteLock(std::string entryPath)
+    : entryPath_(std::move(entryPath))
+{ }
+
+CatalogSnapshots::WriteLock::WriteLock(WriteLock &&other) noexcept
+    : entryPath_(std::move(other.entryPath_))
+{
+    other.entryPath_.clear();
+}
+
+CatalogSnapshots::WriteLock &CatalogSnapshots::WriteLock::operator=(WriteLock &&other) noexcept {
+    if (this != &other) {
+        release();
+        entryPath_ = std::move(other.entryPath_);
+        other.entryPath_.clear();
+    }
+    return *this;
+}
+
+CatalogSnapshots::WriteLock::~WriteLock() {
+    release();
+}
+
+void CatalogSnapshots::WriteLock::release() {
+    // A moved-from lock has no entry.
+    if (!entryPath_.empty())
+        CatalogSnapshots::instance().releaseWriter(entryPath_);
+    entryPath_.clear();
+}
+
+CatalogSnapshots &CatalogSnapshots::instance() {
+    static CatalogSnapshots snapshots;
+    return snapshots;
+}
+
+CatalogSnapshots::WriteLock CatalogSnapshots::lockForWriting(TiledEntry &entry) {
+    std::string entryPath = entry.path();
+    {
+        std::unique_lock lock(mutex_);
+        writerReleased_.wait(lock, [&] { return !writers_.count(entryPath); });
+        writers_.insert(entryPath);
+    }
+
+    WriteLock writeLock(entryPath);
+    // No other writer is active, so any unpublished directories were left by a write that did not finish.
+    entry.discardUnpublishedTileDirectories();
+    return writeLock;
+}
+
+void CatalogSnapshots::releaseWriter(const std::string &entryPath) {
+    {
+        std::scoped_lock lock(mutex_);
+        writers_.erase(entryPath);
+    }
+    writerReleased_.notify_all();
+}
+
+unsigned int CatalogSnapshots::pin(const TiledEntry &entry) {
+    std::scoped_lock lock(mutex_);
+    auto version = entry.loadPublishedTileVersion();
+    pinnedVersions_[entry.path()].insert(version);
+    return version;
+}
+
+void CatalogSnapshots::release(const std::experimental::filesystem::path &entryPath, unsigned int snapshotVersion) {
+    std::vector<std::experimental::filesystem::path> reclaimed;
+    {
+        std::scoped_lock lock(mutex_);
+        auto &pinned = pinnedVersions_.at(entryPath);
+        pinned.erase(pinned.find(snapshotVersion));
+        if (pinned.empty())
+            pinnedVersions_.erase(entryPath);
+
+        reclaimed = takeReclaimableDirectories(entryPath);
+    }
+    remove(reclaimed);
+}
+
+bool CatalogSnapshots::reclaimWhenUnpinned(const std::experimental::filesystem::path &entryPath,
+                                           const std::experimental::filesystem::path &directory,
+                                           unsigned int shadowedAsOf) {
+    std::vector<std::experimental::filesystem::path> reclaimed;
+    {
+        std::scoped_lock lock(mutex_);
+        if (!canReclaim(entryPath, shadowedAsOf)) {
+            auto &pending = pendingReclamations_[entryPath];
+            bool isAlreadyPending = std::any_of(pending.begin(), pending.end(), [&](const auto &reclamation) {
+                return reclamation.directory == directory;
+            });
+            if (!isAlreadyPending)
+                pending.push_back({directory, shadowedAsOf});
+            return false;
+        }
+
+        reclaimed.push_back(hide(directory));
+    }
+    remove(reclaimed);
+    return true;
+}
+
+unsigned int CatalogSnapshots::numberOfPendingReclamations(const std::experimental::filesystem::path &entryPath) const {
+    std::scoped_lock lock(mutex_);
+    return pendingReclamations_.count(entryPath) ? pendingReclamations_.at(entryPath).size() : 0;
+}
+
+bool CatalogSnapshots::canReclaim(const std::string &entryPath, unsigned int shadowedAsOf) const {
+    // The pinned versions are ordered, so only the oldest snapshot has to be checked.
+    return !pinnedVersions_.count(entryPath) || *pinnedVersions_.at(entryPath).begin() >= shadowedAsOf;
+}
+
+std::vector<std::experimental::filesystem::path> CatalogSnapshots::takeReclaimableDirectories(const std::string &entryPath) {
+    std::vector<std::experimental::filesystem::path> reclaimable;
+    if (!pendingReclamations_.count(entryPath))
+        return reclaimable;
+
+    auto &pending = pendingReclamations_.at(entryPath);
+    for (auto it = pending.begin(); it != pending.end();) {
+        if (canReclaim(entryPath, it->shadowedAsOf)) {
+            reclaimable.push_back(hide(it->directory));
+            it = pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (pending.empty())
+        pendingReclamations_.erase(entryPath);
+    return reclaimable;
+}
+
+std::experimental::filesystem::path CatalogSnapshots::hide(const std::experimental::filesystem::path &directory) {
+    // Renaming is atomic, so readers that pin a snapshot after this point never load the directory.
+    auto hiddenDirectory = TileFiles::obsoleteDirectoryName(directory);
+    std::experimental::filesystem::rename(directory, hiddenDirectory);
+    EncodedGOPCache::instance().invalidateDirectory(directory);
+    TileFiles::forgetPackedTiles(directory);
+    return hiddenDirectory;
+}
+
+void CatalogSnapshots::remove(const std::vector<std::experimental::filesystem::path> &hiddenDirectories) {
+    for (const auto &directory : hiddenDirectories)
+        std::experimental::filesystem::remove_all(directory);
+}
+
+} // namespace tasm
@@ -0,0 +1,187 @@
+#include "CompressedTileIngester.h"
+
+#include "CatalogSnapshots.h"
+#include "MP4Reader.h"
+#include "NalType.h"
+#include "Transaction.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <optional>
+
+namespace tasm {
+
+static TileLayout TileLayoutForGrid(const stitching::TileGrid &grid) {
+    return TileLayout(grid.widthsOfColumns.size(), grid.heightsOfRows.size(), grid.widthsOfColumns, grid.heightsOfRows);
+}
+
+// Raw Annex B files are read this many bytes at a time.
+static const size_t AnnexBReadSize = 4u * 1024 * 1024;
+
+// Returns the offset of the first three-byte start code at or after offset, or data.size() if there is none.
+static size_t NextStartCode(const std::vector<char> &data, size_t offset) {
+    for (; offset + 3 <= data.size(); ++offset) {
+        if (!data[offset] && !data[offset + 1] && data[offset + 2] == 1)
+            return offset;
+    }
+    return data.size();
+}
+
+// Whether a nal of this type that follows a VCL nal starts a new access unit (7.4.2.4.4).
+static bool StartsAccessUnit(unsigned int type) {
+    return (type >= stitching::NalUnitVPS && type <= stitching::NalUnitAccessUnitDelimiter)
+            || type == stitching::NalUnitPrefixSEI
+            || (type >= stitching::NalUnitReservedNVCL41 && type <= stitching::NalUnitReservedNVCL44)
+            || (type >= 48 && type <= 55);
+}
+
+static void CheckCanBeMuxed(const stitching::ExtractedTiles &extracted) {
+    if (!extracted.outputsInDecodingOrder)
+        throw std::runtime_error("Tiles cannot be ingested from streams whose pictures are output out of decoding order");
+}
+
+void CompressedTileIngester::forEachAnnexBGOP(const std::function<bool(const std::vector<char>&)> &visit) const {
+    std::ifstream file(video_->path(), std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Failed to open " + video_->path().string());
+
+    std::vector<char> data;
+    // Where to look for the next start code that has not been examined.
+    size_t position = 0;
+    // Whether data holds a VCL nal, so that the next IRAP picture starts a new GOP.
+    bool hasPicture = false;
+    // The first nal after the last VCL nal that belongs to the next access unit, if one has been seen.
+    std::optional<size_t> startOfAccessUnit;
+
+    while (file) {
+        auto size = data.size();
+        data.resize(size + AnnexBReadSize);
+        file.read(data.data() + size, AnnexBReadSize);
+        data.resize(size + file.gcount());
+
+        // A nal is examined once its header and the first byte of its slice segment header have been read.
+        while (true) {
+            auto start = NextStartCode(data, position);
+            if (start + 6 > data.size()) {
+                // Only the last two bytes can begin a start code that ends in the next block.
+                if (start == data.size())
+                    position = std::max(position, data.size() - std::min<size_t>(data.size(), 2));
+                break;
+            }
+
+            position = start + 3;
+            auto type = (static_cast<unsigned char>(data[start + 3]) >> 1) & 0x3fu;
+            if (type > stitching::NalUnitReservedVCL31) {
+                if (hasPicture && !startOfAccessUnit && StartsAccessUnit(type))
+                    startOfAccessUnit = start;
+                continue;
+            }
+
+            auto isFirstInPicture = static_cast<unsigned char>(data[start + 5]) & 0x80u;
+            if (isFirstInPicture && hasPicture && type >= stitching::NalUnitCodedSliceBLAWLP && type <= stitching::NalUnitReservedIRAPVCL23) {
+                auto end = startOfAccessUnit.value_or(start);
+                // Keep the leading zero of a four-byte start code with its nal.
+                if (end && !data[end - 1])
+                    --end;
+                if (!visit(std::vector<char>(data.begin(), data.begin() + end)))
+                    return;
+                data.erase(data.begin(), data.begin() + end);
+                position -= end;
+            }
+            hasPicture = true;
+            startOfAccessUnit.reset();
+        }
+    }
+
+    if (!data.empty())
+        visit(data);
+}
+
+void CompressedTileIngester::forEachGOP(const std::function<bool(const std::vector<char>&)> &visit) const {
+    auto &path = video_->path();
+    if (path.extension() != ".mp4") {
+        forEachAnnexBGOP(visit);
+        return;
+    }
+
+    MP4Reader reader(path);
+    std::vector<int> keyframes = reader.keyframeNumbers();
+    if (keyframes.empty()) {
+        // Every frame is a keyframe, so group them into GOPs of one second.
+        for (auto frame = 0u; frame < reader.numberOfSamples(); frame += video_->configuration().frameRate)
+            keyframes.push_back(frame);
+    }
+
+    for (auto i = 0u; i < keyframes.size(); ++i) {
+        auto lastFrame = i + 1 < keyframes.size() ? keyframes[i + 1] - 1 : static_cast<int>(reader.numberOfSamples()) - 1;
+        auto gop = reader.dataForSamples(MP4Reader::frameNumberToSampleNumber(keyframes[i]), MP4Reader::frameNumberToSampleNumber(lastFrame));
+        if (!visit(*gop))
+            return;
+    }
+}
+
+std::shared_ptr<const TileLayout> CompressedTileIngester::sourceTileLayout() const {
+    if (video_->configuration().codec != Codec::HEVC)
+        return nullptr;
+
+    try {
+        std::shared_ptr<const TileLayout> layout;
+        forEachGOP([&](const std::vector<char> &gop) {
+            stitching::TileExtractor extractor;
+            auto extracted = extractor.Extract(stitching::bytestring_view(gop.data(), gop.size()));
+            if (!extracted.empty()) {
+                CheckCanBeMuxed(extracted.front());
+                layout = std::make_shared<const TileLayout>(TileLayoutForGrid(extracted.front().grid));
+            }
+            return false;
+        });
+        return layout;
+    } catch (const std::runtime_error &error) {
+        std::cerr << "Tiles cannot be extracted from " << video_->path() << ": " << error.what() << std::endl;
+        return nullptr;
+    }
+}
+
+void CompressedTileIngester::ingest() {
+    auto entry = std::make_shared<TiledEntry>(outputEntryName_);
+    auto writeLock = CatalogSnapshots::instance().lockForWriting(*entry);
+
+    try {
+        stitching::TileExtractor extractor;
+        int frameNumber = 0;
+        forEachGOP([&](const std::vector<char> &gop) {
+            // Each GOP is written as soon as it is extracted rather than merged with the GOPs that share its grid.
+            for (auto &extracted : extractor.Extract(stitching::bytestring_view(gop.data(), gop.size()))) {
+                CheckCanBeMuxed(extracted);
+                saveTileGroupToDisk(entry, extracted, frameNumber);
+                frameNumber += extracted.numberOfPictures;
+            }
+            return true;
+        });
+    } catch (const std::runtime_error&) {
+        // Nothing was published, and the write lock is still held, so only this ingest's directories are removed.
+        entry->discardUnpublishedTileDirectories();
+        throw;
+    }
+
+    // Make every tile group written by this ingest visible to readers at once.
+    entry->publishTileVersion();
+}
+
+void CompressedTileIngester::saveTileGroupToDisk(std::shared_ptr<TiledEntry> entry, stitching::ExtractedTiles &extracted, int firstFrame) const {
+    TileCrackingTransaction transaction(entry,
+                                        TileLayoutForGrid(extracted.grid),
+                                        firstFrame,
+                                        firstFrame + extracted.numberOfPictures - 1,
+                                        video_->configuration().frameRate);
+
+    for (auto tileIndex = 0u; tileIndex < extracted.tiles.size(); ++tileIndex) {
+        gpac::EncodedChunks chunks;
+        chunks.push_back(std::make_unique<std::vector<char>>(std::move(extracted.tiles[tileIndex])));
+        transaction.write(tileIndex, std::move(chunks));
+    }
+
+    transaction.commit();
+}
+
+} // namespace tasm
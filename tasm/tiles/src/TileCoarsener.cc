@@ -0,0 +1,128 @@
+#include "TileCoarsener.h"
+
+#include "CatalogSnapshots.h"
+#include "DecodeReader.h"
+#include "Stitcher.h"
+#include "TileExtractor.h"
+#include "TileLocationProvider.h"
+#include "Transaction.h"
+#include <algorithm>
+
+namespace tasm {
+
+static std::vector<unsigned int> Boundaries(const std::vector<unsigned int> &sizes) {
+    std::vector<unsigned int> boundaries{0};
+    for (auto size : sizes)
+        boundaries.push_back(boundaries.back() + size);
+    return boundaries;
+}
+
+bool TileCoarsener::isCoarseningOf(const TileLayout &currentLayout, const TileLayout &newLayout) {
+    auto columns = Boundaries(currentLayout.widthsOfColumns());
+    auto rows = Boundaries(currentLayout.heightsOfRows());
+    auto newColumns = Boundaries(newLayout.widthsOfColumns());
+    auto newRows = Boundaries(newLayout.heightsOfRows());
+
+    return columns.back() == newColumns.back()
+            && rows.back() == newRows.back()
+            && std::includes(columns.begin(), columns.end(), newColumns.begin(), newColumns.end())
+            && std::includes(rows.begin(), rows.end(), newRows.begin(), newRows.end());
+}
+
+// Stitches the tiles of currentLayout that newTile covers into a single tile.
+static std::unique_ptr<std::vector<char>> StitchedTile(const TileLayout &currentLayout,
+                                                       const Rectangle &newTile,
+                                                       const std::vector<std::shared_ptr<const std::vector<char>>> &currentTileData) {
+    auto columns = Boundaries(currentLayout.widthsOfColumns());
+    auto rows = Boundaries(currentLayout.heightsOfRows());
+    auto firstColumn = std::find(columns.begin(), columns.end(), newTile.x) - columns.begin();
+    auto lastColumn = std::find(columns.begin(), columns.end(), newTile.x + newTile.width) - columns.begin();
+    auto firstRow = std::find(rows.begin(), rows.end(), newTile.y) - rows.begin();
+    auto lastRow = std::find(rows.begin(), rows.end(), newTile.y + newTile.height) - rows.begin();
+    assert(lastColumn < static_cast<long>(columns.size()) && lastRow < static_cast<long>(rows.size()));
+
+    std::vector<std::shared_ptr<const std::vector<char>>> tiles;
+    for (auto row = firstRow; row < lastRow; ++row) {
+        for (auto column = firstColumn; column < lastColumn; ++column)
+            tiles.push_back(currentTileData[row * currentLayout.numberOfColumns() + column]);
+    }
+    if (tiles.size() == 1)
+        return std::make_unique<std::vector<char>>(*tiles.front());
+
+    TileLayout mergedLayout(lastColumn - firstColumn,
+                            lastRow - firstRow,
+                            std::vector<unsigned int>(currentLayout.widthsOfColumns().begin() + firstColumn, currentLayout.widthsOfColumns().begin() + lastColumn),
+                            std::vector<unsigned int>(currentLayout.heightsOfRows().begin() + firstRow, currentLayout.heightsOfRows().begin() + lastRow));
+    // The tiles were encoded together, so they share the CTB size of the first tile's SPS.
+    auto ctbSize = stitching::TileExtractor::CtbSize(stitching::bytestring_view(tiles.front()->data(), tiles.front()->size()));
+    stitching::StitchContext context({mergedLayout.numberOfRows(), mergedLayout.numberOfColumns()},
+                                     {mergedLayout.codedHeight(), mergedLayout.codedWidth()},
+                                     {mergedLayout.totalHeight(), mergedLayout.totalWidth()},
+                                     false,
+                                     stitching::TileSizesInCtbs(mergedLayout.heightsOfRows(), ctbSize),
+                                     stitching::TileSizesInCtbs(mergedLayout.widthsOfColumns(), ctbSize));
+
+    // Tiles that were already coarsened are split so that the merged tile is stitched from the original tiles.
+    auto expandedContext = stitching::ExpandStitchedTiles(context, tiles);
+    stitching::Stitcher stitcher(expandedContext ? *expandedContext : context, tiles);
+    return stitcher.GetStitchedSegments();
+}
+
+std::shared_ptr<std::vector<int>> TileCoarsener::coarsen(const std::vector<int> &gopStartFrames, TileLayoutProvider &newLayoutProvider,
+                                                         unsigned int gopLength, unsigned int frameRate) {
+    // The lock is taken before the current tiles are loaded, so they cannot be replaced by another writer before this one publishes.
+    auto writeLock = CatalogSnapshots::instance().lockForWriting(*entry_);
+    SingleTileLocationProvider currentTiles(std::make_shared<TiledVideoManager>(entry_));
+    auto framesToTranscode = std::make_shared<std::vector<int>>();
+    bool didWriteTiles = false;
+
+    for (auto firstFrame : gopStartFrames) {
+        auto currentLayout = currentTiles.tileLayoutForFrame(firstFrame);
+        auto newLayout = newLayoutProvider.tileLayoutForFrame(firstFrame);
+        if (*currentLayout == *newLayout)
+            continue;
+        if (!isCoarseningOf(*currentLayout, *newLayout)) {
+            framesToTranscode->push_back(firstFrame);
+            continue;
+        }
+
+        // The GOP has to lie within a single GOP of the current tiles.
+        auto directory = currentTiles.locationOfTileForFrame(0, firstFrame).parent_path();
+        auto lastFrame = std::min(firstFrame + static_cast<int>(gopLength) - 1, static_cast<int>(TileFiles::firstAndLastFramesFromPath(directory).second));
+        auto framesInGOP = std::make_shared<std::vector<int>>();
+        for (auto frame = firstFrame; frame <= lastFrame; ++frame)
+            framesInGOP->push_back(frame);
+
+        std::vector<std::shared_ptr<const std::vector<char>>> currentTileData;
+        bool isWholeGOP = true;
+        for (auto tile = 0u; tile < currentLayout->numberOfTiles() && isWholeGOP; ++tile) {
+            auto tilePath = currentTiles.locationOfTileForFrame(tile, firstFrame);
+            EncodedFrameReader reader(tilePath, std::make_shared<std::vector<int>>(*framesInGOP), currentTiles.frameOffsetInTileFile(tilePath), true);
+            auto gop = reader.read();
+            isWholeGOP = gop && static_cast<int>(gop->firstFrameIndex()) == firstFrame && gop->numberOfFrames() == framesInGOP->size();
+            if (isWholeGOP)
+                currentTileData.push_back(std::shared_ptr(std::move(gop->data())));
+        }
+        if (!isWholeGOP || *newLayoutProvider.tileLayoutForFrame(lastFrame) != *newLayout) {
+            framesToTranscode->push_back(firstFrame);
+            continue;
+        }
+
+        TileCrackingTransaction transaction(entry_, *newLayout, firstFrame, lastFrame, frameRate);
+        for (auto tile = 0u; tile < newLayout->numberOfTiles(); ++tile) {
+            gpac::EncodedChunks encodedData;
+            encodedData.push_back(StitchedTile(*currentLayout, newLayout->rectangleForTile(tile), currentTileData));
+            transaction.write(tile, std::move(encodedData));
+        }
+        transaction.commit();
+        didWriteTiles = true;
+    }
+
+    // Make every GOP coarsened by this call visible to readers at once.
+    if (didWriteTiles)
+        entry_->publishTileVersion();
+
+    return framesToTranscode;
+}
+
+} // namespace tasm
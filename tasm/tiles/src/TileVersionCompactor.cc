@@ -0,0 +1,107 @@
+#include "TileVersionCompactor.h"
+
+#include "CatalogSnapshots.h"
+#include "Files.h"
+#include "TiledVideoManager.h"
+#include <algorithm>
+#include <iostream>
+
+namespace tasm {
+
+// The directory with id 0 holds the video that retileVideoBasedOnRegret() re-encodes from, so it is always kept.
+static const int RETILING_SOURCE_ID = 0;
+
+std::vector<ShadowedDirectory> TileVersionCompactor::shadowedDirectoriesWithVersions(const TiledVideoManager &tiledVideoManager) const {
+    std::vector<ShadowedDirectory> shadowed;
+
+    for (const auto &idAndDirectory : tiledVideoManager.directoryIdToTileDirectory_) {
+        auto id = idAndDirectory.first;
+        if (id == RETILING_SOURCE_ID)
+            continue;
+
+        // A snapshot sees a newer version of frame f once it includes the oldest directory newer than `id` that covers f.
+        // The directory is invisible to a snapshot once that holds for all of its frames.
+        auto firstAndLastFrame = TileFiles::firstAndLastFramesFromPath(idAndDirectory.second);
+        bool isShadowed = true;
+        int shadowingVersion = id;
+        for (auto frame = firstAndLastFrame.first; frame <= firstAndLastFrame.second; ++frame) {
+            auto layoutIds = tiledVideoManager.tileLayoutIdsForFrame(frame);
+            int oldestNewerId = INT32_MAX;
+            for (auto layoutId : layoutIds) {
+                if (layoutId > id)
+                    oldestNewerId = std::min(oldestNewerId, layoutId);
+            }
+
+            if (oldestNewerId == INT32_MAX) {
+                isShadowed = false;
+                break;
+            }
+            shadowingVersion = std::max(shadowingVersion, oldestNewerId);
+        }
+
+        if (isShadowed)
+            shadowed.push_back({idAndDirectory.second, static_cast<unsigned int>(shadowingVersion) + 1});
+    }
+    return shadowed;
+}
+
+std::vector<std::experimental::filesystem::path> TileVersionCompactor::shadowedDirectories() const {
+    TiledVideoManager tiledVideoManager(entry_);
+    std::vector<std::experimental::filesystem::path> shadowed;
+    for (const auto &directory : shadowedDirectoriesWithVersions(tiledVideoManager))
+        shadowed.push_back(directory.path);
+    return shadowed;
+}
+
+unsigned int TileVersionCompactor::compact() {
+    unsigned int numberOfRemovedDirectories = 0;
+    unsigned int numberOfDeferredDirectories = 0;
+    {
+        // The manager pins the latest published version, so directories written by an in-progress retile are not considered.
+        TiledVideoManager tiledVideoManager(entry_);
+        for (const auto &directory : shadowedDirectoriesWithVersions(tiledVideoManager)) {
+            if (CatalogSnapshots::instance().reclaimWhenUnpinned(entry_->path(), directory.path, directory.shadowedAsOf))
+                ++numberOfRemovedDirectories;
+            else
+                ++numberOfDeferredDirectories;
+        }
+    }
+
+    std::cout << "ANALYSIS: compacted " << entry_->name() << " removed-directories " << numberOfRemovedDirectories
+              << " deferred-directories " << numberOfDeferredDirectories << std::endl;
+    return numberOfRemovedDirectories;
+}
+
+void BackgroundTileVersionCompactor::stop() {
+    {
+        std::scoped_lock lock(mutex_);
+        shouldStop_ = true;
+    }
+    stopCondition_.notify_all();
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void BackgroundTileVersionCompactor::run() {
+    std::unique_lock lock(mutex_);
+    while (!stopCondition_.wait_for(lock, interval_, [this] { return shouldStop_; })) {
+        lock.unlock();
+        compactCatalog();
+        lock.lock();
+    }
+}
+
+void BackgroundTileVersionCompactor::compactCatalog() {
+    for (auto &dir : std::experimental::filesystem::directory_iterator(CatalogConfiguration::CatalogPath())) {
+        if (!std::experimental::filesystem::is_directory(dir.status()))
+            continue;
+
+        try {
+            TileVersionCompactor(std::make_shared<TiledEntry>(dir.path().filename())).compact();
+        } catch (const std::exception &e) {
+            std::cerr << "Failed to compact " << dir.path() << ": " << e.what() << std::endl;
+        }
+    }
+}
+
+} // namespace tasm
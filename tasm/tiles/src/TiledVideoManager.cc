@@ -22,6 +22,10 @@ void TiledVideoManager::loadAllTileConfigurations() {
         if (!std::experimental::filesystem::is_directory(dir.status()))
             continue;
 
+        // Skip directories that were removed by compaction but not yet deleted.
+        if (TileFiles::isObsoleteDirectory(dir.path()))
+            continue;
+
         auto dirId = globalDirId++;
         auto tileDirectoryPath = dir.path();
         // Parse frame range from path.
@@ -29,6 +33,10 @@ void TiledVideoManager::loadAllTileConfigurations() {
         auto tileVersion = TileFiles::tileVersionFromPath(tileDirectoryPath);
         dirId = tileVersion;
 
+        // Directories written after the snapshot was pinned have not been published to this reader.
+        if (tileVersion >= snapshotVersion_)
+            continue;
+
         directoryIntervals.emplace_back(firstAndLastFrame.first, firstAndLastFrame.second, dirId);
         if (firstAndLastFrame.second > maximumFrame_)
             maximumFrame_ = firstAndLastFrame.second;
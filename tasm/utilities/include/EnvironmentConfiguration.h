@@ -11,13 +11,68 @@ class EnvironmentConfiguration {
 public:
     static constexpr auto DefaultLabelsDB = "default_db_path";
     static constexpr auto CatalogPath = "catalog_path";
+    static constexpr auto EncodedGOPCacheSize = "encoded_gop_cache_size";
+    static constexpr auto PackTiles = "pack_tiles";
+    static constexpr auto ReadAheadDepth = "read_ahead_depth";
+    static constexpr auto ReadAheadThreads = "read_ahead_threads";
+    static constexpr auto StitchAheadDepth = "stitch_ahead_depth";
+    static constexpr auto StitchThreads = "stitch_threads";
+    static constexpr auto StitchPlanCacheSize = "stitch_plan_cache_size";
+    static constexpr auto PlanningWindow = "planning_window";
+    static constexpr auto DecoderInstances = "decoder_instances";
+    static constexpr auto SoftwareDecode = "software_decode";
+    static constexpr auto SoftwareDecodeThreads = "software_decode_threads";
+    static constexpr auto ImageBufferPoolSize = "image_buffer_pool_size";
+    static constexpr auto SelectionPrefetchDepth = "selection_prefetch_depth";
+    static constexpr auto IngestTiledSources = "ingest_tiled_sources";
     EnvironmentConfiguration(const std::unordered_map<std::string, std::string> &configOptions = {})
         : labelsDatabasePath_(configOptions.count(DefaultLabelsDB) ? configOptions.at(DefaultLabelsDB) : defaultDBPath),
-        catalogPath_(configOptions.count(CatalogPath) ? configOptions.at(CatalogPath) : defaultCatalogPath)
+        catalogPath_(configOptions.count(CatalogPath) ? configOptions.at(CatalogPath) : defaultCatalogPath),
+        encodedGOPCacheSize_(configOptions.count(EncodedGOPCacheSize) ? std::stoull(configOptions.at(EncodedGOPCacheSize)) : defaultEncodedGOPCacheSize),
+        packTiles_(configOptions.count(PackTiles) ? configOptions.at(PackTiles) == "true" : false),
+        readAheadDepth_(configOptions.count(ReadAheadDepth) ? std::stoul(configOptions.at(ReadAheadDepth)) : defaultReadAheadDepth),
+        readAheadThreads_(configOptions.count(ReadAheadThreads) ? std::stoul(configOptions.at(ReadAheadThreads)) : defaultReadAheadThreads),
+        stitchAheadDepth_(configOptions.count(StitchAheadDepth) ? std::stoul(configOptions.at(StitchAheadDepth)) : defaultStitchAheadDepth),
+        stitchThreads_(configOptions.count(StitchThreads) ? std::stoul(configOptions.at(StitchThreads)) : 0),
+        stitchPlanCacheSize_(configOptions.count(StitchPlanCacheSize) ? std::stoul(configOptions.at(StitchPlanCacheSize)) : defaultStitchPlanCacheSize),
+        planningWindow_(configOptions.count(PlanningWindow) ? std::stoul(configOptions.at(PlanningWindow)) : defaultPlanningWindow),
+        decoderInstances_(configOptions.count(DecoderInstances) ? std::stoul(configOptions.at(DecoderInstances)) : defaultDecoderInstances),
+        softwareDecode_(configOptions.count(SoftwareDecode) ? configOptions.at(SoftwareDecode) == "true" : false),
+        softwareDecodeThreads_(configOptions.count(SoftwareDecodeThreads) ? std::stoul(configOptions.at(SoftwareDecodeThreads)) : 0),
+        imageBufferPoolSize_(configOptions.count(ImageBufferPoolSize) ? std::stoull(configOptions.at(ImageBufferPoolSize)) : defaultImageBufferPoolSize),
+        selectionPrefetchDepth_(configOptions.count(SelectionPrefetchDepth) ? std::stoul(configOptions.at(SelectionPrefetchDepth)) : 0),
+        ingestTiledSources_(configOptions.count(IngestTiledSources) ? configOptions.at(IngestTiledSources) == "true" : false)
     { }
 
     const std::experimental::filesystem::path &defaultLabelsDatabasePath() const { return labelsDatabasePath_; };
     const std::experimental::filesystem::path &catalogPath() const { return catalogPath_; }
+    unsigned long long encodedGOPCacheSize() const { return encodedGOPCacheSize_; }
+    // When set, all tiles of a layout group are written as tracks of a single container.
+    bool packTiles() const { return packTiles_; }
+    // Number of GOPs tile scans read ahead of the decoder; 0 reads synchronously.
+    unsigned int readAheadDepth() const { return readAheadDepth_; }
+    unsigned int readAheadThreads() const { return readAheadThreads_; }
+    // Number of GOPs full-frame scans stitch ahead of the decoder; 0 stitches synchronously.
+    unsigned int stitchAheadDepth() const { return stitchAheadDepth_; }
+    // Number of threads that stitch ahead; 0 uses one per core.
+    unsigned int stitchThreads() const { return stitchThreads_; }
+    // Number of stitch plans a full-frame scan keeps for layouts that recur; 0 builds a new plan for every GOP.
+    unsigned int stitchPlanCacheSize() const { return stitchPlanCacheSize_; }
+    // Number of frames tile scans plan reads for at a time; 0 plans the whole query before reading.
+    unsigned int planningWindow() const { return planningWindow_; }
+    // Number of decoders that tile scans spread their reads across.
+    unsigned int decoderInstances() const { return decoderInstances_; }
+    // When set, queries decode with libavcodec even if a GPU is available. Queries always do when there is no GPU.
+    bool softwareDecode() const { return softwareDecode_; }
+    // Number of threads that decode on the CPU; 0 uses one per core.
+    unsigned int softwareDecodeThreads() const { return softwareDecodeThreads_; }
+    // Bytes of released image buffers that are kept for reuse; 0 frees every buffer when its image is released.
+    unsigned long long imageBufferPoolSize() const { return imageBufferPoolSize_; }
+    // Number of images Python selections produce ahead of the caller on a background thread; 0 produces them on demand.
+    unsigned int selectionPrefetchDepth() const { return selectionPrefetchDepth_; }
+    // When set, storing a source that is already tiled with the requested uniform layout splits its bitstream
+    // instead of re-encoding it, so the stored tiles keep the source's GOPs and encoder settings.
+    bool ingestTiledSources() const { return ingestTiledSources_; }
 
     static const EnvironmentConfiguration & instance() {
         if (instance_.has_value())
@@ -32,8 +87,30 @@ public:
 private:
     std::experimental::filesystem::path labelsDatabasePath_;
     std::experimental::filesystem::path catalogPath_;
+    unsigned long long encodedGOPCacheSize_;
+    bool packTiles_;
+    unsigned int readAheadDepth_;
+    unsigned int readAheadThreads_;
+    unsigned int stitchAheadDepth_;
+    unsigned int stitchThreads_;
+    unsigned int stitchPlanCacheSize_;
+    unsigned int planningWindow_;
+    unsigned int decoderInstances_;
+    bool softwareDecode_;
+    unsigned int softwareDecodeThreads_;
+    unsigned long long imageBufferPoolSize_;
+    unsigned int selectionPrefetchDepth_;
+    bool ingestTiledSources_;
     static constexpr auto defaultDBPath = "labels.db";
     static constexpr auto defaultCatalogPath = "resources";
+    static constexpr unsigned long long defaultEncodedGOPCacheSize = 256ull * 1024 * 1024;
+    static constexpr unsigned int defaultReadAheadDepth = 4;
+    static constexpr unsigned int defaultReadAheadThreads = 2;
+    static constexpr unsigned int defaultStitchAheadDepth = 4;
+    static constexpr unsigned int defaultStitchPlanCacheSize = 64;
+    static constexpr unsigned int defaultPlanningWindow = 300;
+    static constexpr unsigned int defaultDecoderInstances = 1;
+    static constexpr unsigned long long defaultImageBufferPoolSize = 256ull * 1024 * 1024;
 
     static std::optional<EnvironmentConfiguration> instance_;
 };
@@ -36,6 +36,32 @@ public:
         return ".mp4";
     }
 
+    static std::experimental::filesystem::path packedTilesFilename(const std::experimental::filesystem::path &directoryPath) {
+        return directoryPath / (packed_tiles_filename_ + muxedFilenameExtension());
+    }
+
+    // Whether a directory is packed is remembered, because every tile read from it would otherwise stat the container.
+    // Directories that are removed or rewritten must be forgotten with forgetPackedTiles.
+    static bool directoryHasPackedTiles(const std::experimental::filesystem::path &directoryPath);
+    static void forgetPackedTiles(const std::experimental::filesystem::path &directoryPath);
+
+    // Maps a tile filename to the container and 1-indexed track that hold the tile.
+    // Tiles in a packed directory all live in one container, with tile N stored in track N + 1.
+    static std::pair<std::experimental::filesystem::path, unsigned int> containerAndTrackForTile(const std::experimental::filesystem::path &tileFilename) {
+        auto directoryPath = tileFilename.parent_path();
+        if (!directoryHasPackedTiles(directoryPath))
+            return std::make_pair(tileFilename, 1u);
+
+        return std::make_pair(packedTilesFilename(directoryPath), tileNumberFromFilename(tileFilename) + 1);
+    }
+
+    static unsigned int tileNumberFromFilename(const std::experimental::filesystem::path &tileFilename) {
+        std::string stem = tileFilename.stem();
+        auto lastSeparator = stem.rfind(separating_string_);
+        assert(lastSeparator != std::string::npos);
+        return std::stoul(stem.substr(lastSeparator + 1));
+    }
+
     static std::experimental::filesystem::path tileMetadataFilename(const TiledEntry &entry, unsigned int firstFrame, unsigned lastFrame) {
         return directoryForTilesInFrames(entry, firstFrame, lastFrame) / tile_metadata_filename_;
     }
@@ -57,6 +83,15 @@ public:
         return std::make_pair(firstFrame, lastFrame);
     }
 
+    static std::experimental::filesystem::path obsoleteDirectoryName(const std::experimental::filesystem::path &directoryPath) {
+        auto obsoletePath = directoryPath;
+        return obsoletePath.replace_extension(obsolete_directory_extension_);
+    }
+
+    static bool isObsoleteDirectory(const std::experimental::filesystem::path &directoryPath) {
+        return directoryPath.extension() == obsolete_directory_extension_;
+    }
+
     static unsigned int tileVersionFromPath(const std::experimental::filesystem::path &directoryPath) {
         std::string directoryName = directoryPath.filename();
         auto lastSeparator = directoryName.rfind(separating_string_);
@@ -74,6 +109,8 @@ private:
 
     static constexpr auto tile_version_filename_ = "tile-version";
     static constexpr auto tile_metadata_filename_ = "tile-metadata.bin";
+    static constexpr auto packed_tiles_filename_ = "packed-tiles";
+    static constexpr auto obsolete_directory_extension_ = ".obsolete";
     static constexpr auto separating_string_ = "-";
 };
 
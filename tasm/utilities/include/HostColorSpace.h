@@ -0,0 +1,37 @@
+#ifndef TASM_HOSTCOLORSPACE_H
+#define TASM_HOSTCOLORSPACE_H
+
+#include "PixelFormat.h"
+#include <cstdint>
+
+namespace tasm {
+
+// The kernels that rows can be converted with. They produce identical pixels.
+enum class ColorConversionKernel {
+    Scalar,
+    AVX2,
+};
+
+// The AVX2 kernel is only available if the host supports it and the library was built without TASM_DISABLE_AVX2_KERNEL.
+bool IsColorConversionKernelSupported(ColorConversionKernel kernel);
+
+// Converts the width x height region at (xOffset, yOffset) of an NV12 frame in host memory to RGBA.
+// Uses the same BT.709 matrix as Nv12ToColor32. Rows are converted with AVX2 when the host supports it.
+void Nv12ToRGBA(const uint8_t *luma, const uint8_t *chroma, unsigned int pitch,
+                unsigned int xOffset, unsigned int yOffset, unsigned int width, unsigned int height,
+                uint8_t *rgba, unsigned int rgbaPitch);
+
+// Same as above, but converts rows with `kernel`, which must be supported.
+void Nv12ToRGBA(const uint8_t *luma, const uint8_t *chroma, unsigned int pitch,
+                unsigned int xOffset, unsigned int yOffset, unsigned int width, unsigned int height,
+                uint8_t *rgba, unsigned int rgbaPitch, ColorConversionKernel kernel);
+
+// Converts the same region to `format`, writing PixelFormatSize(format, width, height) bytes to `destination`.
+// For NV12, each output chroma sample is the one that covers the first pixel it applies to.
+void Nv12ToPixelFormat(const uint8_t *luma, const uint8_t *chroma, unsigned int pitch,
+                       unsigned int xOffset, unsigned int yOffset, unsigned int width, unsigned int height,
+                       PixelFormat format, uint8_t *destination);
+
+} // namespace tasm
+
+#endif //TASM_HOSTCOLORSPACE_H
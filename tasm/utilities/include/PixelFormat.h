@@ -0,0 +1,34 @@
+#ifndef TASM_PIXELFORMAT_H
+#define TASM_PIXELFORMAT_H
+
+namespace tasm {
+
+// Layouts that query results can be returned in. Every layout is tightly packed.
+enum class PixelFormat {
+    RGBA,      // Interleaved R, G, B, A. Alpha is 0, as with Nv12ToColor32.
+    RGB,       // Interleaved R, G, B.
+    BGR,       // Interleaved B, G, R.
+    PlanarRGB, // A full R plane, then G, then B.
+    Gray,      // Full-range luma.
+    NV12,      // The decoded luma plane followed by interleaved U, V at half resolution, without conversion.
+};
+
+inline unsigned int PixelFormatSize(PixelFormat format, unsigned int width, unsigned int height) {
+    switch (format) {
+        case PixelFormat::RGBA:
+            return width * height * 4;
+        case PixelFormat::RGB:
+        case PixelFormat::BGR:
+        case PixelFormat::PlanarRGB:
+            return width * height * 3;
+        case PixelFormat::Gray:
+            return width * height;
+        case PixelFormat::NV12:
+            return width * height + 2 * ((width + 1) / 2) * ((height + 1) / 2);
+    }
+    return 0;
+}
+
+} // namespace tasm
+
+#endif //TASM_PIXELFORMAT_H
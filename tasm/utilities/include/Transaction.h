@@ -2,9 +2,12 @@
 #define TASM_TRANSACTION_H
 
 #include "Files.h"
+#include "Gpac.h"
 #include "TileLayout.h"
 #include "Video.h"
+#include <map>
 #include <mutex>
+#include <stdexcept>
 
 class Transaction;
 class OutputStream {
@@ -16,6 +19,7 @@ public:
                  unsigned int lastFrame)
             : transaction_(transaction),
             entry_(entry),
+              tileNumber_(tileNumber),
               filename_(tasm::TileFiles::temporaryTileFilename(entry, tileNumber, firstFrame, lastFrame)),
               codec_(Codec::HEVC),
               stream_(filename_)
@@ -26,11 +30,13 @@ public:
 
     std::ofstream& stream() { return stream_; }
     const std::experimental::filesystem::path &filename() const { return filename_; }
+    unsigned int tileNumber() const { return tileNumber_; }
     const auto &codec() const { return codec_; }
 
 protected:
     const Transaction &transaction_;
     const tasm::TiledEntry &entry_;
+    const unsigned int tileNumber_;
     const std::experimental::filesystem::path filename_;
     const Codec codec_;
     std::ofstream stream_;
@@ -72,20 +78,23 @@ private:
 
 class TileCrackingTransaction: public Transaction {
 public:
-    TileCrackingTransaction(std::shared_ptr<tasm::TiledEntry> entry, const tasm::TileLayout &tileLayout, int firstFrame = -1, int lastFrame = -1)
+    TileCrackingTransaction(std::shared_ptr<tasm::TiledEntry> entry, const tasm::TileLayout &tileLayout, int firstFrame = -1, int lastFrame = -1, unsigned int frameRate = 0)
             : Transaction(0u),
               entry_(entry),
               tileLayout_(tileLayout),
               firstFrame_(firstFrame),
               lastFrame_(lastFrame),
+              frameRate_(frameRate),
               complete_(false)
     {
         prepareTileDirectory();
     }
 
+    // Transactions must be committed explicitly. One that is destroyed without being committed, or whose commit
+    // failed, is aborted, so that a partially-written tile directory is not left behind.
     ~TileCrackingTransaction() override {
         if (!complete_)
-            commit();
+            abort();
     }
 
     virtual OutputStream& write(unsigned int tileNumber) {
@@ -96,12 +105,22 @@ public:
                                      lastFrame_);
     }
 
+    // Hands the encoded bitstream for a tile to the transaction. It is muxed directly from memory on commit,
+    // so no temporary file is written. Requires a frame rate to be passed to the constructor.
+    void write(unsigned int tileNumber, tasm::gpac::EncodedChunks encodedData) {
+        if (!frameRate_)
+            throw std::runtime_error("Tiles can only be muxed from memory by a transaction with a frame rate");
+        encodedDataForTiles_[tileNumber] = std::move(encodedData);
+    }
+
     void commit() override;
 
     void abort() override;
 
 private:
     void prepareTileDirectory();
+    void muxOutputs();
+    void packOutputs();
     void writeTileMetadata();
 
     std::shared_ptr<tasm::TiledEntry> entry_;
@@ -109,6 +128,8 @@ private:
 
     int firstFrame_;
     int lastFrame_;
+    unsigned int frameRate_;
+    std::map<unsigned int, tasm::gpac::EncodedChunks> encodedDataForTiles_;
 
     bool complete_;
 };
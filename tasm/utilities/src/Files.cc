@@ -0,0 +1,27 @@
+#include "Files.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace tasm {
+
+static std::mutex packedDirectoriesMutex;
+static std::unordered_map<std::string, bool> packedDirectories;
+
+bool TileFiles::directoryHasPackedTiles(const std::experimental::filesystem::path &directoryPath) {
+    std::scoped_lock lock(packedDirectoriesMutex);
+    auto packed = packedDirectories.find(directoryPath.string());
+    if (packed != packedDirectories.end())
+        return packed->second;
+
+    auto hasPackedTiles = std::experimental::filesystem::exists(packedTilesFilename(directoryPath));
+    packedDirectories[directoryPath.string()] = hasPackedTiles;
+    return hasPackedTiles;
+}
+
+void TileFiles::forgetPackedTiles(const std::experimental::filesystem::path &directoryPath) {
+    std::scoped_lock lock(packedDirectoriesMutex);
+    packedDirectories.erase(directoryPath.string());
+}
+
+} // namespace tasm
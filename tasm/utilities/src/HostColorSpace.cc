@@ -0,0 +1,228 @@
+#include "HostColorSpace.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <vector>
+#if !defined(TASM_DISABLE_AVX2_KERNEL) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define TASM_HAS_AVX2_KERNEL 1
+#endif
+
+namespace tasm {
+
+namespace {
+
+// The BT.709 matrix that SetMatYuv2Rgb computes for Nv12ToColor32, scaled from video range to full range.
+struct Yuv2Rgb {
+    static constexpr float wr = 0.2126f;
+    static constexpr float wb = 0.0722f;
+    static constexpr float scale = 255.0f / (235 - 16);
+
+    static constexpr float y = scale;
+    static constexpr float rv = scale * (1.0f - wr) / 0.5f;
+    static constexpr float gu = scale * -wb * (1.0f - wb) / 0.5f / (1 - wb - wr);
+    static constexpr float gv = scale * -wr * (1 - wr) / 0.5f / (1 - wb - wr);
+    static constexpr float bu = scale * (1.0f - wb) / 0.5f;
+};
+
+inline uint8_t Clamp(float value) {
+    return static_cast<uint8_t>(std::min(std::max(value, 0.0f), 255.0f));
+}
+
+// Converts columns [begin, end) of a row. `y` points at the first column of the region, `uv` at the start of the chroma row.
+void Nv12ToRGBARow(const uint8_t *y, const uint8_t *uv, unsigned int xOffset, unsigned int begin, unsigned int end, uint8_t *destination) {
+    for (auto column = begin; column < end; ++column) {
+        auto chromaColumn = (xOffset + column) / 2 * 2;
+        float fy = static_cast<int>(y[column]) - 16;
+        float fu = static_cast<int>(uv[chromaColumn]) - 128;
+        float fv = static_cast<int>(uv[chromaColumn + 1]) - 128;
+
+        destination[4 * column] = Clamp(Yuv2Rgb::y * fy + Yuv2Rgb::rv * fv);
+        destination[4 * column + 1] = Clamp(Yuv2Rgb::y * fy + Yuv2Rgb::gu * fu + Yuv2Rgb::gv * fv);
+        destination[4 * column + 2] = Clamp(Yuv2Rgb::y * fy + Yuv2Rgb::bu * fu);
+        // Nv12ToColor32 leaves alpha at 0.
+        destination[4 * column + 3] = 0;
+    }
+}
+
+#ifdef TASM_HAS_AVX2_KERNEL
+// Converts eight pixels at a time, starting from `begin`, which must be at an even column of the frame.
+// Returns the first column that is left for the scalar kernel.
+// The arithmetic is done in the same order as the scalar kernel, so both produce identical pixels.
+__attribute__((target("avx2")))
+unsigned int Nv12ToRGBARowAVX2(const uint8_t *y, const uint8_t *uv, unsigned int xOffset, unsigned int begin, unsigned int end, uint8_t *destination) {
+    const auto yScale = _mm256_set1_ps(Yuv2Rgb::y);
+    const auto rv = _mm256_set1_ps(Yuv2Rgb::rv);
+    const auto gu = _mm256_set1_ps(Yuv2Rgb::gu);
+    const auto gv = _mm256_set1_ps(Yuv2Rgb::gv);
+    const auto bu = _mm256_set1_ps(Yuv2Rgb::bu);
+    const auto zero = _mm256_setzero_ps();
+    const auto maximum = _mm256_set1_ps(255.0f);
+    const auto lumaOffset = _mm256_set1_epi32(16);
+    const auto chromaOffset = _mm256_set1_epi32(128);
+    // Each chroma pair covers two pixels, so repeat every U and every V.
+    const auto duplicateU = _mm_setr_epi8(0, 0, 2, 2, 4, 4, 6, 6, -1, -1, -1, -1, -1, -1, -1, -1);
+    const auto duplicateV = _mm_setr_epi8(1, 1, 3, 3, 5, 5, 7, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    auto column = begin;
+    for (; column + 8 <= end; column += 8) {
+        auto luma = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(y + column));
+        auto chroma = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(uv + xOffset + column));
+
+        auto fy = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_cvtepu8_epi32(luma), lumaOffset));
+        auto fu = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_shuffle_epi8(chroma, duplicateU)), chromaOffset));
+        auto fv = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_shuffle_epi8(chroma, duplicateV)), chromaOffset));
+
+        auto scaledY = _mm256_mul_ps(yScale, fy);
+        auto r = _mm256_add_ps(scaledY, _mm256_mul_ps(rv, fv));
+        auto g = _mm256_add_ps(_mm256_add_ps(scaledY, _mm256_mul_ps(gu, fu)), _mm256_mul_ps(gv, fv));
+        auto b = _mm256_add_ps(scaledY, _mm256_mul_ps(bu, fu));
+
+        auto ri = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(r, zero), maximum));
+        auto gi = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(g, zero), maximum));
+        auto bi = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(b, zero), maximum));
+
+        // Pack each pixel into one little-endian word, leaving alpha at 0.
+        auto rgba = _mm256_or_si256(ri, _mm256_or_si256(_mm256_slli_epi32(gi, 8), _mm256_slli_epi32(bi, 16)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + 4 * column), rgba);
+    }
+    return column;
+}
+
+bool HasAVX2() {
+    static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+    return hasAVX2;
+}
+#endif
+
+ColorConversionKernel FastestKernel() {
+#ifdef TASM_HAS_AVX2_KERNEL
+    if (HasAVX2())
+        return ColorConversionKernel::AVX2;
+#endif
+    return ColorConversionKernel::Scalar;
+}
+
+// Converts `width` pixels of a row to RGBA with `kernel`.
+void Nv12ToRGBARow(const uint8_t *y, const uint8_t *uv, unsigned int xOffset, unsigned int width, uint8_t *destination,
+                   ColorConversionKernel kernel = FastestKernel()) {
+    auto column = 0u;
+#ifdef TASM_HAS_AVX2_KERNEL
+    if (kernel == ColorConversionKernel::AVX2) {
+        // Start the vector kernel on a pixel that begins a chroma pair.
+        column = xOffset % 2;
+        Nv12ToRGBARow(y, uv, xOffset, 0, std::min(column, width), destination);
+        column = Nv12ToRGBARowAVX2(y, uv, xOffset, column, width, destination);
+    }
+#endif
+    Nv12ToRGBARow(y, uv, xOffset, column, width, destination);
+}
+
+void Nv12ToGray(const uint8_t *luma, unsigned int pitch,
+                unsigned int xOffset, unsigned int yOffset, unsigned int width, unsigned int height,
+                uint8_t *gray) {
+    // This is the value of R, G, and B for a pixel without chroma.
+    for (auto row = 0u; row < height; ++row) {
+        auto y = luma + (yOffset + row) * pitch + xOffset;
+        auto destination = gray + row * width;
+        for (auto column = 0u; column < width; ++column)
+            destination[column] = Clamp(Yuv2Rgb::y * (static_cast<int>(y[column]) - 16));
+    }
+}
+
+void CopyNv12(const uint8_t *luma, const uint8_t *chroma, unsigned int pitch,
+              unsigned int xOffset, unsigned int yOffset, unsigned int width, unsigned int height,
+              uint8_t *nv12) {
+    for (auto row = 0u; row < height; ++row)
+        memcpy(nv12 + row * width, luma + (yOffset + row) * pitch + xOffset, width);
+
+    auto chromaWidth = (width + 1) / 2;
+    auto chromaHeight = (height + 1) / 2;
+    auto destination = nv12 + width * height;
+    for (auto row = 0u; row < chromaHeight; ++row, destination += 2 * chromaWidth) {
+        auto uv = chroma + (yOffset + 2 * row) / 2 * pitch;
+        if (xOffset % 2 == 0) {
+            memcpy(destination, uv + xOffset, 2 * chromaWidth);
+            continue;
+        }
+
+        for (auto column = 0u; column < chromaWidth; ++column) {
+            auto chromaColumn = (xOffset + 2 * column) / 2 * 2;
+            destination[2 * column] = uv[chromaColumn];
+            destination[2 * column + 1] = uv[chromaColumn + 1];
+        }
+    }
+}
+
+} // namespace
+
+bool IsColorConversionKernelSupported(ColorConversionKernel kernel) {
+    return kernel == ColorConversionKernel::Scalar || FastestKernel() == kernel;
+}
+
+void Nv12ToRGBA(const uint8_t *luma, const uint8_t *chroma, unsigned int pitch,
+                unsigned int xOffset, unsigned int yOffset, unsigned int width, unsigned int height,
+                uint8_t *rgba, unsigned int rgbaPitch) {
+    Nv12ToRGBA(luma, chroma, pitch, xOffset, yOffset, width, height, rgba, rgbaPitch, FastestKernel());
+}
+
+void Nv12ToRGBA(const uint8_t *luma, const uint8_t *chroma, unsigned int pitch,
+                unsigned int xOffset, unsigned int yOffset, unsigned int width, unsigned int height,
+                uint8_t *rgba, unsigned int rgbaPitch, ColorConversionKernel kernel) {
+    assert(IsColorConversionKernelSupported(kernel));
+    for (auto row = 0u; row < height; ++row) {
+        auto y = luma + (yOffset + row) * pitch + xOffset;
+        auto uv = chroma + (yOffset + row) / 2 * pitch;
+        Nv12ToRGBARow(y, uv, xOffset, width, rgba + row * rgbaPitch, kernel);
+    }
+}
+
+void Nv12ToPixelFormat(const uint8_t *luma, const uint8_t *chroma, unsigned int pitch,
+                       unsigned int xOffset, unsigned int yOffset, unsigned int width, unsigned int height,
+                       PixelFormat format, uint8_t *destination) {
+    switch (format) {
+        case PixelFormat::RGBA:
+            Nv12ToRGBA(luma, chroma, pitch, xOffset, yOffset, width, height, destination, 4 * width);
+            return;
+        case PixelFormat::Gray:
+            Nv12ToGray(luma, pitch, xOffset, yOffset, width, height, destination);
+            return;
+        case PixelFormat::NV12:
+            CopyNv12(luma, chroma, pitch, xOffset, yOffset, width, height, destination);
+            return;
+        case PixelFormat::RGB:
+        case PixelFormat::BGR:
+        case PixelFormat::PlanarRGB:
+            break;
+    }
+
+    // Convert a row at a time to RGBA, which stays in cache, and then repack it.
+    thread_local std::vector<uint8_t> rgba;
+    rgba.resize(4 * width);
+    auto planeSize = width * height;
+    for (auto row = 0u; row < height; ++row) {
+        auto y = luma + (yOffset + row) * pitch + xOffset;
+        auto uv = chroma + (yOffset + row) / 2 * pitch;
+        Nv12ToRGBARow(y, uv, xOffset, width, rgba.data());
+
+        if (format == PixelFormat::PlanarRGB) {
+            auto r = destination + row * width;
+            for (auto column = 0u; column < width; ++column) {
+                r[column] = rgba[4 * column];
+                r[planeSize + column] = rgba[4 * column + 1];
+                r[2 * planeSize + column] = rgba[4 * column + 2];
+            }
+        } else {
+            auto rgb = destination + 3 * row * width;
+            auto first = format == PixelFormat::RGB ? 0 : 2;
+            for (auto column = 0u; column < width; ++column) {
+                rgb[3 * column] = rgba[4 * column + first];
+                rgb[3 * column + 1] = rgba[4 * column + 1];
+                rgb[3 * column + 2] = rgba[4 * column + 2 - first];
+            }
+        }
+    }
+}
+
+} // namespace tasm
@@ -1,7 +1,38 @@
 #include "Transaction.h"
 
 #include "Gpac.h"
+#include <atomic>
+#include <functional>
 #include <iostream>
+#include <thread>
+
+// Runs task(0), ..., task(count - 1) on up to one thread per core, and rethrows the first failure.
+static void RunInParallel(unsigned int count, const std::function<void(unsigned int)> &task) {
+    std::atomic<unsigned int> nextIndex(0);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    auto numberOfThreads = std::min(count, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (auto i = 0u; i < numberOfThreads; ++i) {
+        threads.emplace_back([&] {
+            for (auto index = nextIndex++; index < count; index = nextIndex++) {
+                try {
+                    task(index);
+                } catch (...) {
+                    std::scoped_lock lock(errorMutex);
+                    if (!error)
+                        error = std::current_exception();
+                }
+            }
+        });
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+    if (error)
+        std::rethrow_exception(error);
+}
 
 void TileCrackingTransaction::prepareTileDirectory() {
     auto directory = tasm::TileFiles::directoryForTilesInFrames(*entry_, firstFrame_, lastFrame_);
@@ -12,25 +43,82 @@ void TileCrackingTransaction::prepareTileDirectory() {
 
 void TileCrackingTransaction::abort() {
     complete_ = true;
-    for(const auto &output: outputs())
-        std::experimental::filesystem::remove(output.filename());
+    encodedDataForTiles_.clear();
+
+    // The outputs are written inside the tile directory, so removing it removes them too.
+    for (auto &output : outputs())
+        output.stream().close();
+
+    // Abort runs from the destructor, so failures are only logged.
+    std::error_code error;
+    auto directory = tasm::TileFiles::directoryForTilesInFrames(*entry_, firstFrame_, lastFrame_);
+    std::experimental::filesystem::remove_all(directory, error);
+    tasm::TileFiles::forgetPackedTiles(directory);
+    if (error)
+        std::cerr << "Failed to remove aborted tile directory: " << error.message() << std::endl;
 }
 
 void TileCrackingTransaction::commit() {
+    for (auto &output : outputs())
+        output.stream().close();
+
+    if (tasm::EnvironmentConfiguration::instance().packTiles())
+        packOutputs();
+    else
+        muxOutputs();
+    // The directory may have been looked up before its container was written.
+    tasm::TileFiles::forgetPackedTiles(tasm::TileFiles::directoryForTilesInFrames(*entry_, firstFrame_, lastFrame_));
+
+    writeTileMetadata();
+    encodedDataForTiles_.clear();
+
+    entry_->incrementTileVersion();
     complete_ = true;
+}
 
-    for (auto &output : outputs()) {
-        output.stream().close();
+void TileCrackingTransaction::muxOutputs() {
+    // Each tile is written to its own file, so tiles can be muxed concurrently.
+    std::vector<OutputStream*> fileOutputs;
+    for (auto &output : outputs())
+        fileOutputs.push_back(&output);
 
+    RunInParallel(fileOutputs.size(), [&](unsigned int i) {
         // Mux the outputs to mp4.
-        auto muxedFile = output.filename();
+        auto muxedFile = fileOutputs[i]->filename();
         muxedFile.replace_extension(tasm::TileFiles::muxedFilenameExtension());
-        tasm::gpac::mux_media(output.filename(), muxedFile);
+        tasm::gpac::mux_media(fileOutputs[i]->filename(), muxedFile);
+    });
+
+    std::vector<std::pair<unsigned int, const tasm::gpac::EncodedChunks*>> inMemoryOutputs;
+    for (const auto &tileAndData : encodedDataForTiles_)
+        inMemoryOutputs.emplace_back(tileAndData.first, &tileAndData.second);
+
+    auto directory = tasm::TileFiles::directoryForTilesInFrames(*entry_, firstFrame_, lastFrame_);
+    RunInParallel(inMemoryOutputs.size(), [&](unsigned int i) {
+        tasm::gpac::mux_hevc_from_memory({inMemoryOutputs[i].second}, frameRate_, tasm::TileFiles::tileFilename(directory, inMemoryOutputs[i].first));
+    });
+}
+
+void TileCrackingTransaction::packOutputs() {
+    auto directory = tasm::TileFiles::directoryForTilesInFrames(*entry_, firstFrame_, lastFrame_);
+
+    // Tile t is stored in track t + 1, so the tracks have to be ordered by tile number.
+    if (!encodedDataForTiles_.empty()) {
+        assert(outputs().empty());
+        assert(encodedDataForTiles_.size() == tileLayout_.numberOfTiles());
+        std::vector<const tasm::gpac::EncodedChunks*> tracks;
+        for (const auto &tileAndData : encodedDataForTiles_)
+            tracks.push_back(&tileAndData.second);
+        tasm::gpac::mux_hevc_from_memory(tracks, frameRate_, tasm::TileFiles::packedTilesFilename(directory));
+        return;
     }
 
-    writeTileMetadata();
+    std::vector<std::experimental::filesystem::path> sources(tileLayout_.numberOfTiles());
+    assert(outputs().size() == sources.size());
+    for (auto &output : outputs())
+        sources[output.tileNumber()] = output.filename();
 
-    entry_->incrementTileVersion();
+    tasm::gpac::mux_media_as_tracks(sources, tasm::TileFiles::packedTilesFilename(directory));
 }
 
 void TileCrackingTransaction::writeTileMetadata() {
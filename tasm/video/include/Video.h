@@ -57,10 +57,21 @@ public:
     const std::string &name() const { return name_; }
     const std::string &metadataIdentifier() const { return metadataIdentifier_; }
 
+    // Allocates a new tile version for the next directory that is written.
+    // Directories with the new version stay invisible to readers until publishTileVersion() is called.
     void incrementTileVersion();
 
+    // Atomically makes every directory written through this entry visible to readers that open afterwards.
+    void publishTileVersion();
+
+    // Removes directories left behind by writes that were never published, so their versions can be reused.
+    // Only the holder of the entry's write lock may call this; see CatalogSnapshots::lockForWriting.
+    void discardUnpublishedTileDirectories();
+
+    unsigned int loadPublishedTileVersion() const { return loadVersion(); }
+
 private:
-    unsigned int loadVersion() {
+    unsigned int loadVersion() const {
         auto versionPath = path_ / "tile-version";
 
         if (std::experimental::filesystem::exists(versionPath)) {
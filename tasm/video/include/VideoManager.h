@@ -4,6 +4,7 @@
 #include "GPUContext.h"
 #include "ImageUtilities.h"
 #include "RegretAccumulator.h"
+#include "TileVersionCompactor.h"
 #include "VideoLock.h"
 #include <experimental/filesystem>
 #include <TileConfigurationProvider.h>
@@ -22,14 +23,19 @@ enum class SelectStrategy{
 
 class VideoManager {
 public:
-    VideoManager()
-        : gpuContext_(new GPUContext(0)),
-        lock_(new VideoLock(gpuContext_)) {
+    VideoManager() {
+        // Without a GPU, videos can still be queried by decoding them on the CPU.
+        if (GPUContext::device_count()) {
+            gpuContext_ = std::make_shared<GPUContext>(0);
+            lock_ = std::make_shared<VideoLock>(gpuContext_);
+        }
         createCatalogIfNecessary();
     }
 
     void store(const std::experimental::filesystem::path &path, const std::string &name);
     void storeWithUniformLayout(const std::experimental::filesystem::path &path, const std::string &name, unsigned int numRows, unsigned int numColumns);
+    // Stores an HEVC video that was encoded with motion-constrained tiles using its own tile grid, without re-encoding it.
+    void storePreTiled(const std::experimental::filesystem::path &path, const std::string &name);
     void storeWithNonUniformLayout(const std::experimental::filesystem::path &path,
                                     const std::string &storedName,
                                     const std::string &metadataIdentifier,
@@ -42,24 +48,31 @@ public:
                                           std::shared_ptr<MetadataSelection> metadataSelection,
                                           std::shared_ptr<TemporalSelection> temporalSelection,
                                           std::shared_ptr<SemanticIndex> semanticIndex,
-                                          SelectStrategy selectStrategy=SelectStrategy::Objects);
+                                          SelectStrategy selectStrategy=SelectStrategy::Objects,
+                                          PixelFormat format=PixelFormat::RGBA);
 
     void retileVideoBasedOnRegret(const std::string &video);
 
     void activateRegretBasedRetilingForVideo(const std::string &video, const std::string &metadataIdentifier, std::shared_ptr<SemanticIndex> semanticIndex, double threshold = 1.0);
     void deactivateRegretBasedRetilingForVideo(const std::string &video);
 
+    unsigned int compactTileVersions(const std::string &video);
+    void startBackgroundCompaction(std::chrono::seconds interval);
+    void stopBackgroundCompaction();
+
 private:
     void createCatalogIfNecessary();
     void storeTiledVideo(std::shared_ptr<Video>, std::shared_ptr<TileLayoutProvider>, const std::string &savedName);
     void setUpRegretBasedRetiling(const std::string &video, std::shared_ptr<SemanticDataManager> selection, std::shared_ptr<TileLayoutProvider> currentLayout);
     void accumulateRegret(const std::string &video, std::shared_ptr<SemanticDataManager> selection, std::shared_ptr<TileLayoutProvider> currentLayout);
     void retileVideo(std::shared_ptr<Video> video, std::shared_ptr<std::vector<int>> framesToRead, std::shared_ptr<TileLayoutProvider> newLayoutProvider, const std::string &savedName);
+    void assertHasGPU(const std::string &operation) const;
 
     std::shared_ptr<GPUContext> gpuContext_;
     std::shared_ptr<VideoLock> lock_;
 
     std::unordered_map<std::string, std::shared_ptr<RegretAccumulator>> videoToRegretAccumulator_;
+    std::unique_ptr<BackgroundTileVersionCompactor> backgroundCompactor_;
 };
 
 } // namespace tasm
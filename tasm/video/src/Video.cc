@@ -1,14 +1,40 @@
 #include "Video.h"
 
+#include "EncodedGOPCache.h"
 #include "Files.h"
 
 namespace tasm {
 
 void TiledEntry::incrementTileVersion() {
-    std::ofstream output(TileFiles::tileVersionFilename(path_));
-
     ++version_;
-    auto newVersionAsString = std::to_string( version_);
-    std::copy(newVersionAsString.begin(), newVersionAsString.end(), std::ostreambuf_iterator<char>(output));
+}
+
+void TiledEntry::publishTileVersion() {
+    // Write to a temporary file and rename it so readers never see a partially-written version.
+    auto versionPath = TileFiles::tileVersionFilename(path_);
+    auto temporaryPath = versionPath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream output(temporaryPath);
+        auto newVersionAsString = std::to_string(version_);
+        std::copy(newVersionAsString.begin(), newVersionAsString.end(), std::ostreambuf_iterator<char>(output));
+    }
+    std::experimental::filesystem::rename(temporaryPath, versionPath);
+}
+
+void TiledEntry::discardUnpublishedTileDirectories() {
+    auto publishedVersion = loadVersion();
+    for (auto &dir : std::experimental::filesystem::directory_iterator(path_)) {
+        if (!std::experimental::filesystem::is_directory(dir.status()) || TileFiles::isObsoleteDirectory(dir.path()))
+            continue;
+
+        if (TileFiles::tileVersionFromPath(dir.path()) >= publishedVersion) {
+            std::experimental::filesystem::remove_all(dir.path());
+            // A later write reuses the version, so nothing read from the discarded directory may be served for it.
+            EncodedGOPCache::instance().invalidateDirectory(dir.path());
+            TileFiles::forgetPackedTiles(dir.path());
+        }
+    }
+    version_ = publishedVersion;
 }
 } // namespace tasm
\ No newline at end of file
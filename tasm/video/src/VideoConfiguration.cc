@@ -1,5 +1,6 @@
 #include "VideoConfiguration.h"
 
+#include "Files.h"
 #include <cassert>
 #include <iostream>
 #include <stdexcept>
@@ -25,9 +26,14 @@ std::unique_ptr<Configuration> GetConfiguration(const std::experimental::filesys
     char error[AV_ERROR_MAX_STRING_SIZE];
     auto context = avformat_alloc_context();
 
+    // Tiles stored in a packed container are read from the stream corresponding to the tile.
+    auto containerAndTrack = TileFiles::containerAndTrackForTile(path);
+    auto &container = containerAndTrack.first;
+    auto streamIndex = containerAndTrack.second - 1;
+
     std::unique_ptr<Configuration> configuration;
     try {
-        if ((result = avformat_open_input(&context, path.c_str(), nullptr, nullptr)) < 0) {
+        if ((result = avformat_open_input(&context, container.c_str(), nullptr, nullptr)) < 0) {
             throw std::runtime_error(av_make_error_string(error, AV_ERROR_MAX_STRING_SIZE, result));
         } else if ((result = avformat_find_stream_info(context, nullptr)) < 0) {
             throw std::runtime_error(av_make_error_string(error, AV_ERROR_MAX_STRING_SIZE, result));
@@ -35,8 +41,8 @@ std::unique_ptr<Configuration> GetConfiguration(const std::experimental::filesys
             throw std::runtime_error("No bitrate detected");
         }
 
-        assert(context->nb_streams == 1);
-        auto stream = context->streams[0];
+        assert(streamIndex < context->nb_streams);
+        auto stream = context->streams[streamIndex];
 
         auto displayWidth = stream->codecpar->width;
         auto displayHeight = stream->codecpar->height;
@@ -1,5 +1,6 @@
 #include "VideoManager.h"
 
+#include "CompressedTileIngester.h"
 #include "ImageUtilities.h"
 #include "MergeTiles.h"
 #include "TileLocationProvider.h"
@@ -7,10 +8,12 @@
 #include "ScanOperators.h"
 #include "ScanTiledVideoOperator.h"
 #include "DecodeOperators.h"
+#include "EnvironmentConfiguration.h"
 #include "SemanticIndex.h"
 #include "SemanticSelection.h"
 #include "SmartTileConfigurationProvider.h"
 #include "TemporalSelection.h"
+#include "TileCoarsener.h"
 #include "TileOperators.h"
 #include "TransformToImage.h"
 #include "Video.h"
@@ -36,9 +39,34 @@ void VideoManager::store(const std::experimental::filesystem::path &path, const
 void VideoManager::storeWithUniformLayout(const std::experimental::filesystem::path &path, const std::string &name, unsigned int numRows, unsigned int numColumns) {
     std::shared_ptr<Video> video(new Video(path));
     auto tileConfigurationProvider = std::make_shared<UniformTileconfigurationProvider>(numRows, numColumns, video->configuration());
+
+    // If the video is already tiled with the requested layout, split its bitstream instead of re-encoding it.
+    // Untiled sources are always re-encoded, so that they are stored with TASM's own GOPs and encoder settings.
+    if (EnvironmentConfiguration::instance().ingestTiledSources() && numRows * numColumns > 1) {
+        CompressedTileIngester ingester(video, name);
+        auto sourceLayout = ingester.sourceTileLayout();
+        if (sourceLayout && *sourceLayout == *tileConfigurationProvider->tileLayoutForFrame(0)) {
+            try {
+                ingester.ingest();
+                return;
+            } catch (const std::runtime_error &error) {
+                std::cerr << "Re-encoding " << path << " because its tiles cannot be extracted: " << error.what() << std::endl;
+            }
+        }
+    }
+
     storeTiledVideo(video, tileConfigurationProvider, name);
 }
 
+void VideoManager::storePreTiled(const std::experimental::filesystem::path &path, const std::string &name) {
+    std::shared_ptr<Video> video(new Video(path));
+    CompressedTileIngester ingester(video, name);
+    if (!ingester.sourceTileLayout())
+        throw std::runtime_error("Cannot extract tiles from " + path.string());
+
+    ingester.ingest();
+}
+
 void VideoManager::storeWithNonUniformLayout(const std::experimental::filesystem::path &path,
                                                 const std::string &storedName,
                                                 const std::string &metadataIdentifier,
@@ -68,7 +96,14 @@ void VideoManager::storeWithNonUniformLayout(const std::experimental::filesystem
     storeTiledVideo(video, layoutProvider, storedName);
 }
 
+void VideoManager::assertHasGPU(const std::string &operation) const {
+    // Tiles are encoded with NVENC, so only queries can run on hosts without a GPU.
+    if (!gpuContext_)
+        throw std::runtime_error(operation + " requires a GPU");
+}
+
 void VideoManager::storeTiledVideo(std::shared_ptr<Video> video, std::shared_ptr<TileLayoutProvider> tileLayoutProvider, const std::string &savedName) {
+    assertHasGPU("Storing a video");
     std::shared_ptr<ScanFileDecodeReader> scan(new ScanFileDecodeReader(video));
     std::shared_ptr<GPUDecodeFromCPU> decode(new GPUDecodeFromCPU(scan, video->configuration(), gpuContext_, lock_));
 
@@ -96,10 +131,19 @@ void VideoManager::retileVideoBasedOnRegret(const std::string &videoName) {
     // That should probably get more flexible, but for now sorting is easy.
     std::sort(frames->begin(), frames->end());
 
-    retileVideo(video, frames, std::make_shared<ConglomerationTileConfigurationProvider>(std::move(gopToLayouts), gopLength), videoName);
+    auto newLayoutProvider = std::make_shared<ConglomerationTileConfigurationProvider>(std::move(gopToLayouts), gopLength);
+
+    // GOPs whose new layout only merges current tiles are stitched without decoding; the rest are re-encoded.
+    frames = TileCoarsener(tiledEntry).coarsen(*frames, *newLayoutProvider, gopLength, video->configuration().frameRate);
+    if (frames->empty())
+        return;
+
+    retileVideo(video, frames, newLayoutProvider, videoName);
 }
 
 void VideoManager::retileVideo(std::shared_ptr<Video> video, std::shared_ptr<std::vector<int>> framesToRead, std::shared_ptr<TileLayoutProvider> newLayoutProvider, const std::string &savedName) {
+    assertHasGPU("Re-tiling a video");
+
     // Set up scan of original video using specified frames. Re-tile entire GOPs, even if not every frame is specified.
     auto scan = std::make_shared<ScanFramesFromFileDecodeReader>(video, framesToRead, true);
     auto decode = std::make_shared<GPUDecodeFromCPU>(scan, video->configuration(), gpuContext_, lock_);
@@ -110,12 +154,40 @@ void VideoManager::retileVideo(std::shared_ptr<Video> video, std::shared_ptr<std
     }
 }
 
+// Decodes with libavcodec and crops before converting to RGB so that only the pixels that are returned are converted.
+static std::unique_ptr<ImageIterator> selectWithSoftwareDecode(std::shared_ptr<Operator<CPUEncodedFrameDataPtr>> scan,
+                                                             std::shared_ptr<SemanticDataManager> semanticDataManager,
+                                                             std::shared_ptr<TileLayoutProvider> tileLayoutProvider,
+                                                             SelectStrategy selectStrategy,
+                                                             PixelFormat format,
+                                                             bool scansFullFrames) {
+    auto numberOfThreads = EnvironmentConfiguration::instance().softwareDecodeThreads();
+    if (!numberOfThreads)
+        numberOfThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Tiles are decoded by independent streams. Full frames come from a single stream, so it gets all of the threads.
+    auto threadsPerStream = scansFullFrames ? numberOfThreads : 1u;
+    auto decode = std::make_shared<SoftwareDecodeFromCPU>(scan, numberOfThreads, threadsPerStream);
+
+    std::shared_ptr<Operator<CPUPixelDataContainer>> mergeOperator;
+    if (selectStrategy == SelectStrategy::Objects) {
+        std::cout << "Merging pixels to recover objects" << std::endl;
+        mergeOperator = std::make_shared<MergeCPUTilesOperator>(decode, semanticDataManager, tileLayoutProvider);
+    } else {
+        std::cout << "Returning raw tiles" << std::endl;
+        mergeOperator = std::make_shared<CPUTilesToPixelsOperator>(decode, tileLayoutProvider);
+    }
+
+    return std::make_unique<ImageIterator>(std::make_shared<TransformCPUPixelsToImage>(mergeOperator, format), format);
+}
+
 std::unique_ptr<ImageIterator> VideoManager::select(const std::string &video,
                                                     const std::string &metadataIdentifier,
                                                     std::shared_ptr<MetadataSelection> metadataSelection,
                                                     std::shared_ptr<TemporalSelection> temporalSelection,
                                                     std::shared_ptr<SemanticIndex> semanticIndex,
-                                                    SelectStrategy selectStrategy) {
+                                                    SelectStrategy selectStrategy,
+                                                    PixelFormat format) {
     std::shared_ptr<TiledEntry> entry(new TiledEntry(video, metadataIdentifier));
 
     // Set up scan of a tiled video.
@@ -141,6 +213,13 @@ std::unique_ptr<ImageIterator> VideoManager::select(const std::string &video,
     configuration.maxWidth = maxWidth;
     configuration.maxHeight = maxHeight;
 
+    bool shouldDecodeInSoftware = !gpuContext_ || EnvironmentConfiguration::instance().softwareDecode();
+    // Multiple decoder instances only spread reads across GPU decoders; the software decoder already decodes tiles in parallel.
+    auto numberOfDecoders = shouldDecodeInSoftware ? 1u : std::max(1u, EnvironmentConfiguration::instance().decoderInstances());
+    // Objects that span tiles are read from full frames where only the tiles that contain objects have content.
+    // Whether a GOP is stitched is decided as the scans reach it; the stitched GOPs are read after the tiles of the others.
+    std::shared_ptr<ObjectStitchingLayoutProvider> stitchedFrames;
+    std::shared_ptr<ScanFullFramesFromTiledVideoOperator> scanStitchedFrames;
     if (selectStrategy == SelectStrategy::Frames) {
         auto scanFullFrames = std::make_shared<ScanFullFramesFromTiledVideoOperator>(entry, semanticDataManager, tileLocationProvider);
         scan = scanFullFrames;
@@ -154,30 +233,59 @@ std::unique_ptr<ImageIterator> VideoManager::select(const std::string &video,
         maxWidth = configuration.maxWidth;
         maxHeight = configuration.maxHeight;
     } else {
-        scan = std::make_shared<ScanTiledVideoOperator>(entry, semanticDataManager, tileLocationProvider);
+        if (selectStrategy == SelectStrategy::Objects) {
+            stitchedFrames = std::make_shared<ObjectStitchingLayoutProvider>(semanticDataManager, tileLocationProvider);
+            scanStitchedFrames = std::make_shared<ScanFullFramesFromTiledVideoOperator>(entry, semanticDataManager, tileLocationProvider, true, stitchedFrames);
+            tileLayoutProvider = stitchedFrames;
+
+            // The decoder must be able to hold the stitched frames.
+            maxWidth = std::max(maxWidth, scanStitchedFrames->configuration().maxWidth);
+            maxHeight = std::max(maxHeight, scanStitchedFrames->configuration().maxHeight);
+            configuration.maxWidth = maxWidth;
+            configuration.maxHeight = maxHeight;
+        }
+        if (numberOfDecoders == 1)
+            scan = std::make_shared<ScanTiledVideoOperator>(entry, semanticDataManager, tileLocationProvider, false, stitchedFrames);
+        if (scan && scanStitchedFrames)
+            scan = std::make_shared<ConcatenateScansOperator>(std::vector<std::shared_ptr<Operator<CPUEncodedFrameDataPtr>>>{scan, scanStitchedFrames});
     }
 
-    std::shared_ptr<GPUDecodeFromCPU> decode(new GPUDecodeFromCPU(scan, configuration, gpuContext_, lock_, maxWidth, maxHeight));
-    auto toRGB = std::make_shared<TransformToRGB>(decode);
+    // Accumulate regret for this query.
+    if (videoToRegretAccumulator_.count(video))
+        accumulateRegret(video, semanticDataManager, tileLocationProvider);
 
+    if (shouldDecodeInSoftware)
+        return selectWithSoftwareDecode(scan, semanticDataManager, tileLayoutProvider, selectStrategy, format, selectStrategy == SelectStrategy::Frames);
+
+    std::shared_ptr<ConfigurationOperator<GPUDecodedFrameData>> decode;
+    if (scan) {
+        decode = std::make_shared<GPUDecodeFromCPU>(scan, configuration, gpuContext_, lock_, maxWidth, maxHeight);
+    } else {
+        // The query is planned once, and each decoder scans the tile reads that the scheduler assigns to it.
+        auto planner = std::make_shared<TileReadPlanner>(semanticDataManager, tileLocationProvider, numberOfDecoders, stitchedFrames);
+        std::vector<std::shared_ptr<ConfigurationOperator<GPUDecodedFrameData>>> decoders;
+        for (auto i = 0u; i < numberOfDecoders; ++i) {
+            std::shared_ptr<Operator<CPUEncodedFrameDataPtr>> scanForDecoder = std::make_shared<ScanTiledVideoOperator>(entry, planner, i);
+            if (!i && scanStitchedFrames)
+                scanForDecoder = std::make_shared<ConcatenateScansOperator>(std::vector<std::shared_ptr<Operator<CPUEncodedFrameDataPtr>>>{scanForDecoder, scanStitchedFrames});
+            decoders.push_back(std::make_shared<GPUDecodeFromCPU>(scanForDecoder, configuration, gpuContext_, lock_, maxWidth, maxHeight));
+        }
+        decode = std::make_shared<InterleaveDecodedFrames>(std::move(decoders));
+    }
     // Transform tiles to pixel blobs.
     std::shared_ptr<Operator<GPUPixelDataContainer>> mergeOperator;
     if (selectStrategy == SelectStrategy::Objects) {
         std::cout << "Merging pixels to recover objects" << std::endl;
-        mergeOperator = std::make_shared<MergeTilesOperator>(toRGB, semanticDataManager, tileLayoutProvider);
+        mergeOperator = std::make_shared<MergeTilesOperator>(decode, semanticDataManager, tileLayoutProvider);
     } else {
         std::cout << "Returning raw tiles" << std::endl;
-        mergeOperator = std::make_shared<TilesToPixelsOperator>(toRGB);
+        mergeOperator = std::make_shared<TilesToPixelsOperator>(decode, tileLayoutProvider);
     }
 
-    // Transform pixels to RGB images.
-    std::shared_ptr<TransformToImage> transform(new TransformToImage(mergeOperator, maxWidth, maxHeight));
-
-    // Accumulate regret for this query.
-    if (videoToRegretAccumulator_.count(video))
-        accumulateRegret(video, semanticDataManager, tileLocationProvider);
+    // Transform pixels to RGB images. Pixels are cropped before they are converted.
+    std::shared_ptr<TransformToImage> transform(new TransformToImage(mergeOperator, maxWidth, maxHeight, format));
 
-    return std::make_unique<ImageIterator>(transform);
+    return std::make_unique<ImageIterator>(transform, format);
 }
 
 void VideoManager::accumulateRegret(const std::string &video, std::shared_ptr<SemanticDataManager> selection, std::shared_ptr<TileLayoutProvider> currentLayout) {
@@ -208,4 +316,16 @@ void VideoManager::deactivateRegretBasedRetilingForVideo(const std::string &vide
     videoToRegretAccumulator_.erase(video);
 }
 
+unsigned int VideoManager::compactTileVersions(const std::string &video) {
+    return TileVersionCompactor(std::make_shared<TiledEntry>(video)).compact();
+}
+
+void VideoManager::startBackgroundCompaction(std::chrono::seconds interval) {
+    backgroundCompactor_ = std::make_unique<BackgroundTileVersionCompactor>(interval);
+}
+
+void VideoManager::stopBackgroundCompaction() {
+    backgroundCompactor_.reset();
+}
+
 } // namespace tasm
\ No newline at end of file